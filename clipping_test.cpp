@@ -21,9 +21,11 @@
  *****************************************************************************/
 
 #include <iostream>
-#include <fstream>
 #include <vector>
+#include <iterator>
+#include <algorithm>
 #include <cassert>
+#include <typeinfo>
 
 #include <boost/timer/timer.hpp>
 
@@ -31,6 +33,12 @@
 #include <boost/geometry/geometries/box.hpp>
 #include "geometry_impl.hpp"
 #include "geometry_adapters.hpp"
+#include "geometry_envelope.hpp"
+#include "geometry_clip.hpp"
+#include "geometry_wkt_loader.hpp"
+#include "geometry_index.hpp"
+#include "geometry_tile_clip.hpp"
+#include "geometry_parallel.hpp"
 
 
 namespace boost { namespace geometry {
@@ -48,39 +56,36 @@ struct point_type<mapnik::util::variant<mapnik::new_geometry::polygon3, mapnik::
 template <typename Geometry, typename Box>
 inline void read_wkt(std::string const& filename, std::vector<Geometry>& geometries, Box& box)
 {
-    std::ifstream file(filename.c_str());
-    if (file.is_open())
+    std::vector<mapnik::new_geometry::geometry> parsed;
+    mapnik::new_geometry::wkt_load_stats stats;
+    mapnik::new_geometry::wkt_loader loader;
     {
-        while (! file.eof() )
+        boost::timer::auto_cpu_timer t;
+        if (!loader.load(filename, parsed, stats))
         {
-            std::string line;
-            std::getline(file, line);
-            if (! line.empty())
-            {
-                mapnik::new_geometry::polygon3 poly;
-                try
-                {
-                    boost::geometry::read_wkt(line, poly);
-                    geometries.push_back(poly);
-                    boost::geometry::expand(box, boost::geometry::return_envelope<Box>(poly));
-                }
-                catch (boost::geometry::exception const& ex)
-                {
-                    mapnik::new_geometry::multi_polygon multi_poly;
-                    try
-                    {
-                        boost::geometry::read_wkt(line, multi_poly);
-                        geometries.push_back(multi_poly);
-                        boost::geometry::expand(box, boost::geometry::return_envelope<Box>(multi_poly));
-                    }
-                    catch (boost::geometry::exception const& ex)
-                    {
-                        std::cerr << ex.what() << std::endl;
-                    }
-                }
-            }
+            std::cerr << "Can't open " << filename << std::endl;
+            return;
+        }
+    }
+    if (stats.num_errors > 0) std::cerr << "Invalid WKT lines : " << stats.num_errors << std::endl;
+    mapnik::new_geometry::expand(box, stats.box);
+    geometries.reserve(geometries.size() + parsed.size());
+    std::size_t num_skipped = 0;
+    for (auto & geom : parsed)
+    {
+        if (geom.is<mapnik::new_geometry::polygon3>())
+        {
+            geometries.emplace_back(mapnik::new_geometry::cached_envelope<mapnik::new_geometry::polygon3>(
+                                        std::move(geom.get<mapnik::new_geometry::polygon3>())));
+        }
+        else if (geom.is<mapnik::new_geometry::multi_polygon>())
+        {
+            geometries.emplace_back(mapnik::new_geometry::cached_envelope<mapnik::new_geometry::multi_polygon>(
+                                        std::move(geom.get<mapnik::new_geometry::multi_polygon>())));
         }
+        else ++num_skipped;
     }
+    if (num_skipped > 0) std::cerr << "Skipped non polygonal geometries : " << num_skipped << std::endl;
 }
 
 template <typename Box, typename PolygonList>
@@ -97,7 +102,7 @@ struct intersection
 
     void operator() (mapnik::new_geometry::polygon3 const& poly)
     {
-        boost::geometry::intersection(clip_box_, poly, clipped_polygons_);
+        apply(poly, mapnik::new_geometry::envelope(poly));
     }
 
     void operator() (mapnik::new_geometry::multi_polygon const& multi_poly)
@@ -105,10 +110,39 @@ struct intersection
         for (auto const& poly : multi_poly)
         {
             //std::cerr << boost::geometry::wkt(poly) << std::endl;
-            boost::geometry::intersection(clip_box_, poly, clipped_polygons_);
+            apply(poly, mapnik::new_geometry::envelope(poly));
         }
     }
 
+    void operator() (mapnik::new_geometry::cached_envelope<mapnik::new_geometry::polygon3> const& geom)
+    {
+        apply(geom.geometry(), geom.envelope());
+    }
+
+    void operator() (mapnik::new_geometry::cached_envelope<mapnik::new_geometry::multi_polygon> const& geom)
+    {
+        mapnik::new_geometry::bounding_box const& bbox = geom.envelope();
+        if (!mapnik::new_geometry::intersects(clip_box_, bbox)) return;
+        if (mapnik::new_geometry::contains(clip_box_, bbox))
+        {
+            clipped_polygons_.insert(clipped_polygons_.end(), geom.geometry().begin(), geom.geometry().end());
+            return;
+        }
+        (*this)(geom.geometry());
+    }
+
+    // skip polygons outside clip_box, pass through polygons inside it
+    void apply(mapnik::new_geometry::polygon3 const& poly, mapnik::new_geometry::bounding_box const& bbox)
+    {
+        if (!mapnik::new_geometry::intersects(clip_box_, bbox)) return;
+        if (mapnik::new_geometry::contains(clip_box_, bbox))
+        {
+            clipped_polygons_.push_back(poly);
+            return;
+        }
+        boost::geometry::intersection(clip_box_, poly, clipped_polygons_);
+    }
+
     template <typename T>
     void operator() (T const& g)
     {
@@ -118,35 +152,210 @@ struct intersection
     PolygonList & clipped_polygons_;
 };
 
+// same short-circuits as `intersection`, clipping with box_clipper into a reusable buffer
+struct fast_intersection
+{
+    fast_intersection (mapnik::new_geometry::box_clipper & clipper, mapnik::new_geometry::clip_buffer & clipped_polygons)
+        : clipper_(clipper), clipped_polygons_(clipped_polygons) {}
+
+    template <typename Geometry>
+    void apply(Geometry const& geom)
+    {
+        mapnik::util::apply_visitor(*this, geom);
+    }
+
+    void operator() (mapnik::new_geometry::cached_envelope<mapnik::new_geometry::polygon3> const& geom)
+    {
+        apply(geom.geometry(), geom.envelope());
+    }
+
+    void operator() (mapnik::new_geometry::cached_envelope<mapnik::new_geometry::multi_polygon> const& geom)
+    {
+        mapnik::new_geometry::bounding_box const& bbox = geom.envelope();
+        if (!mapnik::new_geometry::intersects(clipper_.box(), bbox)) return;
+        for (auto const& poly : geom.geometry())
+        {
+            apply(poly, mapnik::new_geometry::envelope(poly));
+        }
+    }
+
+    void apply(mapnik::new_geometry::polygon3 const& poly, mapnik::new_geometry::bounding_box const& bbox)
+    {
+        if (!mapnik::new_geometry::intersects(clipper_.box(), bbox)) return;
+        if (mapnik::new_geometry::contains(clipper_.box(), bbox))
+        {
+            clipped_polygons_.append(poly);
+            return;
+        }
+        clipper_(poly, clipped_polygons_);
+    }
+
+    template <typename T>
+    void operator() (T const& g)
+    {
+        std::cerr << typeid(g).name() << std::endl;
+    }
+    mapnik::new_geometry::box_clipper & clipper_;
+    mapnik::new_geometry::clip_buffer & clipped_polygons_;
+};
+
+// box_clipper against a known area and boost::geometry::intersection,
+// for holes and exteriors meeting the box boundary
+bool check_clip(std::string const& poly_wkt, std::string const& box_wkt, double expected)
+{
+    mapnik::new_geometry::polygon3 poly;
+    boost::geometry::read_wkt(poly_wkt, poly);
+    boost::geometry::correct(poly);
+    mapnik::new_geometry::bounding_box box;
+    boost::geometry::read_wkt(box_wkt, box);
+    mapnik::new_geometry::box_clipper clipper(box);
+    mapnik::new_geometry::clip_buffer clipped_polygons;
+    clipper(poly, clipped_polygons);
+    std::vector<mapnik::new_geometry::polygon3> output;
+    clipped_polygons.append_to(output);
+    bool valid = true;
+    double area = 0;
+    for (auto const& p : output)
+    {
+        valid = valid && boost::geometry::is_valid(p);
+        area += boost::geometry::area(p);
+    }
+    std::vector<mapnik::new_geometry::polygon3> ref;
+    boost::geometry::intersection(box, poly, ref);
+    double ref_area = 0;
+    for (auto const& p : ref) ref_area += boost::geometry::area(p);
+    bool result = valid && std::abs(area - expected) <= 1e-9 && std::abs(area - ref_area) <= 1e-9;
+    if (!result)
+    {
+        std::cerr << "CLIP FAILED : " << poly_wkt << " " << box_wkt << " area " << area
+                  << " expected " << expected << " boost " << ref_area << " valid " << std::boolalpha << valid << std::endl;
+    }
+    return result;
+}
+
+// tile_clipper tile by tile against boost::geometry::intersection, for tile
+// lines running through hole and exterior vertices and edges
+bool check_tiles(std::string const& poly_wkt, mapnik::new_geometry::bounding_box const& extent, unsigned zoom)
+{
+    mapnik::new_geometry::polygon3 poly;
+    boost::geometry::read_wkt(poly_wkt, poly);
+    boost::geometry::correct(poly);
+    mapnik::new_geometry::tile_grid grid(extent, zoom);
+    mapnik::new_geometry::tile_clipper clipper(grid, 1);
+    clipper.add(mapnik::new_geometry::geometry(poly));
+    std::vector<mapnik::new_geometry::clipped_tile> tiles;
+    clipper.clip(tiles);
+    std::vector<double> tile_areas(grid.size() * grid.size(), 0.0);
+    bool result = true;
+    std::vector<mapnik::new_geometry::polygon3> output;
+    for (auto const& tile : tiles)
+    {
+        output.clear();
+        tile.polygons.append_to(output);
+        for (auto const& p : output)
+        {
+            result = result && boost::geometry::is_valid(p);
+            tile_areas[tile.y * grid.size() + tile.x] += boost::geometry::area(p);
+        }
+    }
+    for (unsigned y = 0; y < grid.size(); ++y)
+    {
+        for (unsigned x = 0; x < grid.size(); ++x)
+        {
+            std::vector<mapnik::new_geometry::polygon3> ref;
+            boost::geometry::intersection(grid.tile_box(x, y), poly, ref);
+            double ref_area = 0;
+            for (auto const& p : ref) ref_area += boost::geometry::area(p);
+            if (std::abs(tile_areas[y * grid.size() + x] - ref_area) > 1e-9)
+            {
+                std::cerr << "TILE FAILED : " << poly_wkt << " tile " << x << "," << y << " area "
+                          << tile_areas[y * grid.size() + x] << " boost " << ref_area << std::endl;
+                result = false;
+            }
+        }
+    }
+    return result;
+}
+
+// area of boost::geometry::intersection of every polygon with `box`
+template <typename Geometries>
+double reference_area(Geometries const& geometries, std::vector<std::size_t> const& hits,
+                      mapnik::new_geometry::bounding_box const& box)
+{
+    std::vector<mapnik::new_geometry::polygon3> ref;
+    intersection<mapnik::new_geometry::bounding_box, std::vector<mapnik::new_geometry::polygon3> > op(box, ref);
+    for (std::size_t hit : hits)
+    {
+        try
+        {
+            op.apply(geometries[hit]);
+        }
+        catch (boost::geometry::exception const& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+        }
+    }
+    double area = 0;
+    for (auto const& p : ref) area += boost::geometry::area(p);
+    return area;
+}
+
+// clipped area should match the reference up to rounding
+inline bool same_area(double area, double ref_area, double box_area)
+{
+    return std::abs(area - ref_area) <= 1e-6 * box_area;
+}
+
 int main(int argc, char ** argv)
 {
     using polygon_list = std::vector<mapnik::new_geometry::polygon3>;
     using geometry = mapnik::util::variant<mapnik::new_geometry::point,
                                            mapnik::new_geometry::line_string,
-                                           mapnik::new_geometry::polygon3,
-                                           mapnik::new_geometry::multi_polygon>;
+                                           mapnik::new_geometry::cached_envelope<mapnik::new_geometry::polygon3>,
+                                           mapnik::new_geometry::cached_envelope<mapnik::new_geometry::multi_polygon> >;
 
     std::cerr << "Clipping test" << std::endl;
+    bool clip_cases =
+        check_clip("POLYGON((0 0,0 10,10 10,10 0,0 0),(5 2,2 4,2 2,5 2))", "BOX(0 0,5 10)", 47) &&
+        check_clip("POLYGON((0 0,0 10,10 10,10 0,0 0),(2 2,8 2,8 5,2 5,2 2))", "BOX(2 0,10 10)", 62) &&
+        check_clip("POLYGON((0 0,0 10,10 10,10 0,0 0),(5 5,3 3,3 7,5 5))", "BOX(0 0,5 10)", 46) &&
+        check_clip("POLYGON((0 0,0 10,10 10,10 0,0 0),(5 2,5 6,2 6,2 2,5 2))", "BOX(0 0,5 10)", 38) &&
+        check_clip("POLYGON((0 0,0 10,10 10,10 0,0 0),(5 2,8 5,5 8,2 5,5 2))", "BOX(0 0,5 10)", 41) &&
+        check_clip("POLYGON((0 0,0 5,5 5,5 0,0 0))", "BOX(5 0,10 10)", 0) &&
+        check_clip("POLYGON((0 0,0 6,4 6,4 0,0 0))", "BOX(4 0,10 10)", 0) &&
+        check_clip("POLYGON((10.615384615384615 5,10 1,7.333333333333333 5,10.615384615384615 5))", "BOX(4 0,8 4)", 0) &&
+        check_clip("POLYGON((0 0,0 10,10 10,10 0,0 0),(2 2,2 8,5 5,2 2),(5 5,8 8,8 2,5 5))", "BOX(0 0,10 5)", 41);
+    std::cerr << "CLIP CASES : " << std::boolalpha << clip_cases << std::endl;
+    mapnik::new_geometry::bounding_box tile_extent(0, 0, 10, 10);
+    bool tile_cases =
+        check_tiles("POLYGON((0 0,0 10,10 10,10 0,0 0),(5 2,2 4,2 2,5 2))", tile_extent, 1) &&
+        check_tiles("POLYGON((0 0,0 10,10 10,10 0,0 0),(5 2,8 5,5 8,2 5,5 2))", tile_extent, 1) &&
+        check_tiles("POLYGON((0 0,0 10,10 10,10 0,0 0),(2.5 2.5,7.5 2.5,7.5 7.5,2.5 7.5,2.5 2.5))", tile_extent, 2) &&
+        check_tiles("POLYGON((1 1,1 9,9 9,9 1,1 1),(5 5,2 2,2 8,5 5),(5 5,8 8,8 2,5 5))", tile_extent, 2);
+    std::cerr << "TILE CASES : " << std::boolalpha << tile_cases << std::endl;
     std::cerr << "Boost.geometry" << std::endl;
 
-    if (argc != 4)
+    if (argc != 4 && argc != 5)
     {
-        std::cerr << "Usage:" << argv[0] << " <wkt-filename> <bbox-wkt> <num-iterations>" << std::endl;
+        std::cerr << "Usage:" << argv[0] << " <wkt-filename> <bbox-wkt> <num-iterations> [<tile-zoom>]" << std::endl;
         return EXIT_FAILURE;
     }
 
     std::string wkt_filename(argv[1]);
     std::string bbox_wkt(argv[2]);
     std::size_t num_iterations = std::stol(argv[3]);
+    unsigned zoom = (argc == 5) ? static_cast<unsigned>(std::stoul(argv[4])) : 4;
     std::cerr << "NUM_ITERATIONS=" << num_iterations << std::endl;
     mapnik::new_geometry::bounding_box clip_box;
     boost::geometry::read_wkt(bbox_wkt, clip_box);
     std::vector<geometry> geometries;
-    mapnik::new_geometry::bounding_box bbox;
+    mapnik::new_geometry::bounding_box bbox = mapnik::new_geometry::empty_envelope();
     read_wkt(wkt_filename, geometries , bbox);
+    bool valid_output = true;
+    double area = 0;
+    {
     boost::timer::auto_cpu_timer t;
 
-    bool valid_output = true;
     for (std::size_t i = 0; i < num_iterations ; ++i)
     {
         if (i == 0)
@@ -154,7 +363,7 @@ int main(int argc, char ** argv)
             std::cerr << "NUM GEOMETRIES = " << geometries.size() << std::endl;
         }
         std::size_t output_size = 0;
-        for (auto geom : geometries)
+        for (auto const& geom : geometries)
         {
 
             //std::cerr << "Area: " << boost::geometry::area(geom) << std::endl;
@@ -176,7 +385,8 @@ int main(int argc, char ** argv)
                     {
                         if (i == 0)
                         {
-                            valid_output = boost::geometry::is_valid(p);
+                            valid_output = valid_output && boost::geometry::is_valid(p);
+                            area += boost::geometry::area(p);
                             std::cout << boost::geometry::wkt(p) << std::endl;
                         }
                     }
@@ -189,6 +399,220 @@ int main(int argc, char ** argv)
         }
         if (i == 0) std::cerr << "OUPUT SIZE=" << output_size << std::endl;
     }
+    }
     std::cerr << "VALID OUTPUT : " << std::boolalpha << valid_output << std::endl;
-    return EXIT_SUCCESS;
+    std::cerr << "AREA : " << area << std::endl;
+
+    std::cerr << "box_clipper + packed_rtree" << std::endl;
+    bool valid_output_2 = true;
+    double area_2 = 0;
+    {
+        boost::timer::auto_cpu_timer t;
+        // candidates from the index, in layer order
+        std::vector<mapnik::new_geometry::bounding_box> envelopes;
+        envelopes.reserve(geometries.size());
+        for (auto const& geom : geometries)
+        {
+            envelopes.push_back(mapnik::util::apply_visitor(mapnik::new_geometry::envelope_visitor(), geom));
+        }
+        mapnik::new_geometry::packed_rtree index(envelopes.begin(), envelopes.end());
+        std::vector<std::size_t> hits;
+        mapnik::new_geometry::box_clipper clipper(clip_box);
+        mapnik::new_geometry::clip_buffer clipped_polygons;
+        polygon_list output;
+        for (std::size_t i = 0; i < num_iterations ; ++i)
+        {
+            clipped_polygons.clear();
+            hits.clear();
+            index.query(clip_box, std::back_inserter(hits));
+            std::sort(hits.begin(), hits.end());
+            fast_intersection op(clipper, clipped_polygons);
+            for (std::size_t hit : hits)
+            {
+                op.apply(geometries[hit]);
+            }
+            if (i == 0)
+            {
+                std::cerr << "OUPUT SIZE=" << clipped_polygons.num_polygons() << std::endl;
+                clipped_polygons.append_to(output);
+                for (auto const& p : output)
+                {
+                    valid_output_2 = valid_output_2 && boost::geometry::is_valid(p);
+                    area_2 += boost::geometry::area(p);
+                }
+            }
+        }
+    }
+    std::cerr << "VALID OUTPUT : " << std::boolalpha << valid_output_2 << std::endl;
+    std::cerr << "AREA : " << area_2 << std::endl;
+    bool same_as_boost = same_area(area_2, area, boost::geometry::area(clip_box));
+    std::cerr << "SAME AS BOOST : " << std::boolalpha << same_as_boost << std::endl;
+
+    std::cerr << "box_clipper + parallel_executor" << std::endl;
+    std::size_t output_size_3 = 0;
+    double area_3 = 0;
+    {
+        boost::timer::auto_cpu_timer t;
+        mapnik::new_geometry::parallel_executor executor;
+        // one clipper and output buffer per batch, keyed by its first feature
+        std::vector<mapnik::new_geometry::clip_buffer> batch_output(geometries.size());
+        for (std::size_t i = 0; i < num_iterations ; ++i)
+        {
+            executor.for_each_batch(geometries.size(),
+                [&geometries](std::size_t index) { return mapnik::new_geometry::num_vertices(geometries[index]); },
+                [&geometries, &batch_output, &clip_box](std::size_t first, std::size_t last)
+                {
+                    mapnik::new_geometry::box_clipper clipper(clip_box);
+                    mapnik::new_geometry::clip_buffer & clipped_polygons = batch_output[first];
+                    clipped_polygons.clear();
+                    fast_intersection op(clipper, clipped_polygons);
+                    for (std::size_t index = first; index < last; ++index)
+                    {
+                        op.apply(geometries[index]);
+                    }
+                });
+            if (i == 0)
+            {
+                polygon_list output;
+                for (auto const& clipped_polygons : batch_output)
+                {
+                    output_size_3 += clipped_polygons.num_polygons();
+                    clipped_polygons.append_to(output);
+                }
+                for (auto const& p : output) area_3 += boost::geometry::area(p);
+                std::cerr << "OUPUT SIZE=" << output_size_3 << std::endl;
+            }
+        }
+    }
+    std::cerr << "AREA : " << area_3 << std::endl;
+
+    // whole layer into every tile of `zoom` over its extent
+    mapnik::new_geometry::tile_grid grid(bbox, zoom);
+    std::cerr << "Tiles ZOOM=" << zoom << " box_clipper + packed_rtree per tile" << std::endl;
+    std::size_t num_tiles = 0;
+    std::size_t tile_output_size = 0;
+    double tile_area = 0;
+    // boost::geometry::intersection area per tile, computed outside the timer
+    std::vector<double> tile_ref(grid.size() * grid.size(), 0.0);
+    std::size_t num_bad_tiles = 0;
+    {
+        boost::timer::auto_cpu_timer t;
+        std::vector<mapnik::new_geometry::bounding_box> envelopes;
+        envelopes.reserve(geometries.size());
+        for (auto const& geom : geometries)
+        {
+            envelopes.push_back(mapnik::util::apply_visitor(mapnik::new_geometry::envelope_visitor(), geom));
+        }
+        mapnik::new_geometry::packed_rtree index(envelopes.begin(), envelopes.end());
+        std::vector<std::size_t> hits;
+        mapnik::new_geometry::box_clipper clipper(grid.extent);
+        mapnik::new_geometry::clip_buffer clipped_polygons;
+        polygon_list output;
+        for (unsigned y = 0; y < grid.size(); ++y)
+        {
+            for (unsigned x = 0; x < grid.size(); ++x)
+            {
+                mapnik::new_geometry::bounding_box tile_box = grid.tile_box(x, y);
+                clipper.reset(tile_box);
+                clipped_polygons.clear();
+                hits.clear();
+                index.query(tile_box, std::back_inserter(hits));
+                std::sort(hits.begin(), hits.end());
+                fast_intersection op(clipper, clipped_polygons);
+                for (std::size_t hit : hits)
+                {
+                    op.apply(geometries[hit]);
+                }
+                if (clipped_polygons.num_polygons() == 0) continue;
+                ++num_tiles;
+                tile_output_size += clipped_polygons.num_polygons();
+                output.clear();
+                clipped_polygons.append_to(output);
+                for (auto const& p : output) tile_area += boost::geometry::area(p);
+            }
+        }
+    }
+    {
+        std::vector<mapnik::new_geometry::bounding_box> envelopes;
+        envelopes.reserve(geometries.size());
+        for (auto const& geom : geometries)
+        {
+            envelopes.push_back(mapnik::util::apply_visitor(mapnik::new_geometry::envelope_visitor(), geom));
+        }
+        mapnik::new_geometry::packed_rtree index(envelopes.begin(), envelopes.end());
+        std::vector<std::size_t> hits;
+        mapnik::new_geometry::box_clipper clipper(grid.extent);
+        mapnik::new_geometry::clip_buffer clipped_polygons;
+        polygon_list output;
+        for (unsigned y = 0; y < grid.size(); ++y)
+        {
+            for (unsigned x = 0; x < grid.size(); ++x)
+            {
+                mapnik::new_geometry::bounding_box tile_box = grid.tile_box(x, y);
+                hits.clear();
+                index.query(tile_box, std::back_inserter(hits));
+                std::sort(hits.begin(), hits.end());
+                double ref_area = reference_area(geometries, hits, tile_box);
+                tile_ref[y * grid.size() + x] = ref_area;
+                clipper.reset(tile_box);
+                clipped_polygons.clear();
+                fast_intersection op(clipper, clipped_polygons);
+                for (std::size_t hit : hits)
+                {
+                    op.apply(geometries[hit]);
+                }
+                output.clear();
+                clipped_polygons.append_to(output);
+                double area_tile = 0;
+                bool valid_tile = true;
+                for (auto const& p : output)
+                {
+                    area_tile += boost::geometry::area(p);
+                    valid_tile = valid_tile && boost::geometry::is_valid(p);
+                }
+                if (!valid_tile || !same_area(area_tile, ref_area, boost::geometry::area(tile_box))) ++num_bad_tiles;
+            }
+        }
+    }
+    std::cerr << "TILES=" << num_tiles << " OUPUT SIZE=" << tile_output_size << " AREA : " << tile_area << std::endl;
+    std::cerr << "TILES DIFFERENT FROM BOOST : " << num_bad_tiles << std::endl;
+
+    std::cerr << "Tiles ZOOM=" << zoom << " tile_clipper" << std::endl;
+    std::size_t tile_output_size_2 = 0;
+    double tile_area_2 = 0;
+    std::vector<mapnik::new_geometry::clipped_tile> tiles;
+    {
+        boost::timer::auto_cpu_timer t;
+        mapnik::new_geometry::tile_clipper clipper(grid);
+        for (auto const& geom : geometries)
+        {
+            clipper.add(geom);
+        }
+        clipper.clip(tiles);
+    }
+    polygon_list output;
+    std::size_t num_bad_tiles_2 = 0;
+    for (auto const& tile : tiles)
+    {
+        tile_output_size_2 += tile.polygons.num_polygons();
+        output.clear();
+        tile.polygons.append_to(output);
+        double area_tile = 0;
+        bool valid_tile = true;
+        for (auto const& p : output)
+        {
+            area_tile += boost::geometry::area(p);
+            valid_tile = valid_tile && boost::geometry::is_valid(p);
+        }
+        tile_area_2 += area_tile;
+        double box_area = boost::geometry::area(grid.tile_box(tile.x, tile.y));
+        if (!valid_tile || !same_area(area_tile, tile_ref[tile.y * grid.size() + tile.x], box_area)) ++num_bad_tiles_2;
+    }
+    std::cerr << "TILES=" << tiles.size() << " OUPUT SIZE=" << tile_output_size_2 << " AREA : " << tile_area_2 << std::endl;
+    std::cerr << "TILES DIFFERENT FROM BOOST : " << num_bad_tiles_2 << std::endl;
+    bool same_tiles = tiles.size() == num_tiles && std::abs(tile_area - tile_area_2) <= 1e-9 * std::abs(tile_area);
+    std::cerr << "SAME TILES : " << std::boolalpha << same_tiles << std::endl;
+    bool same_output = std::abs(area_2 - area_3) <= 1e-9 * std::abs(area_2);
+    return (clip_cases && tile_cases && valid_output && valid_output_2 && same_as_boost && same_output && same_tiles &&
+            num_bad_tiles == 0 && num_bad_tiles_2 == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
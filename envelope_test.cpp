@@ -0,0 +1,213 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <string>
+#include <algorithm>
+#include <limits>
+
+#include <boost/timer/timer.hpp>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunknown-pragmas"
+#pragma GCC diagnostic ignored "-Wshadow"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#pragma GCC diagnostic ignored "-Wunused-local-typedef"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#include <boost/geometry.hpp>
+#include <boost/geometry/geometries/box.hpp>
+#pragma GCC diagnostic pop
+
+#include "geometry_impl.hpp"
+#include "geometry_adapters.hpp"
+#include "geometry_envelope.hpp"
+
+bool same_box(mapnik::new_geometry::bounding_box const& a, mapnik::new_geometry::bounding_box const& b)
+{
+    return a.p0.x == b.p0.x && a.p0.y == b.p0.y && a.p1.x == b.p1.x && a.p1.y == b.p1.y;
+}
+
+template <typename Geometry>
+bool compare(std::string const& name, std::vector<Geometry> const& geometries)
+{
+    using box_type = boost::geometry::model::box<mapnik::new_geometry::point>;
+    std::cerr << "========== " << name << std::endl;
+    std::vector<mapnik::new_geometry::bounding_box> boost_boxes;
+    std::vector<mapnik::new_geometry::bounding_box> native_boxes;
+    boost_boxes.reserve(geometries.size());
+    native_boxes.reserve(geometries.size());
+    {
+        std::cerr << "boost::geometry::envelope ";
+        boost::timer::auto_cpu_timer t;
+        for (auto const& geom : geometries)
+        {
+            box_type box;
+            boost::geometry::envelope(geom, box);
+            boost_boxes.emplace_back(box.min_corner().x, box.min_corner().y, box.max_corner().x, box.max_corner().y);
+        }
+    }
+    {
+        std::cerr << "mapnik::new_geometry::envelope ";
+        boost::timer::auto_cpu_timer t;
+        for (auto const& geom : geometries)
+        {
+            native_boxes.push_back(mapnik::new_geometry::envelope(geom));
+        }
+    }
+    bool same = std::equal(boost_boxes.begin(), boost_boxes.end(), native_boxes.begin(), same_box);
+    std::cerr << "SAME RESULT : " << std::boolalpha << same << std::endl;
+    return same;
+}
+
+// layouts Boost.Geometry can't read, against the polygon3 envelopes
+template <typename Geometry>
+bool compare_layout(std::string const& name, std::vector<Geometry> const& geometries,
+                    std::vector<mapnik::new_geometry::polygon3> const& polygons)
+{
+    bool same = true;
+    for (std::size_t i = 0; i < geometries.size(); ++i)
+    {
+        same = same && same_box(mapnik::new_geometry::envelope(geometries[i]), mapnik::new_geometry::envelope(polygons[i]));
+    }
+    std::cerr << "========== " << name << " SAME RESULT AS polygon3 : " << std::boolalpha << same << std::endl;
+    return same;
+}
+
+// empty points are NaN : every kernel skips them, wherever they fall in a vector
+bool check_empty_points()
+{
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    mapnik::new_geometry::multi_point multi_pt;
+    multi_pt.emplace_back(5, 5);
+    multi_pt.emplace_back(nan, nan);
+    multi_pt.emplace_back(1, 1);
+    bool same = same_box(mapnik::new_geometry::envelope(multi_pt), mapnik::new_geometry::bounding_box(1, 1, 5, 5));
+    for (std::size_t size = 1; size <= 9; ++size)
+    {
+        for (std::size_t empty = 0; empty < size; ++empty)
+        {
+            multi_pt.clear();
+            mapnik::new_geometry::line_string_soa line;
+            mapnik::new_geometry::bounding_box expected = mapnik::new_geometry::empty_envelope();
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                double x = (i == empty) ? nan : static_cast<double>(i);
+                double y = (i == empty) ? nan : -static_cast<double>(i);
+                multi_pt.emplace_back(x, y);
+                line.add_coord(x, y);
+                if (i != empty) mapnik::new_geometry::expand(expected, mapnik::new_geometry::bounding_box(x, y, x, y));
+            }
+            same = same && same_box(mapnik::new_geometry::envelope(multi_pt), expected);
+            same = same && same_box(mapnik::new_geometry::envelope(line), expected);
+        }
+    }
+    std::cerr << "========== empty points SAME RESULT : " << std::boolalpha << same << std::endl;
+    return same;
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc != 4)
+    {
+        std::cerr << "Usage:" << argv[0] << " <num-geom> <num-rings> <num-points>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const std::size_t NUM_GEOM = static_cast<std::size_t>(std::stol(argv[1]));
+    const std::size_t NUM_RINGS = static_cast<std::size_t>(std::stol(argv[2]));
+    const std::size_t NUM_POINTS = static_cast<std::size_t>(std::stol(argv[3]));
+
+#if defined(MAPNIK_GEOMETRY_ENVELOPE_AVX)
+    std::cerr << "Envelope kernel: AVX" << std::endl;
+#elif defined(MAPNIK_GEOMETRY_ENVELOPE_SSE2)
+    std::cerr << "Envelope kernel: SSE2" << std::endl;
+#else
+    std::cerr << "Envelope kernel: scalar" << std::endl;
+#endif
+
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<double> dist(-180.0, 180.0);
+
+    // holes are random too, most of them stick out of their exterior
+    std::vector<mapnik::new_geometry::polygon3> polygons;
+    std::vector<mapnik::new_geometry::polygon2> polygons2;
+    std::vector<mapnik::new_geometry::polygon> flat_polygons;
+    std::vector<mapnik::new_geometry::polygon_soa> soa_polygons;
+    std::vector<mapnik::new_geometry::line_string_soa> lines;
+    polygons.reserve(NUM_GEOM);
+    polygons2.reserve(NUM_GEOM);
+    flat_polygons.reserve(NUM_GEOM);
+    soa_polygons.reserve(NUM_GEOM);
+    lines.reserve(NUM_GEOM);
+    for (std::size_t n = 0; n < NUM_GEOM; ++n)
+    {
+        mapnik::new_geometry::polygon3 poly;
+        mapnik::new_geometry::polygon2 poly2;
+        mapnik::new_geometry::polygon flat_poly;
+        mapnik::new_geometry::polygon_soa soa_poly;
+        mapnik::new_geometry::line_string_soa line;
+        line.reserve(NUM_POINTS);
+        for (std::size_t j = 0 ; j < NUM_RINGS; ++j)
+        {
+            mapnik::new_geometry::linear_ring ring;
+            ring.reserve(NUM_POINTS);
+            for (std::size_t i = 0; i < NUM_POINTS; ++i)
+            {
+                double x = dist(gen);
+                double y = dist(gen) / 2;
+                ring.emplace_back(x, y);
+                if (j == 0) line.add_coord(x, y);
+            }
+            mapnik::new_geometry::line_string ring2;
+            ring2.data = ring;
+            flat_poly.add_ring(mapnik::new_geometry::line_string(ring2));
+            poly2.add_ring(std::move(ring2));
+            mapnik::new_geometry::line_string_soa soa_ring;
+            for (auto const& pt : ring) soa_ring.add_coord(pt.x, pt.y);
+            soa_poly.add_ring(std::move(soa_ring));
+            if (j == 0) poly.set_exterior_ring(std::move(ring));
+            else poly.add_hole(std::move(ring));
+        }
+        polygons.push_back(std::move(poly));
+        polygons2.push_back(std::move(poly2));
+        flat_polygons.push_back(std::move(flat_poly));
+        soa_polygons.push_back(std::move(soa_poly));
+        lines.push_back(std::move(line));
+    }
+    std::vector<mapnik::new_geometry::multi_polygon> multi_polygons(1);
+    multi_polygons.front().assign(polygons.begin(), polygons.end());
+    std::vector<mapnik::new_geometry::flat_multi_polygon> flat_multi_polygons(1);
+    for (auto const& poly : polygons) flat_multi_polygons.front().add_polygon(poly);
+
+    bool ok = check_empty_points();
+    ok = compare("polygon3", polygons) && ok;
+    ok = compare("polygon2", polygons2) && ok;
+    ok = compare("line_string_soa", lines) && ok;
+    ok = compare("multi_polygon", multi_polygons) && ok;
+    ok = compare("flat_multi_polygon", flat_multi_polygons) && ok;
+    ok = compare_layout("polygon", flat_polygons, polygons) && ok;
+    ok = compare_layout("polygon_soa", soa_polygons, polygons) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -39,6 +39,7 @@
 
 #include "geometry_impl.hpp"
 #include "geometry_adapters.hpp"
+#include "geometry_clip.hpp"
 
 int main(int, char **)
 {
@@ -54,6 +55,32 @@ int main(int, char **)
     std::cerr << "Length: " << boost::geometry::length(line) << std::endl;
     std::cerr << "WKT: " << boost::geometry::wkt(line) << std::endl;
 
+    std::cerr << "LineString clipped (line_clip_adapter)" << std::endl;
+    {
+        mapnik::new_geometry::line_string_vertex_adapter va(line);
+        auto clipped = mapnik::new_geometry::make_line_clip_adapter(va, mapnik::new_geometry::bounding_box(150, 50, 250, 150));
+        clipped.rewind(0);
+        double x, y;
+        unsigned cmd;
+        while ((cmd = clipped.vertex(&x, &y)) != mapnik::SEG_END)
+        {
+            std::cerr << (cmd == mapnik::SEG_MOVETO ? "M " : "L ") << x << " " << y << std::endl;
+        }
+    }
+
+    std::cerr << "LineString (SoA)" << std::endl;
+    mapnik::new_geometry::line_string_soa line_soa;
+    line_soa.add_coord(100,100);
+    line_soa.add_coord(200,100);
+    line_soa.add_coord(100,200);
+    std::cerr << "Num points: " << boost::geometry::num_points(line_soa) << std::endl;
+    std::cerr << "Length: " << boost::geometry::length(line_soa) << std::endl;
+    std::cerr << "WKT: " << boost::geometry::wkt(line_soa) << std::endl;
+    mapnik::new_geometry::polygon_soa poly_soa;
+    line_soa.add_coord(100,100);
+    poly_soa.add_ring(std::move(line_soa));
+    std::cerr << "Ring area (SoA): " << boost::geometry::area(boost::make_iterator_range(poly_soa.ring(0))) << std::endl;
+
     std::cerr << "Polygon" << std::endl;
     mapnik::new_geometry::polygon3 poly;
     {
@@ -96,6 +123,22 @@ int main(int, char **)
     boost::geometry::envelope(poly, box);
     std::cerr << "========== envelope:" << boost::geometry::dsv(box) << std::endl;
 
+    std::cerr << "MultiPolygon (flat)" << std::endl;
+    {
+        mapnik::new_geometry::multi_polygon multi_poly;
+        boost::geometry::read_wkt("MULTIPOLYGON(((0 0,0 100,100 100,100 0,0 0),(50 50,75 50,75 75,50 75,50 50)),((200 0,200 100,300 100,300 0,200 0)))", multi_poly);
+        mapnik::new_geometry::flat_multi_polygon flat_multi_poly;
+        for (auto const& p : multi_poly)
+        {
+            flat_multi_poly.add_polygon(p);
+        }
+        std::cerr << "Num parts: " << flat_multi_poly.num_parts() << " rings: " << flat_multi_poly.num_rings() << std::endl;
+        std::cerr << "Num points: " << boost::geometry::num_points(flat_multi_poly) << std::endl;
+        std::cerr << "Area: " << boost::geometry::area(flat_multi_poly) << std::endl;
+        std::cerr << "WKT: " << boost::geometry::wkt(flat_multi_poly) << std::endl;
+        std::cerr << "Is valid? :" << std::boolalpha << boost::geometry::is_valid(flat_multi_poly) << std::endl;
+    }
+
     std::cerr << "========== clipping" << std::endl;
     using polygon_list = std::vector<mapnik::new_geometry::polygon3>;
 
@@ -137,5 +180,28 @@ int main(int, char **)
         }
         std::cerr << "count=" << count << std::endl;
     }
+    std::cerr << "========== clipping (box_clipper)" << std::endl;
+    {
+        boost::timer::auto_cpu_timer t;
+        std::size_t count = 0;
+        mapnik::new_geometry::box_clipper clipper(clip_box);
+        mapnik::new_geometry::clip_buffer clipped;
+        for (std::size_t i = 0; i < 10000 ; ++i)
+        {
+            clipped.clear();
+            clipper(input_poly, clipped);
+            if (i == 0)
+            {
+                polygon_list clipped_polygons;
+                clipped.append_to(clipped_polygons);
+                for (auto const& p : clipped_polygons)
+                {
+                    std::cerr << boost::geometry::wkt(p) << " valid=" << std::boolalpha << boost::geometry::is_valid(p) << std::endl;
+                }
+            }
+            count += clipped.points.size();
+        }
+        std::cerr << "count=" << count << std::endl;
+    }
     return EXIT_SUCCESS;
 }
@@ -26,7 +26,6 @@
 #include <boost/geometry.hpp>
 #include <boost/geometry/geometries/register/point.hpp>
 #include <boost/geometry/geometries/register/linestring.hpp>
-#include <boost/geometry/geometries/register/ring.hpp>
 #include <boost/range.hpp>
 #include <boost/range/iterator_range_core.hpp>
 #include <boost/geometry/core/mutable_range.hpp>
@@ -35,34 +34,79 @@
 
 // register point
 BOOST_GEOMETRY_REGISTER_POINT_2D (mapnik::new_geometry::point, double, cs::cartesian, x, y)
-// ring
-BOOST_GEOMETRY_REGISTER_RING(mapnik::new_geometry::linear_ring)
+
+// containers are templated on their allocator, register every instantiation
+// through partial specialisations (linear_ring is a plain std::vector<point, A>)
 
 namespace boost {
 
+template <typename Allocator>
+struct range_iterator<mapnik::new_geometry::basic_line_string<Allocator> >
+{
+    using type = typename mapnik::new_geometry::basic_line_string<Allocator>::iterator_type;
+};
+
+template <typename Allocator>
+struct range_const_iterator<mapnik::new_geometry::basic_line_string<Allocator> >
+{
+    using type = typename mapnik::new_geometry::basic_line_string<Allocator>::const_iterator_type;
+};
+
+template <typename Allocator>
+inline typename mapnik::new_geometry::basic_line_string<Allocator>::iterator_type
+range_begin(mapnik::new_geometry::basic_line_string<Allocator> & line) {return line.begin();}
+
+template <typename Allocator>
+inline typename mapnik::new_geometry::basic_line_string<Allocator>::iterator_type
+range_end(mapnik::new_geometry::basic_line_string<Allocator> & line) {return line.end();}
+
+template <typename Allocator>
+inline typename mapnik::new_geometry::basic_line_string<Allocator>::const_iterator_type
+range_begin(mapnik::new_geometry::basic_line_string<Allocator> const& line) {return line.begin();}
+
+template <typename Allocator>
+inline typename mapnik::new_geometry::basic_line_string<Allocator>::const_iterator_type
+range_end(mapnik::new_geometry::basic_line_string<Allocator> const& line) {return line.end();}
+
+// line_string_soa : read-only proxy point range over separate x/y arrays
 template <>
-struct range_iterator<mapnik::new_geometry::line_string>
+struct range_iterator<mapnik::new_geometry::line_string_soa>
 {
-    using type = mapnik::new_geometry::line_string::iterator_type;
+    using type = mapnik::new_geometry::line_string_soa::const_iterator_type;
 };
 
 template <>
-struct range_const_iterator<mapnik::new_geometry::line_string>
+struct range_const_iterator<mapnik::new_geometry::line_string_soa>
 {
-    using type = mapnik::new_geometry::line_string::const_iterator_type;
+    using type = mapnik::new_geometry::line_string_soa::const_iterator_type;
 };
 
-inline mapnik::new_geometry::line_string::iterator_type
-range_begin(mapnik::new_geometry::line_string & line) {return line.begin();}
+inline mapnik::new_geometry::line_string_soa::const_iterator_type
+range_begin(mapnik::new_geometry::line_string_soa const& line) {return line.begin();}
 
-inline mapnik::new_geometry::line_string::iterator_type
-range_end(mapnik::new_geometry::line_string & line) {return line.end();}
+inline mapnik::new_geometry::line_string_soa::const_iterator_type
+range_end(mapnik::new_geometry::line_string_soa const& line) {return line.end();}
 
-inline mapnik::new_geometry::line_string::const_iterator_type
-range_begin(mapnik::new_geometry::line_string const& line) {return line.begin();}
+// flat_multi_polygon : read-only range of flat_polygon_view
+template <typename Allocator>
+struct range_iterator<mapnik::new_geometry::basic_flat_multi_polygon<Allocator> >
+{
+    using type = mapnik::new_geometry::flat_polygon_view const*;
+};
 
-inline mapnik::new_geometry::line_string::const_iterator_type
-range_end(mapnik::new_geometry::line_string const& line) {return line.end();}
+template <typename Allocator>
+struct range_const_iterator<mapnik::new_geometry::basic_flat_multi_polygon<Allocator> >
+{
+    using type = mapnik::new_geometry::flat_polygon_view const*;
+};
+
+template <typename Allocator>
+inline mapnik::new_geometry::flat_polygon_view const*
+range_begin(mapnik::new_geometry::basic_flat_multi_polygon<Allocator> const& multi_poly) {return multi_poly.begin();}
+
+template <typename Allocator>
+inline mapnik::new_geometry::flat_polygon_view const*
+range_end(mapnik::new_geometry::basic_flat_multi_polygon<Allocator> const& multi_poly) {return multi_poly.end();}
 
 
 // register polygon
@@ -101,70 +145,98 @@ struct indexed_access<mapnik::new_geometry::bounding_box, max_corner, 1>
     static inline void set(mapnik::new_geometry::bounding_box& b, double value) { b.p1.y = value; }
 };
 
+// ring
+template <typename Allocator>
+struct tag<std::vector<mapnik::new_geometry::point, Allocator> >
+{
+    using type = ring_tag;
+};
+
+template <typename Allocator>
+struct tag<mapnik::new_geometry::basic_line_string<Allocator> >
+{
+    using type = ring_tag;
+};
+
+template<>
+struct tag<mapnik::new_geometry::line_string_soa>
+{
+    using type = linestring_tag;
+};
+
+// polygon_soa::ring(index) as a read-only ring
 template<>
-struct tag<mapnik::new_geometry::line_string>
+struct tag<boost::iterator_range<mapnik::new_geometry::polygon_soa::iterator_type> >
 {
     using type = ring_tag;
 };
 
 // polygon 2
-template<> struct tag<mapnik::new_geometry::polygon2>
+template <typename Allocator>
+struct tag<mapnik::new_geometry::basic_polygon2<Allocator> >
 {
     using type = polygon_tag;
 };
 
 // ring
-template<> struct ring_const_type<mapnik::new_geometry::polygon2>
+template <typename Allocator>
+struct ring_const_type<mapnik::new_geometry::basic_polygon2<Allocator> >
 {
-    using type =  mapnik::new_geometry::line_string::cont_type const&;
+    using type = typename mapnik::new_geometry::basic_polygon2<Allocator>::ring_type const&;
 };
 
-template<> struct ring_mutable_type<mapnik::new_geometry::polygon2>
+template <typename Allocator>
+struct ring_mutable_type<mapnik::new_geometry::basic_polygon2<Allocator> >
 {
-    using type = mapnik::new_geometry::line_string::cont_type&;
+    using type = typename mapnik::new_geometry::basic_polygon2<Allocator>::ring_type&;
 };
 
 // interior
-template<> struct interior_const_type<mapnik::new_geometry::polygon2>
+template <typename Allocator>
+struct interior_const_type<mapnik::new_geometry::basic_polygon2<Allocator> >
 {
-    using rings_type = std::vector<mapnik::new_geometry::line_string::cont_type>;
-    using type = boost::iterator_range<rings_type::const_iterator> const;
+    using rings_type = decltype(mapnik::new_geometry::basic_polygon2<Allocator>::rings);
+    using type = boost::iterator_range<typename rings_type::const_iterator> const;
 };
 
-template<> struct interior_mutable_type<mapnik::new_geometry::polygon2>
+template <typename Allocator>
+struct interior_mutable_type<mapnik::new_geometry::basic_polygon2<Allocator> >
 {
-    using rings_type = std::vector<mapnik::new_geometry::line_string::cont_type>;
-    using type = boost::iterator_range<rings_type::iterator>;
+    using rings_type = decltype(mapnik::new_geometry::basic_polygon2<Allocator>::rings);
+    using type = boost::iterator_range<typename rings_type::iterator>;
 };
 
 // exterior
-template<>
-struct exterior_ring<mapnik::new_geometry::polygon2>
+template <typename Allocator>
+struct exterior_ring<mapnik::new_geometry::basic_polygon2<Allocator> >
 {
-    static mapnik::new_geometry::line_string::cont_type& get(mapnik::new_geometry::polygon2 & p)
+    using polygon_type = mapnik::new_geometry::basic_polygon2<Allocator>;
+    static typename polygon_type::ring_type& get(polygon_type & p)
     {
         return p.rings.front();
     }
 
-    static mapnik::new_geometry::line_string::cont_type const& get(mapnik::new_geometry::polygon2 const& p)
+    static typename polygon_type::ring_type const& get(polygon_type const& p)
     {
         return p.rings.front();
     }
 };
 
-template<>
-struct interior_rings<mapnik::new_geometry::polygon2>
+template <typename Allocator>
+struct interior_rings<mapnik::new_geometry::basic_polygon2<Allocator> >
 {
-    using ring_iterator = std::vector<mapnik::new_geometry::line_string::cont_type>::iterator;
-    using const_ring_iterator = std::vector<mapnik::new_geometry::line_string::cont_type>::const_iterator;
+    using polygon_type = mapnik::new_geometry::basic_polygon2<Allocator>;
+    using rings_type = decltype(polygon_type::rings);
+    using ring_iterator = typename rings_type::iterator;
+    using const_ring_iterator = typename rings_type::const_iterator;
     using holes_type = boost::iterator_range<ring_iterator>;
     using const_holes_type = boost::iterator_range<const_ring_iterator>;
-    static holes_type get(mapnik::new_geometry::polygon2 & p)
+    static holes_type get(polygon_type & p)
     {
         return boost::make_iterator_range(p.rings.begin() + 1, p.rings.end());
     }
 
-    static const_holes_type get(mapnik::new_geometry::polygon2 const& p)
+    static const_holes_type get(polygon_type const& p)
     {
        return boost::make_iterator_range(p.rings.begin() + 1, p.rings.end());
     }
@@ -173,80 +245,147 @@ struct interior_rings<mapnik::new_geometry::polygon2>
 
 // mapnik::new_geometry::polygon3
 
-template<> struct tag<mapnik::new_geometry::polygon3>
+template <typename Allocator>
+struct tag<mapnik::new_geometry::basic_polygon3<Allocator> >
 {
     using type = polygon_tag;
 };
 
 
-template<> struct tag<mapnik::new_geometry::multi_point>
+template <typename Allocator>
+struct tag<mapnik::new_geometry::basic_multi_point<Allocator> >
 {
     using type = multi_point_tag;
 };
 
-template<> struct tag<mapnik::new_geometry::multi_line_string>
+template <typename Allocator>
+struct tag<mapnik::new_geometry::basic_multi_line_string<Allocator> >
 {
     using type = multi_linestring_tag;
 };
 
 
-template<> struct tag<mapnik::new_geometry::multi_polygon>
+template <typename Allocator>
+struct tag<mapnik::new_geometry::basic_multi_polygon<Allocator> >
 {
     using type = multi_polygon_tag;
 };
 
 // ring
-template<> struct ring_const_type<mapnik::new_geometry::polygon3>
+template <typename Allocator>
+struct ring_const_type<mapnik::new_geometry::basic_polygon3<Allocator> >
 {
-    using type =  mapnik::new_geometry::linear_ring const&;
+    using type = typename mapnik::new_geometry::basic_polygon3<Allocator>::ring_type const&;
 };
 
-template<> struct ring_mutable_type<mapnik::new_geometry::polygon3>
+template <typename Allocator>
+struct ring_mutable_type<mapnik::new_geometry::basic_polygon3<Allocator> >
 {
-    using type = mapnik::new_geometry::linear_ring&;
+    using type = typename mapnik::new_geometry::basic_polygon3<Allocator>::ring_type&;
 };
 
 // interior
-template<> struct interior_const_type<mapnik::new_geometry::polygon3>
+template <typename Allocator>
+struct interior_const_type<mapnik::new_geometry::basic_polygon3<Allocator> >
 {
-    using type = std::vector<mapnik::new_geometry::linear_ring> const&;
+    using type = decltype(mapnik::new_geometry::basic_polygon3<Allocator>::interior_rings) const&;
 };
 
-template<> struct interior_mutable_type<mapnik::new_geometry::polygon3>
+template <typename Allocator>
+struct interior_mutable_type<mapnik::new_geometry::basic_polygon3<Allocator> >
 {
-    using type = std::vector<mapnik::new_geometry::linear_ring>&;
+    using type = decltype(mapnik::new_geometry::basic_polygon3<Allocator>::interior_rings)&;
 };
 
 // exterior
-template<>
-struct exterior_ring<mapnik::new_geometry::polygon3>
+template <typename Allocator>
+struct exterior_ring<mapnik::new_geometry::basic_polygon3<Allocator> >
 {
-    static mapnik::new_geometry::linear_ring& get(mapnik::new_geometry::polygon3 & p)
+    using polygon_type = mapnik::new_geometry::basic_polygon3<Allocator>;
+    static typename polygon_type::ring_type& get(polygon_type & p)
     {
         return p.exterior_ring;
     }
 
-    static mapnik::new_geometry::linear_ring const& get(mapnik::new_geometry::polygon3 const& p)
+    static typename polygon_type::ring_type const& get(polygon_type const& p)
     {
         return p.exterior_ring;
     }
 };
 
-template<>
-struct interior_rings<mapnik::new_geometry::polygon3>
+template <typename Allocator>
+struct interior_rings<mapnik::new_geometry::basic_polygon3<Allocator> >
 {
-    using holes_type = std::vector<mapnik::new_geometry::linear_ring>;
-    static holes_type&  get(mapnik::new_geometry::polygon3 & p)
+    using polygon_type = mapnik::new_geometry::basic_polygon3<Allocator>;
+    using holes_type = decltype(polygon_type::interior_rings);
+    static holes_type&  get(polygon_type & p)
     {
         return p.interior_rings;
     }
 
-    static holes_type const& get(mapnik::new_geometry::polygon3 const& p)
+    static holes_type const& get(polygon_type const& p)
     {
         return p.interior_rings;
     }
 };
 
+// mapnik::new_geometry::flat_multi_polygon (read-only)
+
+template<>
+struct tag<mapnik::new_geometry::flat_polygon_view::ring_type>
+{
+    using type = ring_tag;
+};
+
+template<> struct tag<mapnik::new_geometry::flat_polygon_view>
+{
+    using type = polygon_tag;
+};
+
+template<> struct ring_const_type<mapnik::new_geometry::flat_polygon_view>
+{
+    using type = mapnik::new_geometry::flat_polygon_view::ring_type const&;
+};
+
+template<> struct ring_mutable_type<mapnik::new_geometry::flat_polygon_view>
+{
+    using type = mapnik::new_geometry::flat_polygon_view::ring_type const&;
+};
+
+template<> struct interior_const_type<mapnik::new_geometry::flat_polygon_view>
+{
+    using type = mapnik::new_geometry::flat_polygon_view::rings_type const;
+};
+
+template<> struct interior_mutable_type<mapnik::new_geometry::flat_polygon_view>
+{
+    using type = mapnik::new_geometry::flat_polygon_view::rings_type const;
+};
+
+template<>
+struct exterior_ring<mapnik::new_geometry::flat_polygon_view>
+{
+    static mapnik::new_geometry::flat_polygon_view::ring_type const& get(mapnik::new_geometry::flat_polygon_view const& p)
+    {
+        return p.exterior_ring();
+    }
+};
+
+template<>
+struct interior_rings<mapnik::new_geometry::flat_polygon_view>
+{
+    static mapnik::new_geometry::flat_polygon_view::rings_type get(mapnik::new_geometry::flat_polygon_view const& p)
+    {
+        return p.interior_rings();
+    }
+};
+
+template <typename Allocator>
+struct tag<mapnik::new_geometry::basic_flat_multi_polygon<Allocator> >
+{
+    using type = multi_polygon_tag;
+};
+
 
 }}}
 
@@ -0,0 +1,153 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_ARENA_HPP
+#define MAPNIK_GEOMETRY_ARENA_HPP
+
+#include "geometry_impl.hpp"
+
+#include <mapnik/util/noncopyable.hpp>
+
+#include <vector>
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+
+namespace mapnik { namespace new_geometry {
+
+// Monotonic (bump pointer) memory arena. Individual deallocations are
+// no-ops, all memory is returned at once by release() or on destruction.
+// Meant for batches of geometries with a common lifetime, e.g. one tile or
+// one query result. Not thread safe, use one arena per thread.
+class arena : mapnik::util::noncopyable
+{
+public:
+    explicit arena(std::size_t block_size = 64 * 1024)
+        : block_size_(block_size),
+          current_(nullptr),
+          end_(nullptr),
+          allocated_(0) {}
+
+    ~arena()
+    {
+        release();
+    }
+
+    void * allocate(std::size_t size, std::size_t align = alignof(std::max_align_t))
+    {
+        std::uintptr_t ptr = (reinterpret_cast<std::uintptr_t>(current_) + align - 1) & ~(align - 1);
+        if (current_ == nullptr || ptr + size > reinterpret_cast<std::uintptr_t>(end_))
+        {
+            // oversized requests get a block of their own
+            std::size_t bytes = std::max(block_size_, size + align);
+            char * block = static_cast<char*>(::operator new(bytes));
+            blocks_.push_back(block);
+            current_ = block;
+            end_ = block + bytes;
+            ptr = (reinterpret_cast<std::uintptr_t>(current_) + align - 1) & ~(align - 1);
+        }
+        current_ = reinterpret_cast<char*>(ptr + size);
+        allocated_ += size;
+        return reinterpret_cast<void*>(ptr);
+    }
+
+    // free every block, all objects allocated from this arena become invalid
+    void release()
+    {
+        for (char * block : blocks_)
+        {
+            ::operator delete(block);
+        }
+        blocks_.clear();
+        current_ = end_ = nullptr;
+        allocated_ = 0;
+    }
+
+    std::size_t bytes_allocated() const
+    {
+        return allocated_;
+    }
+
+    std::size_t num_blocks() const
+    {
+        return blocks_.size();
+    }
+
+private:
+    std::size_t block_size_;
+    char * current_;
+    char * end_;
+    std::size_t allocated_;
+    std::vector<char*> blocks_;
+};
+
+// Stateful allocator drawing from an arena, usable with every basic_*
+// geometry container (e.g basic_polygon3<arena_allocator<point>>).
+template <typename T>
+struct arena_allocator
+{
+    using value_type = T;
+
+    explicit arena_allocator(arena & a) noexcept
+        : arena_(&a) {}
+
+    template <typename U>
+    arena_allocator(arena_allocator<U> const& other) noexcept
+        : arena_(other.arena_) {}
+
+    T * allocate(std::size_t n)
+    {
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, std::size_t) noexcept {}
+
+    arena * arena_;
+};
+
+template <typename T, typename U>
+inline bool operator==(arena_allocator<T> const& lhs, arena_allocator<U> const& rhs)
+{
+    return lhs.arena_ == rhs.arena_;
+}
+
+template <typename T, typename U>
+inline bool operator!=(arena_allocator<T> const& lhs, arena_allocator<U> const& rhs)
+{
+    return lhs.arena_ != rhs.arena_;
+}
+
+using arena_line_string = basic_line_string<arena_allocator<point> >;
+using arena_linear_ring = basic_linear_ring<arena_allocator<point> >;
+using arena_polygon = basic_polygon<arena_allocator<point> >;
+using arena_polygon2 = basic_polygon2<arena_allocator<point> >;
+using arena_polygon3 = basic_polygon3<arena_allocator<point> >;
+using arena_multi_point = basic_multi_point<arena_allocator<point> >;
+using arena_multi_line_string = basic_multi_line_string<arena_allocator<point> >;
+using arena_multi_polygon = basic_multi_polygon<arena_allocator<point> >;
+using arena_geometry = basic_geometry<arena_allocator<point> >;
+using arena_geometry_collection = basic_geometry_collection<arena_allocator<point> >;
+
+}}
+
+#endif //MAPNIK_GEOMETRY_ARENA_HPP
@@ -0,0 +1,649 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// Benchmark suite : create, iterate (range-for and vertex adapter), envelope,
+// clip, simplify, serialize and parse over every polygon layout, line_string
+// and the multi polygon layouts, swept over geometry/ring/point counts.
+// Results go to stdout (or --output) as one JSON document, progress to stderr.
+//
+//   geometry_benchmark --geoms=100,1000 --rings=1,5 --points=16,256 --samples=15
+//   geometry_benchmark --layouts=polygon3 --ops=clip,simplify --output=clip.json
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <new>
+
+#include "geometry_impl.hpp"
+#include "geometry_envelope.hpp"
+#include "geometry_clip.hpp"
+#include "geometry_simplify.hpp"
+#include "geometry_wkb.hpp"
+#include "geometry_to_geojson.hpp"
+#include "geometry_from_geojson.hpp"
+
+// Every heap allocation made by the process goes through here, a sample
+// reports the difference between the counters before and after it.
+namespace {
+std::size_t alloc_count = 0;
+std::size_t alloc_bytes = 0;
+}
+
+void * operator new(std::size_t size)
+{
+    ++alloc_count;
+    alloc_bytes += size;
+    if (void * p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void * p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+using namespace mapnik::new_geometry;
+
+struct sweep_point
+{
+    std::size_t num_geom;
+    std::size_t num_rings;
+    std::size_t num_points;
+};
+
+struct options
+{
+    std::vector<std::size_t> geoms{100, 1000};
+    std::vector<std::size_t> rings{1, 5};
+    std::vector<std::size_t> points{16, 256};
+    std::vector<std::string> layouts{"polygon", "polygon2", "polygon3", "polygon_soa",
+                                     "line_string", "multi_polygon", "flat_multi_polygon"};
+    std::vector<std::string> ops{"create", "iterate", "iterate_adapter", "envelope", "clip", "simplify",
+                                  "serialize_wkb", "serialize_geojson", "parse_wkb", "parse_geojson"};
+    std::size_t samples = 11;
+    std::string output;
+};
+
+// statistics over the samples of one (layout, op, sweep point)
+struct result
+{
+    std::string layout;
+    std::string op;
+    sweep_point sweep;
+    std::size_t num_vertices;
+    std::vector<double> ns;
+    std::size_t allocations;
+    std::size_t allocated_bytes;
+    std::size_t output_bytes;
+    double checksum;
+};
+
+double percentile(std::vector<double> const& sorted, double p)
+{
+    if (sorted.empty()) return 0.0;
+    double pos = p * static_cast<double>(sorted.size() - 1);
+    std::size_t lo = static_cast<std::size_t>(pos);
+    std::size_t hi = std::min(lo + 1, sorted.size() - 1);
+    return sorted[lo] + (pos - static_cast<double>(lo)) * (sorted[hi] - sorted[lo]);
+}
+
+// Ring templates on the unit square : exterior clockwise around the centre,
+// holes counter-clockwise on a circle of radius 0.25 inside it. Rings are
+// closed and wobble a little so simplification has something to remove.
+std::vector<std::vector<point> > make_ring_templates(std::size_t num_rings, std::size_t num_points)
+{
+    double const pi = 3.14159265358979323846;
+    std::size_t num_holes = num_rings > 0 ? num_rings - 1 : 0;
+    double hole_radius = num_holes > 0 ? std::min(0.1, 0.2 * std::sin(pi / static_cast<double>(std::max<std::size_t>(num_holes, 2)))) : 0.0;
+    std::vector<std::vector<point> > rings;
+    for (std::size_t j = 0; j < num_rings; ++j)
+    {
+        double cx = 0.5, cy = 0.5, radius = 0.45, dir = -1.0;
+        if (j > 0)
+        {
+            double a = 2.0 * pi * static_cast<double>(j - 1) / static_cast<double>(num_holes);
+            cx += 0.25 * std::cos(a);
+            cy += 0.25 * std::sin(a);
+            radius = hole_radius;
+            dir = 1.0;
+        }
+        std::vector<point> ring;
+        std::size_t n = std::max<std::size_t>(num_points, 4) - 1;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            double a = dir * 2.0 * pi * static_cast<double>(i) / static_cast<double>(n);
+            double r = radius * (1.0 + 0.05 * std::sin(7.0 * a));
+            ring.emplace_back(cx + r * std::cos(a), cy + r * std::sin(a));
+        }
+        ring.push_back(ring.front());
+        rings.push_back(std::move(ring));
+    }
+    return rings;
+}
+
+// geometry n sits in its own cell of a 100 column grid
+inline point cell_origin(std::size_t n)
+{
+    return point(static_cast<double>(n % 100) * 2.0, static_cast<double>(n / 100) * 2.0);
+}
+
+template <typename Polygon>
+struct layout_traits;
+
+template <>
+struct layout_traits<polygon>
+{
+    using vertex_adapter = polygon_vertex_adapter;
+
+    static void add_ring(polygon & poly, std::vector<point> const& ring, point const& origin, bool)
+    {
+        line_string line;
+        line.reserve(ring.size());
+        for (auto const& pt : ring) line.add_coord(pt.x + origin.x, pt.y + origin.y);
+        poly.add_ring(std::move(line));
+    }
+};
+
+template <>
+struct layout_traits<polygon2>
+{
+    using vertex_adapter = polygon_vertex_adapter_2;
+
+    static void add_ring(polygon2 & poly, std::vector<point> const& ring, point const& origin, bool)
+    {
+        line_string line;
+        line.reserve(ring.size());
+        for (auto const& pt : ring) line.add_coord(pt.x + origin.x, pt.y + origin.y);
+        poly.add_ring(std::move(line));
+    }
+};
+
+template <>
+struct layout_traits<polygon3>
+{
+    using vertex_adapter = polygon_vertex_adapter_3;
+
+    static void add_ring(polygon3 & poly, std::vector<point> const& ring, point const& origin, bool exterior)
+    {
+        linear_ring r;
+        r.reserve(ring.size());
+        for (auto const& pt : ring) r.emplace_back(pt.x + origin.x, pt.y + origin.y);
+        if (exterior) poly.set_exterior_ring(std::move(r));
+        else poly.add_hole(std::move(r));
+    }
+};
+
+template <>
+struct layout_traits<polygon_soa>
+{
+    using vertex_adapter = polygon_soa_vertex_adapter;
+
+    static void add_ring(polygon_soa & poly, std::vector<point> const& ring, point const& origin, bool)
+    {
+        line_string_soa line;
+        line.reserve(ring.size());
+        for (auto const& pt : ring) line.add_coord(pt.x + origin.x, pt.y + origin.y);
+        poly.add_ring(std::move(line));
+    }
+};
+
+// the rings chained into one path, same vertices as the polygon layouts
+template <>
+struct layout_traits<line_string>
+{
+    using vertex_adapter = line_string_vertex_adapter;
+
+    static void add_ring(line_string & line, std::vector<point> const& ring, point const& origin, bool)
+    {
+        line.reserve(line.data.size() + ring.size());
+        for (auto const& pt : ring) line.add_coord(pt.x + origin.x, pt.y + origin.y);
+    }
+};
+
+// one part per geometry, the container overhead against polygon3
+template <>
+struct layout_traits<multi_polygon>
+{
+    using vertex_adapter = multi_polygon_vertex_adapter;
+
+    static void add_ring(multi_polygon & multi_poly, std::vector<point> const& ring, point const& origin, bool exterior)
+    {
+        if (exterior) multi_poly.emplace_back();
+        layout_traits<polygon3>::add_ring(multi_poly.back(), ring, origin, exterior);
+    }
+};
+
+template <>
+struct layout_traits<flat_multi_polygon>
+{
+    using vertex_adapter = flat_multi_polygon_vertex_adapter;
+
+    static void add_ring(flat_multi_polygon & multi_poly, std::vector<point> const& ring, point const& origin, bool exterior)
+    {
+        linear_ring r;
+        r.reserve(ring.size());
+        for (auto const& pt : ring) r.emplace_back(pt.x + origin.x, pt.y + origin.y);
+        if (exterior) multi_poly.begin_part();
+        multi_poly.add_ring(r.begin(), r.end());
+    }
+};
+
+template <typename Polygon>
+void create(std::vector<Polygon> & polys, std::vector<std::vector<point> > const& rings, std::size_t num_geom)
+{
+    polys.clear();
+    polys.reserve(num_geom);
+    for (std::size_t n = 0; n < num_geom; ++n)
+    {
+        Polygon poly;
+        point origin = cell_origin(n);
+        for (std::size_t j = 0; j < rings.size(); ++j)
+        {
+            layout_traits<Polygon>::add_ring(poly, rings[j], origin, j == 0);
+        }
+        polys.push_back(std::move(poly));
+    }
+}
+
+class runner
+{
+public:
+    runner(std::size_t samples, std::vector<result> & results)
+        : samples_(samples),
+          results_(results) {}
+
+    // Runs `setup` untimed then `body` timed, once to warm up and then
+    // `samples` times. body returns a checksum so it can't be optimised out.
+    template <typename Setup, typename Body>
+    void run(std::string const& layout, std::string const& op, sweep_point const& sweep,
+             std::size_t num_vertices, Setup setup, Body body)
+    {
+        result r;
+        r.layout = layout;
+        r.op = op;
+        r.sweep = sweep;
+        r.num_vertices = num_vertices;
+        r.allocations = 0;
+        r.allocated_bytes = 0;
+        r.output_bytes = 0;
+        setup();
+        r.checksum = body(r.output_bytes);
+        for (std::size_t s = 0; s < samples_; ++s)
+        {
+            setup();
+            std::size_t count = alloc_count;
+            std::size_t bytes = alloc_bytes;
+            auto start = std::chrono::steady_clock::now();
+            r.checksum = body(r.output_bytes);
+            auto stop = std::chrono::steady_clock::now();
+            r.allocations += alloc_count - count;
+            r.allocated_bytes += alloc_bytes - bytes;
+            r.ns.push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+        }
+        if (samples_ > 0)
+        {
+            r.allocations /= samples_;
+            r.allocated_bytes /= samples_;
+        }
+        std::sort(r.ns.begin(), r.ns.end());
+        std::clog << layout << " " << op << " geoms=" << sweep.num_geom << " rings=" << sweep.num_rings
+                  << " points=" << sweep.num_points << " median=" << percentile(r.ns, 0.5) / 1e6 << "ms" << std::endl;
+        results_.push_back(std::move(r));
+    }
+private:
+    std::size_t samples_;
+    std::vector<result> & results_;
+};
+
+inline void no_setup() {}
+
+template <typename Polygon>
+void run_clip(runner & bench, std::string const& layout, sweep_point const& sweep,
+              std::size_t num_vertices, std::vector<Polygon> const& polys)
+{
+    // a box over the upper right of each cell cuts every ring of the template
+    box_clipper clipper(bounding_box(0.5, 0.5, 1.5, 1.5));
+    clip_buffer buf;
+    bench.run(layout, "clip", sweep, num_vertices, no_setup,
+              [&](std::size_t & output_bytes) {
+                  buf.clear();
+                  for (std::size_t n = 0; n < polys.size(); ++n)
+                  {
+                      point origin = cell_origin(n);
+                      clipper.reset(bounding_box(origin.x + 0.5, origin.y + 0.5, origin.x + 1.5, origin.y + 1.5));
+                      clipper(polys[n], buf);
+                  }
+                  output_bytes = buf.points.size() * sizeof(point);
+                  return static_cast<double>(buf.points.size());
+              });
+}
+
+// lines are clipped on the fly by line_clip_adapter, nothing is stored
+inline void run_clip(runner & bench, std::string const& layout, sweep_point const& sweep,
+                     std::size_t num_vertices, std::vector<line_string> const& lines)
+{
+    bench.run(layout, "clip", sweep, num_vertices, no_setup,
+              [&](std::size_t &) {
+                  std::size_t count = 0;
+                  double x, y;
+                  for (std::size_t n = 0; n < lines.size(); ++n)
+                  {
+                      point origin = cell_origin(n);
+                      line_string_vertex_adapter va(lines[n]);
+                      auto clipped = make_line_clip_adapter(va, bounding_box(origin.x + 0.5, origin.y + 0.5,
+                                                                             origin.x + 1.5, origin.y + 1.5));
+                      clipped.rewind(0);
+                      while (clipped.vertex(&x, &y) != mapnik::SEG_END) ++count;
+                  }
+                  return static_cast<double>(count);
+              });
+}
+
+template <typename Polygon>
+void run_layout(runner & bench, options const& opts, std::string const& layout, sweep_point const& sweep)
+{
+    auto rings = make_ring_templates(sweep.num_rings, sweep.num_points);
+    std::size_t num_vertices = 0;
+    for (auto const& ring : rings) num_vertices += ring.size();
+    num_vertices *= sweep.num_geom;
+
+    std::vector<Polygon> polys;
+    create(polys, rings, sweep.num_geom);
+    auto wants = [&opts](char const* op) {
+        return std::find(opts.ops.begin(), opts.ops.end(), op) != opts.ops.end();
+    };
+
+    if (wants("create"))
+    {
+        std::vector<Polygon> out;
+        bench.run(layout, "create", sweep, num_vertices,
+                  [&out]() { std::vector<Polygon>().swap(out); },
+                  [&](std::size_t &) {
+                      create(out, rings, sweep.num_geom);
+                      return static_cast<double>(out.size());
+                  });
+    }
+    if (wants("iterate"))
+    {
+        bench.run(layout, "iterate", sweep, num_vertices, no_setup,
+                  [&polys](std::size_t &) {
+                      double sum = 0;
+                      for (auto const& poly : polys)
+                      {
+                          for (mapnik::vertex2d const& v : vertices(poly)) sum += v.x + v.y;
+                      }
+                      return sum;
+                  });
+    }
+    if (wants("iterate_adapter"))
+    {
+        // same walk as "iterate" through the vertex()/rewind() adapter
+        bench.run(layout, "iterate_adapter", sweep, num_vertices, no_setup,
+                  [&polys](std::size_t &) {
+                      double sum = 0;
+                      double x, y;
+                      for (auto const& poly : polys)
+                      {
+                          typename layout_traits<Polygon>::vertex_adapter va(poly);
+                          va.rewind(0);
+                          while (va.vertex(&x, &y) != mapnik::SEG_END) sum += x + y;
+                      }
+                      return sum;
+                  });
+    }
+    if (wants("envelope"))
+    {
+        bench.run(layout, "envelope", sweep, num_vertices, no_setup,
+                  [&polys](std::size_t &) {
+                      bounding_box bbox = empty_envelope();
+                      for (auto const& poly : polys) expand(bbox, envelope(poly));
+                      return bbox.p1.x - bbox.p0.x + bbox.p1.y - bbox.p0.y;
+                  });
+    }
+    if (wants("clip")) run_clip(bench, layout, sweep, num_vertices, polys);
+    if (wants("simplify"))
+    {
+        // simplification is in place, every sample starts from fresh geometries
+        std::vector<Polygon> work;
+        simplifier simplify(0.01);
+        bench.run(layout, "simplify", sweep, num_vertices,
+                  [&]() { create(work, rings, sweep.num_geom); },
+                  [&](std::size_t &) {
+                      for (auto & poly : work) simplify(poly);
+                      double sum = 0;
+                      for (auto const& poly : work) sum += static_cast<double>(boost::size(vertices(poly)));
+                      return sum;
+                  });
+    }
+    if (wants("serialize_wkb"))
+    {
+        std::string wkb;
+        bench.run(layout, "serialize_wkb", sweep, num_vertices,
+                  [&wkb]() { std::string().swap(wkb); },
+                  [&](std::size_t & output_bytes) {
+                      for (auto const& poly : polys) to_wkb(wkb, poly);
+                      output_bytes = wkb.size();
+                      return static_cast<double>(wkb.size());
+                  });
+    }
+    if (wants("serialize_geojson"))
+    {
+        std::string json;
+        bench.run(layout, "serialize_geojson", sweep, num_vertices,
+                  [&json]() { std::string().swap(json); },
+                  [&](std::size_t & output_bytes) {
+                      for (auto const& poly : polys) to_geojson(json, poly);
+                      output_bytes = json.size();
+                      return static_cast<double>(json.size());
+                  });
+    }
+}
+
+// Parsers always produce the `geometry` variant (polygon3), so parsing is
+// measured once per sweep point from polygon3 input.
+void run_parse(runner & bench, options const& opts, sweep_point const& sweep)
+{
+    bool parse_wkb = std::find(opts.ops.begin(), opts.ops.end(), "parse_wkb") != opts.ops.end();
+    bool parse_geojson = std::find(opts.ops.begin(), opts.ops.end(), "parse_geojson") != opts.ops.end();
+    if (!parse_wkb && !parse_geojson) return;
+
+    auto rings = make_ring_templates(sweep.num_rings, sweep.num_points);
+    std::size_t num_vertices = 0;
+    for (auto const& ring : rings) num_vertices += ring.size();
+    num_vertices *= sweep.num_geom;
+    std::vector<polygon3> polys;
+    create(polys, rings, sweep.num_geom);
+
+    std::vector<geometry> out;
+    auto clear_out = [&out]() { std::vector<geometry>().swap(out); };
+    if (parse_wkb)
+    {
+        std::vector<std::string> input(polys.size());
+        for (std::size_t n = 0; n < polys.size(); ++n) to_wkb(input[n], polys[n]);
+        bench.run("geometry", "parse_wkb", sweep, num_vertices, clear_out,
+                  [&](std::size_t &) {
+                      out.reserve(input.size());
+                      for (auto const& wkb : input)
+                      {
+                          geometry geom;
+                          if (from_wkb(wkb.data(), wkb.size(), geom)) out.push_back(std::move(geom));
+                      }
+                      return static_cast<double>(out.size());
+                  });
+    }
+    if (parse_geojson)
+    {
+        std::vector<std::string> input(polys.size());
+        for (std::size_t n = 0; n < polys.size(); ++n) to_geojson(input[n], polys[n]);
+        bench.run("geometry", "parse_geojson", sweep, num_vertices, clear_out,
+                  [&](std::size_t &) {
+                      out.reserve(input.size());
+                      for (auto const& json : input)
+                      {
+                          geometry geom;
+                          if (from_geojson(json, geom)) out.push_back(std::move(geom));
+                      }
+                      return static_cast<double>(out.size());
+                  });
+    }
+}
+
+void write_json(std::ostream & out, options const& opts, std::vector<result> const& results)
+{
+    out.precision(17);
+    out << "{\n  \"benchmark\": \"geometry_benchmark\",\n  \"samples\": " << opts.samples
+        << ",\n  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        result const& r = results[i];
+        double median = percentile(r.ns, 0.5);
+        double mean = 0;
+        for (double ns : r.ns) mean += ns;
+        if (!r.ns.empty()) mean /= static_cast<double>(r.ns.size());
+        double vertices = static_cast<double>(std::max<std::size_t>(r.num_vertices, 1));
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"layout\": \"" << r.layout << "\", \"op\": \"" << r.op << "\""
+            << ", \"geoms\": " << r.sweep.num_geom
+            << ", \"rings\": " << r.sweep.num_rings
+            << ", \"points\": " << r.sweep.num_points
+            << ", \"vertices\": " << r.num_vertices
+            << ", \"min_ns\": " << (r.ns.empty() ? 0.0 : r.ns.front())
+            << ", \"median_ns\": " << median
+            << ", \"mean_ns\": " << mean
+            << ", \"p90_ns\": " << percentile(r.ns, 0.9)
+            << ", \"p99_ns\": " << percentile(r.ns, 0.99)
+            << ", \"max_ns\": " << (r.ns.empty() ? 0.0 : r.ns.back())
+            << ", \"ns_per_vertex\": " << median / vertices
+            << ", \"allocations\": " << r.allocations
+            << ", \"allocated_bytes\": " << r.allocated_bytes
+            << ", \"allocated_bytes_per_vertex\": " << static_cast<double>(r.allocated_bytes) / vertices
+            << ", \"output_bytes_per_vertex\": " << static_cast<double>(r.output_bytes) / vertices
+            << ", \"checksum\": " << r.checksum << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+template <typename T>
+std::vector<T> split(std::string const& value)
+{
+    std::vector<T> items;
+    std::istringstream in(value);
+    std::string item;
+    while (std::getline(in, item, ','))
+    {
+        std::istringstream s(item);
+        T v;
+        if (s >> v) items.push_back(v);
+    }
+    return items;
+}
+
+bool parse_options(int argc, char ** argv, options & opts)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        std::size_t eq = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) return false;
+        std::string key = arg.substr(2, eq - 2);
+        std::string value = arg.substr(eq + 1);
+        if (key == "geoms") opts.geoms = split<std::size_t>(value);
+        else if (key == "rings") opts.rings = split<std::size_t>(value);
+        else if (key == "points") opts.points = split<std::size_t>(value);
+        else if (key == "layouts") opts.layouts = split<std::string>(value);
+        else if (key == "ops") opts.ops = split<std::string>(value);
+        else if (key == "samples") opts.samples = static_cast<std::size_t>(std::stoul(value));
+        else if (key == "output") opts.output = value;
+        else return false;
+    }
+    return opts.samples > 0;
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    options opts;
+    if (!parse_options(argc, argv, opts))
+    {
+        std::cerr << "Usage:" << argv[0] << " [--geoms=n,..] [--rings=n,..] [--points=n,..] [--samples=n]"
+                  << " [--layouts=polygon,polygon2,polygon3,polygon_soa,line_string,multi_polygon,flat_multi_polygon]"
+                  << " [--ops=create,iterate,iterate_adapter,envelope,clip,simplify,serialize_wkb,serialize_geojson,parse_wkb,parse_geojson]"
+                  << " [--output=file.json]" << std::endl;
+        return 1;
+    }
+
+    std::vector<result> results;
+    runner bench(opts.samples, results);
+    for (std::size_t num_geom : opts.geoms)
+    {
+        for (std::size_t num_rings : opts.rings)
+        {
+            for (std::size_t num_points : opts.points)
+            {
+                sweep_point sweep{num_geom, num_rings, num_points};
+                for (auto const& layout : opts.layouts)
+                {
+                    if (layout == "polygon") run_layout<polygon>(bench, opts, layout, sweep);
+                    else if (layout == "polygon2") run_layout<polygon2>(bench, opts, layout, sweep);
+                    else if (layout == "polygon3") run_layout<polygon3>(bench, opts, layout, sweep);
+                    else if (layout == "polygon_soa") run_layout<polygon_soa>(bench, opts, layout, sweep);
+                    else if (layout == "line_string") run_layout<line_string>(bench, opts, layout, sweep);
+                    else if (layout == "multi_polygon") run_layout<multi_polygon>(bench, opts, layout, sweep);
+                    else if (layout == "flat_multi_polygon") run_layout<flat_multi_polygon>(bench, opts, layout, sweep);
+                    else std::cerr << "unknown layout: " << layout << std::endl;
+                }
+                run_parse(bench, opts, sweep);
+            }
+        }
+    }
+
+    if (opts.output.empty())
+    {
+        write_json(std::cout, opts, results);
+    }
+    else
+    {
+        std::ofstream out(opts.output.c_str());
+        if (!out)
+        {
+            std::cerr << "cannot open " << opts.output << std::endl;
+            return 1;
+        }
+        write_json(out, opts, results);
+    }
+    return 0;
+}
@@ -0,0 +1,1103 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_CLIP_HPP
+#define MAPNIK_GEOMETRY_CLIP_HPP
+
+#include "geometry_impl.hpp"
+#include "geometry_envelope.hpp"
+
+#include <vector>
+#include <tuple>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+namespace mapnik { namespace new_geometry {
+
+namespace detail {
+
+// Liang-Barsky, edges : 0 left, 1 right, 2 bottom, 3 top
+// on success [t0, t1] is the part of a->b inside the box, e0/e1 the box edge
+// the segment enters/leaves through (-1 if the end point itself is inside)
+inline bool clip_segment(bounding_box const& box, point const& a, point const& b,
+                         double & t0, double & t1, int & e0, int & e1)
+{
+    double dx = b.x - a.x;
+    double dy = b.y - a.y;
+    double p[4] = { -dx, dx, -dy, dy };
+    double q[4] = { a.x - box.p0.x, box.p1.x - a.x, a.y - box.p0.y, box.p1.y - a.y };
+    t0 = 0.0;
+    t1 = 1.0;
+    e0 = e1 = -1;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (p[i] == 0.0)
+        {
+            if (q[i] < 0.0) return false;
+        }
+        else
+        {
+            double r = q[i] / p[i];
+            if (p[i] < 0.0)
+            {
+                if (r > t1) return false;
+                if (r > t0) { t0 = r; e0 = i; }
+            }
+            else
+            {
+                if (r < t0) return false;
+                if (r < t1) { t1 = r; e1 = i; }
+            }
+        }
+    }
+    return true;
+}
+
+// point at `t` along a->b snapped onto box edge `edge`
+inline point interpolate(bounding_box const& box, point const& a, point const& b, double t, int edge)
+{
+    if (edge < 0) return (t == 0.0) ? a : b;
+    point pt(a.x + t * (b.x - a.x), a.y + t * (b.y - a.y));
+    switch (edge)
+    {
+    case 0: pt.x = box.p0.x; break;
+    case 1: pt.x = box.p1.x; break;
+    case 2: pt.y = box.p0.y; break;
+    default: pt.y = box.p1.y; break;
+    }
+    pt.x = std::min(std::max(pt.x, box.p0.x), box.p1.x);
+    pt.y = std::min(std::max(pt.y, box.p0.y), box.p1.y);
+    return pt;
+}
+
+} // namespace detail
+
+// Flat multi-polygon produced by box_clipper : all vertices in one buffer,
+// rings as (start, count) into `points`, polygons as (first ring, num rings).
+// clear() keeps capacity so a buffer reused between clips stops allocating.
+struct clip_buffer
+{
+    using index_type = std::tuple<std::uint32_t, std::uint32_t>;
+    std::vector<point> points;
+    std::vector<index_type> rings;
+    std::vector<index_type> polygons;
+
+    void clear()
+    {
+        points.clear();
+        rings.clear();
+        polygons.clear();
+    }
+
+    inline std::size_t num_polygons() const
+    {
+        return polygons.size();
+    }
+
+    inline std::pair<point const*, point const*> ring(std::size_t index) const
+    {
+        index_type const& r = rings[index];
+        point const* first = points.data() + std::get<0>(r);
+        return std::make_pair(first, first + std::get<1>(r));
+    }
+
+    template <typename Allocator>
+    void append(basic_polygon3<Allocator> const& poly)
+    {
+        std::uint32_t first_ring = static_cast<std::uint32_t>(rings.size());
+        append_ring(poly.exterior_ring);
+        for (auto const& hole : poly.interior_rings)
+        {
+            append_ring(hole);
+        }
+        polygons.emplace_back(first_ring, static_cast<std::uint32_t>(rings.size()) - first_ring);
+    }
+
+    // copy polygon `index` of `other`
+    void append(clip_buffer const& other, std::size_t index)
+    {
+        index_type const& p = other.polygons[index];
+        std::uint32_t first_ring = static_cast<std::uint32_t>(rings.size());
+        for (std::size_t i = 0; i < std::get<1>(p); ++i)
+        {
+            auto r = other.ring(std::get<0>(p) + i);
+            append_ring(r.first, r.second);
+        }
+        polygons.emplace_back(first_ring, std::get<1>(p));
+    }
+
+    template <typename Allocator>
+    void append_ring(basic_linear_ring<Allocator> const& r)
+    {
+        append_ring(r.data(), r.data() + r.size());
+    }
+
+    void append_ring(point const* first, point const* last)
+    {
+        rings.emplace_back(static_cast<std::uint32_t>(points.size()), static_cast<std::uint32_t>(last - first));
+        points.insert(points.end(), first, last);
+    }
+
+    // copy polygon `index` into `poly`, reusing its ring storage
+    template <typename Allocator>
+    void to_polygon3(std::size_t index, basic_polygon3<Allocator> & poly) const
+    {
+        index_type const& p = polygons[index];
+        std::size_t first_ring = std::get<0>(p);
+        std::size_t num_rings = std::get<1>(p);
+        auto ext = ring(first_ring);
+        poly.exterior_ring.assign(ext.first, ext.second);
+        if (poly.interior_rings.size() > num_rings - 1)
+        {
+            poly.interior_rings.erase(poly.interior_rings.begin() + static_cast<std::ptrdiff_t>(num_rings - 1), poly.interior_rings.end());
+        }
+        for (std::size_t i = 1; i < num_rings; ++i)
+        {
+            auto hole = ring(first_ring + i);
+            if (i > poly.interior_rings.size()) poly.interior_rings.emplace_back(poly.exterior_ring.get_allocator());
+            poly.interior_rings[i - 1].assign(hole.first, hole.second);
+        }
+    }
+
+    template <typename Polygons>
+    void append_to(Polygons & out) const
+    {
+        using polygon_type = typename Polygons::value_type;
+        for (std::size_t i = 0; i < num_polygons(); ++i)
+        {
+            // construct from the container's allocator (stateful allocators)
+            out.emplace_back(typename polygon_type::allocator_type(out.get_allocator()));
+            to_polygon3(i, out.back());
+        }
+    }
+};
+
+// Axis-aligned rectangle clipper for polygon, polygon2, polygon3,
+// polygon_soa and the multi_polygon types.
+//
+// Every ring edge is clipped against the box (Liang-Barsky). Rings fully
+// inside are copied as-is, crossing rings are cut into boundary-to-boundary
+// chains which are then stitched together by walking the box perimeter in
+// ring orientation (Weiler-Atherton specialised for rectangles). Unlike
+// Sutherland-Hodgman this splits concave input into separate parts instead
+// of producing degenerate bridges along the box edges, so valid input gives
+// valid (multi)polygon output. Rings are expected in Boost.Geometry default
+// orientation (clockwise exterior, counter-clockwise holes) and closed.
+//
+// All working memory is kept in the clipper and reused between calls.
+class box_clipper
+{
+public:
+    explicit box_clipper(bounding_box const& box)
+        : box_(box),
+          width_(box.p1.x - box.p0.x),
+          height_(box.p1.y - box.p0.y) {}
+
+    bounding_box const& box() const { return box_; }
+
+    // clip against another box, keeping the working memory
+    void reset(bounding_box const& box)
+    {
+        box_ = box;
+        width_ = box.p1.x - box.p0.x;
+        height_ = box.p1.y - box.p0.y;
+    }
+
+    // clipped parts are appended to `out`
+    template <typename Allocator>
+    void operator() (basic_polygon3<Allocator> const& poly, clip_buffer & out)
+    {
+        begin();
+        add_ring(poly.exterior_ring.data(), poly.exterior_ring.size(), true);
+        for (auto const& hole : poly.interior_rings)
+        {
+            add_ring(hole.data(), hole.size(), false);
+        }
+        finish(out);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon2<Allocator> const& poly, clip_buffer & out)
+    {
+        begin();
+        bool exterior = true;
+        for (auto const& ring : poly.rings)
+        {
+            add_ring(ring.data(), ring.size(), exterior);
+            exterior = false;
+        }
+        finish(out);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon<Allocator> const& poly, clip_buffer & out)
+    {
+        begin();
+        for (std::size_t i = 0; i < poly.num_rings(); ++i)
+        {
+            auto r = poly.ring(i);
+            add_ring(&*r.first, static_cast<std::size_t>(r.second - r.first), i == 0);
+        }
+        finish(out);
+    }
+
+    // rings are gathered into interleaved scratch points first
+    void operator() (polygon_soa const& poly, clip_buffer & out)
+    {
+        begin();
+        bool exterior = true;
+        for (auto const& ring : poly.rings)
+        {
+            std::size_t start = std::get<0>(ring);
+            std::size_t size = std::get<1>(ring);
+            soa_ring_.clear();
+            for (std::size_t i = start; i < start + size; ++i)
+            {
+                soa_ring_.emplace_back(poly.x[i], poly.y[i]);
+            }
+            add_ring(soa_ring_.data(), size, exterior);
+            exterior = false;
+        }
+        finish(out);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_flat_multi_polygon<Allocator> const& multi_poly, clip_buffer & out)
+    {
+        for (auto const& part : multi_poly.parts)
+        {
+            begin();
+            std::size_t first_ring = std::get<0>(part);
+            for (std::size_t i = 0; i < std::get<1>(part); ++i)
+            {
+                auto r = multi_poly.ring(first_ring + i);
+                add_ring(r.first, static_cast<std::size_t>(r.second - r.first), i == 0);
+            }
+            finish(out);
+        }
+    }
+
+    template <typename Allocator>
+    void operator() (basic_multi_polygon<Allocator> const& multi_poly, clip_buffer & out)
+    {
+        for (auto const& poly : multi_poly)
+        {
+            (*this)(poly, out);
+        }
+    }
+
+    // polygon `index` of `in` (e.g the output of a clip against a larger box),
+    // `in` and `out` must be different buffers
+    void operator() (clip_buffer const& in, std::size_t index, clip_buffer & out)
+    {
+        begin();
+        clip_buffer::index_type const& p = in.polygons[index];
+        for (std::size_t i = 0; i < std::get<1>(p); ++i)
+        {
+            auto r = in.ring(std::get<0>(p) + i);
+            add_ring(r.first, static_cast<std::size_t>(r.second - r.first), i == 0);
+        }
+        finish(out);
+    }
+
+private:
+    struct chain
+    {
+        std::uint32_t first;
+        std::uint32_t last; // one past
+        double entry;       // perimeter position of first point
+        double exit;        // perimeter position of last point
+    };
+
+    struct ring_range
+    {
+        std::uint32_t first;
+        std::uint32_t size;
+    };
+
+    void begin()
+    {
+        chain_points_.clear();
+        chains_.clear();
+        ring_points_.clear();
+        exteriors_.clear();
+        holes_.clear();
+        box_covered_ = false;
+        box_in_hole_ = false;
+        hole_merged_ = false;
+    }
+
+    inline bool inside(point const& pt) const
+    {
+        return pt.x >= box_.p0.x && pt.x <= box_.p1.x && pt.y >= box_.p0.y && pt.y <= box_.p1.y;
+    }
+
+    inline bool on_boundary(point const& pt) const
+    {
+        return pt.x == box_.p0.x || pt.x == box_.p1.x || pt.y == box_.p0.y || pt.y == box_.p1.y;
+    }
+
+    // a->b lies on the line of a box edge
+    inline bool along_boundary(point const& a, point const& b) const
+    {
+        return (a.x == b.x && (a.x == box_.p0.x || a.x == box_.p1.x)) ||
+               (a.y == b.y && (a.y == box_.p0.y || a.y == box_.p1.y));
+    }
+
+    // clockwise position along the box boundary, starting at (minx,miny)
+    double perimeter_position(point const& pt) const
+    {
+        double d_left = std::abs(pt.x - box_.p0.x);
+        double d_top = std::abs(box_.p1.y - pt.y);
+        double d_right = std::abs(box_.p1.x - pt.x);
+        double d_bottom = std::abs(pt.y - box_.p0.y);
+        double d = std::min(std::min(d_left, d_top), std::min(d_right, d_bottom));
+        if (d == d_left) return pt.y - box_.p0.y;
+        if (d == d_top) return height_ + (pt.x - box_.p0.x);
+        if (d == d_right) return height_ + width_ + (box_.p1.y - pt.y);
+        return 2 * height_ + width_ + (box_.p1.x - pt.x);
+    }
+
+    static void append(std::vector<point> & pts, point const& pt)
+    {
+        if (pts.empty() || pts.back().x != pt.x || pts.back().y != pt.y)
+        {
+            pts.push_back(pt);
+        }
+    }
+
+    void open_chain(point const& pt)
+    {
+        chain c;
+        c.first = static_cast<std::uint32_t>(chain_points_.size());
+        c.last = c.first;
+        c.entry = perimeter_position(pt);
+        c.exit = c.entry;
+        chains_.push_back(c);
+        chain_points_.push_back(pt);
+    }
+
+    void close_chain(point const& pt)
+    {
+        append(chain_points_, pt);
+        chain & c = chains_.back();
+        c.last = static_cast<std::uint32_t>(chain_points_.size());
+        c.exit = perimeter_position(pt);
+        if (c.last - c.first < 2 ||
+            (c.last - c.first == 2 && along_boundary(chain_points_[c.first], pt)))
+        {
+            // touches the boundary in a single point or along one edge
+            chain_points_.resize(c.first);
+            chains_.pop_back();
+        }
+    }
+
+    // end the current chain at boundary point `pt` and start the next one
+    // there, unless `pt` closes the ring ; returns whether a chain is open
+    bool cut_chain(point const& pt, bool last)
+    {
+        if (chain_points_.size() - chains_.back().first < 2) return true;
+        close_chain(pt);
+        if (last) return false;
+        open_chain(pt);
+        return true;
+    }
+
+    static bool ring_contains(point const* pts, std::size_t size, point const& pt)
+    {
+        bool result = false;
+        for (std::size_t i = 0, j = size - 1; i < size; j = i++)
+        {
+            if (((pts[i].y > pt.y) != (pts[j].y > pt.y)) &&
+                (pt.x < (pts[j].x - pts[i].x) * (pt.y - pts[i].y) / (pts[j].y - pts[i].y) + pts[i].x))
+            {
+                result = !result;
+            }
+        }
+        return result;
+    }
+
+    // a point strictly inside a simple ring : the middle of the leftmost
+    // span cut by a horizontal line between its two lowest vertex rows
+    static point interior_point(point const* pts, std::size_t size)
+    {
+        double y0 = pts[0].y;
+        for (std::size_t i = 1; i < size; ++i) y0 = std::min(y0, pts[i].y);
+        double y1 = y0;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            if (pts[i].y > y0 && (y1 == y0 || pts[i].y < y1)) y1 = pts[i].y;
+        }
+        double y = y0 + (y1 - y0) * 0.5;
+        double x0 = std::numeric_limits<double>::max();
+        double x1 = x0;
+        for (std::size_t i = 0, j = size - 1; i < size; j = i++)
+        {
+            if ((pts[i].y > y) != (pts[j].y > y))
+            {
+                double x = (pts[j].x - pts[i].x) * (y - pts[i].y) / (pts[j].y - pts[i].y) + pts[i].x;
+                if (x < x0)
+                {
+                    x1 = x0;
+                    x0 = x;
+                }
+                else if (x < x1) x1 = x;
+            }
+        }
+        return point(x0 + (x1 - x0) * 0.5, y);
+    }
+
+    static double signed_area(point const* pts, std::size_t size)
+    {
+        double area = 0.0;
+        for (std::size_t i = 0, j = size - 1; i < size; j = i++)
+        {
+            area += (pts[i].x - pts[j].x) * (pts[j].y + pts[i].y);
+        }
+        return area * 0.5; // > 0 for clockwise rings
+    }
+
+    void add_ring(point const* pts, std::size_t size, bool exterior)
+    {
+        if (size == 0) return;
+        // number of distinct vertices (closing point excluded)
+        std::size_t count = size;
+        if (size > 1 && pts[0].x == pts[size - 1].x && pts[0].y == pts[size - 1].y) --count;
+        if (count < 3) return;
+
+        // start outside the box, else on the boundary so the ring is cut there
+        std::size_t start = count;
+        std::size_t num_touches = 0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (!inside(pts[i]))
+            {
+                start = i;
+                break;
+            }
+            if (on_boundary(pts[i]) && num_touches++ == 0) start = i;
+        }
+        // kept whole : exteriors touching the boundary in at most one point,
+        // holes not touching it or inside a whole exterior
+        if (start < count && inside(pts[start]) &&
+            (exterior ? num_touches < 2 : !exteriors_.empty())) start = count;
+        if (start == count)
+        {
+            ring_range r;
+            r.first = static_cast<std::uint32_t>(ring_points_.size());
+            ring_points_.insert(ring_points_.end(), pts, pts + count);
+            ring_points_.push_back(pts[0]);
+            r.size = static_cast<std::uint32_t>(count + 1);
+            if (exterior) exteriors_.push_back(r);
+            else holes_.push_back(r);
+            return;
+        }
+
+        // chains run from boundary to boundary through the inside : they are
+        // also cut where the ring touches the boundary, and edges lying on it
+        // are left to the perimeter walk (holes touching the box merge into
+        // the exterior that way)
+        std::size_t num_chains = chains_.size();
+        bool in_chain = false;
+        for (std::size_t k = 0; k < count; ++k)
+        {
+            point const& a = pts[(start + k) % count];
+            point const& b = pts[(start + k + 1) % count];
+            bool in_a = in_chain;
+            bool in_b = inside(b);
+            bool last = (k + 1 == count);
+            double t0, t1;
+            int e0, e1;
+            if (along_boundary(a, b))
+            {
+                if (in_a) close_chain(a);
+                in_chain = false;
+            }
+            else if (in_a && in_b)
+            {
+                append(chain_points_, b);
+                if (on_boundary(b)) in_chain = cut_chain(b, last);
+            }
+            else if (in_a)
+            {
+                if (detail::clip_segment(box_, a, b, t0, t1, e0, e1))
+                {
+                    close_chain(detail::interpolate(box_, a, b, t1, e1));
+                }
+                else
+                {
+                    close_chain(a);
+                }
+                in_chain = false;
+            }
+            else if (in_b)
+            {
+                if (detail::clip_segment(box_, a, b, t0, t1, e0, e1))
+                {
+                    open_chain(detail::interpolate(box_, a, b, t0, e0));
+                }
+                else
+                {
+                    open_chain(b);
+                }
+                append(chain_points_, b);
+                in_chain = on_boundary(b) ? cut_chain(b, last) : true;
+            }
+            else if (detail::clip_segment(box_, a, b, t0, t1, e0, e1) && t0 < t1)
+            {
+                // passes through
+                open_chain(detail::interpolate(box_, a, b, t0, e0));
+                close_chain(detail::interpolate(box_, a, b, t1, e1));
+            }
+        }
+
+        if (!exterior && chains_.size() != num_chains) hole_merged_ = true;
+        if (chains_.size() == num_chains)
+        {
+            // no crossing : ring is disjoint or contains the box
+            point center(box_.p0.x + width_ * 0.5, box_.p0.y + height_ * 0.5);
+            if (ring_contains(pts, count, center))
+            {
+                if (exterior) box_covered_ = true;
+                else box_in_hole_ = true;
+            }
+        }
+    }
+
+    // a->b->c doubles back on itself
+    static bool is_spike(point const& a, point const& b, point const& c)
+    {
+        double dx0 = b.x - a.x;
+        double dy0 = b.y - a.y;
+        double dx1 = c.x - b.x;
+        double dy1 = c.y - b.y;
+        return (dx0 * dy1 - dy0 * dx1) == 0.0 && (dx0 * dx1 + dy0 * dy1) < 0.0;
+    }
+
+    // chains running along the box edges can leave zero-width spikes
+    // where the perimeter walk retraces them, remove those in place
+    static void remove_spikes(std::vector<point> & pts)
+    {
+        pts.pop_back(); // closing point
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < pts.size(); ++i)
+        {
+            point pt = pts[i];
+            while (n >= 2 && is_spike(pts[n - 2], pts[n - 1], pt)) --n;
+            if (n >= 1 && pts[n - 1].x == pt.x && pts[n - 1].y == pt.y) continue;
+            pts[n++] = pt;
+        }
+        pts.resize(n);
+        while (pts.size() >= 3)
+        {
+            std::size_t last = pts.size() - 1;
+            if (pts[last].x == pts[0].x && pts[last].y == pts[0].y)
+            {
+                pts.pop_back();
+            }
+            else if (is_spike(pts[last - 1], pts[last], pts[0]))
+            {
+                pts.pop_back();
+            }
+            else if (is_spike(pts[last], pts[0], pts[1]))
+            {
+                pts.erase(pts.begin());
+            }
+            else break;
+        }
+        if (!pts.empty()) pts.push_back(pts.front());
+    }
+
+    // clockwise loops are exteriors, counter-clockwise ones are merged holes
+    // split off where they touch the exterior
+    void add_loop(std::vector<point> const& pts)
+    {
+        if (pts.size() < 4) return;
+        double area = signed_area(pts.data(), pts.size());
+        if (area == 0.0) return;
+        ring_range r;
+        r.first = static_cast<std::uint32_t>(ring_points_.size());
+        r.size = static_cast<std::uint32_t>(pts.size());
+        ring_points_.insert(ring_points_.end(), pts.begin(), pts.end());
+        if (area > 0.0) exteriors_.push_back(r);
+        else holes_.push_back(r);
+    }
+
+    // box corners strictly between perimeter positions `from` and `to`
+    // (clockwise), all the way round when `full` and from == to
+    void walk_boundary(double from, double to, bool full, std::vector<point> & pts)
+    {
+        double perimeter = 2 * (width_ + height_);
+        double dist = to - from;
+        if (dist < 0 || (full && dist == 0)) dist += perimeter;
+        walk_.clear();
+        double corners[4] = { 0.0, height_, height_ + width_, 2 * height_ + width_ };
+        point corner_points[4] = { box_.p0, point(box_.p0.x, box_.p1.y),
+                                   box_.p1, point(box_.p1.x, box_.p0.y) };
+        for (int i = 0; i < 4; ++i)
+        {
+            double d = corners[i] - from;
+            if (d <= 0) d += perimeter;
+            if (d < dist) walk_.emplace_back(d, corner_points[i]);
+        }
+        std::sort(walk_.begin(), walk_.end(),
+                  [](std::pair<double, point> const& a, std::pair<double, point> const& b)
+                  { return a.first < b.first; });
+        for (auto const& item : walk_)
+        {
+            append(pts, item.second);
+        }
+    }
+
+    static bool point_less(point const& a, point const& b)
+    {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    }
+
+    // copy of `pts` where every vertex lying inside another edge of the ring
+    // (a merged hole touching the exterior there) is added to that edge too,
+    // edges are found through a grid of about one cell per edge
+    void node_ring(std::vector<point> const& pts, std::vector<point> & out)
+    {
+        std::size_t n = pts.size() - 1;
+        bounding_box ext = empty_envelope();
+        detail::expand_points(ext, pts.data(), pts.size());
+        std::size_t dim = std::max(std::size_t(1), static_cast<std::size_t>(std::sqrt(double(n))));
+        double cell_w = (ext.p1.x - ext.p0.x) / double(dim);
+        double cell_h = (ext.p1.y - ext.p0.y) / double(dim);
+        auto cell = [&](double v, double origin, double size)
+        {
+            if (!(size > 0)) return std::size_t(0);
+            return std::min(dim - 1, static_cast<std::size_t>((v - origin) / size));
+        };
+        cell_start_.assign(dim * dim + 1, 0);
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (std::size_t e = 0; e < n; ++e)
+            {
+                point const& a = pts[e];
+                point const& b = pts[e + 1];
+                std::size_t x0 = cell(std::min(a.x, b.x), ext.p0.x, cell_w), x1 = cell(std::max(a.x, b.x), ext.p0.x, cell_w);
+                std::size_t y0 = cell(std::min(a.y, b.y), ext.p0.y, cell_h), y1 = cell(std::max(a.y, b.y), ext.p0.y, cell_h);
+                for (std::size_t y = y0; y <= y1; ++y)
+                {
+                    for (std::size_t x = x0; x <= x1; ++x)
+                    {
+                        if (pass == 0) ++cell_start_[y * dim + x + 1];
+                        else cell_edges_[cell_fill_[y * dim + x]++] = static_cast<std::uint32_t>(e);
+                    }
+                }
+            }
+            if (pass == 0)
+            {
+                for (std::size_t i = 1; i < cell_start_.size(); ++i) cell_start_[i] += cell_start_[i - 1];
+                cell_edges_.resize(cell_start_.back());
+                cell_fill_.assign(cell_start_.begin(), cell_start_.end() - 1);
+            }
+        }
+        splits_.clear();
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            point const& v = pts[i];
+            std::size_t c = cell(v.y, ext.p0.y, cell_h) * dim + cell(v.x, ext.p0.x, cell_w);
+            for (std::size_t k = cell_start_[c]; k < cell_start_[c + 1]; ++k)
+            {
+                std::uint32_t e = cell_edges_[k];
+                point const& a = pts[e];
+                point const& b = pts[e + 1];
+                point ab(b.x - a.x, b.y - a.y);
+                point av(v.x - a.x, v.y - a.y);
+                double dot = ab.x * av.x + ab.y * av.y;
+                double len = ab.x * ab.x + ab.y * ab.y;
+                if (cross(ab, av) == 0.0 && dot > 0.0 && dot < len &&
+                    (v.x != b.x || v.y != b.y)) splits_.emplace_back(e, dot / len, v);
+            }
+        }
+        out.clear();
+        if (splits_.empty())
+        {
+            out.assign(pts.begin(), pts.end());
+            return;
+        }
+        std::sort(splits_.begin(), splits_.end(),
+                  [](std::tuple<std::uint32_t, double, point> const& a, std::tuple<std::uint32_t, double, point> const& b)
+                  { return std::get<0>(a) < std::get<0>(b) || (std::get<0>(a) == std::get<0>(b) && std::get<1>(a) < std::get<1>(b)); });
+        auto split = splits_.begin();
+        for (std::size_t e = 0; e < n; ++e)
+        {
+            append(out, pts[e]);
+            for (; split != splits_.end() && std::get<0>(*split) == e; ++split) append(out, std::get<2>(*split));
+        }
+        append(out, pts[n]);
+    }
+
+    // vertices a stitched ring passes twice away from the boundary : a merged
+    // hole touching the exterior there
+    void find_pinches(std::vector<point> const& pts)
+    {
+        sorted_.assign(pts.begin(), pts.end() - 1);
+        std::sort(sorted_.begin(), sorted_.end(), point_less);
+        pinches_.clear();
+        for (std::size_t i = 1; i < sorted_.size(); ++i)
+        {
+            point const& pt = sorted_[i];
+            if (!point_less(sorted_[i - 1], pt) && !on_boundary(pt) &&
+                (pinches_.empty() || point_less(pinches_.back(), pt))) pinches_.push_back(pt);
+        }
+    }
+
+    // split a stitched ring where it passes the same boundary vertex (or
+    // pinch) twice and emit every loop
+    void emit_loops(std::vector<point> const& stitched)
+    {
+        loop_.clear();
+        boundary_index_.clear();
+        pinches_.clear();
+        std::vector<point> const* ring = &stitched;
+        if (hole_merged_)
+        {
+            node_ring(stitched, noded_);
+            ring = &noded_;
+            find_pinches(noded_);
+        }
+        std::vector<point> const& pts = *ring;
+        for (std::size_t i = 0; i + 1 < pts.size(); ++i)
+        {
+            point const& pt = pts[i];
+            if (on_boundary(pt) ||
+                (!pinches_.empty() && std::binary_search(pinches_.begin(), pinches_.end(), pt, point_less)))
+            {
+                std::size_t j = boundary_index_.size();
+                while (j > 0)
+                {
+                    point const& other = loop_[boundary_index_[j - 1]];
+                    if (other.x == pt.x && other.y == pt.y) break;
+                    --j;
+                }
+                if (j > 0)
+                {
+                    std::size_t start = boundary_index_[j - 1];
+                    ring_.assign(loop_.begin() + static_cast<std::ptrdiff_t>(start), loop_.end());
+                    ring_.push_back(pt);
+                    remove_spikes(ring_);
+                    add_loop(ring_);
+                    loop_.resize(start + 1);
+                    boundary_index_.resize(j);
+                    continue;
+                }
+                boundary_index_.push_back(loop_.size());
+            }
+            loop_.push_back(pt);
+        }
+        if (loop_.empty()) return;
+        loop_.push_back(loop_.front());
+        remove_spikes(loop_);
+        add_loop(loop_);
+    }
+
+    static double cross(point const& a, point const& b)
+    {
+        return a.x * b.y - a.y * b.x;
+    }
+
+    // clockwise direction of the boundary at perimeter position `pos`
+    point boundary_direction(double pos) const
+    {
+        if (pos < height_) return point(0.0, 1.0);
+        if (pos < height_ + width_) return point(1.0, 0.0);
+        if (pos < 2 * height_ + width_) return point(0.0, -1.0);
+        return point(-1.0, 0.0);
+    }
+
+    // among chains order_[first, last) entering at the same point, the one
+    // turning furthest right coming from `back` (a direction pointing away
+    // from that point), only those left of `limit` when given
+    std::size_t rightmost_chain(std::vector<std::uint32_t>::const_iterator first,
+                                std::vector<std::uint32_t>::const_iterator last,
+                                point const& back, point const* limit) const
+    {
+        std::size_t best = chains_.size();
+        point best_dir(0.0, 0.0);
+        for (auto itr = first; itr != last; ++itr)
+        {
+            chain const& n = chains_[*itr];
+            point const& p0 = chain_points_[n.first];
+            point const& p1 = chain_points_[n.first + 1];
+            point dir(p1.x - p0.x, p1.y - p0.y);
+            if (limit && !(cross(back, dir) > 0 && cross(dir, *limit) > 0)) continue;
+            if (best == chains_.size() || cross(dir, best_dir) > 0)
+            {
+                best = *itr;
+                best_dir = dir;
+            }
+        }
+        return best;
+    }
+
+    // walk from the exit of `c` to the chain following it : chains entering
+    // where `c` leaves (the ring touches the boundary there) are taken when
+    // they turn right of the boundary, keeping the inside on the right,
+    // otherwise the first entry clockwise. Where several chains enter at the
+    // same point the rightmost turn wins.
+    std::size_t next_chain(chain const& c)
+    {
+        auto range = std::equal_range(order_.begin(), order_.end(), c.exit, position_less{chains_});
+        point const& exit_pt = chain_points_[c.last - 1];
+        point const& prev = chain_points_[c.last - 2];
+        point along = boundary_direction(c.exit);
+        std::size_t next = rightmost_chain(range.first, range.second,
+                                           point(prev.x - exit_pt.x, prev.y - exit_pt.y), &along);
+        if (next != chains_.size()) return next;
+        auto first = (range.second == order_.end()) ? order_.begin() : range.second;
+        double entry = chains_[*first].entry;
+        auto last = std::upper_bound(first, order_.end(), entry, position_less{chains_});
+        walk_boundary(c.exit, entry, entry == c.exit, stitched_);
+        point const& entry_pt = chain_points_[chains_[*first].first];
+        point const& before = stitched_.back();
+        return rightmost_chain(first, last, point(before.x - entry_pt.x, before.y - entry_pt.y), nullptr);
+    }
+
+    struct position_less
+    {
+        std::vector<chain> const& chains;
+        bool operator() (std::uint32_t a, double pos) const { return chains[a].entry < pos; }
+        bool operator() (double pos, std::uint32_t a) const { return pos < chains[a].entry; }
+    };
+
+    void stitch()
+    {
+        std::size_t num_chains = chains_.size();
+        order_.resize(num_chains);
+        used_.assign(num_chains, false);
+        for (std::size_t i = 0; i < num_chains; ++i) order_[i] = static_cast<std::uint32_t>(i);
+        std::sort(order_.begin(), order_.end(), [this](std::uint32_t a, std::uint32_t b)
+                  { return chains_[a].entry < chains_[b].entry; });
+
+        for (std::size_t i = 0; i < num_chains; ++i)
+        {
+            if (used_[i]) continue;
+            stitched_.clear();
+            std::size_t current = i;
+            for (;;)
+            {
+                used_[current] = true;
+                chain const& c = chains_[current];
+                for (std::uint32_t j = c.first; j < c.last; ++j)
+                {
+                    append(stitched_, chain_points_[j]);
+                }
+                std::size_t next = next_chain(c);
+                if (next == i || used_[next]) break;
+                current = next;
+            }
+            append(stitched_, stitched_.front());
+            emit_loops(stitched_);
+        }
+    }
+
+    void finish(clip_buffer & out)
+    {
+        if (box_in_hole_) return;
+        if (!chains_.empty())
+        {
+            stitch();
+        }
+        else if (box_covered_)
+        {
+            stitched_.clear();
+            stitched_.push_back(box_.p0);
+            stitched_.emplace_back(box_.p0.x, box_.p1.y);
+            stitched_.push_back(box_.p1);
+            stitched_.emplace_back(box_.p1.x, box_.p0.y);
+            stitched_.push_back(box_.p0);
+            add_loop(stitched_);
+        }
+
+        // assign fully contained holes to their exterior, by a point off
+        // the hole's vertices (those may lie on the exterior)
+        hole_owner_.assign(holes_.size(), exteriors_.size());
+        for (std::size_t h = 0; h < holes_.size(); ++h)
+        {
+            point pt = interior_point(ring_points_.data() + holes_[h].first, holes_[h].size);
+            for (std::size_t e = 0; e < exteriors_.size(); ++e)
+            {
+                if (ring_contains(ring_points_.data() + exteriors_[e].first, exteriors_[e].size, pt))
+                {
+                    hole_owner_[h] = e;
+                    break;
+                }
+            }
+        }
+
+        for (std::size_t e = 0; e < exteriors_.size(); ++e)
+        {
+            std::uint32_t first_ring = static_cast<std::uint32_t>(out.rings.size());
+            emit_ring(exteriors_[e], out);
+            for (std::size_t h = 0; h < holes_.size(); ++h)
+            {
+                if (hole_owner_[h] == e) emit_ring(holes_[h], out);
+            }
+            out.polygons.emplace_back(first_ring, static_cast<std::uint32_t>(out.rings.size()) - first_ring);
+        }
+    }
+
+    void emit_ring(ring_range const& r, clip_buffer & out) const
+    {
+        out.rings.emplace_back(static_cast<std::uint32_t>(out.points.size()), r.size);
+        out.points.insert(out.points.end(), ring_points_.begin() + r.first, ring_points_.begin() + r.first + r.size);
+    }
+
+    bounding_box box_;
+    double width_;
+    double height_;
+    bool box_covered_ = false;
+    bool box_in_hole_ = false;
+    bool hole_merged_ = false;
+    std::vector<point> chain_points_;
+    std::vector<chain> chains_;
+    std::vector<point> ring_points_;
+    std::vector<ring_range> exteriors_;
+    std::vector<ring_range> holes_;
+    std::vector<std::size_t> hole_owner_;
+    std::vector<std::uint32_t> order_;
+    std::vector<bool> used_;
+    std::vector<point> stitched_;
+    std::vector<std::pair<double, point> > walk_;
+    std::vector<point> loop_;
+    std::vector<point> ring_;
+    std::vector<std::size_t> boundary_index_;
+    std::vector<point> sorted_;
+    std::vector<point> pinches_;
+    std::vector<point> noded_;
+    std::vector<std::size_t> cell_start_;
+    std::vector<std::size_t> cell_fill_;
+    std::vector<std::uint32_t> cell_edges_;
+    std::vector<std::tuple<std::uint32_t, double, point> > splits_;
+    std::vector<point> soa_ring_;
+};
+
+// Clips the SEG_MOVETO/SEG_LINETO stream of a line vertex source
+// (line_string_vertex_adapter, multi_line_string_vertex_adapter ..)
+// against a box on the fly. Every visible piece starts with SEG_MOVETO.
+// No intermediate geometry is built, state is a few vertices.
+template <typename VertexSource>
+struct line_clip_adapter
+{
+    line_clip_adapter(VertexSource const& source, bounding_box const& box)
+        : source_(source),
+          box_(box),
+          prev_(0, 0),
+          need_move_(true),
+          queue_size_(0),
+          queue_index_(0) {}
+
+    unsigned vertex(double*x, double*y) const
+    {
+        for (;;)
+        {
+            if (queue_index_ < queue_size_)
+            {
+                queued_vertex const& v = queue_[queue_index_++];
+                *x = v.pt.x;
+                *y = v.pt.y;
+                return v.cmd;
+            }
+            queue_size_ = queue_index_ = 0;
+            point pt;
+            unsigned cmd = source_.vertex(&pt.x, &pt.y);
+            if (cmd == mapnik::SEG_END) return mapnik::SEG_END;
+            if (cmd == mapnik::SEG_MOVETO)
+            {
+                prev_ = pt;
+                need_move_ = true;
+                if (inside(pt))
+                {
+                    push(mapnik::SEG_MOVETO, pt);
+                    need_move_ = false;
+                }
+                continue;
+            }
+            // SEG_LINETO (SEG_CLOSE treated alike)
+            double t0, t1;
+            int e0, e1;
+            if (detail::clip_segment(box_, prev_, pt, t0, t1, e0, e1) && t0 < t1)
+            {
+                if (need_move_ || t0 > 0.0)
+                {
+                    push(mapnik::SEG_MOVETO, detail::interpolate(box_, prev_, pt, t0, e0));
+                }
+                push(mapnik::SEG_LINETO, detail::interpolate(box_, prev_, pt, t1, e1));
+                need_move_ = (t1 < 1.0);
+            }
+            else
+            {
+                need_move_ = true;
+            }
+            prev_ = pt;
+        }
+    }
+
+    void rewind(unsigned path_id) const
+    {
+        source_.rewind(path_id);
+        need_move_ = true;
+        queue_size_ = queue_index_ = 0;
+    }
+
+private:
+    struct queued_vertex
+    {
+        unsigned cmd;
+        point pt;
+    };
+
+    inline bool inside(point const& pt) const
+    {
+        return pt.x >= box_.p0.x && pt.x <= box_.p1.x && pt.y >= box_.p0.y && pt.y <= box_.p1.y;
+    }
+
+    void push(unsigned cmd, point const& pt) const
+    {
+        queued_vertex & v = queue_[queue_size_++];
+        v.cmd = cmd;
+        v.pt = pt;
+    }
+
+    VertexSource const& source_;
+    bounding_box box_;
+    mutable point prev_;
+    mutable bool need_move_;
+    mutable queued_vertex queue_[2];
+    mutable std::size_t queue_size_;
+    mutable std::size_t queue_index_;
+};
+
+template <typename VertexSource>
+inline line_clip_adapter<VertexSource> make_line_clip_adapter(VertexSource const& source, bounding_box const& box)
+{
+    return line_clip_adapter<VertexSource>(source, box);
+}
+
+}}
+
+#endif //MAPNIK_GEOMETRY_CLIP_HPP
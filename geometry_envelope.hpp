@@ -0,0 +1,386 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_ENVELOPE_HPP
+#define MAPNIK_GEOMETRY_ENVELOPE_HPP
+
+#include "geometry_impl.hpp"
+
+#include <limits>
+#include <algorithm>
+#include <tuple>
+
+// min/max reductions : AVX (4 doubles), SSE2 (2 doubles) or scalar,
+// selected at compile time from the target flags (e.g -mavx, -msse2)
+// min_pd/max_pd return their second operand when either is NaN, so the new
+// value goes first : NaN ordinates (empty points) are skipped in every
+// kernel, as std::min/std::max do in the scalar loop
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MAPNIK_GEOMETRY_ENVELOPE_AVX
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MAPNIK_GEOMETRY_ENVELOPE_SSE2
+#endif
+
+namespace mapnik { namespace new_geometry {
+
+// inverted box, expanding it by any valid box yields that box
+inline bounding_box empty_envelope()
+{
+    return bounding_box(std::numeric_limits<double>::max(),
+                        std::numeric_limits<double>::max(),
+                        -std::numeric_limits<double>::max(),
+                        -std::numeric_limits<double>::max());
+}
+
+inline bool is_empty(bounding_box const& bbox)
+{
+    return bbox.p0.x > bbox.p1.x || bbox.p0.y > bbox.p1.y;
+}
+
+inline void expand(bounding_box & bbox, bounding_box const& other)
+{
+    bbox.p0.x = std::min(bbox.p0.x, other.p0.x);
+    bbox.p0.y = std::min(bbox.p0.y, other.p0.y);
+    bbox.p1.x = std::max(bbox.p1.x, other.p1.x);
+    bbox.p1.y = std::max(bbox.p1.y, other.p1.y);
+}
+
+inline bool intersects(bounding_box const& a, bounding_box const& b)
+{
+    return !(b.p0.x > a.p1.x || b.p1.x < a.p0.x || b.p0.y > a.p1.y || b.p1.y < a.p0.y);
+}
+
+// true if `inner` lies completely inside `outer`
+inline bool contains(bounding_box const& outer, bounding_box const& inner)
+{
+    return inner.p0.x >= outer.p0.x && inner.p1.x <= outer.p1.x
+        && inner.p0.y >= outer.p0.y && inner.p1.y <= outer.p1.y;
+}
+
+namespace detail {
+
+static_assert(sizeof(point) == 2 * sizeof(double), "point must be two packed doubles");
+
+// interleaved x,y,x,y.. buffer
+inline void expand_points(bounding_box & bbox, point const* pts, std::size_t size)
+{
+    std::size_t i = 0;
+#if defined(MAPNIK_GEOMETRY_ENVELOPE_AVX)
+    if (size >= 2)
+    {
+        __m256d lo = _mm256_set_pd(bbox.p0.y, bbox.p0.x, bbox.p0.y, bbox.p0.x);
+        __m256d hi = _mm256_set_pd(bbox.p1.y, bbox.p1.x, bbox.p1.y, bbox.p1.x);
+        for (; i + 2 <= size; i += 2)
+        {
+            __m256d v = _mm256_loadu_pd(&pts[i].x);
+            lo = _mm256_min_pd(v, lo);
+            hi = _mm256_max_pd(v, hi);
+        }
+        __m128d lo2 = _mm_min_pd(_mm256_castpd256_pd128(lo), _mm256_extractf128_pd(lo, 1));
+        __m128d hi2 = _mm_max_pd(_mm256_castpd256_pd128(hi), _mm256_extractf128_pd(hi, 1));
+        if (i < size)
+        {
+            __m128d v = _mm_loadu_pd(&pts[i].x);
+            lo2 = _mm_min_pd(v, lo2);
+            hi2 = _mm_max_pd(v, hi2);
+            ++i;
+        }
+        _mm_storeu_pd(&bbox.p0.x, lo2);
+        _mm_storeu_pd(&bbox.p1.x, hi2);
+    }
+#elif defined(MAPNIK_GEOMETRY_ENVELOPE_SSE2)
+    __m128d lo = _mm_loadu_pd(&bbox.p0.x);
+    __m128d hi = _mm_loadu_pd(&bbox.p1.x);
+    for (; i < size; ++i)
+    {
+        __m128d v = _mm_loadu_pd(&pts[i].x);
+        lo = _mm_min_pd(v, lo);
+        hi = _mm_max_pd(v, hi);
+    }
+    _mm_storeu_pd(&bbox.p0.x, lo);
+    _mm_storeu_pd(&bbox.p1.x, hi);
+#endif
+    for (; i < size; ++i)
+    {
+        bbox.p0.x = std::min(bbox.p0.x, pts[i].x);
+        bbox.p0.y = std::min(bbox.p0.y, pts[i].y);
+        bbox.p1.x = std::max(bbox.p1.x, pts[i].x);
+        bbox.p1.y = std::max(bbox.p1.y, pts[i].y);
+    }
+}
+
+// single ordinate array (soa storage)
+inline void expand_ordinates(double & lo, double & hi, double const* vals, std::size_t size)
+{
+    std::size_t i = 0;
+#if defined(MAPNIK_GEOMETRY_ENVELOPE_AVX)
+    if (size >= 4)
+    {
+        __m256d lo4 = _mm256_set1_pd(lo);
+        __m256d hi4 = _mm256_set1_pd(hi);
+        for (; i + 4 <= size; i += 4)
+        {
+            __m256d v = _mm256_loadu_pd(vals + i);
+            lo4 = _mm256_min_pd(v, lo4);
+            hi4 = _mm256_max_pd(v, hi4);
+        }
+        __m128d lo2 = _mm_min_pd(_mm256_castpd256_pd128(lo4), _mm256_extractf128_pd(lo4, 1));
+        __m128d hi2 = _mm_max_pd(_mm256_castpd256_pd128(hi4), _mm256_extractf128_pd(hi4, 1));
+        lo = _mm_cvtsd_f64(_mm_min_sd(lo2, _mm_unpackhi_pd(lo2, lo2)));
+        hi = _mm_cvtsd_f64(_mm_max_sd(hi2, _mm_unpackhi_pd(hi2, hi2)));
+    }
+#elif defined(MAPNIK_GEOMETRY_ENVELOPE_SSE2)
+    if (size >= 2)
+    {
+        __m128d lo2 = _mm_set1_pd(lo);
+        __m128d hi2 = _mm_set1_pd(hi);
+        for (; i + 2 <= size; i += 2)
+        {
+            __m128d v = _mm_loadu_pd(vals + i);
+            lo2 = _mm_min_pd(v, lo2);
+            hi2 = _mm_max_pd(v, hi2);
+        }
+        lo = _mm_cvtsd_f64(_mm_min_sd(lo2, _mm_unpackhi_pd(lo2, lo2)));
+        hi = _mm_cvtsd_f64(_mm_max_sd(hi2, _mm_unpackhi_pd(hi2, hi2)));
+    }
+#endif
+    for (; i < size; ++i)
+    {
+        lo = std::min(lo, vals[i]);
+        hi = std::max(hi, vals[i]);
+    }
+}
+
+template <typename Ring>
+inline void expand_ring(bounding_box & bbox, Ring const& ring)
+{
+    if (!ring.empty()) expand_points(bbox, ring.data(), ring.size());
+}
+
+// (start, count) ring of a flat buffer
+template <typename Points, typename Index>
+inline void expand_ring(bounding_box & bbox, Points const& data, Index const& ring)
+{
+    if (std::get<1>(ring) > 0) expand_points(bbox, data.data() + std::get<0>(ring), std::get<1>(ring));
+}
+
+} // namespace detail
+
+inline bounding_box envelope(point const& pt)
+{
+    return bounding_box(pt.x, pt.y, pt.x, pt.y);
+}
+
+template <typename Allocator>
+inline bounding_box envelope(basic_line_string<Allocator> const& line)
+{
+    bounding_box bbox = empty_envelope();
+    detail::expand_ring(bbox, line.data);
+    return bbox;
+}
+
+// Polygons are bounded by their exterior ring in every layout, holes are
+// ignored even when they stick out of malformed input (as Boost.Geometry).
+template <typename Allocator>
+inline bounding_box envelope(basic_polygon<Allocator> const& poly)
+{
+    bounding_box bbox = empty_envelope();
+    if (!poly.rings.empty()) detail::expand_ring(bbox, poly.data, poly.rings.front());
+    return bbox;
+}
+
+template <typename Allocator>
+inline bounding_box envelope(basic_polygon2<Allocator> const& poly)
+{
+    bounding_box bbox = empty_envelope();
+    if (!poly.rings.empty()) detail::expand_ring(bbox, poly.rings.front());
+    return bbox;
+}
+
+template <typename Allocator>
+inline bounding_box envelope(basic_polygon3<Allocator> const& poly)
+{
+    bounding_box bbox = empty_envelope();
+    detail::expand_ring(bbox, poly.exterior_ring);
+    return bbox;
+}
+
+inline bounding_box envelope(soa_vertex_sequence const& seq)
+{
+    bounding_box bbox = empty_envelope();
+    detail::expand_ordinates(bbox.p0.x, bbox.p1.x, seq.x.data(), seq.size());
+    detail::expand_ordinates(bbox.p0.y, bbox.p1.y, seq.y.data(), seq.size());
+    return bbox;
+}
+
+inline bounding_box envelope(polygon_soa const& poly)
+{
+    bounding_box bbox = empty_envelope();
+    if (!poly.rings.empty())
+    {
+        std::size_t start = std::get<0>(poly.rings.front());
+        std::size_t count = std::get<1>(poly.rings.front());
+        detail::expand_ordinates(bbox.p0.x, bbox.p1.x, poly.x.data() + start, count);
+        detail::expand_ordinates(bbox.p0.y, bbox.p1.y, poly.y.data() + start, count);
+    }
+    return bbox;
+}
+
+template <typename Allocator>
+inline bounding_box envelope(basic_multi_point<Allocator> const& multi_pt)
+{
+    bounding_box bbox = empty_envelope();
+    detail::expand_ring(bbox, multi_pt);
+    return bbox;
+}
+
+template <typename Allocator>
+inline bounding_box envelope(basic_multi_line_string<Allocator> const& multi_line)
+{
+    bounding_box bbox = empty_envelope();
+    for (auto const& line : multi_line)
+    {
+        detail::expand_ring(bbox, line.data);
+    }
+    return bbox;
+}
+
+template <typename Allocator>
+inline bounding_box envelope(basic_multi_polygon<Allocator> const& multi_poly)
+{
+    bounding_box bbox = empty_envelope();
+    for (auto const& poly : multi_poly)
+    {
+        detail::expand_ring(bbox, poly.exterior_ring);
+    }
+    return bbox;
+}
+
+template <typename Allocator>
+inline bounding_box envelope(basic_flat_multi_polygon<Allocator> const& multi_poly)
+{
+    bounding_box bbox = empty_envelope();
+    for (auto const& part : multi_poly.parts)
+    {
+        if (std::get<1>(part) > 0) detail::expand_ring(bbox, multi_poly.data, multi_poly.rings[std::get<0>(part)]);
+    }
+    return bbox;
+}
+
+template <typename Allocator>
+inline bounding_box envelope(basic_geometry_collection<Allocator> const& collection);
+
+struct envelope_visitor
+{
+    template <typename T>
+    bounding_box operator() (T const& geom) const
+    {
+        return envelope(geom);
+    }
+};
+
+template <typename Allocator>
+inline bounding_box envelope(basic_geometry<Allocator> const& geom)
+{
+    return mapnik::util::apply_visitor(envelope_visitor(), geom);
+}
+
+template <typename Allocator>
+inline bounding_box envelope(basic_geometry_collection<Allocator> const& collection)
+{
+    bounding_box bbox = empty_envelope();
+    for (auto const& geom : collection)
+    {
+        expand(bbox, envelope(geom));
+    }
+    return bbox;
+}
+
+// Optional wrapper carrying a lazily computed bounding box.
+// Read access through geometry(), any mutation must go through
+// mutable_geometry() which invalidates the cached box.
+// Note: the lazy update is not synchronised, call envelope() (or update())
+// once before sharing between threads.
+template <typename Geometry>
+struct cached_envelope
+{
+    using geometry_type = Geometry;
+
+    cached_envelope()
+        : geom_(),
+          bbox_(empty_envelope()),
+          valid_(false) {}
+
+    cached_envelope(Geometry && geom)
+        : geom_(std::move(geom)),
+          bbox_(empty_envelope()),
+          valid_(false) {}
+
+    cached_envelope(Geometry const& geom)
+        : geom_(geom),
+          bbox_(empty_envelope()),
+          valid_(false) {}
+
+    Geometry const& geometry() const
+    {
+        return geom_;
+    }
+
+    Geometry & mutable_geometry()
+    {
+        valid_ = false;
+        return geom_;
+    }
+
+    bounding_box const& envelope() const
+    {
+        if (!valid_) update();
+        return bbox_;
+    }
+
+    void update() const
+    {
+        bbox_ = new_geometry::envelope(geom_);
+        valid_ = true;
+    }
+
+    bool cached() const
+    {
+        return valid_;
+    }
+private:
+    Geometry geom_;
+    mutable bounding_box bbox_;
+    mutable bool valid_;
+};
+
+template <typename Geometry>
+inline bounding_box envelope(cached_envelope<Geometry> const& geom)
+{
+    return geom.envelope();
+}
+
+}}
+
+#endif //MAPNIK_GEOMETRY_ENVELOPE_HPP
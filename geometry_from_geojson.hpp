@@ -0,0 +1,461 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_FROM_GEOJSON_HPP
+#define MAPNIK_GEOMETRY_FROM_GEOJSON_HPP
+
+#include "geometry_impl.hpp"
+#include "geometry_parse_number.hpp"
+
+#include <string>
+#include <cstring>
+#include <limits>
+
+namespace mapnik { namespace new_geometry {
+
+// Single pass GeoJSON reader building new_geometry types directly :
+// Point, LineString, Polygon (polygon3), MultiPoint, MultiLineString,
+// MultiPolygon (multi_polygon of polygon3) and GeometryCollection. A Feature
+// object yields its "geometry" member, an empty geometry_collection when it
+// is null. Objects nested deeper than max_depth (collections of collections,
+// ...) are rejected. Every container is created with the
+// parser allocator (e.g arena_allocator<point>) and each position list is
+// reserved from a bracket pre-scan before it's read. Members may come in any
+// order, "coordinates" seen before "type" are skipped and re-read.
+template <typename Allocator = std::allocator<point> >
+class basic_geojson_parser
+{
+public:
+    using geometry_type = basic_geometry<Allocator>;
+
+    static const std::size_t max_depth = 16;
+
+    explicit basic_geojson_parser(Allocator const& alloc = Allocator())
+        : alloc_(alloc),
+          itr_(nullptr),
+          end_(nullptr),
+          depth_(0) {}
+
+    // false on malformed input or unsupported geometry type
+    bool parse(char const* first, char const* last, geometry_type & geom)
+    {
+        itr_ = first;
+        end_ = last;
+        depth_ = 0;
+        if (!parse_object(geom)) return false;
+        skip_ws();
+        return itr_ == end_;
+    }
+
+    bool parse(std::string const& json, geometry_type & geom)
+    {
+        return parse(json.data(), json.data() + json.size(), geom);
+    }
+
+private:
+    enum geojson_type
+    {
+        unknown_type,
+        point_type,
+        line_string_type,
+        polygon_type,
+        multi_point_type,
+        multi_line_string_type,
+        multi_polygon_type,
+        geometry_collection_type,
+        feature_type
+    };
+
+    using line_string_type_ = basic_line_string<Allocator>;
+    using polygon_type_ = basic_polygon3<Allocator>;
+    using ring_type = typename polygon_type_::ring_type;
+    using multi_point_type_ = basic_multi_point<Allocator>;
+    using multi_line_string_type_ = basic_multi_line_string<Allocator>;
+    using multi_polygon_type_ = basic_multi_polygon<Allocator>;
+    using collection_type = basic_geometry_collection<Allocator>;
+
+    void skip_ws()
+    {
+        while (itr_ != end_ && (*itr_ == ' ' || *itr_ == '\n' || *itr_ == '\r' || *itr_ == '\t')) ++itr_;
+    }
+
+    bool expect(char c)
+    {
+        skip_ws();
+        if (itr_ == end_ || *itr_ != c) return false;
+        ++itr_;
+        return true;
+    }
+
+    bool peek(char c)
+    {
+        skip_ws();
+        return itr_ != end_ && *itr_ == c;
+    }
+
+    // string body between quotes, escapes are kept as is
+    bool parse_string(char const*& first, char const*& last)
+    {
+        if (!expect('"')) return false;
+        first = itr_;
+        while (itr_ != end_ && *itr_ != '"')
+        {
+            if (*itr_ == '\\' && ++itr_ == end_) return false;
+            ++itr_;
+        }
+        if (itr_ == end_) return false;
+        last = itr_++;
+        return true;
+    }
+
+    static bool equals(char const* first, char const* last, char const* str)
+    {
+        std::size_t size = static_cast<std::size_t>(last - first);
+        return std::strlen(str) == size && std::memcmp(first, str, size) == 0;
+    }
+
+    static geojson_type to_type(char const* first, char const* last)
+    {
+        if (equals(first, last, "Point")) return point_type;
+        if (equals(first, last, "LineString")) return line_string_type;
+        if (equals(first, last, "Polygon")) return polygon_type;
+        if (equals(first, last, "MultiPoint")) return multi_point_type;
+        if (equals(first, last, "MultiLineString")) return multi_line_string_type;
+        if (equals(first, last, "MultiPolygon")) return multi_polygon_type;
+        if (equals(first, last, "GeometryCollection")) return geometry_collection_type;
+        if (equals(first, last, "Feature")) return feature_type;
+        return unknown_type;
+    }
+
+    // any JSON value
+    bool skip_value()
+    {
+        skip_ws();
+        if (itr_ == end_) return false;
+        char const* first;
+        char const* last;
+        switch (*itr_)
+        {
+        case '"':
+            return parse_string(first, last);
+        case '{':
+        case '[':
+        {
+            std::size_t depth = 0;
+            while (itr_ != end_)
+            {
+                char c = *itr_;
+                if (c == '"')
+                {
+                    if (!parse_string(first, last)) return false;
+                    continue;
+                }
+                ++itr_;
+                if (c == '{' || c == '[') ++depth;
+                else if ((c == '}' || c == ']') && --depth == 0) return true;
+            }
+            return false;
+        }
+        default:
+            while (itr_ != end_ && *itr_ != ',' && *itr_ != '}' && *itr_ != ']'
+                   && *itr_ != ' ' && *itr_ != '\n' && *itr_ != '\r' && *itr_ != '\t') ++itr_;
+            return true;
+        }
+    }
+
+    bool parse_number(double & value)
+    {
+        skip_ws();
+        return detail::parse_number(itr_, end_, value);
+    }
+
+    // number of positions in the list starting at itr_
+    std::size_t count_positions() const
+    {
+        std::size_t depth = 0;
+        std::size_t count = 0;
+        for (char const* p = itr_; p != end_; ++p)
+        {
+            if (*p == '[')
+            {
+                if (++depth == 2) ++count;
+            }
+            else if (*p == ']' && --depth == 0) break;
+        }
+        return count;
+    }
+
+    // [x, y(, z ...)] extra ordinates are dropped
+    bool parse_position(double & x, double & y)
+    {
+        if (!expect('[') || !parse_number(x) || !expect(',') || !parse_number(y)) return false;
+        while (peek(','))
+        {
+            ++itr_;
+            double z;
+            if (!parse_number(z)) return false;
+        }
+        return expect(']');
+    }
+
+    template <typename Points>
+    bool parse_positions(Points & points)
+    {
+        skip_ws();
+        points.reserve(count_positions());
+        if (!expect('[')) return false;
+        if (peek(']'))
+        {
+            ++itr_;
+            return true;
+        }
+        do
+        {
+            double x, y;
+            if (!parse_position(x, y)) return false;
+            points.emplace_back(x, y);
+        }
+        while (expect(','));
+        return expect(']');
+    }
+
+    bool parse_rings(polygon_type_ & poly)
+    {
+        if (!expect('[')) return false;
+        if (peek(']'))
+        {
+            ++itr_;
+            return true;
+        }
+        bool exterior = true;
+        do
+        {
+            ring_type ring(alloc_);
+            if (!parse_positions(ring)) return false;
+            if (exterior) poly.set_exterior_ring(std::move(ring));
+            else poly.add_hole(std::move(ring));
+            exterior = false;
+        }
+        while (expect(','));
+        return expect(']');
+    }
+
+    // '[' item (',' item)* ']'
+    template <typename Container, typename Parse>
+    bool parse_list(Container & cont, Parse parse_item)
+    {
+        if (!expect('[')) return false;
+        if (peek(']'))
+        {
+            ++itr_;
+            return true;
+        }
+        do
+        {
+            cont.emplace_back(alloc_);
+            if (!(this->*parse_item)(cont.back())) return false;
+        }
+        while (expect(','));
+        return expect(']');
+    }
+
+    bool parse_line_string(line_string_type_ & line)
+    {
+        return parse_positions(line.data);
+    }
+
+    bool parse_coordinates(geojson_type type, geometry_type & geom)
+    {
+        switch (type)
+        {
+        case point_type:
+        {
+            // [] is an empty point, NaN as POINT EMPTY in geometry_from_wkt.hpp
+            double x = std::numeric_limits<double>::quiet_NaN();
+            double y = x;
+            char const* start = itr_;
+            if (!expect('[') || !expect(']'))
+            {
+                itr_ = start;
+                if (!parse_position(x, y)) return false;
+            }
+            geom = point(x, y);
+            return true;
+        }
+        case line_string_type:
+        {
+            line_string_type_ line(alloc_);
+            if (!parse_positions(line.data)) return false;
+            geom = std::move(line);
+            return true;
+        }
+        case polygon_type:
+        {
+            polygon_type_ poly(alloc_);
+            if (!parse_rings(poly)) return false;
+            geom = std::move(poly);
+            return true;
+        }
+        case multi_point_type:
+        {
+            multi_point_type_ multi_pt(alloc_);
+            if (!parse_positions(multi_pt)) return false;
+            geom = std::move(multi_pt);
+            return true;
+        }
+        case multi_line_string_type:
+        {
+            multi_line_string_type_ multi_line(alloc_);
+            if (!parse_list(multi_line, &basic_geojson_parser::parse_line_string)) return false;
+            geom = std::move(multi_line);
+            return true;
+        }
+        case multi_polygon_type:
+        {
+            multi_polygon_type_ multi_poly(alloc_);
+            if (!parse_list(multi_poly, &basic_geojson_parser::parse_rings)) return false;
+            geom = std::move(multi_poly);
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    bool parse_null()
+    {
+        skip_ws();
+        if (end_ - itr_ < 4 || std::memcmp(itr_, "null", 4) != 0) return false;
+        itr_ += 4;
+        return true;
+    }
+
+    bool parse_object(geometry_type & geom)
+    {
+        if (depth_ == max_depth) return false;
+        ++depth_;
+        bool result = parse_object_members(geom);
+        --depth_;
+        return result;
+    }
+
+    bool parse_object_members(geometry_type & geom)
+    {
+        if (!expect('{')) return false;
+        geojson_type type = unknown_type;
+        char const* deferred = nullptr;
+        bool done = false;
+        if (peek('}'))
+        {
+            ++itr_;
+            return false;
+        }
+        do
+        {
+            char const* first;
+            char const* last;
+            if (!parse_string(first, last) || !expect(':')) return false;
+            if (equals(first, last, "type"))
+            {
+                char const* type_first;
+                char const* type_last;
+                if (!parse_string(type_first, type_last)) return false;
+                type = to_type(type_first, type_last);
+                if (type == unknown_type) return false;
+            }
+            else if (!done && (equals(first, last, "coordinates") || equals(first, last, "geometries")))
+            {
+                skip_ws();
+                if (type == unknown_type)
+                {
+                    deferred = itr_;
+                    if (!skip_value()) return false;
+                }
+                else
+                {
+                    if (!parse_member(type, geom)) return false;
+                    done = true;
+                }
+            }
+            else if (!done && equals(first, last, "geometry"))
+            {
+                if (parse_null()) geom = collection_type(alloc_);
+                else if (!parse_object(geom)) return false;
+                done = true;
+            }
+            else if (!skip_value()) return false;
+        }
+        while (expect(','));
+        if (!expect('}')) return false;
+        if (!done && deferred != nullptr && type != feature_type)
+        {
+            char const* end_of_object = itr_;
+            itr_ = deferred;
+            if (!parse_member(type, geom)) return false;
+            itr_ = end_of_object;
+            done = true;
+        }
+        return done;
+    }
+
+    bool parse_member(geojson_type type, geometry_type & geom)
+    {
+        if (type == geometry_collection_type)
+        {
+            collection_type collection(alloc_);
+            if (!expect('[')) return false;
+            if (!peek(']'))
+            {
+                do
+                {
+                    // built on the parser allocator until the member replaces it
+                    collection.emplace_back(collection_type(alloc_));
+                    if (!parse_object(collection.back())) return false;
+                }
+                while (expect(','));
+            }
+            if (!expect(']')) return false;
+            geom = std::move(collection);
+            return true;
+        }
+        return parse_coordinates(type, geom);
+    }
+
+    Allocator alloc_;
+    char const* itr_;
+    char const* end_;
+    std::size_t depth_;
+};
+
+using geojson_parser = basic_geojson_parser<>;
+
+template <typename Allocator>
+inline bool from_geojson(std::string const& json, basic_geometry<Allocator> & geom,
+                         Allocator const& alloc = Allocator())
+{
+    basic_geojson_parser<Allocator> parser(alloc);
+    return parser.parse(json, geom);
+}
+
+}}
+
+#endif //MAPNIK_GEOMETRY_FROM_GEOJSON_HPP
@@ -0,0 +1,381 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_FROM_WKT_HPP
+#define MAPNIK_GEOMETRY_FROM_WKT_HPP
+
+#include "geometry_impl.hpp"
+#include "geometry_parse_number.hpp"
+
+#include <string>
+#include <limits>
+
+namespace mapnik { namespace new_geometry {
+
+// Single pass WKT reader building new_geometry types directly, the type is
+// dispatched on the tag (no trial parses, no exceptions) : POINT, LINESTRING,
+// POLYGON (polygon3), MULTIPOINT, MULTILINESTRING, MULTIPOLYGON
+// (multi_polygon of polygon3) and GEOMETRYCOLLECTION. Tags are case
+// insensitive, EWKT "SRID=n;" prefixes and Z/M/ZM ordinates are accepted and
+// dropped. POINT EMPTY is a NaN point. Point lists are reserved from a comma
+// pre-scan before they're read.
+template <typename Allocator = std::allocator<point> >
+class basic_wkt_parser
+{
+public:
+    using geometry_type = basic_geometry<Allocator>;
+
+    static const std::size_t max_depth = 16;
+
+    explicit basic_wkt_parser(Allocator const& alloc = Allocator())
+        : alloc_(alloc),
+          itr_(nullptr),
+          end_(nullptr) {}
+
+    // false on malformed input
+    bool parse(char const* first, char const* last, geometry_type & geom)
+    {
+        itr_ = first;
+        end_ = last;
+        skip_ws();
+        if (end_ - itr_ > 5 && upper(itr_[0]) == 'S' && upper(itr_[1]) == 'R' && upper(itr_[2]) == 'I'
+            && upper(itr_[3]) == 'D' && itr_[4] == '=')
+        {
+            while (itr_ != end_ && *itr_ != ';') ++itr_;
+            if (itr_ == end_) return false;
+            ++itr_;
+        }
+        if (!parse_tagged(geom, 0)) return false;
+        skip_ws();
+        return itr_ == end_;
+    }
+
+    bool parse(std::string const& wkt, geometry_type & geom)
+    {
+        return parse(wkt.data(), wkt.data() + wkt.size(), geom);
+    }
+
+private:
+    enum wkt_type
+    {
+        unknown_type,
+        point_type,
+        line_string_type,
+        polygon_type,
+        multi_point_type,
+        multi_line_string_type,
+        multi_polygon_type,
+        geometry_collection_type
+    };
+
+    using line_string_type_ = basic_line_string<Allocator>;
+    using polygon_type_ = basic_polygon3<Allocator>;
+    using ring_type = typename polygon_type_::ring_type;
+    using multi_point_type_ = basic_multi_point<Allocator>;
+    using multi_line_string_type_ = basic_multi_line_string<Allocator>;
+    using multi_polygon_type_ = basic_multi_polygon<Allocator>;
+    using collection_type = basic_geometry_collection<Allocator>;
+
+    static char upper(char c)
+    {
+        return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+    }
+
+    static bool is_alpha(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    void skip_ws()
+    {
+        while (itr_ != end_ && (*itr_ == ' ' || *itr_ == '\n' || *itr_ == '\r' || *itr_ == '\t')) ++itr_;
+    }
+
+    bool expect(char c)
+    {
+        skip_ws();
+        if (itr_ == end_ || *itr_ != c) return false;
+        ++itr_;
+        return true;
+    }
+
+    bool peek(char c)
+    {
+        skip_ws();
+        return itr_ != end_ && *itr_ == c;
+    }
+
+    // case insensitive match of [first, last) against an upper case keyword
+    static bool equals(char const* first, char const* last, char const* str)
+    {
+        for (; first != last; ++first, ++str)
+        {
+            if (*str == '\0' || upper(*first) != *str) return false;
+        }
+        return *str == '\0';
+    }
+
+    bool parse_word(char const*& first, char const*& last)
+    {
+        skip_ws();
+        first = itr_;
+        while (itr_ != end_ && is_alpha(*itr_)) ++itr_;
+        last = itr_;
+        return first != last;
+    }
+
+    // optional Z / M / ZM token then optional EMPTY, true when EMPTY
+    bool parse_empty()
+    {
+        skip_ws();
+        char const* start = itr_;
+        char const* first;
+        char const* last;
+        if (!parse_word(first, last)) return false;
+        if (equals(first, last, "Z") || equals(first, last, "M") || equals(first, last, "ZM"))
+        {
+            start = itr_;
+            if (!parse_word(first, last)) return false;
+        }
+        if (equals(first, last, "EMPTY")) return true;
+        itr_ = start;
+        return false;
+    }
+
+    static wkt_type to_type(char const* first, char const* last)
+    {
+        // "POINTZ", "POINTM", "POINTZM" ... EWKT style suffixes
+        if (last - first > 2 && upper(*(last - 2)) == 'Z' && upper(*(last - 1)) == 'M') last -= 2;
+        else if (last - first > 1 && (upper(*(last - 1)) == 'Z' || upper(*(last - 1)) == 'M')) --last;
+        if (equals(first, last, "POINT")) return point_type;
+        if (equals(first, last, "LINESTRING")) return line_string_type;
+        if (equals(first, last, "POLYGON")) return polygon_type;
+        if (equals(first, last, "MULTIPOINT")) return multi_point_type;
+        if (equals(first, last, "MULTILINESTRING")) return multi_line_string_type;
+        if (equals(first, last, "MULTIPOLYGON")) return multi_polygon_type;
+        if (equals(first, last, "GEOMETRYCOLLECTION")) return geometry_collection_type;
+        return unknown_type;
+    }
+
+    // number of comma separated items in the list starting at itr_
+    std::size_t count_items() const
+    {
+        std::size_t depth = 0;
+        std::size_t count = 1;
+        for (char const* p = itr_; p != end_; ++p)
+        {
+            if (*p == '(') ++depth;
+            else if (*p == ')')
+            {
+                if (--depth == 0) break;
+            }
+            else if (*p == ',' && depth == 1) ++count;
+        }
+        return count;
+    }
+
+    // x y (z (m)) extra ordinates are dropped
+    bool parse_coord(double & x, double & y)
+    {
+        skip_ws();
+        if (!detail::parse_number(itr_, end_, x)) return false;
+        skip_ws();
+        if (!detail::parse_number(itr_, end_, y)) return false;
+        for (;;)
+        {
+            skip_ws();
+            if (itr_ == end_ || *itr_ == ',' || *itr_ == ')') return true;
+            double value;
+            if (!detail::parse_number(itr_, end_, value)) return false;
+        }
+    }
+
+    // ( x y, x y ... ) or EMPTY
+    template <typename Points>
+    bool parse_points(Points & points)
+    {
+        if (parse_empty()) return true;
+        if (!peek('(')) return false;
+        points.reserve(count_items());
+        ++itr_;
+        do
+        {
+            double x, y;
+            if (!parse_coord(x, y)) return false;
+            points.emplace_back(x, y);
+        }
+        while (expect(','));
+        return expect(')');
+    }
+
+    // MULTIPOINT accepts both ( x y, ... ) and ( (x y), ... )
+    bool parse_multi_point(multi_point_type_ & multi_pt)
+    {
+        if (parse_empty()) return true;
+        if (!peek('(')) return false;
+        multi_pt.reserve(count_items());
+        ++itr_;
+        do
+        {
+            double x, y;
+            if (parse_empty()) continue;
+            if (peek('('))
+            {
+                ++itr_;
+                if (!parse_coord(x, y) || !expect(')')) return false;
+            }
+            else if (!parse_coord(x, y)) return false;
+            multi_pt.emplace_back(x, y);
+        }
+        while (expect(','));
+        return expect(')');
+    }
+
+    bool parse_line_string(line_string_type_ & line)
+    {
+        return parse_points(line.data);
+    }
+
+    bool parse_rings(polygon_type_ & poly)
+    {
+        if (parse_empty()) return true;
+        if (!expect('(')) return false;
+        bool exterior = true;
+        do
+        {
+            ring_type ring(alloc_);
+            if (!parse_points(ring)) return false;
+            if (exterior) poly.set_exterior_ring(std::move(ring));
+            else poly.add_hole(std::move(ring));
+            exterior = false;
+        }
+        while (expect(','));
+        return expect(')');
+    }
+
+    // ( item, item ... ) or EMPTY
+    template <typename Container, typename Item>
+    bool parse_list(Container & cont, bool (basic_wkt_parser::*parse_item)(Item &))
+    {
+        if (parse_empty()) return true;
+        if (!peek('(')) return false;
+        cont.reserve(count_items());
+        ++itr_;
+        do
+        {
+            cont.emplace_back(alloc_);
+            if (!(this->*parse_item)(cont.back())) return false;
+        }
+        while (expect(','));
+        return expect(')');
+    }
+
+    bool parse_tagged(geometry_type & geom, std::size_t depth)
+    {
+        char const* first;
+        char const* last;
+        if (depth == max_depth || !parse_word(first, last)) return false;
+        switch (to_type(first, last))
+        {
+        case point_type:
+        {
+            double x = std::numeric_limits<double>::quiet_NaN();
+            double y = x;
+            if (!parse_empty() && (!expect('(') || !parse_coord(x, y) || !expect(')'))) return false;
+            geom = point(x, y);
+            return true;
+        }
+        case line_string_type:
+        {
+            line_string_type_ line(alloc_);
+            if (!parse_points(line.data)) return false;
+            geom = std::move(line);
+            return true;
+        }
+        case polygon_type:
+        {
+            polygon_type_ poly(alloc_);
+            if (!parse_rings(poly)) return false;
+            geom = std::move(poly);
+            return true;
+        }
+        case multi_point_type:
+        {
+            multi_point_type_ multi_pt(alloc_);
+            if (!parse_multi_point(multi_pt)) return false;
+            geom = std::move(multi_pt);
+            return true;
+        }
+        case multi_line_string_type:
+        {
+            multi_line_string_type_ multi_line(alloc_);
+            if (!parse_list(multi_line, &basic_wkt_parser::parse_line_string)) return false;
+            geom = std::move(multi_line);
+            return true;
+        }
+        case multi_polygon_type:
+        {
+            multi_polygon_type_ multi_poly(alloc_);
+            if (!parse_list(multi_poly, &basic_wkt_parser::parse_rings)) return false;
+            geom = std::move(multi_poly);
+            return true;
+        }
+        case geometry_collection_type:
+        {
+            collection_type collection(alloc_);
+            if (!parse_empty())
+            {
+                if (!expect('(')) return false;
+                do
+                {
+                    collection.emplace_back();
+                    if (!parse_tagged(collection.back(), depth + 1)) return false;
+                }
+                while (expect(','));
+                if (!expect(')')) return false;
+            }
+            geom = std::move(collection);
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    Allocator alloc_;
+    char const* itr_;
+    char const* end_;
+};
+
+using wkt_parser = basic_wkt_parser<>;
+
+template <typename Allocator>
+inline bool from_wkt(std::string const& wkt, basic_geometry<Allocator> & geom,
+                     Allocator const& alloc = Allocator())
+{
+    basic_wkt_parser<Allocator> parser(alloc);
+    return parser.parse(wkt, geom);
+}
+
+}}
+
+#endif //MAPNIK_GEOMETRY_FROM_WKT_HPP
@@ -20,16 +20,27 @@
  *
  *****************************************************************************/
 
+#ifndef MAPNIK_GEOMETRY_IMPL_HPP
+#define MAPNIK_GEOMETRY_IMPL_HPP
+
 #include <vector>
 #include <mapnik/util/variant.hpp>
 #include <mapnik/vertex.hpp>
 #include <mapnik/util/noncopyable.hpp>
 
+#include <boost/align/aligned_allocator.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/range/iterator_range_core.hpp>
+
 #include <algorithm>
+#include <cmath>
 #include <vector>
 #include <tuple>
 #include <type_traits>
 #include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
 #include <utility>
 
 namespace mapnik { namespace new_geometry {
@@ -80,46 +91,113 @@ struct bounding_box
     point p1;
 };
 
-struct vertex_sequence
+// All containers below are templated on the allocator used for their
+// point buffers (other buffers use the same allocator rebound), the
+// familiar names are aliases using std::allocator<point>.
+template <typename Allocator, typename T>
+using rebind_alloc = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+
+template <typename Allocator = std::allocator<point> >
+struct basic_vertex_sequence
 {
-    typedef std::vector<point> cont_type;
+    using allocator_type = Allocator;
+    typedef std::vector<point, Allocator> cont_type;
     cont_type data;
+    basic_vertex_sequence() = default;
+    explicit basic_vertex_sequence(Allocator const& alloc)
+        : data(alloc) {}
     void reserve(std::size_t size)
     {
         data.reserve(size);
     }
 };
 
-struct line_string : vertex_sequence
+using vertex_sequence = basic_vertex_sequence<>;
+
+// structure-of-arrays storage : x and y ordinates are kept in separate
+// contiguous (32-byte aligned) arrays so kernels can run over them with SIMD.
+// Iteration yields `point` by value through a proxy iterator.
+struct soa_vertex_sequence
 {
-    using const_iterator_type = cont_type::const_iterator;
-    using iterator_type = cont_type::iterator;
-    using value_type = cont_type::value_type;
-    iterator_type begin() { return data.begin(); }
-    iterator_type end() { return data.end(); }
-    const_iterator_type begin() const { return data.begin(); }
-    const_iterator_type end() const { return data.end(); }
-    line_string() = default;
-    line_string (line_string && other) = default ;
-    line_string& operator=(line_string &&) = default;
-    line_string (line_string const& ) = default;
-    line_string& operator=(line_string const&) = default;
-    inline std::size_t num_points() const { return data.size(); }
-    inline void clear() { data.clear();}
-    inline void resize(std::size_t new_size) { data.resize(new_size);}
-    inline void push_back(value_type const& val) { data.push_back(val);}
+    using coord_type = std::vector<double, boost::alignment::aligned_allocator<double, 32> >;
+
+    struct const_iterator : boost::iterator_facade<const_iterator,
+                                                   point const,
+                                                   boost::random_access_traversal_tag,
+                                                   point>
+    {
+        const_iterator()
+            : x_(nullptr), y_(nullptr) {}
+        const_iterator(double const* x, double const* y)
+            : x_(x), y_(y) {}
+    private:
+        friend class boost::iterator_core_access;
+        point dereference() const { return point(*x_, *y_); }
+        bool equal(const_iterator const& other) const { return x_ == other.x_; }
+        void increment() { ++x_; ++y_; }
+        void decrement() { --x_; --y_; }
+        void advance(std::ptrdiff_t n) { x_ += n; y_ += n; }
+        std::ptrdiff_t distance_to(const_iterator const& other) const { return other.x_ - x_; }
+        double const* x_;
+        double const* y_;
+    };
+
+    coord_type x;
+    coord_type y;
+    void reserve(std::size_t size)
+    {
+        x.reserve(size);
+        y.reserve(size);
+    }
+    inline std::size_t size() const { return x.size(); }
+    inline point operator[](std::size_t index) const { return point(x[index], y[index]); }
+    const_iterator begin() const { return const_iterator(x.data(), y.data()); }
+    const_iterator end() const { return const_iterator(x.data() + x.size(), y.data() + y.size()); }
+};
+
+template <typename Allocator = std::allocator<point> >
+struct basic_line_string : basic_vertex_sequence<Allocator>
+{
+    using cont_type = typename basic_vertex_sequence<Allocator>::cont_type;
+    using const_iterator_type = typename cont_type::const_iterator;
+    using iterator_type = typename cont_type::iterator;
+    using value_type = typename cont_type::value_type;
+    iterator_type begin() { return this->data.begin(); }
+    iterator_type end() { return this->data.end(); }
+    const_iterator_type begin() const { return this->data.begin(); }
+    const_iterator_type end() const { return this->data.end(); }
+    basic_line_string() = default;
+    explicit basic_line_string(Allocator const& alloc)
+        : basic_vertex_sequence<Allocator>(alloc) {}
+    basic_line_string (basic_line_string && other) = default ;
+    basic_line_string& operator=(basic_line_string &&) = default;
+    basic_line_string (basic_line_string const& ) = default;
+    basic_line_string& operator=(basic_line_string const&) = default;
+    inline std::size_t num_points() const { return this->data.size(); }
+    inline void clear() { this->data.clear();}
+    inline void resize(std::size_t new_size) { this->data.resize(new_size);}
+    inline void push_back(value_type const& val) { this->data.push_back(val);}
     void add_coord(double x, double y)
     {
-        data.emplace_back(x,y);
+        this->data.emplace_back(x,y);
     }
 };
 
-struct polygon2
+using line_string = basic_line_string<>;
+
+template <typename Allocator = std::allocator<point> >
+struct basic_polygon2
 {
+    using allocator_type = Allocator;
+    using ring_type = typename basic_line_string<Allocator>::cont_type;
     //polygon2(polygon const&) = delete;
-    std::vector<line_string::cont_type> rings;
+    std::vector<ring_type, rebind_alloc<Allocator, ring_type> > rings;
+
+    basic_polygon2() = default;
+    explicit basic_polygon2(Allocator const& alloc)
+        : rings(alloc) {}
 
-    inline void add_ring(line_string && ring)
+    inline void add_ring(basic_line_string<Allocator> && ring)
     {
         rings.emplace_back(std::move(ring.data));
     }
@@ -130,19 +208,52 @@ struct polygon2
     }
 };
 
-using linear_ring = std::vector<point>;
+using polygon2 = basic_polygon2<>;
 
-struct polygon3
+struct line_string_soa : soa_vertex_sequence
 {
-    linear_ring exterior_ring;
-    std::vector<linear_ring> interior_rings;
+    using const_iterator_type = soa_vertex_sequence::const_iterator;
+    using value_type = point;
+    line_string_soa() = default;
+    line_string_soa (line_string_soa && other) = default ;
+    line_string_soa& operator=(line_string_soa &&) = default;
+    line_string_soa (line_string_soa const& ) = default;
+    line_string_soa& operator=(line_string_soa const&) = default;
+    inline std::size_t num_points() const { return x.size(); }
+    inline void clear() { x.clear(); y.clear(); }
+    inline void resize(std::size_t new_size) { x.resize(new_size); y.resize(new_size); }
+    inline void push_back(value_type const& val) { add_coord(val.x, val.y); }
+    void add_coord(double x_, double y_)
+    {
+        x.push_back(x_);
+        y.push_back(y_);
+    }
+};
+
+template <typename Allocator = std::allocator<point> >
+using basic_linear_ring = std::vector<point, Allocator>;
+
+using linear_ring = basic_linear_ring<>;
+
+template <typename Allocator = std::allocator<point> >
+struct basic_polygon3
+{
+    using allocator_type = Allocator;
+    using ring_type = basic_linear_ring<Allocator>;
+    ring_type exterior_ring;
+    std::vector<ring_type, rebind_alloc<Allocator, ring_type> > interior_rings;
+
+    basic_polygon3() = default;
+    explicit basic_polygon3(Allocator const& alloc)
+        : exterior_ring(alloc),
+          interior_rings(alloc) {}
 
-    inline void set_exterior_ring(linear_ring && ring)
+    inline void set_exterior_ring(ring_type && ring)
     {
         exterior_ring = std::move(ring);
     }
 
-    inline void add_hole(linear_ring && ring)
+    inline void add_hole(ring_type && ring)
     {
         interior_rings.emplace_back(std::move(ring));
     }
@@ -153,26 +264,347 @@ struct polygon3
     }
 };
 
-struct multi_point : std::vector<point> {};
-struct multi_line_string : std::vector<line_string> {};
-struct multi_polygon : std::vector<polygon3> {};
+using polygon3 = basic_polygon3<>;
 
-struct polygon : vertex_sequence
+template <typename Allocator = std::allocator<point> >
+struct basic_multi_point : std::vector<point, Allocator>
 {
-    typedef line_string::cont_type::const_iterator iterator_type;
-    std::vector<std::tuple<std::uint32_t, std::uint32_t> > rings;
+    using allocator_type = Allocator;
+    basic_multi_point() = default;
+    explicit basic_multi_point(Allocator const& alloc)
+        : std::vector<point, Allocator>(alloc) {}
+};
+
+template <typename Allocator = std::allocator<point> >
+struct basic_multi_line_string : std::vector<basic_line_string<Allocator>,
+                                             rebind_alloc<Allocator, basic_line_string<Allocator> > >
+{
+    using allocator_type = Allocator;
+    basic_multi_line_string() = default;
+    explicit basic_multi_line_string(Allocator const& alloc)
+        : std::vector<basic_line_string<Allocator>,
+                      rebind_alloc<Allocator, basic_line_string<Allocator> > >(alloc) {}
+};
+
+template <typename Allocator = std::allocator<point> >
+struct basic_multi_polygon : std::vector<basic_polygon3<Allocator>,
+                                         rebind_alloc<Allocator, basic_polygon3<Allocator> > >
+{
+    using allocator_type = Allocator;
+    basic_multi_polygon() = default;
+    explicit basic_multi_polygon(Allocator const& alloc)
+        : std::vector<basic_polygon3<Allocator>,
+                      rebind_alloc<Allocator, basic_polygon3<Allocator> > >(alloc) {}
+};
+
+using multi_point = basic_multi_point<>;
+using multi_line_string = basic_multi_line_string<>;
+using multi_polygon = basic_multi_polygon<>;
+
+template <typename Allocator = std::allocator<point> >
+struct basic_polygon : basic_vertex_sequence<Allocator>
+{
+    using cont_type = typename basic_vertex_sequence<Allocator>::cont_type;
+    typedef typename cont_type::const_iterator iterator_type;
+    using ring_index_type = std::tuple<std::uint32_t, std::uint32_t>;
+    std::vector<ring_index_type, rebind_alloc<Allocator, ring_index_type> > rings;
     // ring's element count. first ring exterior, subsequent rings are interior
     // rings[0] + ..+ rings[rings.size()-1] == data.size()
-    polygon() = default;
-    polygon (polygon && other) noexcept = default;
-    inline void add_ring(line_string && ring)
+    basic_polygon() = default;
+    explicit basic_polygon(Allocator const& alloc)
+        : basic_vertex_sequence<Allocator>(alloc),
+          rings(alloc) {}
+    basic_polygon (basic_polygon && other) noexcept = default;
+    basic_polygon& operator=(basic_polygon &&) = default;
+    inline void add_ring(basic_line_string<Allocator> && ring)
     {
         std::size_t count = ring.data.size();
         if (count != 0)
         {
-            std::size_t start = data.size();
-            data.resize(start + ring.data.size());
-            std::move_backward(ring.begin(),ring.end(), data.end());
+            std::size_t start = this->data.size();
+            this->data.resize(start + ring.data.size());
+            std::move_backward(ring.begin(),ring.end(), this->data.end());
+            rings.emplace_back(start,count);
+        }
+    }
+
+    inline std::size_t num_rings() const
+    {
+        return rings.size();
+    }
+
+    inline std::pair<iterator_type,iterator_type> ring(std::size_t index) const
+    {
+        if (index < num_rings())
+        {
+            ring_index_type const& ring = rings[index];
+            return std::make_pair(this->data.begin() + std::get<0>(ring), this->data.begin() + std::get<0>(ring) + std::get<1>(ring));
+        }
+        else
+        {
+            return std::make_pair(this->data.end(),this->data.end());
+        }
+    }
+};
+
+using polygon = basic_polygon<>;
+
+// Read-only view of one part of a flat_multi_polygon (first ring exterior,
+// then holes), rings are point ranges into the shared vertex buffer.
+struct flat_polygon_view
+{
+    using ring_type = boost::iterator_range<point const*>;
+    using rings_type = boost::iterator_range<ring_type const*>;
+
+    flat_polygon_view(ring_type const* first, ring_type const* last)
+        : first_(first), last_(last) {}
+
+    // an empty ring for a part without rings
+    ring_type const& exterior_ring() const
+    {
+        static const ring_type empty_ring;
+        return first_ != last_ ? *first_ : empty_ring;
+    }
+
+    rings_type interior_rings() const
+    {
+        return first_ != last_ ? rings_type(first_ + 1, last_) : rings_type(last_, last_);
+    }
+
+    inline std::size_t num_rings() const
+    {
+        return static_cast<std::size_t>(last_ - first_);
+    }
+private:
+    ring_type const* first_;
+    ring_type const* last_;
+};
+
+// Multi-polygon in three flat buffers : every vertex of every part in `data`,
+// rings as (start, count) into `data`, parts as (first ring, num rings) into
+// `rings`. Building is append-only (add_polygon or begin_part + add_ring).
+//
+// Boost.Geometry keeps references to rings and polygons, so iterating parts
+// (begin()/end()) goes through a table of flat_polygon_view. The table is
+// kept up to date by the mutators, const access never writes and is safe
+// from several threads. Code writing `data`, `rings` or `parts` directly
+// must call update_views() afterwards.
+template <typename Allocator = std::allocator<point> >
+struct basic_flat_multi_polygon
+{
+    using allocator_type = Allocator;
+    using index_type = std::tuple<std::uint32_t, std::uint32_t>;
+    using cont_type = std::vector<point, Allocator>;
+    using const_iterator_type = flat_polygon_view const*;
+    cont_type data;
+    std::vector<index_type, rebind_alloc<Allocator, index_type> > rings;
+    std::vector<index_type, rebind_alloc<Allocator, index_type> > parts;
+
+    basic_flat_multi_polygon() = default;
+    explicit basic_flat_multi_polygon(Allocator const& alloc)
+        : data(alloc),
+          rings(alloc),
+          parts(alloc),
+          ring_views_(alloc),
+          part_views_(alloc) {}
+
+    // views point into the buffers, they are rebuilt for the new owner
+    basic_flat_multi_polygon(basic_flat_multi_polygon const& other)
+        : data(other.data),
+          rings(other.rings),
+          parts(other.parts),
+          ring_views_(other.ring_views_.get_allocator()),
+          part_views_(other.part_views_.get_allocator())
+    {
+        update_views();
+    }
+
+    // vector move construction keeps the buffers, views stay valid
+    basic_flat_multi_polygon(basic_flat_multi_polygon && other) noexcept = default;
+
+    basic_flat_multi_polygon & operator=(basic_flat_multi_polygon const& other)
+    {
+        if (this == &other) return *this;
+        data = other.data;
+        rings = other.rings;
+        parts = other.parts;
+        update_views();
+        return *this;
+    }
+
+    basic_flat_multi_polygon & operator=(basic_flat_multi_polygon && other)
+    {
+        if (this == &other) return *this;
+        point const* other_data = other.data.data();
+        ring_type const* other_views = other.ring_views_.data();
+        data = std::move(other.data);
+        rings = std::move(other.rings);
+        parts = std::move(other.parts);
+        ring_views_ = std::move(other.ring_views_);
+        part_views_ = std::move(other.part_views_);
+        // unequal allocators move element-wise, the views must follow
+        if (data.data() != other_data || ring_views_.data() != other_views) update_views();
+        other.clear();
+        return *this;
+    }
+
+    void reserve(std::size_t num_points, std::size_t num_rings, std::size_t num_parts)
+    {
+        data.reserve(num_points);
+        rings.reserve(num_rings);
+        parts.reserve(num_parts);
+        ring_views_.reserve(num_rings);
+        part_views_.reserve(num_parts);
+        update_views();
+    }
+
+    // starts a part without rings, add_ring() fills it
+    inline void begin_part()
+    {
+        parts.emplace_back(rings.size(), 0);
+        ring_type const* last = ring_views_.data() + ring_views_.size();
+        part_views_.emplace_back(last, last);
+    }
+
+    // append ring to the current part (first ring is the exterior),
+    // empty rings are dropped
+    template <typename Iterator>
+    void add_ring(Iterator first, Iterator last)
+    {
+        if (parts.empty()) throw std::logic_error("flat_multi_polygon::add_ring before begin_part");
+        std::size_t start = data.size();
+        point const* old_data = data.data();
+        data.insert(data.end(), first, last);
+        std::size_t count = data.size() - start;
+        if (count == 0) return;
+        rings.emplace_back(start, count);
+        ++std::get<1>(parts.back());
+        if (data.data() != old_data) rebase_ring_views();
+        ring_type const* old_views = ring_views_.data();
+        ring_views_.emplace_back(data.data() + start, data.data() + start + count);
+        if (ring_views_.data() != old_views) rebase_part_views();
+        else set_part_view(part_views_.size() - 1);
+    }
+
+    template <typename PolygonAllocator>
+    void add_polygon(basic_polygon3<PolygonAllocator> const& poly)
+    {
+        if (poly.exterior_ring.empty()) return;
+        begin_part();
+        add_ring(poly.exterior_ring.begin(), poly.exterior_ring.end());
+        for (auto const& hole : poly.interior_rings)
+        {
+            add_ring(hole.begin(), hole.end());
+        }
+    }
+
+    inline void clear()
+    {
+        data.clear();
+        rings.clear();
+        parts.clear();
+        ring_views_.clear();
+        part_views_.clear();
+    }
+
+    inline std::size_t num_parts() const { return parts.size(); }
+    inline std::size_t num_rings() const { return rings.size(); }
+    inline std::size_t num_points() const { return data.size(); }
+
+    inline std::pair<point const*, point const*> ring(std::size_t index) const
+    {
+        index_type const& r = rings[index];
+        point const* first = data.data() + std::get<0>(r);
+        return std::make_pair(first, first + std::get<1>(r));
+    }
+
+    inline flat_polygon_view const& part(std::size_t index) const
+    {
+        return part_views_[index];
+    }
+
+    const_iterator_type begin() const
+    {
+        return part_views_.data();
+    }
+
+    const_iterator_type end() const
+    {
+        return part_views_.data() + part_views_.size();
+    }
+
+    // rebuild the views after writing the buffers directly
+    void update_views()
+    {
+        ring_views_.clear();
+        ring_views_.reserve(rings.size());
+        for (auto const& r : rings)
+        {
+            point const* first = data.data() + std::get<0>(r);
+            ring_views_.emplace_back(first, first + std::get<1>(r));
+        }
+        rebase_part_views();
+    }
+
+private:
+    using ring_type = flat_polygon_view::ring_type;
+    using ring_views_type = std::vector<ring_type, rebind_alloc<Allocator, ring_type> >;
+    using part_views_type = std::vector<flat_polygon_view, rebind_alloc<Allocator, flat_polygon_view> >;
+
+    // `data` moved, ring views follow
+    void rebase_ring_views()
+    {
+        for (std::size_t i = 0; i < ring_views_.size(); ++i)
+        {
+            point const* first = data.data() + std::get<0>(rings[i]);
+            ring_views_[i] = ring_type(first, first + std::get<1>(rings[i]));
+        }
+    }
+
+    void rebase_part_views()
+    {
+        part_views_.clear();
+        part_views_.reserve(parts.size());
+        for (std::size_t i = 0; i < parts.size(); ++i)
+        {
+            ring_type const* first = ring_views_.data() + std::get<0>(parts[i]);
+            part_views_.emplace_back(first, first + std::get<1>(parts[i]));
+        }
+    }
+
+    void set_part_view(std::size_t index)
+    {
+        ring_type const* first = ring_views_.data() + std::get<0>(parts[index]);
+        part_views_[index] = flat_polygon_view(first, first + std::get<1>(parts[index]));
+    }
+
+public:
+    // view tables (memory accounting)
+    ring_views_type const& ring_views() const { return ring_views_; }
+    part_views_type const& part_views() const { return part_views_; }
+private:
+    ring_views_type ring_views_;
+    part_views_type part_views_;
+};
+
+using flat_multi_polygon = basic_flat_multi_polygon<>;
+
+// SoA counterpart of `polygon` : same ring offsets table, separate x/y buffers
+struct polygon_soa : soa_vertex_sequence
+{
+    typedef soa_vertex_sequence::const_iterator iterator_type;
+    std::vector<std::tuple<std::uint32_t, std::uint32_t> > rings;
+    polygon_soa() = default;
+    polygon_soa (polygon_soa && other) noexcept = default;
+    polygon_soa& operator=(polygon_soa &&) = default;
+    inline void add_ring(line_string_soa && ring)
+    {
+        std::size_t count = ring.size();
+        if (count != 0)
+        {
+            std::size_t start = x.size();
+            x.insert(x.end(), ring.x.begin(), ring.x.end());
+            y.insert(y.end(), ring.y.begin(), ring.y.end());
             rings.emplace_back(start,count);
         }
     }
@@ -187,242 +619,1065 @@ struct polygon : vertex_sequence
         if (index < num_rings())
         {
             std::tuple<std::uint32_t,std::uint32_t> const& ring = rings[index];
-            return std::make_pair(data.begin() + std::get<0>(ring), data.begin() + std::get<0>(ring) + std::get<1>(ring));
+            return std::make_pair(begin() + std::get<0>(ring), begin() + std::get<0>(ring) + std::get<1>(ring));
         }
         else
         {
-            return std::make_pair(data.end(),data.end());
+            return std::make_pair(end(),end());
         }
     }
 };
 
-typedef mapnik::util::variant< point,line_string, polygon, polygon2, polygon3> geometry;
+template <typename Allocator = std::allocator<point> >
+struct basic_geometry_collection;
+
+template <typename Allocator = std::allocator<point> >
+using basic_geometry = mapnik::util::variant<point,
+                                             basic_line_string<Allocator>,
+                                             basic_polygon<Allocator>,
+                                             basic_polygon2<Allocator>,
+                                             basic_polygon3<Allocator>,
+                                             line_string_soa,
+                                             polygon_soa,
+                                             basic_multi_point<Allocator>,
+                                             basic_multi_line_string<Allocator>,
+                                             basic_multi_polygon<Allocator>,
+                                             basic_geometry_collection<Allocator> >;
+
+template <typename Allocator>
+struct basic_geometry_collection : std::vector<basic_geometry<Allocator>,
+                                               rebind_alloc<Allocator, basic_geometry<Allocator> > >
+{
+    using allocator_type = Allocator;
+    basic_geometry_collection() = default;
+    explicit basic_geometry_collection(Allocator const& alloc)
+        : std::vector<basic_geometry<Allocator>,
+                      rebind_alloc<Allocator, basic_geometry<Allocator> > >(alloc) {}
+};
+
+typedef basic_geometry<> geometry;
+using geometry_collection = basic_geometry_collection<>;
+
+// Contiguous run of coordinates handed out by the adapters' next_span() :
+// first point is a SEG_MOVETO, the following ones SEG_LINETO. Rings of more
+// than one point end with SEG_CLOSE, see `close`. next_span() and vertex()
+// share the adapter position, don't interleave them without a rewind().
+struct vertex_span
+{
+    enum close_type : std::uint8_t
+    {
+        no_close,    // line
+        close_last,  // last point is reported as SEG_CLOSE
+        close_after  // SEG_CLOSE at the first point follows the last one
+    };
+
+    point const* first;
+    point const* last;
+    close_type close;
+
+    std::size_t size() const
+    {
+        return static_cast<std::size_t>(last - first);
+    }
+};
+
+// Vertex iterators : forward iterators yielding the command stream of a
+// geometry as mapnik::vertex2d {x, y, cmd} values. All traversal state is
+// in the iterator, ranges from vertices(geom) only refer to the geometry,
+// so any number of threads can walk the same geometry. The vertex adapters
+// below are vertex()/rewind() shims over these iterators. Their fused
+// next_vertex() step is the faster walk, a range-for goes through
+// dereference/increment/equal and costs 10-40% more per vertex
+// (geometry_benchmark --ops=iterate,iterate_adapter).
+template <typename Derived>
+using vertex_iterator_facade = boost::iterator_facade<Derived, vertex2d const, boost::forward_traversal_tag, vertex2d>;
+
+template <typename Iterator>
+using vertex_range = boost::iterator_range<Iterator>;
+
+namespace detail {
+
+template <typename Iterator>
+inline unsigned next_vertex(Iterator & itr, Iterator const& end, double*x, double*y)
+{
+    if (itr == end) return mapnik::SEG_END;
+    vertex2d v = *itr;
+    ++itr;
+    *x = v.x;
+    *y = v.y;
+    return v.cmd;
+}
+
+}
+
+// POINT EMPTY (NaN coordinates, see geometry_from_wkt.hpp) yields no vertex,
+// like the WKB view does
+struct point_vertex_iterator : vertex_iterator_facade<point_vertex_iterator>
+{
+    point_vertex_iterator()
+        : pt_(nullptr) {}
+    explicit point_vertex_iterator(point const* pt)
+        : pt_(std::isnan(pt->x) ? nullptr : pt) {}
+private:
+    friend class boost::iterator_core_access;
+    vertex2d dereference() const { return vertex2d(pt_->x, pt_->y, mapnik::SEG_MOVETO); }
+    bool equal(point_vertex_iterator const& other) const { return pt_ == other.pt_; }
+    void increment() { pt_ = nullptr; }
+    point const* pt_;
+};
+
+// contiguous points, one path
+struct line_string_vertex_iterator : vertex_iterator_facade<line_string_vertex_iterator>
+{
+    line_string_vertex_iterator()
+        : first_(nullptr), pos_(nullptr) {}
+    line_string_vertex_iterator(point const* first, point const* pos)
+        : first_(first), pos_(pos) {}
+    point const* first_;
+    point const* pos_;
+private:
+    friend class boost::iterator_core_access;
+    vertex2d dereference() const
+    {
+        return vertex2d(pos_->x, pos_->y, (pos_ == first_) ? mapnik::SEG_MOVETO : mapnik::SEG_LINETO);
+    }
+    bool equal(line_string_vertex_iterator const& other) const { return pos_ == other.pos_; }
+    void increment() { ++pos_; }
+};
+
+// one path per point, empty (NaN) points are skipped
+struct multi_point_vertex_iterator : vertex_iterator_facade<multi_point_vertex_iterator>
+{
+    multi_point_vertex_iterator()
+        : pos_(nullptr), last_(nullptr) {}
+    multi_point_vertex_iterator(point const* pos, point const* last)
+        : pos_(pos), last_(last)
+    {
+        skip_empty();
+    }
+private:
+    friend class boost::iterator_core_access;
+    void skip_empty()
+    {
+        while (pos_ != last_ && std::isnan(pos_->x)) ++pos_;
+    }
+    vertex2d dereference() const { return vertex2d(pos_->x, pos_->y, mapnik::SEG_MOVETO); }
+    bool equal(multi_point_vertex_iterator const& other) const { return pos_ == other.pos_; }
+    void increment()
+    {
+        ++pos_;
+        skip_empty();
+    }
+    point const* pos_;
+    point const* last_;
+};
+
+struct line_string_soa_vertex_iterator : vertex_iterator_facade<line_string_soa_vertex_iterator>
+{
+    line_string_soa_vertex_iterator()
+        : x_(nullptr), y_(nullptr), index_(0) {}
+    line_string_soa_vertex_iterator(double const* x, double const* y, std::size_t index)
+        : x_(x), y_(y), index_(index) {}
+private:
+    friend class boost::iterator_core_access;
+    vertex2d dereference() const
+    {
+        return vertex2d(x_[index_], y_[index_], (index_ == 0) ? mapnik::SEG_MOVETO : mapnik::SEG_LINETO);
+    }
+    bool equal(line_string_soa_vertex_iterator const& other) const { return index_ == other.index_; }
+    void increment() { ++index_; }
+    double const* x_;
+    double const* y_;
+    std::size_t index_;
+};
+
+// empty lines are skipped, at the end line_ == last_line_ and index_ == 0
+template <typename Allocator>
+struct basic_multi_line_string_vertex_iterator : vertex_iterator_facade<basic_multi_line_string_vertex_iterator<Allocator> >
+{
+    using line_type = basic_line_string<Allocator>;
+    basic_multi_line_string_vertex_iterator()
+        : line_(nullptr), last_line_(nullptr), index_(0) {}
+    basic_multi_line_string_vertex_iterator(line_type const* line, line_type const* last_line)
+        : line_(line), last_line_(last_line), index_(0)
+    {
+        skip_empty();
+    }
+    void next_line()
+    {
+        ++line_;
+        index_ = 0;
+        skip_empty();
+    }
+    line_type const* line_;
+    line_type const* last_line_;
+    std::size_t index_;
+private:
+    friend class boost::iterator_core_access;
+    void skip_empty()
+    {
+        while (line_ != last_line_ && line_->data.empty()) ++line_;
+    }
+    vertex2d dereference() const
+    {
+        point const& pt = line_->data[index_];
+        return vertex2d(pt.x, pt.y, (index_ == 0) ? mapnik::SEG_MOVETO : mapnik::SEG_LINETO);
+    }
+    bool equal(basic_multi_line_string_vertex_iterator const& other) const
+    {
+        return line_ == other.line_ && index_ == other.index_;
+    }
+    void increment()
+    {
+        if (++index_ == line_->data.size()) next_line();
+    }
+};
+
+inline vertex_range<point_vertex_iterator> vertices(point const& pt)
+{
+    return vertex_range<point_vertex_iterator>(point_vertex_iterator(&pt), point_vertex_iterator());
+}
+
+template <typename Allocator>
+inline vertex_range<line_string_vertex_iterator> vertices(basic_line_string<Allocator> const& line)
+{
+    point const* first = line.data.data();
+    return vertex_range<line_string_vertex_iterator>(line_string_vertex_iterator(first, first),
+                                                     line_string_vertex_iterator(first, first + line.data.size()));
+}
+
+template <typename Allocator>
+inline vertex_range<multi_point_vertex_iterator> vertices(basic_multi_point<Allocator> const& multi_pt)
+{
+    point const* first = multi_pt.data();
+    point const* last = first + multi_pt.size();
+    return vertex_range<multi_point_vertex_iterator>(multi_point_vertex_iterator(first, last),
+                                                     multi_point_vertex_iterator(last, last));
+}
+
+inline vertex_range<line_string_soa_vertex_iterator> vertices(line_string_soa const& line)
+{
+    return vertex_range<line_string_soa_vertex_iterator>(line_string_soa_vertex_iterator(line.x.data(), line.y.data(), 0),
+                                                         line_string_soa_vertex_iterator(line.x.data(), line.y.data(), line.size()));
+}
+
+template <typename Allocator>
+inline vertex_range<basic_multi_line_string_vertex_iterator<Allocator> > vertices(basic_multi_line_string<Allocator> const& multi_line)
+{
+    using iterator = basic_multi_line_string_vertex_iterator<Allocator>;
+    auto first = multi_line.data();
+    auto last = first + multi_line.size();
+    return vertex_range<iterator>(iterator(first, last), iterator(last, last));
+}
 
 struct point_vertex_adapter
 {
     point_vertex_adapter(point const& pt)
         : pt_(pt),
-          first_(true) {}
+          itr_(&pt) {}
 
     unsigned vertex(double*x, double*y) const
     {
-        if (first_)
-        {
-            *x = pt_.x;
-            *y = pt_.y;
-            first_ = false;
-            return mapnik::SEG_MOVETO;
-        }
-        return mapnik::SEG_END;
+        return detail::next_vertex(itr_, point_vertex_iterator(), x, y);
     }
 
     void rewind(unsigned) const
     {
-        first_ = true;
+        itr_ = point_vertex_iterator(&pt_);
     }
     point const& pt_;
-    mutable bool first_;
+    mutable point_vertex_iterator itr_;
 };
 
-struct line_string_vertex_adapter
+template <typename Allocator>
+struct basic_line_string_vertex_adapter
 {
-    line_string_vertex_adapter(line_string const& line)
-        : line_(line),
-          current_index_(0),
-          end_index_(line.data.size())
-    {}
+    basic_line_string_vertex_adapter(basic_line_string<Allocator> const& line)
+        : range_(vertices(line)),
+          itr_(range_.begin()) {}
 
     unsigned vertex(double*x, double*y) const
     {
-        if (current_index_ != end_index_)
-        {
-            point const& coord = line_.data[current_index_++];
-            *x = coord.x;
-            *y = coord.y;
-            if (current_index_ == 1)
-            {
-                return mapnik::SEG_MOVETO;
-            }
-            else
-            {
-                return mapnik::SEG_LINETO;
-            }
-        }
-        return mapnik::SEG_END;
+        return detail::next_vertex(itr_, range_.end(), x, y);
+    }
+
+    bool next_span(vertex_span & span) const
+    {
+        if (itr_ == range_.end()) return false;
+        span.first = itr_.pos_;
+        span.last = range_.end().pos_;
+        span.close = vertex_span::no_close;
+        itr_ = range_.end();
+        return true;
     }
 
     void rewind(unsigned) const
     {
-        current_index_ = 0;
+        itr_ = range_.begin();
+    }
+    vertex_range<line_string_vertex_iterator> const range_;
+    mutable line_string_vertex_iterator itr_;
+};
+
+using line_string_vertex_adapter = basic_line_string_vertex_adapter<std::allocator<point> >;
+
+// every point starts a new path (SEG_MOVETO)
+template <typename Allocator>
+struct basic_multi_point_vertex_adapter
+{
+    basic_multi_point_vertex_adapter(basic_multi_point<Allocator> const& multi_pt)
+        : range_(vertices(multi_pt)),
+          itr_(range_.begin()) {}
+
+    unsigned vertex(double*x, double*y) const
+    {
+        return detail::next_vertex(itr_, range_.end(), x, y);
     }
-    line_string const& line_;
-    mutable std::size_t current_index_;
-    const std::size_t end_index_;
 
+    void rewind(unsigned) const
+    {
+        itr_ = range_.begin();
+    }
+    vertex_range<multi_point_vertex_iterator> const range_;
+    mutable multi_point_vertex_iterator itr_;
 };
 
-struct polygon_vertex_adapter
+using multi_point_vertex_adapter = basic_multi_point_vertex_adapter<std::allocator<point> >;
+
+template <typename Allocator>
+struct basic_multi_line_string_vertex_adapter
 {
-    polygon_vertex_adapter(polygon const& poly)
-        : poly_(poly),
-          rings_itr_(poly_.rings.begin()),
-          rings_end_(poly_.rings.end()),
-          current_index_(0),
-          end_index_(0),
-          start_loop_(false) {}
+    basic_multi_line_string_vertex_adapter(basic_multi_line_string<Allocator> const& multi_line)
+        : range_(vertices(multi_line)),
+          itr_(range_.begin()) {}
+
+    unsigned vertex(double*x, double*y) const
+    {
+        return detail::next_vertex(itr_, range_.end(), x, y);
+    }
+
+    bool next_span(vertex_span & span) const
+    {
+        if (itr_ == range_.end()) return false;
+        point const* data = itr_.line_->data.data();
+        span.first = data + itr_.index_;
+        span.last = data + itr_.line_->data.size();
+        span.close = vertex_span::no_close;
+        itr_.next_line();
+        return true;
+    }
 
     void rewind(unsigned) const
     {
-        rings_itr_ = poly_.rings.begin();
-        current_index_ = 0;
-        end_index_ = 0;
-        start_loop_ = false;
+        itr_ = range_.begin();
     }
+    vertex_range<basic_multi_line_string_vertex_iterator<Allocator> > const range_;
+    mutable basic_multi_line_string_vertex_iterator<Allocator> itr_;
+};
+
+using multi_line_string_vertex_adapter = basic_multi_line_string_vertex_adapter<std::allocator<point> >;
+
+struct line_string_soa_vertex_adapter
+{
+    line_string_soa_vertex_adapter(line_string_soa const& line)
+        : range_(vertices(line)),
+          itr_(range_.begin()) {}
 
     unsigned vertex(double*x, double*y) const
     {
-        if (current_index_ == end_index_)
+        return detail::next_vertex(itr_, range_.end(), x, y);
+    }
+
+    void rewind(unsigned) const
+    {
+        itr_ = range_.begin();
+    }
+    vertex_range<line_string_soa_vertex_iterator> const range_;
+    mutable line_string_soa_vertex_iterator itr_;
+};
+
+// Ring closure policies for ring_vertex_adapter. Either way every ring of
+// more than one point is reported as SEG_MOVETO, SEG_LINETO ..., SEG_CLOSE.
+//
+// closed_ring : the last stored point repeats the first one (OGC and
+// Boost.Geometry default), it is reported as the SEG_CLOSE vertex.
+struct closed_ring
+{
+    static const vertex_span::close_type span_close = vertex_span::close_last;
+    static std::size_t num_vertices(std::size_t size) { return size; }
+    static std::size_t close_index(std::size_t size) { return size - 1; }
+};
+
+// open_ring : the closing point is not stored (one point less per ring),
+// SEG_CLOSE is generated at the first point after the last stored one.
+struct open_ring
+{
+    static const vertex_span::close_type span_close = vertex_span::close_after;
+    static std::size_t num_vertices(std::size_t size) { return (size > 1) ? size + 1 : size; }
+    static std::size_t close_index(std::size_t) { return 0; }
+};
+
+// ring views produced by the ring sources below
+struct aos_ring
+{
+    point const* first;
+    point const* last;
+    std::size_t size() const { return static_cast<std::size_t>(last - first); }
+    void get(std::size_t index, double*x, double*y) const
+    {
+        *x = first[index].x;
+        *y = first[index].y;
+    }
+};
+
+struct soa_ring
+{
+    double const* x_;
+    double const* y_;
+    std::size_t size_;
+    std::size_t size() const { return size_; }
+    void get(std::size_t index, double*x, double*y) const
+    {
+        *x = x_[index];
+        *y = y_[index];
+    }
+};
+
+// Rings of `polygon` and `flat_multi_polygon` : offset/size table over `data`
+template <typename Geometry>
+struct table_ring_source
+{
+    using geometry_type = Geometry;
+    using ring_type = aos_ring;
+    table_ring_source()
+        : geom_(nullptr), index_(0) {}
+    explicit table_ring_source(geometry_type const& geom)
+        : geom_(&geom), index_(0) {}
+    void rewind() { index_ = 0; }
+    bool next(ring_type & ring)
+    {
+        if (index_ == geom_->rings.size()) return false;
+        auto const& r = geom_->rings[index_++];
+        ring.first = geom_->data.data() + std::get<0>(r);
+        ring.last = ring.first + std::get<1>(r);
+        return true;
+    }
+    geometry_type const* geom_;
+    std::size_t index_;
+};
+
+struct polygon_soa_ring_source
+{
+    using geometry_type = polygon_soa;
+    using ring_type = soa_ring;
+    polygon_soa_ring_source()
+        : poly_(nullptr), index_(0) {}
+    explicit polygon_soa_ring_source(geometry_type const& poly)
+        : poly_(&poly), index_(0) {}
+    void rewind() { index_ = 0; }
+    bool next(ring_type & ring)
+    {
+        if (index_ == poly_->rings.size()) return false;
+        auto const& r = poly_->rings[index_++];
+        ring.x_ = poly_->x.data() + std::get<0>(r);
+        ring.y_ = poly_->y.data() + std::get<0>(r);
+        ring.size_ = std::get<1>(r);
+        return true;
+    }
+    geometry_type const* poly_;
+    std::size_t index_;
+};
+
+template <typename Allocator>
+struct polygon2_ring_source
+{
+    using geometry_type = basic_polygon2<Allocator>;
+    using ring_type = aos_ring;
+    polygon2_ring_source()
+        : poly_(nullptr), index_(0) {}
+    explicit polygon2_ring_source(geometry_type const& poly)
+        : poly_(&poly), index_(0) {}
+    void rewind() { index_ = 0; }
+    bool next(ring_type & ring)
+    {
+        if (index_ == poly_->rings.size()) return false;
+        auto const& r = poly_->rings[index_++];
+        ring.first = r.data();
+        ring.last = r.data() + r.size();
+        return true;
+    }
+    geometry_type const* poly_;
+    std::size_t index_;
+};
+
+template <typename Allocator>
+struct polygon3_ring_source
+{
+    using geometry_type = basic_polygon3<Allocator>;
+    using ring_type = aos_ring;
+    polygon3_ring_source()
+        : poly_(nullptr), index_(0) {}
+    explicit polygon3_ring_source(geometry_type const& poly)
+        : poly_(&poly), index_(0) {}
+    void rewind() { index_ = 0; }
+    bool next(ring_type & ring)
+    {
+        if (index_ > poly_->interior_rings.size()) return false;
+        auto const& r = (index_ == 0) ? poly_->exterior_ring : poly_->interior_rings[index_ - 1];
+        ++index_;
+        ring.first = r.data();
+        ring.last = r.data() + r.size();
+        return true;
+    }
+    geometry_type const* poly_;
+    std::size_t index_;
+};
+
+// every ring of every part in turn
+template <typename Allocator>
+struct multi_polygon_ring_source
+{
+    using geometry_type = basic_multi_polygon<Allocator>;
+    using ring_type = aos_ring;
+    multi_polygon_ring_source()
+        : multi_poly_(nullptr), part_index_(0), ring_index_(0) {}
+    explicit multi_polygon_ring_source(geometry_type const& multi_poly)
+        : multi_poly_(&multi_poly), part_index_(0), ring_index_(0) {}
+    void rewind()
+    {
+        part_index_ = 0;
+        ring_index_ = 0;
+    }
+    bool next(ring_type & ring)
+    {
+        for (; part_index_ < multi_poly_->size(); ++part_index_, ring_index_ = 0)
+        {
+            basic_polygon3<Allocator> const& poly = (*multi_poly_)[part_index_];
+            if (ring_index_ <= poly.interior_rings.size())
+            {
+                auto const& r = (ring_index_ == 0) ? poly.exterior_ring : poly.interior_rings[ring_index_ - 1];
+                ++ring_index_;
+                ring.first = r.data();
+                ring.last = r.data() + r.size();
+                return true;
+            }
+        }
+        return false;
+    }
+    geometry_type const* multi_poly_;
+    std::size_t part_index_;
+    std::size_t ring_index_;
+};
+
+// Single vertex iterator for every polygon layout : RingSource walks the
+// rings of the geometry, Closure (closed_ring or open_ring) decides where
+// SEG_CLOSE comes from. Empty rings are skipped, the end iterator has no
+// ring (num_vertices_ == 0).
+template <typename RingSource, typename Closure = closed_ring>
+struct ring_vertex_iterator : vertex_iterator_facade<ring_vertex_iterator<RingSource, Closure> >
+{
+    using geometry_type = typename RingSource::geometry_type;
+    using ring_type = typename RingSource::ring_type;
+
+    ring_vertex_iterator()
+        : source_(),
+          ring_(),
+          ring_number_(0),
+          index_(0),
+          num_vertices_(0) {}
+
+    explicit ring_vertex_iterator(geometry_type const& geom)
+        : source_(geom),
+          ring_(),
+          ring_number_(0),
+          index_(0),
+          num_vertices_(0)
+    {
+        next_ring();
+    }
+
+    // skips the rest of the current ring
+    void next_ring()
+    {
+        index_ = 0;
+        do
         {
-            if (rings_itr_ == rings_end_)
-                return mapnik::SEG_END;
-            current_index_ = std::get<0>(*rings_itr_);
-            end_index_ = current_index_ + std::get<1>(*rings_itr_);
-            ++rings_itr_;
-            start_loop_ = true;
+            if (!source_.next(ring_))
+            {
+                ring_number_ = 0;
+                num_vertices_ = 0;
+                return;
+            }
+            ++ring_number_;
+            num_vertices_ = Closure::num_vertices(ring_.size());
         }
-        point const& coord = poly_.data[current_index_++];
-        *x = coord.x;
-        *y = coord.y;
+        while (num_vertices_ == 0);
+    }
 
-        if (start_loop_)
+    // *itr then ++itr in one go for the vertex() shim, SEG_END at the end
+    unsigned next_vertex(double*x, double*y)
+    {
+        if (num_vertices_ == 0) return mapnik::SEG_END;
+        std::size_t index = index_++;
+        if (index == 0)
         {
-            start_loop_= false;
+            ring_.get(0, x, y);
+            if (index_ == num_vertices_) next_ring();
             return mapnik::SEG_MOVETO;
         }
-        if (current_index_ == end_index_)
+        if (index_ == num_vertices_)
+        {
+            ring_.get(Closure::close_index(ring_.size()), x, y);
+            next_ring();
             return mapnik::SEG_CLOSE;
+        }
+        ring_.get(index, x, y);
         return mapnik::SEG_LINETO;
     }
+
+    RingSource source_;
+    ring_type ring_;
+    std::size_t ring_number_;
+    std::size_t index_;
+    std::size_t num_vertices_;
 private:
-    polygon const& poly_;
-    mutable std::vector<std::tuple<uint32_t,uint32_t> >::const_iterator rings_itr_;
-    mutable std::vector<std::tuple<uint32_t,uint32_t> >::const_iterator rings_end_;
-    mutable std::size_t current_index_;
-    mutable std::size_t end_index_;
-    mutable bool start_loop_;
+    friend class boost::iterator_core_access;
+    vertex2d dereference() const
+    {
+        vertex2d v;
+        if (index_ == 0)
+        {
+            ring_.get(0, &v.x, &v.y);
+            v.cmd = mapnik::SEG_MOVETO;
+        }
+        else if (index_ + 1 == num_vertices_)
+        {
+            ring_.get(Closure::close_index(ring_.size()), &v.x, &v.y);
+            v.cmd = mapnik::SEG_CLOSE;
+        }
+        else
+        {
+            ring_.get(index_, &v.x, &v.y);
+            v.cmd = mapnik::SEG_LINETO;
+        }
+        return v;
+    }
+    bool equal(ring_vertex_iterator const& other) const
+    {
+        return ring_number_ == other.ring_number_ && index_ == other.index_;
+    }
+    void increment()
+    {
+        if (++index_ == num_vertices_) next_ring();
+    }
 };
 
-struct polygon_vertex_adapter_2
+namespace detail {
+
+template <typename RingSource, typename Closure>
+inline unsigned next_vertex(ring_vertex_iterator<RingSource, Closure> & itr, ring_vertex_iterator<RingSource, Closure> const&,
+                            double*x, double*y)
 {
-    polygon_vertex_adapter_2(polygon2 const& poly)
-        : poly_(poly),
-          rings_itr_(0),
-          rings_end_(poly_.rings.size()),
-          current_index_(0),
-          end_index_((rings_itr_ < rings_end_) ? poly_.rings[0].size() : 0),
-          start_loop_(true) {}
+    return itr.next_vertex(x, y);
+}
+
+}
+
+template <typename RingSource, typename Closure = closed_ring>
+struct ring_vertex_adapter
+{
+    using iterator = ring_vertex_iterator<RingSource, Closure>;
+    using geometry_type = typename iterator::geometry_type;
+    using ring_type = typename iterator::ring_type;
+
+    explicit ring_vertex_adapter(geometry_type const& geom)
+        : geom_(geom),
+          itr_(geom) {}
 
     void rewind(unsigned) const
     {
-        rings_itr_ = 0;
-        rings_end_ = poly_.rings.size();
-        current_index_ = 0;
-        end_index_ = (rings_itr_ < rings_end_) ? poly_.rings[0].size() : 0;
-        start_loop_ = true;
+        itr_ = iterator(geom_);
     }
 
     unsigned vertex(double*x, double*y) const
     {
-        if (rings_itr_ == rings_end_)
-            return mapnik::SEG_END;
-        if (current_index_ < end_index_)
-        {
-            point const& coord = poly_.rings[rings_itr_][current_index_++];
-            *x = coord.x;
-            *y = coord.y;
-            if (start_loop_)
-            {
-                start_loop_= false;
-                return mapnik::SEG_MOVETO;
-            }
-            return mapnik::SEG_LINETO;
-        }
-        else if (++rings_itr_ != rings_end_)
+        return itr_.next_vertex(x, y);
+    }
+
+    // whole rings, only for layouts storing `point`s contiguously
+    template <typename Ring = ring_type>
+    auto next_span(vertex_span & span) const
+        -> typename std::enable_if<std::is_same<Ring, aos_ring>::value, bool>::type
+    {
+        if (itr_.index_ != 0) itr_.next_ring();
+        if (itr_.num_vertices_ == 0) return false;
+        span.first = itr_.ring_.first;
+        span.last = itr_.ring_.last;
+        span.close = Closure::span_close;
+        itr_.next_ring();
+        return true;
+    }
+private:
+    geometry_type const& geom_;
+    mutable iterator itr_;
+};
+
+template <typename Allocator, typename Closure = closed_ring>
+using basic_polygon_vertex_adapter = ring_vertex_adapter<table_ring_source<basic_polygon<Allocator> >, Closure>;
+using polygon_vertex_adapter = basic_polygon_vertex_adapter<std::allocator<point> >;
+
+template <typename Allocator, typename Closure = closed_ring>
+using basic_flat_multi_polygon_vertex_adapter = ring_vertex_adapter<table_ring_source<basic_flat_multi_polygon<Allocator> >, Closure>;
+using flat_multi_polygon_vertex_adapter = basic_flat_multi_polygon_vertex_adapter<std::allocator<point> >;
+
+template <typename Closure = closed_ring>
+using basic_polygon_soa_vertex_adapter = ring_vertex_adapter<polygon_soa_ring_source, Closure>;
+using polygon_soa_vertex_adapter = basic_polygon_soa_vertex_adapter<>;
+
+template <typename Allocator, typename Closure = closed_ring>
+using basic_polygon_vertex_adapter_2 = ring_vertex_adapter<polygon2_ring_source<Allocator>, Closure>;
+using polygon_vertex_adapter_2 = basic_polygon_vertex_adapter_2<std::allocator<point> >;
+
+template <typename Allocator, typename Closure = closed_ring>
+using basic_polygon_vertex_adapter_3 = ring_vertex_adapter<polygon3_ring_source<Allocator>, Closure>;
+using polygon_vertex_adapter_3 = basic_polygon_vertex_adapter_3<std::allocator<point> >;
+
+template <typename Allocator, typename Closure = closed_ring>
+using basic_multi_polygon_vertex_adapter = ring_vertex_adapter<multi_polygon_ring_source<Allocator>, Closure>;
+using multi_polygon_vertex_adapter = basic_multi_polygon_vertex_adapter<std::allocator<point> >;
+
+// vertices<open_ring>(poly) for rings stored without the closing point
+template <typename Closure = closed_ring, typename Allocator>
+inline vertex_range<ring_vertex_iterator<table_ring_source<basic_polygon<Allocator> >, Closure> >
+vertices(basic_polygon<Allocator> const& poly)
+{
+    using iterator = ring_vertex_iterator<table_ring_source<basic_polygon<Allocator> >, Closure>;
+    return vertex_range<iterator>(iterator(poly), iterator());
+}
+
+template <typename Closure = closed_ring, typename Allocator>
+inline vertex_range<ring_vertex_iterator<table_ring_source<basic_flat_multi_polygon<Allocator> >, Closure> >
+vertices(basic_flat_multi_polygon<Allocator> const& multi_poly)
+{
+    using iterator = ring_vertex_iterator<table_ring_source<basic_flat_multi_polygon<Allocator> >, Closure>;
+    return vertex_range<iterator>(iterator(multi_poly), iterator());
+}
+
+template <typename Closure = closed_ring>
+inline vertex_range<ring_vertex_iterator<polygon_soa_ring_source, Closure> >
+vertices(polygon_soa const& poly)
+{
+    using iterator = ring_vertex_iterator<polygon_soa_ring_source, Closure>;
+    return vertex_range<iterator>(iterator(poly), iterator());
+}
+
+template <typename Closure = closed_ring, typename Allocator>
+inline vertex_range<ring_vertex_iterator<polygon2_ring_source<Allocator>, Closure> >
+vertices(basic_polygon2<Allocator> const& poly)
+{
+    using iterator = ring_vertex_iterator<polygon2_ring_source<Allocator>, Closure>;
+    return vertex_range<iterator>(iterator(poly), iterator());
+}
+
+template <typename Closure = closed_ring, typename Allocator>
+inline vertex_range<ring_vertex_iterator<polygon3_ring_source<Allocator>, Closure> >
+vertices(basic_polygon3<Allocator> const& poly)
+{
+    using iterator = ring_vertex_iterator<polygon3_ring_source<Allocator>, Closure>;
+    return vertex_range<iterator>(iterator(poly), iterator());
+}
+
+template <typename Closure = closed_ring, typename Allocator>
+inline vertex_range<ring_vertex_iterator<multi_polygon_ring_source<Allocator>, Closure> >
+vertices(basic_multi_polygon<Allocator> const& multi_poly)
+{
+    using iterator = ring_vertex_iterator<multi_polygon_ring_source<Allocator>, Closure>;
+    return vertex_range<iterator>(iterator(multi_poly), iterator());
+}
+
+// true when Adapter provides next_span(vertex_span &)
+template <typename Adapter>
+struct has_next_span
+{
+    template <typename U>
+    static auto test(int) -> decltype(std::declval<U const&>().next_span(std::declval<vertex_span&>()), std::true_type());
+    template <typename U>
+    static std::false_type test(...);
+    static const bool value = decltype(test<Adapter>(0))::value;
+};
+
+// Batch pull interface : read(buf, n) fills up to n vertices (x, y, cmd) and
+// returns how many were written, 0 once the adapter reached SEG_END. Adapters
+// with contiguous rings are copied span by span, others fall back to vertex().
+template <typename Adapter, bool = has_next_span<Adapter>::value>
+struct vertex_batch_reader
+{
+    explicit vertex_batch_reader(Adapter const& va)
+        : va_(va) {}
+
+    void rewind(unsigned pathid)
+    {
+        va_.rewind(pathid);
+    }
+
+    std::size_t read(vertex2d * buf, std::size_t n)
+    {
+        std::size_t count = 0;
+        while (count < n)
         {
-            current_index_ = 0;
-            end_index_ = poly_.rings[rings_itr_].size();
-            point const& coord = poly_.rings[rings_itr_][current_index_++];
-            *x = coord.x;
-            *y = coord.y;
-            return mapnik::SEG_MOVETO;
+            vertex2d & v = buf[count];
+            v.cmd = va_.vertex(&v.x, &v.y);
+            if (v.cmd == mapnik::SEG_END) break;
+            ++count;
         }
-        return mapnik::SEG_END;
+        return count;
     }
 private:
-    polygon2 const& poly_;
-    mutable std::size_t rings_itr_;
-    mutable std::size_t rings_end_;
-    mutable std::size_t current_index_;
-    mutable std::size_t end_index_;
-    mutable bool start_loop_;
+    Adapter const& va_;
 };
 
-struct polygon_vertex_adapter_3
+template <typename Adapter>
+struct vertex_batch_reader<Adapter, true>
 {
-    polygon_vertex_adapter_3(polygon3 const& poly)
-        : poly_(poly),
-          rings_itr_(0),
-          rings_end_(poly_.interior_rings.size() + 1),
-          current_index_(0),
-          end_index_((rings_itr_ < rings_end_) ? poly_.exterior_ring.size() : 0),
-          start_loop_(true) {}
+    explicit vertex_batch_reader(Adapter const& va)
+        : va_(va),
+          span_{nullptr, nullptr, vertex_span::no_close},
+          pos_(nullptr),
+          pending_close_(false) {}
 
-    void rewind(unsigned) const
+    void rewind(unsigned pathid)
     {
-        rings_itr_ = 0;
-        rings_end_ = poly_.interior_rings.size() + 1;
-        current_index_ = 0;
-        end_index_ = (rings_itr_ < rings_end_) ? poly_.exterior_ring.size() : 0;
-        start_loop_ = true;
+        va_.rewind(pathid);
+        span_.first = span_.last = pos_ = nullptr;
+        pending_close_ = false;
     }
 
-    unsigned vertex(double*x, double*y) const
+    std::size_t read(vertex2d * buf, std::size_t n)
     {
-        if (rings_itr_ == rings_end_)
-            return mapnik::SEG_END;
-        if (current_index_ < end_index_)
+        std::size_t count = 0;
+        while (count < n)
         {
-            point const& coord = (rings_itr_ == 0) ?
-                poly_.exterior_ring[current_index_++] : poly_.interior_rings[rings_itr_- 1][current_index_++];
-            *x = coord.x;
-            *y = coord.y;
-            if (start_loop_)
+            if (pos_ == span_.last)
             {
-                start_loop_= false;
-                return mapnik::SEG_MOVETO;
+                if (pending_close_)
+                {
+                    buf[count++] = vertex2d(span_.first->x, span_.first->y, mapnik::SEG_CLOSE);
+                    pending_close_ = false;
+                    continue;
+                }
+                if (!va_.next_span(span_)) break;
+                pos_ = span_.first;
+                pending_close_ = (span_.close == vertex_span::close_after && span_.size() > 1);
             }
-            return mapnik::SEG_LINETO;
+            std::size_t size = std::min(n - count, static_cast<std::size_t>(span_.last - pos_));
+            point const* end = pos_ + size;
+            vertex2d * out = buf + count;
+            for (point const* itr = pos_; itr != end; ++itr, ++out)
+            {
+                out->x = itr->x;
+                out->y = itr->y;
+                out->cmd = mapnik::SEG_LINETO;
+            }
+            if (pos_ == span_.first) buf[count].cmd = mapnik::SEG_MOVETO;
+            if (end == span_.last && span_.close == vertex_span::close_last && span_.size() > 1)
+            {
+                buf[count + size - 1].cmd = mapnik::SEG_CLOSE;
+            }
+            pos_ = end;
+            count += size;
+        }
+        return count;
+    }
+private:
+    Adapter const& va_;
+    vertex_span span_;
+    point const* pos_;
+    bool pending_close_;
+};
+
+template <typename Adapter>
+vertex_batch_reader<Adapter> make_vertex_batch_reader(Adapter const& va)
+{
+    return vertex_batch_reader<Adapter>(va);
+}
+
+template <typename T>
+struct vertex_processor;
+
+// Walks the members of a geometry_collection (and of nested collections)
+// in order. The iterator of the current member is constructed in place in
+// fixed storage, nesting is tracked on a fixed-size stack : no allocation.
+// Iterators compare by the number of vertices walked, they are only
+// comparable within the same collection.
+template <typename Allocator>
+struct basic_geometry_collection_vertex_iterator
+    : vertex_iterator_facade<basic_geometry_collection_vertex_iterator<Allocator> >
+{
+    using collection_type = basic_geometry_collection<Allocator>;
+    static const std::size_t max_depth = 16;
+
+    basic_geometry_collection_vertex_iterator()
+        : depth_(0),
+          count_(0),
+          next_(nullptr) {}
+
+    explicit basic_geometry_collection_vertex_iterator(collection_type const& collection)
+        : depth_(1),
+          count_(0),
+          next_(nullptr)
+    {
+        stack_[0] = level(&collection);
+        next_member();
+    }
+
+    // *itr then ++itr in one go for the vertex() shim, SEG_END at the end
+    unsigned next_vertex(double*x, double*y)
+    {
+        if (next_ == nullptr) return mapnik::SEG_END;
+        *x = current_.x;
+        *y = current_.y;
+        unsigned cmd = current_.cmd;
+        increment();
+        return cmd;
+    }
+
+private:
+    friend class boost::iterator_core_access;
+
+    struct level
+    {
+        level() : collection(nullptr), index(0) {}
+        explicit level(collection_type const* c) : collection(c), index(0) {}
+        collection_type const* collection;
+        std::size_t index;
+    };
+
+    template <typename Iterator>
+    using range_type = std::pair<Iterator, Iterator>;
+
+    template <typename Iterator>
+    static unsigned call_next_vertex(void * storage, double*x, double*y)
+    {
+        range_type<Iterator> & range = *static_cast<range_type<Iterator>*>(storage);
+        return detail::next_vertex(range.first, range.second, x, y);
+    }
+
+    struct start_member
+    {
+        template <typename Geometry>
+        void operator() (Geometry const& geom) const
+        {
+            using iterator = typename decltype(vertices(geom))::iterator;
+            static_assert(sizeof(range_type<iterator>) <= sizeof(storage_type), "iterator storage too small");
+            static_assert(std::is_trivially_destructible<iterator>::value, "iterator must be trivially destructible");
+            auto range = vertices(geom);
+            new (&self_.storage_) range_type<iterator>(range.begin(), range.end());
+            self_.next_ = &call_next_vertex<iterator>;
         }
-        else if (++rings_itr_ != rings_end_)
+
+        // nested collections are expanded by next_member()
+        void operator() (collection_type const&) const {}
+
+        basic_geometry_collection_vertex_iterator & self_;
+    };
+
+    // move to the first vertex of the next non-empty member
+    void next_member()
+    {
+        while (depth_ > 0)
         {
-            current_index_ = 0;
-            end_index_ = poly_.interior_rings[rings_itr_ - 1].size();
-            point const& coord = poly_.interior_rings[rings_itr_ - 1][current_index_++];
-            *x = coord.x;
-            *y = coord.y;
-            return mapnik::SEG_MOVETO;
+            level & top = stack_[depth_ - 1];
+            if (top.index == top.collection->size())
+            {
+                --depth_;
+                continue;
+            }
+            basic_geometry<Allocator> const& geom = (*top.collection)[top.index++];
+            if (geom.template is<collection_type>())
+            {
+                if (depth_ == max_depth) throw std::runtime_error("geometry_collection nested too deep");
+                stack_[depth_++] = level(&geom.template get<collection_type>());
+                continue;
+            }
+            mapnik::util::apply_visitor(start_member{*this}, geom);
+            current_.cmd = next_(&storage_, &current_.x, &current_.y);
+            if (current_.cmd != mapnik::SEG_END) return;
         }
-        return mapnik::SEG_END;
+        count_ = 0;
+        next_ = nullptr;
+    }
+
+    vertex2d dereference() const
+    {
+        return current_;
+    }
+
+    bool equal(basic_geometry_collection_vertex_iterator const& other) const
+    {
+        return count_ == other.count_ && (next_ == nullptr) == (other.next_ == nullptr);
+    }
+
+    void increment()
+    {
+        ++count_;
+        current_.cmd = next_(&storage_, &current_.x, &current_.y);
+        if (current_.cmd == mapnik::SEG_END) next_member();
+    }
+
+    using storage_type = typename std::aligned_union<0,
+                                                     range_type<point_vertex_iterator>,
+                                                     range_type<line_string_vertex_iterator>,
+                                                     range_type<multi_point_vertex_iterator>,
+                                                     range_type<line_string_soa_vertex_iterator>,
+                                                     range_type<basic_multi_line_string_vertex_iterator<Allocator> >,
+                                                     range_type<ring_vertex_iterator<table_ring_source<basic_polygon<Allocator> > > >,
+                                                     range_type<ring_vertex_iterator<polygon_soa_ring_source> >,
+                                                     range_type<ring_vertex_iterator<polygon2_ring_source<Allocator> > >,
+                                                     range_type<ring_vertex_iterator<polygon3_ring_source<Allocator> > >,
+                                                     range_type<ring_vertex_iterator<multi_polygon_ring_source<Allocator> > > >::type;
+
+    level stack_[max_depth];
+    std::size_t depth_;
+    std::size_t count_;
+    vertex2d current_;
+    storage_type storage_;
+    unsigned (*next_)(void *, double*, double*);
+};
+
+template <typename Allocator>
+inline vertex_range<basic_geometry_collection_vertex_iterator<Allocator> >
+vertices(basic_geometry_collection<Allocator> const& collection)
+{
+    using iterator = basic_geometry_collection_vertex_iterator<Allocator>;
+    return vertex_range<iterator>(iterator(collection), iterator());
+}
+
+template <typename Allocator>
+struct basic_geometry_collection_vertex_adapter
+{
+    using iterator = basic_geometry_collection_vertex_iterator<Allocator>;
+    using collection_type = basic_geometry_collection<Allocator>;
+
+    basic_geometry_collection_vertex_adapter(collection_type const& collection)
+        : collection_(collection),
+          itr_(collection) {}
+
+    void rewind(unsigned) const
+    {
+        itr_ = iterator(collection_);
+    }
+
+    unsigned vertex(double*x, double*y) const
+    {
+        return itr_.next_vertex(x, y);
     }
 private:
-    polygon3 const& poly_;
-    mutable std::size_t rings_itr_;
-    mutable std::size_t rings_end_;
-    mutable std::size_t current_index_;
-    mutable std::size_t end_index_;
-    mutable bool start_loop_;
+    collection_type const& collection_;
+    mutable iterator itr_;
 };
 
+using geometry_collection_vertex_adapter = basic_geometry_collection_vertex_adapter<std::allocator<point> >;
+
 //
 template <typename T>
 struct vertex_processor
@@ -438,30 +1693,89 @@ struct vertex_processor
         return proc_(va);
     }
 
-    auto operator() (line_string const& line)
-        -> typename std::result_of<processor_type(line_string_vertex_adapter const&)>::type
+    template <typename Allocator>
+    auto operator() (basic_line_string<Allocator> const& line) const
+        -> typename std::result_of<processor_type(basic_line_string_vertex_adapter<Allocator> const&)>::type
     {
-        line_string_vertex_adapter va(line);
+        basic_line_string_vertex_adapter<Allocator> va(line);
         return proc_(va);
     }
-    auto operator() (polygon const& poly) const
-        -> typename std::result_of<processor_type(polygon_vertex_adapter const&)>::type
+
+    template <typename Allocator>
+    auto operator() (basic_polygon<Allocator> const& poly) const
+        -> typename std::result_of<processor_type(basic_polygon_vertex_adapter<Allocator> const&)>::type
+    {
+        basic_polygon_vertex_adapter<Allocator> va(poly);
+        return proc_(va);
+    }
+
+    template <typename Allocator>
+    auto operator() (basic_polygon2<Allocator> const& poly) const
+        -> typename std::result_of<processor_type(basic_polygon_vertex_adapter_2<Allocator> const&)>::type
+    {
+        basic_polygon_vertex_adapter_2<Allocator> va(poly);
+        return proc_(va);
+    }
+
+    template <typename Allocator>
+    auto operator() (basic_polygon3<Allocator> const& poly) const
+        -> typename std::result_of<processor_type(basic_polygon_vertex_adapter_3<Allocator> const&)>::type
+    {
+        basic_polygon_vertex_adapter_3<Allocator> va(poly);
+        return proc_(va);
+    }
+
+    template <typename Allocator>
+    auto operator() (basic_flat_multi_polygon<Allocator> const& multi_poly) const
+        -> typename std::result_of<processor_type(basic_flat_multi_polygon_vertex_adapter<Allocator> const&)>::type
+    {
+        basic_flat_multi_polygon_vertex_adapter<Allocator> va(multi_poly);
+        return proc_(va);
+    }
+
+    template <typename Allocator>
+    auto operator() (basic_multi_point<Allocator> const& multi_pt) const
+        -> typename std::result_of<processor_type(basic_multi_point_vertex_adapter<Allocator> const&)>::type
+    {
+        basic_multi_point_vertex_adapter<Allocator> va(multi_pt);
+        return proc_(va);
+    }
+
+    template <typename Allocator>
+    auto operator() (basic_multi_line_string<Allocator> const& multi_line) const
+        -> typename std::result_of<processor_type(basic_multi_line_string_vertex_adapter<Allocator> const&)>::type
     {
-        polygon_vertex_adapter va(poly);
+        basic_multi_line_string_vertex_adapter<Allocator> va(multi_line);
         return proc_(va);
     }
 
-    auto operator() (polygon2 const& poly) const
-        -> typename std::result_of<processor_type(polygon_vertex_adapter_2 const&)>::type
+    template <typename Allocator>
+    auto operator() (basic_multi_polygon<Allocator> const& multi_poly) const
+        -> typename std::result_of<processor_type(basic_multi_polygon_vertex_adapter<Allocator> const&)>::type
     {
-        polygon_vertex_adapter_2 va(poly);
+        basic_multi_polygon_vertex_adapter<Allocator> va(multi_poly);
         return proc_(va);
     }
 
-    auto operator() (polygon3 const& poly) const
-        -> typename std::result_of<processor_type(polygon_vertex_adapter_3 const&)>::type
+    template <typename Allocator>
+    auto operator() (basic_geometry_collection<Allocator> const& collection) const
+        -> typename std::result_of<processor_type(basic_geometry_collection_vertex_adapter<Allocator> const&)>::type
     {
-        polygon_vertex_adapter_3 va(poly);
+        basic_geometry_collection_vertex_adapter<Allocator> va(collection);
+        return proc_(va);
+    }
+
+    auto operator() (line_string_soa const& line) const
+        -> typename std::result_of<processor_type(line_string_soa_vertex_adapter const&)>::type
+    {
+        line_string_soa_vertex_adapter va(line);
+        return proc_(va);
+    }
+
+    auto operator() (polygon_soa const& poly) const
+        -> typename std::result_of<processor_type(polygon_soa_vertex_adapter const&)>::type
+    {
+        polygon_soa_vertex_adapter va(poly);
         return proc_(va);
     }
 
@@ -469,3 +1783,5 @@ struct vertex_processor
 };
 
 }}
+
+#endif //MAPNIK_GEOMETRY_IMPL_HPP
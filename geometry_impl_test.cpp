@@ -23,7 +23,14 @@
 #include <iostream>
 #include <cstdint>
 #include <vector>
+#include <tuple>
 #include <cassert>
+#include <cstdio>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <random>
+#include <limits>
 
 #include <mapnik/util/variant.hpp>
 #include <mapnik/geometry.hpp>
@@ -31,6 +38,15 @@
 #include <mapnik/timer.hpp>
 
 #include "geometry_impl.hpp"
+#include "geometry_arena.hpp"
+#include "geometry_wkb.hpp"
+#include "geometry_store.hpp"
+#include "geometry_quantized.hpp"
+#include "geometry_parallel.hpp"
+#include "geometry_simplify.hpp"
+#include "geometry_lod.hpp"
+#include "geometry_transform.hpp"
+#include "geometry_memory.hpp"
 
 struct vertex_counter
 {
@@ -50,6 +66,176 @@ struct vertex_counter
     }
 };
 
+// sum of coordinates, one vertex() call per vertex
+struct vertex_summer
+{
+    template <typename T>
+    double operator() (T const& adapter) const
+    {
+        double sum = 0;
+        adapter.rewind(0);
+        for (;;)
+        {
+            double x,y;
+            unsigned cmd = adapter.vertex(&x, &y);
+            if (cmd == mapnik::SEG_END) break;
+            sum += x + y;
+        }
+        return sum;
+    }
+};
+
+// sum of coordinates, pulled in batches of vertex2d
+struct batch_vertex_summer
+{
+    explicit batch_vertex_summer(std::vector<mapnik::vertex2d> & buf)
+        : buf_(buf) {}
+
+    template <typename T>
+    double operator() (T const& adapter) const
+    {
+        double sum = 0;
+        mapnik::vertex2d * buf = buf_.data();
+        auto reader = mapnik::new_geometry::make_vertex_batch_reader(adapter);
+        reader.rewind(0);
+        std::size_t size;
+        while ((size = reader.read(buf, buf_.size())) > 0)
+        {
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                sum += buf[i].x + buf[i].y;
+            }
+        }
+        return sum;
+    }
+    std::vector<mapnik::vertex2d> & buf_;
+};
+
+// sum of coordinates, whole rings at a time
+struct span_vertex_summer
+{
+    template <typename T>
+    double operator() (T const& adapter) const
+    {
+        double sum = 0;
+        mapnik::new_geometry::vertex_span span{nullptr, nullptr, mapnik::new_geometry::vertex_span::no_close};
+        adapter.rewind(0);
+        while (adapter.next_span(span))
+        {
+            for (auto itr = span.first; itr != span.last; ++itr)
+            {
+                sum += itr->x + itr->y;
+            }
+        }
+        return sum;
+    }
+};
+
+// sum of coordinates, range-for over vertices(geom)
+struct range_vertex_summer
+{
+    template <typename T>
+    double operator() (T const& geom) const
+    {
+        double sum = 0;
+        for (mapnik::vertex2d const& v : mapnik::new_geometry::vertices(geom))
+        {
+            sum += v.x + v.y;
+        }
+        return sum;
+    }
+};
+
+// every vertex with its command, in output order
+struct vertex_recorder
+{
+    using vertex_type = std::tuple<double, double, unsigned>;
+
+    template <typename T>
+    std::vector<vertex_type> operator() (T const& adapter) const
+    {
+        std::vector<vertex_type> vertices;
+        adapter.rewind(0);
+        for (;;)
+        {
+            double x,y;
+            unsigned cmd = adapter.vertex(&x, &y);
+            if (cmd == mapnik::SEG_END) break;
+            vertices.emplace_back(x, y, cmd);
+        }
+        return vertices;
+    }
+};
+
+template <typename Polygons>
+void create_polygons(Polygons & geom_cont, std::size_t num_geom, std::size_t num_rings, std::size_t num_points)
+{
+    using polygon_type = typename Polygons::value_type;
+    using ring_type = typename polygon_type::ring_type;
+    auto alloc = typename polygon_type::allocator_type(geom_cont.get_allocator());
+    for (std::size_t n = 0; n < num_geom; ++n)
+    {
+        polygon_type poly(alloc);
+        for (std::size_t j = 0 ; j < num_rings; ++j)
+        {
+            ring_type ring(alloc);
+            ring.reserve(num_points);
+            for (size_t i = 0; i < num_points; ++i)
+            {
+                double x = i;
+                double y = num_points - i;
+                ring.emplace_back(x, y);
+            }
+            if (j == 0) poly.set_exterior_ring(std::move(ring));
+            else poly.add_hole(std::move(ring));
+        }
+        geom_cont.push_back(std::move(poly));
+    }
+}
+
+// closed random walk rings in projected metres
+void create_random_walk_polygons(std::vector<mapnik::new_geometry::polygon3> & polys,
+                                 std::size_t num_geom, std::size_t num_rings, std::size_t num_points)
+{
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> origin(-2.0e7, 2.0e7);
+    std::uniform_real_distribution<double> step(-50.0, 50.0);
+    for (std::size_t n = 0; n < num_geom; ++n)
+    {
+        mapnik::new_geometry::polygon3 poly;
+        for (std::size_t j = 0; j < num_rings; ++j)
+        {
+            mapnik::new_geometry::linear_ring ring;
+            ring.reserve(num_points + 1);
+            double x = origin(gen);
+            double y = origin(gen);
+            for (std::size_t i = 0; i < num_points; ++i)
+            {
+                ring.emplace_back(x, y);
+                x += step(gen);
+                y += step(gen);
+            }
+            ring.push_back(ring.front());
+            if (j == 0) poly.set_exterior_ring(std::move(ring));
+            else poly.add_hole(std::move(ring));
+        }
+        polys.push_back(std::move(poly));
+    }
+}
+
+// heap usage of a layer of num_geom geometries holding num_points vertices
+void print_memory_usage(char const* name, mapnik::new_geometry::memory_stats const& stats,
+                        std::size_t num_geom, std::size_t num_points)
+{
+    std::cerr << "METHOD = 16 " << name << " heap = " << stats.heap_bytes
+              << " used = " << stats.used_bytes
+              << " waste = " << stats.waste_bytes()
+              << " allocations = " << stats.allocations
+              << " bytes/geometry = " << double(stats.heap_bytes) / double(num_geom)
+              << " allocations/geometry = " << double(stats.allocations) / double(num_geom)
+              << " bytes/point = " << double(stats.heap_bytes) / double(num_points) << std::endl;
+}
+
 int main(int argc, char ** argv)
 {
     if (argc != 5)
@@ -62,6 +248,7 @@ int main(int argc, char ** argv)
         std::cerr << "sizeof(mapnik::new_geometry::line_string)="<< sizeof(mapnik::new_geometry::line_string) << std::endl;
         std::cerr << "sizeof(mapnik::new_geometry::polygon)="<< sizeof(mapnik::new_geometry::polygon) << std::endl;
         std::cerr << "sizeof(mapnik::new_geometry::polygon2)="<< sizeof(mapnik::new_geometry::polygon2) << std::endl;
+        std::cerr << "sizeof(mapnik::new_geometry::polygon_soa)="<< sizeof(mapnik::new_geometry::polygon_soa) << std::endl;
         std::cerr << "sizeof(mapnik::new_geometry::polygon_vertex_adapter)="<< sizeof(mapnik::new_geometry::polygon_vertex_adapter) << std::endl;
         std::cerr << "sizeof(mapnik::new_geometry::polygon_vertex_adapter_2)="<< sizeof(mapnik::new_geometry::polygon_vertex_adapter_2) << std::endl;
         std::cerr << "\n";
@@ -154,6 +341,18 @@ int main(int argc, char ** argv)
             }
             std::cerr << "--------count = " << count << std::endl;
         }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 2 mapnik::new_geometry sum x/y");
+            double sum = 0;
+            for (auto const& geom : geom_cont)
+            {
+                for (auto const& pt : geom.get<mapnik::new_geometry::polygon>().data)
+                {
+                    sum += pt.x + pt.y;
+                }
+            }
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
     }
 
     else if (METHOD == 3)
@@ -229,5 +428,879 @@ int main(int argc, char ** argv)
             std::cerr << "--------count = " << count << std::endl;
         }
     }
+    else if (METHOD == 5)
+    {
+        std::vector<mapnik::new_geometry::geometry> geom_cont;
+        geom_cont.reserve(NUM_GEOM);
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 5 mapnik::new_geometry::polygon_soa create");
+            for (std::size_t n = 0; n < NUM_GEOM; ++n)
+            {
+                mapnik::new_geometry::polygon_soa poly;
+
+                for (std::size_t j =0 ; j < NUM_RINGS;++j)
+                {
+                    mapnik::new_geometry::line_string_soa ring;
+                    ring.reserve(NUM_POINTS);
+                    for (size_t i=0; i < NUM_POINTS;++i)
+                    {
+                        double x = i;
+                        double y = NUM_POINTS-i;
+                        ring.add_coord(x, y);
+                    }
+                    poly.add_ring(std::move(ring));
+                }
+                geom_cont.emplace_back(std::move(poly));
+            }
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 5 mapnik::new_geometry::polygon_soa iterate");
+            std::size_t count = 0;
+            for (auto const& geom : geom_cont)
+            {
+                vertex_counter counter;
+                count += mapnik::util::apply_visitor(mapnik::new_geometry::vertex_processor<vertex_counter>(counter), geom);
+            }
+            std::cerr << "--------count = " << count << std::endl;
+        }
+        {
+            // AoS vs SoA raw coordinate sweep (compare with polygon data in METHOD = 2)
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 5 mapnik::new_geometry::polygon_soa sum x/y");
+            double sum = 0;
+            for (auto const& geom : geom_cont)
+            {
+                auto const& poly = geom.get<mapnik::new_geometry::polygon_soa>();
+                std::size_t size = poly.size();
+                double const* x = poly.x.data();
+                double const* y = poly.y.data();
+                for (std::size_t i = 0; i < size; ++i)
+                {
+                    sum += x[i] + y[i];
+                }
+            }
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+    }
+    else if (METHOD == 6)
+    {
+        // create + destroy, heap vs monotonic arena
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 6 mapnik::new_geometry::polygon3 std::allocator create/destroy");
+            std::vector<mapnik::new_geometry::polygon3> geom_cont;
+            geom_cont.reserve(NUM_GEOM);
+            create_polygons(geom_cont, NUM_GEOM, NUM_RINGS, NUM_POINTS);
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 6 mapnik::new_geometry::polygon3 arena create/destroy");
+            using polygon_type = mapnik::new_geometry::arena_polygon3;
+            mapnik::new_geometry::arena pool(1024 * 1024);
+            mapnik::new_geometry::arena_allocator<polygon_type> alloc(pool);
+            std::vector<polygon_type, mapnik::new_geometry::arena_allocator<polygon_type> > geom_cont(alloc);
+            geom_cont.reserve(NUM_GEOM);
+            create_polygons(geom_cont, NUM_GEOM, NUM_RINGS, NUM_POINTS);
+            std::cerr << "--------arena bytes = " << pool.bytes_allocated()
+                      << " blocks = " << pool.num_blocks() << std::endl;
+        }
+    }
+    else if (METHOD == 7)
+    {
+        // one multi_polygon of NUM_GEOM parts : vector<polygon3> vs flat buffers
+        mapnik::new_geometry::multi_polygon multi_poly;
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 7 mapnik::new_geometry::multi_polygon create");
+            create_polygons(multi_poly, NUM_GEOM, NUM_RINGS, NUM_POINTS);
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 7 mapnik::new_geometry::multi_polygon iterate");
+            std::size_t count = 0;
+            vertex_counter counter;
+            for (auto const& poly : multi_poly)
+            {
+                count += counter(mapnik::new_geometry::polygon_vertex_adapter_3(poly));
+            }
+            std::cerr << "--------count = " << count << std::endl;
+        }
+        mapnik::new_geometry::flat_multi_polygon flat_multi_poly;
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 7 mapnik::new_geometry::flat_multi_polygon create");
+            flat_multi_poly.reserve(NUM_GEOM * NUM_RINGS * NUM_POINTS, NUM_GEOM * NUM_RINGS, NUM_GEOM);
+            mapnik::new_geometry::linear_ring ring; // scratch, reused
+            ring.reserve(NUM_POINTS);
+            for (std::size_t n = 0; n < NUM_GEOM; ++n)
+            {
+                flat_multi_poly.begin_part();
+                for (std::size_t j = 0 ; j < NUM_RINGS; ++j)
+                {
+                    ring.clear();
+                    for (size_t i = 0; i < NUM_POINTS; ++i)
+                    {
+                        double x = i;
+                        double y = NUM_POINTS - i;
+                        ring.emplace_back(x, y);
+                    }
+                    flat_multi_poly.add_ring(ring.begin(), ring.end());
+                }
+            }
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 7 mapnik::new_geometry::flat_multi_polygon iterate");
+            vertex_counter counter;
+            std::size_t count = counter(mapnik::new_geometry::flat_multi_polygon_vertex_adapter(flat_multi_poly));
+            std::cerr << "--------count = " << count << std::endl;
+        }
+        {
+            // part views after clear() and a rebuild into the same capacity,
+            // parts without rings, copies and add_ring() before begin_part()
+            mapnik::new_geometry::flat_multi_polygon checked;
+            checked.reserve(64, 8, 8);
+            mapnik::new_geometry::linear_ring ring{{0, 0}, {0, 4}, {4, 4}, {4, 0}, {0, 0}};
+            mapnik::new_geometry::linear_ring small_ring{{1, 1}, {1, 2}, {2, 2}, {1, 1}};
+            checked.begin_part();
+            checked.add_ring(ring.begin(), ring.end());
+            checked.begin_part();
+            checked.add_ring(ring.begin(), ring.end());
+            checked.clear();
+            checked.begin_part();
+            checked.add_ring(small_ring.begin(), small_ring.end());
+            checked.begin_part();
+            checked.begin_part();
+            checked.add_ring(ring.begin(), ring.end());
+            checked.add_ring(small_ring.begin(), small_ring.end());
+            mapnik::new_geometry::flat_multi_polygon copy(checked);
+            bool ok = true;
+            for (auto const* geom : {&checked, &copy})
+            {
+                ok = ok && geom->num_parts() == 3
+                    && geom->part(0).exterior_ring().size() == small_ring.size()
+                    && geom->part(0).exterior_ring().begin() == geom->data.data()
+                    && geom->part(1).num_rings() == 0
+                    && geom->part(1).exterior_ring().empty()
+                    && geom->part(1).interior_rings().empty()
+                    && geom->part(2).exterior_ring().size() == ring.size()
+                    && geom->part(2).interior_rings().size() == 1
+                    && geom->part(2).interior_rings().front().begin() == geom->data.data() + small_ring.size() + ring.size();
+            }
+            mapnik::new_geometry::flat_multi_polygon unstarted;
+            try
+            {
+                unstarted.add_ring(ring.begin(), ring.end());
+                ok = false;
+            }
+            catch (std::logic_error const&) {}
+            if (!ok)
+            {
+                std::cerr << "flat_multi_polygon part views are wrong" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    else if (METHOD == 8)
+    {
+        // mixed layer : multi geometries and collections through one vertex_processor
+        std::vector<mapnik::new_geometry::geometry> geom_cont;
+        geom_cont.reserve(NUM_GEOM);
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 8 mapnik::new_geometry multi/collection create");
+            for (std::size_t n = 0; n < NUM_GEOM; ++n)
+            {
+                mapnik::new_geometry::multi_polygon multi_poly;
+                create_polygons(multi_poly, 2, NUM_RINGS, NUM_POINTS);
+                if (n % 3 == 0)
+                {
+                    geom_cont.emplace_back(std::move(multi_poly));
+                }
+                else
+                {
+                    mapnik::new_geometry::multi_line_string multi_line;
+                    multi_line.resize(NUM_RINGS);
+                    for (auto & line : multi_line)
+                    {
+                        for (size_t i = 0; i < NUM_POINTS; ++i)
+                        {
+                            line.add_coord(i, NUM_POINTS - i);
+                        }
+                    }
+                    if (n % 3 == 1)
+                    {
+                        geom_cont.emplace_back(std::move(multi_line));
+                    }
+                    else
+                    {
+                        mapnik::new_geometry::geometry_collection collection;
+                        collection.emplace_back(std::move(multi_poly));
+                        collection.emplace_back(std::move(multi_line));
+                        geom_cont.emplace_back(std::move(collection));
+                    }
+                }
+            }
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 8 mapnik::new_geometry multi/collection iterate");
+            std::size_t count = 0;
+            for (auto const& geom : geom_cont)
+            {
+                vertex_counter counter;
+                count += mapnik::util::apply_visitor(mapnik::new_geometry::vertex_processor<vertex_counter>(counter), geom);
+            }
+            std::cerr << "--------count = " << count << std::endl;
+        }
+    }
+    else if (METHOD == 9)
+    {
+        // per-vertex vs batch vs span traversal of the same polygons
+        std::vector<mapnik::new_geometry::polygon3> geom_cont;
+        geom_cont.reserve(NUM_GEOM);
+        create_polygons(geom_cont, NUM_GEOM, NUM_RINGS, NUM_POINTS);
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 9 mapnik::new_geometry::polygon3 vertex()");
+            double sum = 0;
+            vertex_summer summer;
+            for (auto const& poly : geom_cont)
+            {
+                sum += summer(mapnik::new_geometry::polygon_vertex_adapter_3(poly));
+            }
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 9 mapnik::new_geometry::polygon3 vertices() range-for");
+            double sum = 0;
+            range_vertex_summer summer;
+            for (auto const& poly : geom_cont)
+            {
+                sum += summer(poly);
+            }
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 9 mapnik::new_geometry::polygon3 batch read()");
+            double sum = 0;
+            std::vector<mapnik::vertex2d> buf(256);
+            batch_vertex_summer summer(buf);
+            for (auto const& poly : geom_cont)
+            {
+                sum += summer(mapnik::new_geometry::polygon_vertex_adapter_3(poly));
+            }
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 9 mapnik::new_geometry::polygon3 next_span()");
+            double sum = 0;
+            span_vertex_summer summer;
+            for (auto const& poly : geom_cont)
+            {
+                sum += summer(mapnik::new_geometry::polygon_vertex_adapter_3(poly));
+            }
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+    }
+    else if (METHOD == 10)
+    {
+        // POINT EMPTY (NaN) : write -> read -> view, no vertex on either path
+        {
+            double nan = std::numeric_limits<double>::quiet_NaN();
+            mapnik::new_geometry::multi_point multi_pt;
+            multi_pt.emplace_back(nan, nan);
+            multi_pt.emplace_back(1.0, 2.0);
+            mapnik::new_geometry::geometry_collection collection;
+            collection.emplace_back(mapnik::new_geometry::point(nan, nan));
+            collection.emplace_back(std::move(multi_pt));
+            mapnik::new_geometry::geometry written(std::move(collection));
+            std::string row;
+            mapnik::new_geometry::to_wkb(row, written);
+            mapnik::new_geometry::geometry geom;
+            if (!mapnik::new_geometry::from_wkb(row.data(), row.size(), geom) ||
+                !geom.is<mapnik::new_geometry::geometry_collection>()) return EXIT_FAILURE;
+            auto const& read = geom.get<mapnik::new_geometry::geometry_collection>();
+            if (read.size() != 2 ||
+                !read[0].is<mapnik::new_geometry::point>() ||
+                !read[1].is<mapnik::new_geometry::multi_point>()) return EXIT_FAILURE;
+            mapnik::new_geometry::wkb_view view(row.data(), row.size());
+            vertex_counter counter;
+            std::size_t pt_count = counter(mapnik::new_geometry::point_vertex_adapter(read[0].get<mapnik::new_geometry::point>()));
+            std::size_t multi_count = counter(mapnik::new_geometry::multi_point_vertex_adapter(read[1].get<mapnik::new_geometry::multi_point>()));
+            std::size_t read_count = counter(mapnik::new_geometry::geometry_collection_vertex_adapter(read));
+            std::size_t view_count = view.valid() ? counter(mapnik::new_geometry::wkb_vertex_adapter(view)) : 0;
+            if (pt_count != 0 || multi_count != 1 || read_count != 1 || view_count != 1)
+            {
+                std::cerr << "POINT EMPTY round-trip mismatch : " << pt_count << " " << multi_count
+                          << " " << read_count << " " << view_count << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        // WKB rows (e.g. from a database) : decode + iterate vs zero-copy wkb_view
+        std::vector<mapnik::new_geometry::polygon3> polys;
+        polys.reserve(NUM_GEOM);
+        create_polygons(polys, NUM_GEOM, NUM_RINGS, NUM_POINTS);
+        std::vector<std::string> rows;
+        rows.reserve(NUM_GEOM);
+        for (auto const& poly : polys)
+        {
+            rows.emplace_back();
+            mapnik::new_geometry::to_wkb(rows.back(), poly);
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 10 mapnik::new_geometry WKB decode + iterate");
+            double sum = 0;
+            vertex_summer summer;
+            mapnik::new_geometry::wkb_reader reader;
+            for (auto const& row : rows)
+            {
+                mapnik::new_geometry::geometry geom;
+                if (!reader.read(row.data(), row.size(), geom)) return EXIT_FAILURE;
+                sum += summer(mapnik::new_geometry::polygon_vertex_adapter_3(geom.get<mapnik::new_geometry::polygon3>()));
+            }
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 10 mapnik::new_geometry wkb_view iterate");
+            double sum = 0;
+            vertex_summer summer;
+            for (auto const& row : rows)
+            {
+                mapnik::new_geometry::wkb_view view(row.data(), row.size());
+                if (!view.valid()) return EXIT_FAILURE;
+                sum += summer(mapnik::new_geometry::wkb_vertex_adapter(view));
+            }
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+    }
+    else if (METHOD == 11)
+    {
+        // geometry_store : write once, then mmap + iterate with no parsing
+        std::string filename("geometry_impl_test.store");
+        {
+            std::vector<mapnik::new_geometry::polygon3> polys;
+            polys.reserve(NUM_GEOM);
+            create_polygons(polys, NUM_GEOM, NUM_RINGS, NUM_POINTS);
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 11 mapnik::new_geometry::geometry_store write");
+            mapnik::new_geometry::geometry_store_writer writer;
+            for (auto const& poly : polys) writer.add(poly);
+            if (!writer.save(filename)) return EXIT_FAILURE;
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 11 mapnik::new_geometry::geometry_store open + iterate");
+            mapnik::new_geometry::geometry_store store(filename);
+            if (!store.is_open()) return EXIT_FAILURE;
+            double sum = 0;
+            vertex_summer summer;
+            for (std::size_t i = 0; i < store.size(); ++i)
+            {
+                mapnik::new_geometry::stored_geometry geom = store[i];
+                sum += summer(mapnik::new_geometry::stored_geometry_vertex_adapter(geom));
+            }
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+        {
+            // an empty exterior keeps its record, the hole stays a hole
+            mapnik::new_geometry::polygon3 poly;
+            poly.interior_rings.emplace_back();
+            poly.interior_rings.back().emplace_back(1, 1);
+            poly.interior_rings.back().emplace_back(2, 1);
+            poly.interior_rings.back().emplace_back(2, 2);
+            poly.interior_rings.back().emplace_back(1, 1);
+            mapnik::new_geometry::geometry_store_writer writer;
+            writer.add(poly);
+            if (!writer.save(filename)) return EXIT_FAILURE;
+            mapnik::new_geometry::geometry_store store(filename);
+            if (!store.is_open() || !store.valid() || store.size() != 1) return EXIT_FAILURE;
+            mapnik::new_geometry::geometry geom;
+            mapnik::new_geometry::to_geometry(store[0], geom);
+            if (!geom.is<mapnik::new_geometry::polygon>()) return EXIT_FAILURE;
+            auto const& stored = geom.get<mapnik::new_geometry::polygon>();
+            // adapter built from the temporary store[0]
+            mapnik::new_geometry::stored_geometry_vertex_adapter va(store[0]);
+            double x, y;
+            unsigned num_vertices = 0;
+            while (va.vertex(&x, &y) != mapnik::SEG_END) ++num_vertices;
+            if (stored.rings.size() != 2 || std::get<1>(stored.rings[0]) != 0
+                || std::get<1>(stored.rings[1]) != 4 || num_vertices != 4)
+            {
+                std::cerr << "geometry_store lost the empty exterior ring" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        std::remove(filename.c_str());
+    }
+    else if (METHOD == 12)
+    {
+        // quantized (delta + zigzag varint) polygons, 1cm grid
+        std::vector<mapnik::new_geometry::polygon3> polys;
+        polys.reserve(NUM_GEOM);
+        create_random_walk_polygons(polys, NUM_GEOM, NUM_RINGS, NUM_POINTS);
+        mapnik::new_geometry::quantization q(-2.0e7, -2.0e7, 0.01);
+        std::vector<mapnik::new_geometry::quantized_polygon> quantized;
+        quantized.reserve(NUM_GEOM);
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 12 mapnik::new_geometry::quantized_polygon encode");
+            for (auto const& poly : polys) quantized.emplace_back(poly, q);
+        }
+        std::size_t num_points = 0;
+        std::size_t num_bytes = 0;
+        for (auto const& poly : polys)
+        {
+            num_points += poly.exterior_ring.size();
+            for (auto const& hole : poly.interior_rings) num_points += hole.size();
+        }
+        for (auto const& poly : quantized) num_bytes += poly.bytes.size();
+        std::cerr << "--------compression ratio = " << double(num_points * sizeof(mapnik::new_geometry::point)) / double(num_bytes)
+                  << " (" << double(num_bytes) / double(num_points) << " bytes/point)" << std::endl;
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 12 mapnik::new_geometry::polygon3 iterate");
+            double sum = 0;
+            vertex_summer summer;
+            for (auto const& poly : polys)
+            {
+                sum += summer(mapnik::new_geometry::polygon_vertex_adapter_3(poly));
+            }
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+        {
+            mapnik::timer t;
+            double sum = 0;
+            vertex_summer summer;
+            for (auto const& poly : quantized)
+            {
+                sum += summer(mapnik::new_geometry::quantized_polygon_vertex_adapter(poly));
+            }
+            t.stop();
+            std::cerr << "--------sum = " << sum << std::endl;
+            std::cerr << "METHOD = 12 mapnik::new_geometry::quantized_polygon decode: " << t.wall_clock_elapsed() << "ms "
+                      << double(num_points) / (t.wall_clock_elapsed() * 1000.0) << " Mpoints/s" << std::endl;
+        }
+        if (!polys.empty())
+        {
+            // every polygon layout encodes to the same bytes
+            mapnik::new_geometry::polygon flat;
+            mapnik::new_geometry::polygon2 poly2;
+            mapnik::new_geometry::line_string exterior;
+            exterior.data = polys[0].exterior_ring;
+            flat.add_ring(std::move(exterior));
+            poly2.rings.push_back(polys[0].exterior_ring);
+            for (auto const& hole : polys[0].interior_rings)
+            {
+                mapnik::new_geometry::line_string ring;
+                ring.data = hole;
+                flat.add_ring(std::move(ring));
+                poly2.rings.push_back(hole);
+            }
+            if (mapnik::new_geometry::quantized_polygon(flat, q).bytes != quantized[0].bytes
+                || mapnik::new_geometry::quantized_polygon(poly2, q).bytes != quantized[0].bytes)
+            {
+                std::cerr << "quantized_polygon differs between polygon layouts" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        {
+            // invalid grids and coordinates off the grid throw
+            std::size_t rejected = 0;
+            double const bad_resolutions[] = { 0.0, -1.0, std::nan(""), HUGE_VAL, 1e-320 };
+            for (double resolution : bad_resolutions)
+            {
+                try { mapnik::new_geometry::quantization bad(0, 0, resolution); }
+                catch (std::runtime_error const&) { ++rejected; }
+            }
+            double const bad_coords[] = { std::nan(""), HUGE_VAL, 1e300 };
+            for (double x : bad_coords)
+            {
+                mapnik::new_geometry::polygon3 poly;
+                poly.exterior_ring.emplace_back(x, 0);
+                try { mapnik::new_geometry::quantized_polygon bad(poly, q); }
+                catch (std::runtime_error const&) { ++rejected; }
+            }
+            // 2^62 itself is off the grid, the largest deltas still round trip
+            mapnik::new_geometry::quantization unit(0, 0, 1);
+            double const limit = 4611686018427387904.0;
+            double const off_grid[] = { limit, -limit };
+            for (double x : off_grid)
+            {
+                mapnik::new_geometry::polygon3 poly;
+                poly.exterior_ring.emplace_back(x, 0);
+                try { mapnik::new_geometry::quantized_polygon bad(poly, unit); }
+                catch (std::runtime_error const&) { ++rejected; }
+            }
+            mapnik::new_geometry::polygon3 extreme;
+            extreme.exterior_ring.emplace_back(limit - 1024, 0);
+            extreme.exterior_ring.emplace_back(-(limit - 1024), 0);
+            extreme.exterior_ring.emplace_back(limit - 1024, 0);
+            mapnik::new_geometry::polygon3 decoded;
+            mapnik::new_geometry::quantized_polygon(extreme, unit).decode(decoded);
+            if (rejected != 10 || decoded.exterior_ring.size() != 3
+                || decoded.exterior_ring[1].x != -(limit - 1024) || decoded.exterior_ring[2].x != limit - 1024)
+            {
+                std::cerr << "quantization accepted an invalid grid or coordinate" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    else if (METHOD == 13)
+    {
+        // skewed layer : every 1000th feature is a multi_polygon of 1000 polygons
+        std::vector<mapnik::new_geometry::polygon3> polys;
+        polys.reserve(NUM_GEOM);
+        create_polygons(polys, NUM_GEOM, NUM_RINGS, NUM_POINTS);
+        std::vector<mapnik::new_geometry::geometry> geoms;
+        geoms.reserve(NUM_GEOM);
+        for (std::size_t i = 0; i < polys.size(); ++i)
+        {
+            if (i % 1000 == 0)
+            {
+                mapnik::new_geometry::multi_polygon multi_poly;
+                multi_poly.resize(1000, polys[i]);
+                geoms.push_back(std::move(multi_poly));
+            }
+            else geoms.push_back(polys[i]);
+        }
+        mapnik::new_geometry::parallel_executor executor;
+        std::cerr << "--------threads = " << executor.num_threads() << std::endl;
+        mapnik::new_geometry::bounding_box box = mapnik::new_geometry::empty_envelope();
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 13 mapnik::new_geometry envelope");
+            for (auto const& geom : geoms)
+            {
+                mapnik::new_geometry::expand(box, mapnik::util::apply_visitor(mapnik::new_geometry::envelope_visitor(), geom));
+            }
+        }
+        mapnik::new_geometry::bounding_box parallel_box;
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 13 mapnik::new_geometry envelope parallel_executor");
+            parallel_box = executor.transform_reduce(geoms.begin(), geoms.end(), mapnik::new_geometry::empty_envelope(),
+                [](mapnik::new_geometry::bounding_box a, mapnik::new_geometry::bounding_box const& b)
+                {
+                    mapnik::new_geometry::expand(a, b);
+                    return a;
+                },
+                [](mapnik::new_geometry::geometry const& geom)
+                {
+                    return mapnik::util::apply_visitor(mapnik::new_geometry::envelope_visitor(), geom);
+                });
+        }
+        if (box.p0.x != parallel_box.p0.x || box.p0.y != parallel_box.p0.y ||
+            box.p1.x != parallel_box.p1.x || box.p1.y != parallel_box.p1.y) return EXIT_FAILURE;
+        std::vector<std::string> rows(geoms.size());
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 13 mapnik::new_geometry to_wkb");
+            for (std::size_t i = 0; i < geoms.size(); ++i)
+            {
+                mapnik::new_geometry::to_wkb(rows[i], geoms[i]);
+            }
+        }
+        std::vector<std::string> parallel_rows(geoms.size());
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 13 mapnik::new_geometry to_wkb parallel_executor");
+            executor.for_each_batch(geoms.size(),
+                [&geoms](std::size_t i) { return mapnik::new_geometry::num_vertices(geoms[i]); },
+                [&geoms, &parallel_rows](std::size_t first, std::size_t last)
+                {
+                    for (std::size_t i = first; i < last; ++i)
+                    {
+                        mapnik::new_geometry::to_wkb(parallel_rows[i], geoms[i]);
+                    }
+                });
+        }
+        if (rows != parallel_rows) return EXIT_FAILURE;
+    }
+    else if (METHOD == 14)
+    {
+        // overview simplification at 100m of random walk (50m steps) rings
+        double const tolerance = 100.0;
+        std::vector<mapnik::new_geometry::polygon3> polys;
+        polys.reserve(NUM_GEOM);
+        create_random_walk_polygons(polys, NUM_GEOM, NUM_RINGS, NUM_POINTS);
+        std::size_t num_points = 0;
+        for (auto const& poly : polys)
+        {
+            num_points += poly.exterior_ring.size();
+            for (auto const& hole : poly.interior_rings) num_points += hole.size();
+        }
+        {
+            std::vector<mapnik::new_geometry::polygon3> simplified(polys);
+            std::size_t count = 0;
+            {
+                mapnik::progress_timer __stats__(std::clog, "METHOD = 14 mapnik::new_geometry::simplifier douglas_peucker");
+                mapnik::new_geometry::simplifier simplify(tolerance);
+                for (auto & poly : simplified) simplify(poly);
+            }
+            for (auto const& poly : simplified) count += poly.exterior_ring.size();
+            std::cerr << "--------kept = " << NUM_RINGS * count * 100.0 / double(num_points) << "%" << std::endl;
+        }
+        {
+            std::vector<mapnik::new_geometry::polygon3> simplified(polys);
+            std::size_t count = 0;
+            {
+                mapnik::progress_timer __stats__(std::clog, "METHOD = 14 mapnik::new_geometry::simplifier visvalingam");
+                mapnik::new_geometry::simplifier simplify(tolerance, mapnik::new_geometry::visvalingam);
+                for (auto & poly : simplified) simplify(poly);
+            }
+            for (auto const& poly : simplified) count += poly.exterior_ring.size();
+            std::cerr << "--------kept = " << NUM_RINGS * count * 100.0 / double(num_points) << "%" << std::endl;
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 14 mapnik::new_geometry::simplify_adapter iterate");
+            mapnik::new_geometry::simplifier simplify(tolerance);
+            std::size_t count = 0;
+            vertex_counter counter;
+            for (auto const& poly : polys)
+            {
+                mapnik::new_geometry::polygon_vertex_adapter_3 va(poly);
+                count += counter(mapnik::new_geometry::make_simplify_adapter(va, simplify));
+            }
+            std::cerr << "--------vertices = " << count << std::endl;
+        }
+        // flat polygons with precomputed ranks
+        std::vector<mapnik::new_geometry::polygon> flat_polys;
+        flat_polys.reserve(NUM_GEOM);
+        for (auto const& poly : polys)
+        {
+            mapnik::new_geometry::polygon flat_poly;
+            mapnik::new_geometry::line_string ring;
+            ring.data = poly.exterior_ring;
+            flat_poly.add_ring(std::move(ring));
+            for (auto const& hole : poly.interior_rings)
+            {
+                ring.data = hole;
+                flat_poly.add_ring(std::move(ring));
+            }
+            flat_polys.push_back(std::move(flat_poly));
+        }
+        std::vector<mapnik::new_geometry::lod_ranks> ranks(NUM_GEOM);
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 14 mapnik::new_geometry::lod_ranks build");
+            for (std::size_t i = 0; i < NUM_GEOM; ++i) ranks[i].build(flat_polys[i]);
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 14 mapnik::new_geometry::polygon iterate");
+            double sum = 0;
+            vertex_summer summer;
+            for (auto const& poly : flat_polys)
+            {
+                sum += summer(mapnik::new_geometry::polygon_vertex_adapter(poly));
+            }
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 14 mapnik::new_geometry::lod_vertex_adapter iterate");
+            double sum = 0;
+            vertex_summer summer;
+            for (std::size_t i = 0; i < NUM_GEOM; ++i)
+            {
+                sum += summer(mapnik::new_geometry::make_lod_vertex_adapter(flat_polys[i], ranks[i], tolerance));
+            }
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+        {
+            // same vertices and commands as simplifier(douglas_peucker, preserve_rings),
+            // from no simplification up to every ring cut down to its preserved 4 points
+            double const tolerances[] = { 0.0, 10.0, tolerance, 1000.0, 1.0e6 };
+            vertex_recorder recorder;
+            for (double tol : tolerances)
+            {
+                mapnik::new_geometry::simplifier simplify(tol, mapnik::new_geometry::douglas_peucker, true);
+                for (std::size_t i = 0; i < NUM_GEOM; ++i)
+                {
+                    mapnik::new_geometry::polygon3 simplified(polys[i]);
+                    simplify(simplified);
+                    if (recorder(mapnik::new_geometry::polygon_vertex_adapter_3(simplified))
+                        != recorder(mapnik::new_geometry::make_lod_vertex_adapter(flat_polys[i], ranks[i], tol)))
+                    {
+                        std::cerr << "lod_vertex_adapter differs from simplifier at tolerance " << tol << std::endl;
+                        return EXIT_FAILURE;
+                    }
+                }
+            }
+        }
+    }
+    else if (METHOD == 15)
+    {
+        // projected metres -> 256x256 screen and -> lon/lat
+        std::vector<mapnik::new_geometry::polygon3> polys;
+        polys.reserve(NUM_GEOM);
+        create_random_walk_polygons(polys, NUM_GEOM, NUM_RINGS, NUM_POINTS);
+        mapnik::new_geometry::bounding_box extent(-2.0e7, -2.0e7, 2.0e7, 2.0e7);
+        mapnik::new_geometry::affine_transform tr = mapnik::new_geometry::affine_transform::screen(extent, 256, 256);
+        mapnik::new_geometry::web_mercator_inverse merc2lonlat;
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 15 mapnik::new_geometry affine per vertex");
+            double sum = 0;
+            for (auto const& poly : polys)
+            {
+                mapnik::new_geometry::polygon_vertex_adapter_3 va(poly);
+                double x, y;
+                va.rewind(0);
+                while (va.vertex(&x, &y) != mapnik::SEG_END)
+                {
+                    tr(x, y);
+                    sum += x + y;
+                }
+            }
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+        std::vector<mapnik::new_geometry::polygon3> out(NUM_GEOM);
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 15 mapnik::new_geometry affine bulk into destination");
+            for (std::size_t i = 0; i < NUM_GEOM; ++i) mapnik::new_geometry::transform(polys[i], out[i], tr);
+        }
+        {
+            double sum = 0;
+            vertex_summer summer;
+            for (auto const& poly : out) sum += summer(mapnik::new_geometry::polygon_vertex_adapter_3(poly));
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+        {
+            std::vector<mapnik::new_geometry::polygon3> in_place(polys);
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 15 mapnik::new_geometry affine bulk in place");
+            for (auto & poly : in_place) mapnik::new_geometry::transform(poly, tr);
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 15 mapnik::new_geometry web_mercator_inverse per vertex");
+            double sum = 0;
+            for (auto const& poly : polys)
+            {
+                mapnik::new_geometry::polygon_vertex_adapter_3 va(poly);
+                double x, y;
+                va.rewind(0);
+                while (va.vertex(&x, &y) != mapnik::SEG_END)
+                {
+                    merc2lonlat(x, y);
+                    sum += x + y;
+                }
+            }
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 15 mapnik::new_geometry web_mercator_inverse bulk into destination");
+            for (std::size_t i = 0; i < NUM_GEOM; ++i) mapnik::new_geometry::transform(polys[i], out[i], merc2lonlat);
+        }
+        {
+            double sum = 0;
+            vertex_summer summer;
+            for (auto const& poly : out) sum += summer(mapnik::new_geometry::polygon_vertex_adapter_3(poly));
+            std::cerr << "--------sum = " << sum << std::endl;
+        }
+        {
+            mapnik::progress_timer __stats__(std::clog, "METHOD = 15 mapnik::new_geometry web_mercator_forward bulk in place");
+            mapnik::new_geometry::web_mercator_forward lonlat2merc;
+            for (auto & poly : out) mapnik::new_geometry::transform(poly, lonlat2merc);
+        }
+        if (!polys.empty())
+        {
+            // arena geometries (no default allocator) : a collection copied
+            // into a point, then into a collection already holding elements
+            mapnik::new_geometry::arena pool;
+            mapnik::new_geometry::arena_allocator<mapnik::new_geometry::point> alloc(pool);
+            mapnik::new_geometry::arena_polygon3 poly(alloc);
+            poly.exterior_ring.assign(polys[0].exterior_ring.begin(), polys[0].exterior_ring.end());
+            mapnik::new_geometry::arena_geometry_collection collection(alloc);
+            collection.emplace_back(std::move(poly));
+            collection.emplace_back(mapnik::new_geometry::point(1, 2));
+            mapnik::new_geometry::arena_geometry src(std::move(collection));
+            mapnik::new_geometry::arena_geometry dst(mapnik::new_geometry::point(0, 0));
+            mapnik::new_geometry::transform(src, dst, tr, alloc);
+            mapnik::new_geometry::transform(src, dst, tr, alloc);
+            mapnik::new_geometry::polygon3 expected;
+            mapnik::new_geometry::transform(polys[0], expected, tr);
+            auto const& copied = dst.get<mapnik::new_geometry::arena_geometry_collection>();
+            auto const& ring = copied[0].get<mapnik::new_geometry::arena_polygon3>().exterior_ring;
+            if (copied.size() != 2 || !std::equal(ring.begin(), ring.end(), expected.exterior_ring.begin(),
+                                                  [](mapnik::new_geometry::point const& a, mapnik::new_geometry::point const& b)
+                                                  { return a.x == b.x && a.y == b.y; }))
+            {
+                std::cerr << "transform into an arena geometry is wrong" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    else if (METHOD == 16)
+    {
+        // heap bytes, slack and allocation counts per layout for the same input
+        std::size_t num_points = NUM_GEOM * NUM_RINGS * NUM_POINTS;
+        {
+            std::vector<mapnik::new_geometry::polygon> polys;
+            polys.reserve(NUM_GEOM);
+            for (std::size_t n = 0; n < NUM_GEOM; ++n)
+            {
+                mapnik::new_geometry::polygon poly;
+                for (std::size_t j = 0 ; j < NUM_RINGS; ++j)
+                {
+                    mapnik::new_geometry::line_string ring;
+                    ring.reserve(NUM_POINTS);
+                    for (std::size_t i = 0; i < NUM_POINTS; ++i) ring.add_coord(double(i), double(NUM_POINTS - i));
+                    poly.add_ring(std::move(ring));
+                }
+                polys.push_back(std::move(poly));
+            }
+            print_memory_usage("mapnik::new_geometry::polygon", mapnik::new_geometry::memory_usage(polys), NUM_GEOM, num_points);
+        }
+        {
+            std::vector<mapnik::new_geometry::polygon2> polys;
+            polys.reserve(NUM_GEOM);
+            for (std::size_t n = 0; n < NUM_GEOM; ++n)
+            {
+                mapnik::new_geometry::polygon2 poly;
+                for (std::size_t j = 0 ; j < NUM_RINGS; ++j)
+                {
+                    mapnik::new_geometry::line_string ring;
+                    ring.reserve(NUM_POINTS);
+                    for (std::size_t i = 0; i < NUM_POINTS; ++i) ring.add_coord(double(i), double(NUM_POINTS - i));
+                    poly.add_ring(std::move(ring));
+                }
+                polys.push_back(std::move(poly));
+            }
+            print_memory_usage("mapnik::new_geometry::polygon2", mapnik::new_geometry::memory_usage(polys), NUM_GEOM, num_points);
+        }
+        {
+            std::vector<mapnik::new_geometry::polygon3> polys;
+            polys.reserve(NUM_GEOM);
+            create_polygons(polys, NUM_GEOM, NUM_RINGS, NUM_POINTS);
+            print_memory_usage("mapnik::new_geometry::polygon3", mapnik::new_geometry::memory_usage(polys), NUM_GEOM, num_points);
+
+            mapnik::new_geometry::flat_multi_polygon flat_multi_poly;
+            for (auto const& poly : polys) flat_multi_poly.add_polygon(poly);
+            print_memory_usage("mapnik::new_geometry::flat_multi_polygon", mapnik::new_geometry::memory_usage(flat_multi_poly), NUM_GEOM, num_points);
+
+            mapnik::new_geometry::quantization q(0.0, 0.0, 0.01);
+            std::vector<mapnik::new_geometry::quantized_polygon> quantized;
+            quantized.reserve(NUM_GEOM);
+            for (auto const& poly : polys) quantized.emplace_back(poly, q);
+            print_memory_usage("mapnik::new_geometry::quantized_polygon", mapnik::new_geometry::memory_usage(quantized), NUM_GEOM, num_points);
+        }
+        {
+            std::vector<mapnik::new_geometry::polygon_soa> polys;
+            polys.reserve(NUM_GEOM);
+            for (std::size_t n = 0; n < NUM_GEOM; ++n)
+            {
+                mapnik::new_geometry::polygon_soa poly;
+                for (std::size_t j = 0 ; j < NUM_RINGS; ++j)
+                {
+                    mapnik::new_geometry::line_string_soa ring;
+                    ring.reserve(NUM_POINTS);
+                    for (std::size_t i = 0; i < NUM_POINTS; ++i) ring.add_coord(double(i), double(NUM_POINTS - i));
+                    poly.add_ring(std::move(ring));
+                }
+                polys.push_back(std::move(poly));
+            }
+            print_memory_usage("mapnik::new_geometry::polygon_soa", mapnik::new_geometry::memory_usage(polys), NUM_GEOM, num_points);
+        }
+        {
+            // counted allocations must agree with memory_usage()
+            using polygon_type = mapnik::new_geometry::counting_polygon3;
+            mapnik::new_geometry::allocation_counter counter;
+            mapnik::new_geometry::counting_allocator<polygon_type> alloc(counter);
+            std::vector<polygon_type, mapnik::new_geometry::counting_allocator<polygon_type> > polys(alloc);
+            polys.reserve(NUM_GEOM);
+            create_polygons(polys, NUM_GEOM, NUM_RINGS, NUM_POINTS);
+            mapnik::new_geometry::memory_stats stats = mapnik::new_geometry::memory_usage(polys);
+            print_memory_usage("mapnik::new_geometry::counting_polygon3", stats, NUM_GEOM, num_points);
+            std::cerr << "--------counted allocations = " << counter.allocations
+                      << " live = " << counter.allocations - counter.deallocations
+                      << " in use = " << counter.bytes_in_use
+                      << " peak = " << counter.peak_bytes << std::endl;
+            if (stats.heap_bytes != counter.bytes_in_use
+                || stats.allocations != counter.allocations - counter.deallocations)
+            {
+                std::cerr << "memory_usage() disagrees with allocation_counter" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+    }
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,321 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_INDEX_HPP
+#define MAPNIK_GEOMETRY_INDEX_HPP
+
+#include "geometry_impl.hpp"
+#include "geometry_envelope.hpp"
+
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+namespace mapnik { namespace new_geometry {
+
+// Static packed R-tree in flat arrays (boxes + indices, leaves first then
+// one level after the other up to the root). Nodes hold up to node_size
+// children. Query cost grows with the number of hits, not the layer size.
+//
+// packed_rtree_view queries arrays owned elsewhere, e.g. a serialized tree
+// mapped next to a geometry_store. packed_rtree builds and owns them.
+class packed_rtree_view
+{
+public:
+    static const unsigned max_node_size = 32;
+    // pending nodes of a query, bounded by num_levels * node_size
+    static const std::size_t max_stack_size = 512;
+
+    packed_rtree_view()
+        : boxes_(nullptr),
+          indices_(nullptr),
+          levels_(nullptr),
+          num_items_(0),
+          num_boxes_(0),
+          num_levels_(0),
+          node_size_(0) {}
+
+    // serialized tree (packed_rtree::write), false when malformed
+    bool attach(char const* data, std::size_t size)
+    {
+        *this = packed_rtree_view();
+        header h;
+        if (size < sizeof(header)) return false;
+        std::memcpy(&h, data, sizeof(header));
+        if (std::memcmp(h.magic, "MNKRTREE", 8) != 0 || h.version != 1
+            || h.node_size < 2 || h.node_size > max_node_size
+            || h.num_levels > 64 || h.num_boxes < h.num_items || h.num_boxes >= (std::uint64_t(1) << 32)) return false;
+        std::size_t levels_offset = sizeof(header);
+        std::size_t boxes_offset = align(levels_offset + h.num_levels * sizeof(std::uint64_t));
+        std::size_t indices_offset = boxes_offset + h.num_boxes * sizeof(bounding_box);
+        if (size < indices_offset || (size - indices_offset) / sizeof(std::uint32_t) < h.num_boxes) return false;
+        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(data);
+        if (address % alignof(bounding_box) != 0) return false;
+        packed_rtree_view view;
+        view.levels_ = reinterpret_cast<std::uint64_t const*>(data + levels_offset);
+        view.boxes_ = reinterpret_cast<bounding_box const*>(data + boxes_offset);
+        view.indices_ = reinterpret_cast<std::uint32_t const*>(data + indices_offset);
+        view.num_items_ = h.num_items;
+        view.num_boxes_ = h.num_boxes;
+        view.num_levels_ = h.num_levels;
+        view.node_size_ = h.node_size;
+        if (!view.check()) return false;
+        *this = view;
+        return true;
+    }
+
+    std::size_t size() const { return num_items_; }
+    bool empty() const { return num_items_ == 0; }
+
+    // envelope of all items (an empty_envelope() when empty)
+    bounding_box bounds() const
+    {
+        return (num_boxes_ == 0) ? empty_envelope() : boxes_[num_boxes_ - 1];
+    }
+
+    // calls callback(item index) for every item whose box intersects `box`
+    template <typename Visitor>
+    void visit(bounding_box const& box, Visitor && callback) const
+    {
+        if (num_items_ == 0) return;
+        std::uint32_t stack[max_stack_size];
+        std::size_t depth = 0;
+        std::uint32_t root = static_cast<std::uint32_t>(num_boxes_ - 1);
+        if (!intersects(box, boxes_[root])) return;
+        if (num_levels_ == 1)
+        {
+            callback(static_cast<std::size_t>(indices_[root]));
+            return;
+        }
+        stack[depth++] = root;
+        while (depth != 0)
+        {
+            std::uint32_t node = stack[--depth];
+            std::size_t level = level_of(node);
+            std::uint32_t first = indices_[node];
+            std::uint32_t last = std::min(first + node_size_, static_cast<std::uint32_t>(levels_[level - 1]));
+            if (level == 1)
+            {
+                for (std::uint32_t i = first; i != last; ++i)
+                {
+                    if (intersects(box, boxes_[i])) callback(static_cast<std::size_t>(indices_[i]));
+                }
+            }
+            else
+            {
+                for (std::uint32_t i = first; i != last; ++i)
+                {
+                    if (intersects(box, boxes_[i])) stack[depth++] = i;
+                }
+            }
+        }
+    }
+
+    // writes the index of every hit to `out`
+    template <typename OutputIterator>
+    OutputIterator query(bounding_box const& box, OutputIterator out) const
+    {
+        visit(box, [&out](std::size_t index) { *out++ = index; });
+        return out;
+    }
+
+protected:
+    struct header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t node_size;
+        std::uint64_t num_items;
+        std::uint64_t num_boxes;
+        std::uint64_t num_levels;
+        std::uint64_t reserved;
+    };
+
+    static std::size_t align(std::size_t offset)
+    {
+        return (offset + 15) & ~std::size_t(15);
+    }
+
+    // levels_[l] is the end of level l in boxes_ (level 0 are the leaves)
+    std::size_t level_of(std::uint32_t node) const
+    {
+        std::size_t level = 0;
+        while (node >= levels_[level]) ++level;
+        return level;
+    }
+
+    // structure of an attached tree : level ends increasing up to a single
+    // root, item indices in range, children of every node in the level below
+    bool check() const
+    {
+        if (num_items_ == 0) return num_boxes_ == 0 && num_levels_ == 0;
+        if (num_levels_ == 0 || levels_[0] != num_items_ || levels_[num_levels_ - 1] != num_boxes_) return false;
+        for (std::size_t l = 1; l < num_levels_; ++l)
+        {
+            if (levels_[l] <= levels_[l - 1]) return false;
+        }
+        if (levels_[num_levels_ - 1] - (num_levels_ > 1 ? levels_[num_levels_ - 2] : 0) != 1) return false;
+        if (num_levels_ * node_size_ > max_stack_size) return false;
+        for (std::size_t i = 0; i < num_items_; ++i)
+        {
+            if (indices_[i] >= num_items_) return false;
+        }
+        for (std::size_t l = 1; l < num_levels_; ++l)
+        {
+            for (std::uint64_t i = levels_[l - 1]; i < levels_[l]; ++i)
+            {
+                std::uint64_t first = indices_[i];
+                if (first < (l > 1 ? levels_[l - 2] : 0) || first >= levels_[l - 1]) return false;
+            }
+        }
+        return true;
+    }
+
+    bounding_box const* boxes_;
+    std::uint32_t const* indices_;
+    std::uint64_t const* levels_;
+    std::size_t num_items_;
+    std::size_t num_boxes_;
+    std::size_t num_levels_;
+    unsigned node_size_;
+};
+
+// Bulk loaded (Sort-Tile-Recursive) packed_rtree over item envelopes,
+// item i being the i-th box of the input range.
+class packed_rtree : public packed_rtree_view
+{
+public:
+    template <typename Iterator>
+    packed_rtree(Iterator first, Iterator last, unsigned node_size = 16)
+    {
+        node_size_ = std::max(2u, std::min(node_size, static_cast<unsigned>(max_node_size)));
+        std::vector<bounding_box> items(first, last);
+        build(items);
+    }
+
+    packed_rtree(packed_rtree &&) = default;
+    packed_rtree& operator=(packed_rtree &&) = default;
+    packed_rtree(packed_rtree const&) = delete;
+    packed_rtree& operator=(packed_rtree const&) = delete;
+
+    // serialized form for packed_rtree_view::attach
+    bool write(std::ostream & out) const
+    {
+        header h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, "MNKRTREE", 8);
+        h.version = 1;
+        h.node_size = node_size_;
+        h.num_items = num_items_;
+        h.num_boxes = num_boxes_;
+        h.num_levels = num_levels_;
+        static const char padding[16] = {};
+        std::size_t levels_size = level_storage_.size() * sizeof(std::uint64_t);
+        out.write(reinterpret_cast<char const*>(&h), sizeof(h));
+        out.write(reinterpret_cast<char const*>(level_storage_.data()), static_cast<std::streamsize>(levels_size));
+        out.write(padding, static_cast<std::streamsize>(align(sizeof(h) + levels_size) - sizeof(h) - levels_size));
+        out.write(reinterpret_cast<char const*>(box_storage_.data()),
+                  static_cast<std::streamsize>(box_storage_.size() * sizeof(bounding_box)));
+        out.write(reinterpret_cast<char const*>(index_storage_.data()),
+                  static_cast<std::streamsize>(index_storage_.size() * sizeof(std::uint32_t)));
+        return static_cast<bool>(out);
+    }
+
+private:
+    static double center_x(bounding_box const& b) { return 0.5 * (b.p0.x + b.p1.x); }
+    static double center_y(bounding_box const& b) { return 0.5 * (b.p0.y + b.p1.y); }
+
+    void build(std::vector<bounding_box> const& items)
+    {
+        std::size_t n = items.size();
+        if (n == 0)
+        {
+            set_views();
+            return;
+        }
+        // STR leaf order : vertical slices by center x, each sorted by center y
+        std::vector<std::uint32_t> order(n);
+        std::iota(order.begin(), order.end(), 0u);
+        std::vector<double> centers(n);
+        for (std::size_t i = 0; i < n; ++i) centers[i] = center_x(items[i]);
+        std::sort(order.begin(), order.end(), [&centers](std::uint32_t a, std::uint32_t b)
+                  { return centers[a] < centers[b]; });
+        for (std::size_t i = 0; i < n; ++i) centers[i] = center_y(items[i]);
+        std::size_t num_leaves = (n + node_size_ - 1) / node_size_;
+        std::size_t num_slices = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(num_leaves))));
+        std::size_t slice_size = num_slices * node_size_;
+        for (std::size_t i = 0; i < n; i += slice_size)
+        {
+            auto slice_end = order.begin() + static_cast<std::ptrdiff_t>(std::min(i + slice_size, n));
+            std::sort(order.begin() + static_cast<std::ptrdiff_t>(i), slice_end, [&centers](std::uint32_t a, std::uint32_t b)
+                      { return centers[a] < centers[b]; });
+        }
+        box_storage_.reserve(n + n / (node_size_ - 1) + 1);
+        index_storage_.reserve(box_storage_.capacity());
+        for (std::uint32_t i : order)
+        {
+            box_storage_.push_back(items[i]);
+            index_storage_.push_back(i);
+        }
+        level_storage_.push_back(n);
+        // parents of consecutive runs of node_size boxes until a single root
+        std::size_t level_begin = 0;
+        std::size_t level_end = n;
+        while (level_end - level_begin > 1)
+        {
+            for (std::size_t i = level_begin; i < level_end; i += node_size_)
+            {
+                bounding_box bbox = empty_envelope();
+                std::size_t last = std::min(i + node_size_, level_end);
+                for (std::size_t j = i; j < last; ++j) expand(bbox, box_storage_[j]);
+                box_storage_.push_back(bbox);
+                index_storage_.push_back(static_cast<std::uint32_t>(i));
+            }
+            level_begin = level_end;
+            level_end = box_storage_.size();
+            level_storage_.push_back(level_end);
+        }
+        set_views();
+    }
+
+    void set_views()
+    {
+        boxes_ = box_storage_.data();
+        indices_ = index_storage_.data();
+        levels_ = level_storage_.data();
+        num_items_ = level_storage_.empty() ? 0 : static_cast<std::size_t>(level_storage_[0]);
+        num_boxes_ = box_storage_.size();
+        num_levels_ = level_storage_.size();
+    }
+
+    std::vector<bounding_box> box_storage_;
+    std::vector<std::uint32_t> index_storage_;
+    std::vector<std::uint64_t> level_storage_;
+};
+
+}}
+
+#endif //MAPNIK_GEOMETRY_INDEX_HPP
@@ -0,0 +1,271 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_LOD_HPP
+#define MAPNIK_GEOMETRY_LOD_HPP
+
+#include "geometry_impl.hpp"
+#include "geometry_simplify.hpp"
+
+#include <vector>
+#include <limits>
+#include <cstdint>
+
+namespace mapnik { namespace new_geometry {
+
+// Level of detail ranks for the vertex buffer of a line_string, polygon or
+// flat_multi_polygon, one entry per vertex in `data` order. The coordinates
+// are not copied.
+//
+// error[i] is the largest squared tolerance at which Douglas-Peucker keeps
+// vertex i, clamped to the one of the vertex that split its range so ranks
+// decrease down the split tree, and skip[i] is the end of that range. Any
+// vertex in (i, skip[i]) then ranks below i, a vertex adapter can jump over
+// the whole range when i is dropped. Rings use the same split and ring
+// preserving rule as simplifier(douglas_peucker, preserve_rings = true), so
+// emitting the vertices ranked above tolerance^2 gives exactly its output.
+struct lod_ranks
+{
+    std::vector<double> error;
+    std::vector<std::uint32_t> skip;
+
+    template <typename Allocator>
+    void build(basic_line_string<Allocator> const& line)
+    {
+        resize(line.data.size());
+        build_path(line.data.data(), 0, line.data.size(), false);
+    }
+
+    template <typename Allocator>
+    void build(basic_polygon<Allocator> const& poly)
+    {
+        build_rings(poly.data, poly.rings);
+    }
+
+    template <typename Allocator>
+    void build(basic_flat_multi_polygon<Allocator> const& multi_poly)
+    {
+        build_rings(multi_poly.data, multi_poly.rings);
+    }
+
+private:
+    struct range
+    {
+        std::uint32_t first;
+        std::uint32_t last;
+        double limit;
+    };
+
+    void resize(std::size_t size)
+    {
+        error.assign(size, std::numeric_limits<double>::infinity());
+        skip.resize(size);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            skip[i] = static_cast<std::uint32_t>(i + 1);
+        }
+    }
+
+    template <typename Data, typename Rings>
+    void build_rings(Data const& data, Rings const& rings)
+    {
+        resize(data.size());
+        for (auto const& r : rings)
+        {
+            build_path(data.data() + std::get<0>(r), std::get<0>(r), std::get<1>(r), true);
+        }
+    }
+
+    // ranks of pts[0 .. size) stored at [offset, offset + size)
+    void build_path(point const* pts, std::size_t offset, std::size_t size, bool closed)
+    {
+        if (size <= (closed ? 4u : 2u)) return;
+        aos_ring ring{pts, pts + size};
+        double const inf = std::numeric_limits<double>::infinity();
+        stack_.clear();
+        if (closed)
+        {
+            std::size_t split = 1;
+            double max_distance2 = -1.0;
+            for (std::size_t i = 1; i < size - 1; ++i)
+            {
+                double d2 = (pts[i].x - pts[0].x) * (pts[i].x - pts[0].x) + (pts[i].y - pts[0].y) * (pts[i].y - pts[0].y);
+                if (d2 > max_distance2)
+                {
+                    max_distance2 = d2;
+                    split = i;
+                }
+            }
+            skip[offset + split] = static_cast<std::uint32_t>(offset + size - 1);
+            double d0, d1;
+            std::size_t v0 = detail::farthest_vertex(ring, 0, split, d0);
+            std::size_t v1 = detail::farthest_vertex(ring, split, size - 1, d1);
+            // the farther top vertex is never dropped, as with preserve_rings
+            std::uint32_t forced = static_cast<std::uint32_t>(offset + ((d0 >= d1) ? v0 : v1));
+            stack_.push_back(range{0, static_cast<std::uint32_t>(split), inf});
+            stack_.push_back(range{static_cast<std::uint32_t>(split), static_cast<std::uint32_t>(size - 1), inf});
+            process(ring, offset);
+            error[forced] = inf;
+        }
+        else
+        {
+            stack_.push_back(range{0, static_cast<std::uint32_t>(size - 1), inf});
+            process(ring, offset);
+        }
+    }
+
+    void process(aos_ring const& ring, std::size_t offset)
+    {
+        while (!stack_.empty())
+        {
+            range r = stack_.back();
+            stack_.pop_back();
+            if (r.last - r.first < 2) continue;
+            double d2;
+            std::size_t index = detail::farthest_vertex(ring, r.first, r.last, d2);
+            double rank = std::min(d2, r.limit);
+            error[offset + index] = rank;
+            skip[offset + index] = static_cast<std::uint32_t>(offset + r.last);
+            stack_.push_back(range{r.first, static_cast<std::uint32_t>(index), rank});
+            stack_.push_back(range{static_cast<std::uint32_t>(index), r.last, rank});
+        }
+    }
+
+    std::vector<range> stack_;
+};
+
+namespace detail {
+
+// paths of the layouts lod_ranks supports : (start, count) and closure
+template <typename Geometry>
+struct lod_paths;
+
+template <typename Allocator>
+struct lod_paths<basic_line_string<Allocator> >
+{
+    static const bool closed = false;
+    static std::size_t size(basic_line_string<Allocator> const&) { return 1; }
+    static std::pair<std::size_t, std::size_t> path(basic_line_string<Allocator> const& line, std::size_t)
+    {
+        return std::make_pair(std::size_t(0), line.data.size());
+    }
+};
+
+template <typename Geometry>
+struct lod_ring_paths
+{
+    static const bool closed = true;
+    static std::size_t size(Geometry const& geom) { return geom.rings.size(); }
+    static std::pair<std::size_t, std::size_t> path(Geometry const& geom, std::size_t index)
+    {
+        return std::make_pair(static_cast<std::size_t>(std::get<0>(geom.rings[index])),
+                              static_cast<std::size_t>(std::get<1>(geom.rings[index])));
+    }
+};
+
+template <typename Allocator>
+struct lod_paths<basic_polygon<Allocator> > : lod_ring_paths<basic_polygon<Allocator> > {};
+
+template <typename Allocator>
+struct lod_paths<basic_flat_multi_polygon<Allocator> > : lod_ring_paths<basic_flat_multi_polygon<Allocator> > {};
+
+}
+
+// Emits the vertices of `geom` ranked above tolerance^2, with the commands
+// of the full resolution adapters (rings end with SEG_CLOSE on their last
+// point). Dropped ranges are jumped over, the cost follows the output size
+// times the split tree depth, not the input size.
+template <typename Geometry>
+struct lod_vertex_adapter
+{
+    using paths = detail::lod_paths<Geometry>;
+
+    lod_vertex_adapter(Geometry const& geom, lod_ranks const& ranks, double tolerance)
+        : geom_(geom),
+          ranks_(ranks),
+          tolerance2_(tolerance * tolerance),
+          path_index_(0),
+          start_(0),
+          index_(0),
+          end_(0) {}
+
+    unsigned vertex(double*x, double*y) const
+    {
+        for (;;)
+        {
+            if (index_ < end_)
+            {
+                std::size_t index = index_;
+                point const& pt = geom_.data[index];
+                *x = pt.x;
+                *y = pt.y;
+                if (index == end_ - 1 && index != start_)
+                {
+                    index_ = end_;
+                    return paths::closed ? mapnik::SEG_CLOSE : mapnik::SEG_LINETO;
+                }
+                index_ = next(index);
+                return (index == start_) ? mapnik::SEG_MOVETO : mapnik::SEG_LINETO;
+            }
+            if (path_index_ == paths::size(geom_)) return mapnik::SEG_END;
+            auto p = paths::path(geom_, path_index_++);
+            start_ = index_ = p.first;
+            end_ = p.first + p.second;
+        }
+    }
+
+    void rewind(unsigned) const
+    {
+        path_index_ = 0;
+        start_ = index_ = end_ = 0;
+    }
+
+private:
+    std::size_t next(std::size_t index) const
+    {
+        std::size_t last = end_ - 1;
+        std::size_t i = index + 1;
+        while (i < last && ranks_.error[i] <= tolerance2_)
+        {
+            i = ranks_.skip[i];
+        }
+        return i;
+    }
+
+    Geometry const& geom_;
+    lod_ranks const& ranks_;
+    double tolerance2_;
+    mutable std::size_t path_index_;
+    mutable std::size_t start_;
+    mutable std::size_t index_;
+    mutable std::size_t end_;
+};
+
+template <typename Geometry>
+inline lod_vertex_adapter<Geometry> make_lod_vertex_adapter(Geometry const& geom, lod_ranks const& ranks, double tolerance)
+{
+    return lod_vertex_adapter<Geometry>(geom, ranks, tolerance);
+}
+
+}}
+
+#endif //MAPNIK_GEOMETRY_LOD_HPP
@@ -0,0 +1,86 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_MAPPED_FILE_HPP
+#define MAPNIK_GEOMETRY_MAPPED_FILE_HPP
+
+#include <string>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace mapnik { namespace new_geometry {
+
+// Read-only memory mapping of a whole file (POSIX)
+class mapped_file
+{
+public:
+    explicit mapped_file(std::string const& filename)
+        : data_(nullptr),
+          size_(0),
+          open_(false)
+    {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd == -1) return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0)
+        {
+            size_ = static_cast<std::size_t>(st.st_size);
+            if (size_ == 0) open_ = true;
+            else
+            {
+                void * addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr != MAP_FAILED)
+                {
+                    ::madvise(addr, size_, MADV_SEQUENTIAL);
+                    data_ = static_cast<char const*>(addr);
+                    open_ = true;
+                }
+            }
+        }
+        ::close(fd);
+    }
+
+    ~mapped_file()
+    {
+        if (data_ != nullptr) ::munmap(const_cast<char *>(data_), size_);
+    }
+
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    bool is_open() const { return open_; }
+    char const* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    char const* data_;
+    std::size_t size_;
+    bool open_;
+};
+
+}}
+
+#endif //MAPNIK_GEOMETRY_MAPPED_FILE_HPP
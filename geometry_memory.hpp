@@ -0,0 +1,306 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_MEMORY_HPP
+#define MAPNIK_GEOMETRY_MEMORY_HPP
+
+#include "geometry_impl.hpp"
+#include "geometry_quantized.hpp"
+
+#include <vector>
+#include <new>
+#include <cstddef>
+
+namespace mapnik { namespace new_geometry {
+
+// Heap owned by a geometry (or a sum of them) : `heap_bytes` is the
+// capacity of every buffer, `used_bytes` the part holding elements and
+// `allocations` the number of live heap blocks. The object itself
+// (sizeof) isn't included, it lives wherever its owner puts it.
+struct memory_stats
+{
+    memory_stats()
+        : heap_bytes(0),
+          used_bytes(0),
+          allocations(0) {}
+
+    // reserve() and growth slack
+    std::size_t waste_bytes() const
+    {
+        return heap_bytes - used_bytes;
+    }
+
+    memory_stats & operator+=(memory_stats const& other)
+    {
+        heap_bytes += other.heap_bytes;
+        used_bytes += other.used_bytes;
+        allocations += other.allocations;
+        return *this;
+    }
+
+    std::size_t heap_bytes;
+    std::size_t used_bytes;
+    std::size_t allocations;
+};
+
+namespace detail {
+
+// one flat buffer, elements own no memory
+template <typename T, typename Allocator>
+inline memory_stats buffer_usage(std::vector<T, Allocator> const& v)
+{
+    memory_stats stats;
+    stats.heap_bytes = v.capacity() * sizeof(T);
+    stats.used_bytes = v.size() * sizeof(T);
+    stats.allocations = v.capacity() > 0 ? 1 : 0;
+    return stats;
+}
+
+}
+
+inline memory_stats memory_usage(point const&)
+{
+    return memory_stats();
+}
+
+// linear_ring
+template <typename Allocator>
+inline memory_stats memory_usage(std::vector<point, Allocator> const& ring)
+{
+    return detail::buffer_usage(ring);
+}
+
+template <typename Allocator>
+inline memory_stats memory_usage(basic_line_string<Allocator> const& line)
+{
+    return detail::buffer_usage(line.data);
+}
+
+inline memory_stats memory_usage(soa_vertex_sequence const& seq)
+{
+    memory_stats stats = detail::buffer_usage(seq.x);
+    stats += detail::buffer_usage(seq.y);
+    return stats;
+}
+
+inline memory_stats memory_usage(polygon_soa const& poly)
+{
+    memory_stats stats = memory_usage(static_cast<soa_vertex_sequence const&>(poly));
+    stats += detail::buffer_usage(poly.rings);
+    return stats;
+}
+
+template <typename Allocator>
+inline memory_stats memory_usage(basic_polygon<Allocator> const& poly)
+{
+    memory_stats stats = detail::buffer_usage(poly.data);
+    stats += detail::buffer_usage(poly.rings);
+    return stats;
+}
+
+template <typename Allocator>
+inline memory_stats memory_usage(basic_polygon2<Allocator> const& poly)
+{
+    memory_stats stats = detail::buffer_usage(poly.rings);
+    for (auto const& ring : poly.rings) stats += memory_usage(ring);
+    return stats;
+}
+
+template <typename Allocator>
+inline memory_stats memory_usage(basic_polygon3<Allocator> const& poly)
+{
+    memory_stats stats = memory_usage(poly.exterior_ring);
+    stats += detail::buffer_usage(poly.interior_rings);
+    for (auto const& hole : poly.interior_rings) stats += memory_usage(hole);
+    return stats;
+}
+
+template <typename Allocator>
+inline memory_stats memory_usage(basic_multi_point<Allocator> const& multi_pt)
+{
+    return detail::buffer_usage(multi_pt);
+}
+
+template <typename Allocator>
+inline memory_stats memory_usage(basic_multi_line_string<Allocator> const& multi_line)
+{
+    memory_stats stats = detail::buffer_usage(multi_line);
+    for (auto const& line : multi_line) stats += memory_usage(line);
+    return stats;
+}
+
+template <typename Allocator>
+inline memory_stats memory_usage(basic_multi_polygon<Allocator> const& multi_poly)
+{
+    memory_stats stats = detail::buffer_usage(multi_poly);
+    for (auto const& poly : multi_poly) stats += memory_usage(poly);
+    return stats;
+}
+
+// includes the view tables built by begin()/end()
+template <typename Allocator>
+inline memory_stats memory_usage(basic_flat_multi_polygon<Allocator> const& multi_poly)
+{
+    memory_stats stats = detail::buffer_usage(multi_poly.data);
+    stats += detail::buffer_usage(multi_poly.rings);
+    stats += detail::buffer_usage(multi_poly.parts);
+    stats += detail::buffer_usage(multi_poly.ring_views());
+    stats += detail::buffer_usage(multi_poly.part_views());
+    return stats;
+}
+
+template <typename Allocator>
+inline memory_stats memory_usage(basic_quantized_line_string<Allocator> const& line)
+{
+    return detail::buffer_usage(line.bytes);
+}
+
+template <typename Allocator>
+inline memory_stats memory_usage(basic_quantized_polygon<Allocator> const& poly)
+{
+    return detail::buffer_usage(poly.bytes);
+}
+
+template <typename Allocator>
+inline memory_stats memory_usage(basic_geometry_collection<Allocator> const& collection);
+
+namespace detail {
+
+struct memory_usage_visitor
+{
+    template <typename T>
+    memory_stats operator() (T const& geom) const
+    {
+        return memory_usage(geom);
+    }
+};
+
+}
+
+template <typename Allocator>
+inline memory_stats memory_usage(basic_geometry<Allocator> const& geom)
+{
+    return mapnik::util::apply_visitor(detail::memory_usage_visitor(), geom);
+}
+
+template <typename Allocator>
+inline memory_stats memory_usage(basic_geometry_collection<Allocator> const& collection)
+{
+    memory_stats stats = detail::buffer_usage(collection);
+    for (auto const& geom : collection) stats += memory_usage(geom);
+    return stats;
+}
+
+// a layer : the vector's own buffer plus every geometry in it
+template <typename Geometry, typename Allocator>
+inline memory_stats memory_usage(std::vector<Geometry, Allocator> const& geoms)
+{
+    memory_stats stats = detail::buffer_usage(geoms);
+    for (auto const& geom : geoms) stats += memory_usage(geom);
+    return stats;
+}
+
+// Totals shared by every copy (and rebind) of a counting_allocator.
+struct allocation_counter
+{
+    allocation_counter()
+        : allocations(0),
+          deallocations(0),
+          bytes_allocated(0),
+          bytes_in_use(0),
+          peak_bytes(0) {}
+
+    void reset()
+    {
+        *this = allocation_counter();
+    }
+
+    std::size_t allocations;
+    std::size_t deallocations;
+    std::size_t bytes_allocated; // cumulative
+    std::size_t bytes_in_use;
+    std::size_t peak_bytes;
+};
+
+// Stateful allocator forwarding to ::operator new and recording every call
+// in an allocation_counter, usable with every basic_* geometry container
+// (e.g basic_polygon3<counting_allocator<point>>). Not thread safe, use
+// one counter per thread.
+template <typename T>
+struct counting_allocator
+{
+    using value_type = T;
+
+    explicit counting_allocator(allocation_counter & counter) noexcept
+        : counter_(&counter) {}
+
+    template <typename U>
+    counting_allocator(counting_allocator<U> const& other) noexcept
+        : counter_(other.counter_) {}
+
+    T * allocate(std::size_t n)
+    {
+        std::size_t bytes = n * sizeof(T);
+        T * p = static_cast<T*>(::operator new(bytes));
+        ++counter_->allocations;
+        counter_->bytes_allocated += bytes;
+        counter_->bytes_in_use += bytes;
+        if (counter_->bytes_in_use > counter_->peak_bytes) counter_->peak_bytes = counter_->bytes_in_use;
+        return p;
+    }
+
+    void deallocate(T * p, std::size_t n) noexcept
+    {
+        ++counter_->deallocations;
+        counter_->bytes_in_use -= n * sizeof(T);
+        ::operator delete(p);
+    }
+
+    allocation_counter * counter_;
+};
+
+template <typename T, typename U>
+inline bool operator==(counting_allocator<T> const& lhs, counting_allocator<U> const& rhs)
+{
+    return lhs.counter_ == rhs.counter_;
+}
+
+template <typename T, typename U>
+inline bool operator!=(counting_allocator<T> const& lhs, counting_allocator<U> const& rhs)
+{
+    return lhs.counter_ != rhs.counter_;
+}
+
+using counting_line_string = basic_line_string<counting_allocator<point> >;
+using counting_linear_ring = basic_linear_ring<counting_allocator<point> >;
+using counting_polygon = basic_polygon<counting_allocator<point> >;
+using counting_polygon2 = basic_polygon2<counting_allocator<point> >;
+using counting_polygon3 = basic_polygon3<counting_allocator<point> >;
+using counting_multi_point = basic_multi_point<counting_allocator<point> >;
+using counting_multi_line_string = basic_multi_line_string<counting_allocator<point> >;
+using counting_multi_polygon = basic_multi_polygon<counting_allocator<point> >;
+using counting_geometry = basic_geometry<counting_allocator<point> >;
+using counting_geometry_collection = basic_geometry_collection<counting_allocator<point> >;
+
+}}
+
+#endif //MAPNIK_GEOMETRY_MEMORY_HPP
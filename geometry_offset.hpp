@@ -0,0 +1,201 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_OFFSET_HPP
+#define MAPNIK_GEOMETRY_OFFSET_HPP
+
+#include "geometry_impl.hpp"
+
+#include <vector>
+#include <cmath>
+
+namespace mapnik { namespace new_geometry {
+
+// Offsets the paths of a vertex source by `distance` on the fly, positive
+// to the left of the direction of travel (y up). Joins are mitred up to
+// `miter_limit` times the distance and bevelled beyond, open ends are
+// butt. Output is staged one path at a time so that a closed path (ending
+// with SEG_CLOSE at its first point) gets a proper join there too.
+template <typename VertexSource>
+struct offset_adapter
+{
+    offset_adapter(VertexSource const& source, double distance, double miter_limit = 4.0)
+        : source_(source),
+          distance_(distance),
+          miter_limit2_(miter_limit * miter_limit),
+          state_(idle),
+          done_(false),
+          index_(0) {}
+
+    unsigned vertex(double*x, double*y) const
+    {
+        for (;;)
+        {
+            if (index_ < path_.size())
+            {
+                queued_vertex const& v = path_[index_++];
+                *x = v.pt.x;
+                *y = v.pt.y;
+                return v.cmd;
+            }
+            if (done_) return mapnik::SEG_END;
+            read_path();
+        }
+    }
+
+    void rewind(unsigned path_id) const
+    {
+        source_.rewind(path_id);
+        path_.clear();
+        index_ = 0;
+        state_ = idle;
+        done_ = false;
+    }
+
+private:
+    enum path_state
+    {
+        idle,    // no path
+        started, // first vertex seen
+        segment  // current_ ends the segment along normal_
+    };
+
+    struct queued_vertex
+    {
+        unsigned cmd;
+        point pt;
+    };
+
+    // offsets source vertices up to the end of the next path
+    void read_path() const
+    {
+        path_.clear();
+        index_ = 0;
+        for (;;)
+        {
+            point pt;
+            unsigned cmd = source_.vertex(&pt.x, &pt.y);
+            if (cmd == mapnik::SEG_END)
+            {
+                finish();
+                done_ = true;
+                return;
+            }
+            if (cmd == mapnik::SEG_MOVETO || state_ == idle)
+            {
+                bool finished = finish();
+                current_ = pt;
+                state_ = started;
+                if (finished) return;
+                continue;
+            }
+            // SEG_LINETO or SEG_CLOSE
+            double dx = pt.x - current_.x;
+            double dy = pt.y - current_.y;
+            double length = std::sqrt(dx * dx + dy * dy);
+            if (length > 0.0)
+            {
+                point normal(-dy / length, dx / length);
+                if (state_ == started)
+                {
+                    push(mapnik::SEG_MOVETO, offset(current_, normal));
+                    first_normal_ = normal;
+                }
+                else
+                {
+                    join(current_, normal_, normal);
+                }
+                normal_ = normal;
+                current_ = pt;
+                state_ = segment;
+            }
+            if (cmd == mapnik::SEG_CLOSE && state_ == segment)
+            {
+                // restart the ring at the join of its last and first segments
+                join(current_, normal_, first_normal_);
+                path_.front().pt = path_.back().pt;
+                path_.back().cmd = mapnik::SEG_CLOSE;
+                state_ = idle;
+                return;
+            }
+        }
+    }
+
+    // pending end of an open path, a single point path is left as is
+    bool finish() const
+    {
+        path_state state = state_;
+        state_ = idle;
+        if (state == segment) push(mapnik::SEG_LINETO, offset(current_, normal_));
+        else if (state == started) push(mapnik::SEG_MOVETO, current_);
+        return state != idle;
+    }
+
+    point offset(point const& pt, point const& normal) const
+    {
+        return point(pt.x + normal.x * distance_, pt.y + normal.y * distance_);
+    }
+
+    // miter length / distance = 2 / |n0 + n1|
+    void join(point const& pt, point const& n0, point const& n1) const
+    {
+        double mx = n0.x + n1.x;
+        double my = n0.y + n1.y;
+        double length2 = mx * mx + my * my;
+        if (length2 * miter_limit2_ >= 4.0)
+        {
+            double scale = 2.0 / length2;
+            push(mapnik::SEG_LINETO, offset(pt, point(mx * scale, my * scale)));
+        }
+        else
+        {
+            push(mapnik::SEG_LINETO, offset(pt, n0));
+            push(mapnik::SEG_LINETO, offset(pt, n1));
+        }
+    }
+
+    void push(unsigned cmd, point const& pt) const
+    {
+        path_.push_back(queued_vertex{cmd, pt});
+    }
+
+    VertexSource const& source_;
+    double distance_;
+    double miter_limit2_;
+    mutable std::vector<queued_vertex> path_;
+    mutable point current_;
+    mutable point normal_;
+    mutable point first_normal_;
+    mutable path_state state_;
+    mutable bool done_;
+    mutable std::size_t index_;
+};
+
+template <typename VertexSource>
+inline offset_adapter<VertexSource> make_offset_adapter(VertexSource const& source, double distance, double miter_limit = 4.0)
+{
+    return offset_adapter<VertexSource>(source, distance, miter_limit);
+}
+
+}}
+
+#endif //MAPNIK_GEOMETRY_OFFSET_HPP
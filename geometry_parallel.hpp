@@ -0,0 +1,369 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_PARALLEL_HPP
+#define MAPNIK_GEOMETRY_PARALLEL_HPP
+
+#include "geometry_impl.hpp"
+#include "geometry_envelope.hpp"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <algorithm>
+
+namespace mapnik { namespace new_geometry {
+
+// number of stored vertices, the default work estimate
+struct vertex_count_visitor
+{
+    std::size_t operator() (point const&) const
+    {
+        return 1;
+    }
+
+    template <typename Allocator>
+    std::size_t operator() (basic_line_string<Allocator> const& line) const
+    {
+        return line.data.size();
+    }
+
+    std::size_t operator() (line_string_soa const& line) const
+    {
+        return line.size();
+    }
+
+    template <typename Allocator>
+    std::size_t operator() (basic_polygon<Allocator> const& poly) const
+    {
+        return poly.data.size();
+    }
+
+    std::size_t operator() (polygon_soa const& poly) const
+    {
+        return poly.x.size();
+    }
+
+    template <typename Allocator>
+    std::size_t operator() (basic_polygon2<Allocator> const& poly) const
+    {
+        std::size_t count = 0;
+        for (auto const& ring : poly.rings) count += ring.size();
+        return count;
+    }
+
+    template <typename Allocator>
+    std::size_t operator() (basic_polygon3<Allocator> const& poly) const
+    {
+        std::size_t count = poly.exterior_ring.size();
+        for (auto const& hole : poly.interior_rings) count += hole.size();
+        return count;
+    }
+
+    template <typename Allocator>
+    std::size_t operator() (basic_multi_point<Allocator> const& multi_pt) const
+    {
+        return multi_pt.size();
+    }
+
+    template <typename Allocator>
+    std::size_t operator() (basic_multi_line_string<Allocator> const& multi_line) const
+    {
+        std::size_t count = 0;
+        for (auto const& line : multi_line) count += (*this)(line);
+        return count;
+    }
+
+    template <typename Allocator>
+    std::size_t operator() (basic_multi_polygon<Allocator> const& multi_poly) const
+    {
+        std::size_t count = 0;
+        for (auto const& poly : multi_poly) count += (*this)(poly);
+        return count;
+    }
+
+    template <typename Allocator>
+    std::size_t operator() (basic_flat_multi_polygon<Allocator> const& multi_poly) const
+    {
+        return multi_poly.data.size();
+    }
+
+    template <typename Allocator>
+    std::size_t operator() (basic_geometry_collection<Allocator> const& collection) const
+    {
+        std::size_t count = 0;
+        for (auto const& geom : collection) count += mapnik::util::apply_visitor(*this, geom);
+        return count;
+    }
+
+    template <typename Geometry>
+    std::size_t operator() (cached_envelope<Geometry> const& geom) const
+    {
+        return (*this)(geom.geometry());
+    }
+};
+
+template <typename... Types>
+inline std::size_t num_vertices(mapnik::util::variant<Types...> const& geom)
+{
+    return mapnik::util::apply_visitor(vertex_count_visitor(), geom);
+}
+
+template <typename Geometry>
+inline std::size_t num_vertices(Geometry const& geom)
+{
+    return vertex_count_visitor()(geom);
+}
+
+// Data parallel loops over a layer (std::vector<geometry>, or the parts of
+// a flat container by index) with work stealing.
+//
+// Items are cut into consecutive batches of about equal estimated cost
+// (vertex count by default), `batches_per_thread` per worker, an item
+// costing more than that being a batch of its own. Every worker starts
+// with an equal cost share of the batches and takes them from the front
+// of its queue, then steals from the back of the others when it runs
+// out. A few huge multi-polygons then don't leave the other workers idle
+// behind a static partition. The first exception thrown by a batch stops
+// the remaining ones and is rethrown by the caller.
+class parallel_executor
+{
+public:
+    explicit parallel_executor(unsigned num_threads = std::thread::hardware_concurrency(),
+                               std::size_t batches_per_thread = 8)
+        : num_threads_(std::max(num_threads, 1u)),
+          batches_per_thread_(std::max(batches_per_thread, std::size_t(1))) {}
+
+    unsigned num_threads() const
+    {
+        return num_threads_;
+    }
+
+    // f(first, last) over index batches covering [0, size), cost(i) is the
+    // estimated work of item i. State needed by the work (a box_clipper, an
+    // output buffer ..) can be created once per batch.
+    template <typename Cost, typename Function>
+    void for_each_batch(std::size_t size, Cost cost, Function f) const
+    {
+        std::vector<batch> batches;
+        partition(size, cost, batches);
+        run(batches, [&f, &batches](std::size_t i)
+            {
+                f(batches[i].first, batches[i].last);
+            });
+    }
+
+    template <typename Iterator, typename Function, typename Cost>
+    void for_each(Iterator first, Iterator last, Function f, Cost cost) const
+    {
+        for_each_batch(static_cast<std::size_t>(std::distance(first, last)),
+                       [first, &cost](std::size_t i) { return cost(first[static_cast<std::ptrdiff_t>(i)]); },
+                       [first, &f](std::size_t batch_first, std::size_t batch_last)
+                       {
+                           for (std::size_t i = batch_first; i < batch_last; ++i) f(first[static_cast<std::ptrdiff_t>(i)]);
+                       });
+    }
+
+    template <typename Iterator, typename Function>
+    void for_each(Iterator first, Iterator last, Function f) const
+    {
+        for_each(first, last, f, item_cost());
+    }
+
+    // reduce(init, transform(*first)), ... batches are reduced locally then
+    // combined in order, so `reduce` only has to be associative
+    template <typename Iterator, typename T, typename Reduce, typename Transform, typename Cost>
+    T transform_reduce(Iterator first, Iterator last, T init, Reduce reduce, Transform transform, Cost cost) const
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::vector<batch> batches;
+        partition(size, [first, &cost](std::size_t i) { return cost(first[static_cast<std::ptrdiff_t>(i)]); }, batches);
+        std::vector<T> results(batches.size(), init);
+        run(batches, [first, &reduce, &transform, &batches, &results](std::size_t b)
+            {
+                std::size_t i = batches[b].first;
+                T & result = results[b];
+                // batch 0 starts from init, the others from their first item
+                if (b != 0) result = transform(first[static_cast<std::ptrdiff_t>(i++)]);
+                for (; i < batches[b].last; ++i)
+                {
+                    result = reduce(std::move(result), transform(first[static_cast<std::ptrdiff_t>(i)]));
+                }
+            });
+        if (results.empty()) return init;
+        for (std::size_t b = 1; b < results.size(); ++b)
+        {
+            results[0] = reduce(std::move(results[0]), std::move(results[b]));
+        }
+        return std::move(results[0]);
+    }
+
+    template <typename Iterator, typename T, typename Reduce, typename Transform>
+    T transform_reduce(Iterator first, Iterator last, T init, Reduce reduce, Transform transform) const
+    {
+        return transform_reduce(first, last, std::move(init), reduce, transform, item_cost());
+    }
+
+private:
+    struct item_cost
+    {
+        template <typename Geometry>
+        std::size_t operator() (Geometry const& geom) const
+        {
+            return num_vertices(geom);
+        }
+    };
+
+    struct batch
+    {
+        std::size_t first;
+        std::size_t last;
+        std::size_t cost;
+    };
+
+    // worker queue, [front, back) of the batches
+    struct queue
+    {
+        std::mutex mutex;
+        std::size_t front;
+        std::size_t back;
+    };
+
+    template <typename Cost>
+    void partition(std::size_t size, Cost const& cost, std::vector<batch> & batches) const
+    {
+        std::vector<std::size_t> costs(size);
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            costs[i] = std::max(static_cast<std::size_t>(cost(i)), std::size_t(1));
+            total += costs[i];
+        }
+        std::size_t target = std::max(total / (num_threads_ * batches_per_thread_), std::size_t(1));
+        batch current{0, 0, 0};
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            if (current.cost > 0 && current.cost + costs[i] > target)
+            {
+                batches.push_back(current);
+                current = batch{i, i, 0};
+            }
+            current.last = i + 1;
+            current.cost += costs[i];
+        }
+        if (current.cost > 0) batches.push_back(current);
+    }
+
+    template <typename Function>
+    void run(std::vector<batch> const& batches, Function const& f) const
+    {
+        std::size_t num_workers = std::min(static_cast<std::size_t>(num_threads_), batches.size());
+        if (num_workers <= 1)
+        {
+            for (std::size_t i = 0; i < batches.size(); ++i) f(i);
+            return;
+        }
+        // equal cost shares of consecutive batches
+        std::vector<queue> queues(num_workers);
+        std::size_t total = 0;
+        for (auto const& b : batches) total += b.cost;
+        std::size_t begin = 0;
+        std::size_t cost = 0;
+        for (std::size_t w = 0; w < num_workers; ++w)
+        {
+            std::size_t end = begin;
+            std::size_t share = total / num_workers * (w + 1);
+            while (end < batches.size() && (w + 1 == num_workers || cost < share))
+            {
+                cost += batches[end++].cost;
+            }
+            queues[w].front = begin;
+            queues[w].back = end;
+            begin = end;
+        }
+
+        std::atomic<bool> stop(false);
+        std::mutex exception_mutex;
+        std::exception_ptr exception;
+        auto worker = [&](std::size_t w)
+        {
+            for (;;)
+            {
+                if (stop) return;
+                std::size_t index;
+                if (!pop(queues[w], index))
+                {
+                    bool stolen = false;
+                    for (std::size_t k = 1; k < num_workers && !stolen; ++k)
+                    {
+                        stolen = steal(queues[(w + k) % num_workers], index);
+                    }
+                    if (!stolen) return;
+                }
+                try
+                {
+                    f(index);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(exception_mutex);
+                    if (!exception) exception = std::current_exception();
+                    stop = true;
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        for (std::size_t w = 1; w < num_workers; ++w)
+        {
+            threads.emplace_back(worker, w);
+        }
+        worker(0);
+        for (auto & t : threads) t.join();
+        if (exception) std::rethrow_exception(exception);
+    }
+
+    static bool pop(queue & q, std::size_t & index)
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.front == q.back) return false;
+        index = q.front++;
+        return true;
+    }
+
+    static bool steal(queue & q, std::size_t & index)
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.front == q.back) return false;
+        index = --q.back;
+        return true;
+    }
+
+    unsigned num_threads_;
+    std::size_t batches_per_thread_;
+};
+
+}}
+
+#endif //MAPNIK_GEOMETRY_PARALLEL_HPP
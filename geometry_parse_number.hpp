@@ -0,0 +1,142 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_PARSE_NUMBER_HPP
+#define MAPNIK_GEOMETRY_PARSE_NUMBER_HPP
+
+#include <cstdlib>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace mapnik { namespace new_geometry { namespace detail {
+
+// Reads a decimal number ([-]digits[.digits][e[+-]digits]) at `itr` and
+// advances past it. No whitespace skipping, no locale. Shared by the text
+// parsers; [first, last) doesn't need to be null terminated (e.g. mmap'ed).
+inline bool parse_number(char const*& itr, char const* last, double & value)
+{
+    static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    char const* start = itr;
+    bool negative = (itr != last && *itr == '-');
+    if (negative) ++itr;
+    std::uint64_t mantissa = 0;
+    int num_digits = 0;
+    int exponent = 0;
+    bool has_digits = false;
+    bool truncated = false;
+    for (; itr != last && *itr >= '0' && *itr <= '9'; ++itr)
+    {
+        has_digits = true;
+        if (num_digits < 19)
+        {
+            mantissa = mantissa * 10 + static_cast<std::uint64_t>(*itr - '0');
+            if (mantissa != 0) ++num_digits;
+        }
+        else
+        {
+            ++exponent;
+            truncated = true;
+        }
+    }
+    if (itr != last && *itr == '.')
+    {
+        ++itr;
+        for (; itr != last && *itr >= '0' && *itr <= '9'; ++itr)
+        {
+            has_digits = true;
+            if (num_digits < 19)
+            {
+                mantissa = mantissa * 10 + static_cast<std::uint64_t>(*itr - '0');
+                if (mantissa != 0) ++num_digits;
+                --exponent;
+            }
+            else truncated = true;
+        }
+    }
+    if (!has_digits) return false;
+    if (itr != last && (*itr == 'e' || *itr == 'E'))
+    {
+        ++itr;
+        bool negative_exp = false;
+        if (itr != last && (*itr == '-' || *itr == '+')) negative_exp = (*itr++ == '-');
+        if (itr == last || *itr < '0' || *itr > '9') return false;
+        int exp = 0;
+        for (; itr != last && *itr >= '0' && *itr <= '9'; ++itr)
+        {
+            if (exp < 10000) exp = exp * 10 + (*itr - '0');
+        }
+        exponent += negative_exp ? -exp : exp;
+    }
+    // exact when mantissa and 10^exponent are both exact doubles
+    if (mantissa < (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+    {
+        double d = static_cast<double>(mantissa);
+        d = (exponent < 0) ? d / pow10[-exponent] : d * pow10[exponent];
+        value = negative ? -d : d;
+        return true;
+    }
+#if LDBL_MANT_DIG >= 64
+    // 17-19 significant digits (e.g. %.17g output) : one correctly rounded
+    // x87 extended operation, then rounding to double is exact unless the
+    // extended result sits next to a halfway point between two doubles
+    static const long double pow10l[] = { 1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L,
+                                          1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L,
+                                          1e19L, 1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L };
+    if (!truncated && exponent >= -27 && exponent <= 27)
+    {
+        long double q = static_cast<long double>(mantissa);
+        q = (exponent < 0) ? q / pow10l[-exponent] : q * pow10l[exponent];
+        int exp2;
+        std::uint64_t bits = static_cast<std::uint64_t>(std::ldexp(std::frexp(q, &exp2), 64));
+        std::uint64_t low = bits & 0x7ff;
+        if (low < 0x3ff || low > 0x401)
+        {
+            double d = static_cast<double>(q);
+            value = negative ? -d : d;
+            return true;
+        }
+    }
+#endif
+    // strtod on a null terminated copy, long inputs are rare
+    char buf[64];
+    std::size_t size = static_cast<std::size_t>(itr - start);
+    if (size < sizeof(buf))
+    {
+        std::memcpy(buf, start, size);
+        buf[size] = '\0';
+        value = std::strtod(buf, nullptr);
+    }
+    else
+    {
+        std::string str(start, itr);
+        value = std::strtod(str.c_str(), nullptr);
+    }
+    return true;
+}
+
+}}}
+
+#endif //MAPNIK_GEOMETRY_PARSE_NUMBER_HPP
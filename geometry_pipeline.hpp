@@ -0,0 +1,194 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_PIPELINE_HPP
+#define MAPNIK_GEOMETRY_PIPELINE_HPP
+
+#include "geometry_impl.hpp"
+#include "geometry_clip.hpp"
+#include "geometry_transform.hpp"
+#include "geometry_simplify.hpp"
+#include "geometry_offset.hpp"
+
+#include <type_traits>
+
+namespace mapnik { namespace new_geometry {
+
+// Vertex pipelines composed at compile time :
+//
+//   auto p = clip_line_stage(box) | make_transform_stage(tr) | simplify_stage(s) | offset_stage(2.0);
+//   p.apply(va, proc); // calls proc.add_path(path), like mapnik::vertex_converter
+//
+// Every stage wraps its input in an adapter living on the stack of apply(),
+// the chain type is fully known so vertex() calls inline into the processor
+// loop, with no virtual dispatch. clip_line_stage and transform_stage
+// stream vertex by vertex. simplify_stage and offset_stage read a whole
+// path (SEG_MOVETO up to the next one) into a buffer before emitting it.
+// Paths keep their order either way. A stage is a pipeline of its own and
+// can be applied alone.
+
+namespace detail {
+
+struct stage_base {};
+
+template <typename Stage, typename Processor>
+struct next_stage
+{
+    next_stage(Stage const& stage, Processor & proc)
+        : stage_(stage),
+          proc_(proc) {}
+
+    template <typename VertexSource>
+    void add_path(VertexSource const& path) const
+    {
+        stage_.apply(path, proc_);
+    }
+
+    Stage const& stage_;
+    Processor & proc_;
+};
+
+template <typename Pipeline, typename Processor>
+struct pipeline_processor
+{
+    template <typename VertexSource>
+    void operator() (VertexSource const& va) const
+    {
+        pipeline_.apply(va, proc_);
+    }
+
+    Pipeline const& pipeline_;
+    Processor & proc_;
+};
+
+}
+
+template <typename First, typename Second>
+struct pipeline : detail::stage_base
+{
+    pipeline(First const& first, Second const& second)
+        : first_(first),
+          second_(second) {}
+
+    template <typename VertexSource, typename Processor>
+    void apply(VertexSource const& source, Processor & proc) const
+    {
+        detail::next_stage<Second, Processor> next(second_, proc);
+        first_.apply(source, next);
+    }
+
+    First first_;
+    Second second_;
+};
+
+template <typename First, typename Second>
+inline typename std::enable_if<std::is_base_of<detail::stage_base, First>::value &&
+                               std::is_base_of<detail::stage_base, Second>::value,
+                               pipeline<First, Second> >::type
+operator| (First const& first, Second const& second)
+{
+    return pipeline<First, Second>(first, second);
+}
+
+// runs `stages` over the vertex adapter of any new_geometry type
+template <typename Stages, typename Processor, typename Allocator>
+inline void apply_pipeline(Stages const& stages, basic_geometry<Allocator> const& geom, Processor & proc)
+{
+    detail::pipeline_processor<Stages, Processor> pipeline_proc{stages, proc};
+    mapnik::util::apply_visitor(vertex_processor<detail::pipeline_processor<Stages, Processor> >(pipeline_proc), geom);
+}
+
+// line_clip_adapter, lines only : polygon rings come out as open pieces
+struct clip_line_stage : detail::stage_base
+{
+    explicit clip_line_stage(bounding_box const& box)
+        : box_(box) {}
+
+    template <typename VertexSource, typename Processor>
+    void apply(VertexSource const& source, Processor & proc) const
+    {
+        line_clip_adapter<VertexSource> path(source, box_);
+        proc.add_path(path);
+    }
+
+    bounding_box box_;
+};
+
+template <typename Transform>
+struct transform_stage : detail::stage_base
+{
+    explicit transform_stage(Transform const& tr)
+        : tr_(tr) {}
+
+    template <typename VertexSource, typename Processor>
+    void apply(VertexSource const& source, Processor & proc) const
+    {
+        transform_adapter<VertexSource, Transform> path(source, tr_);
+        proc.add_path(path);
+    }
+
+    Transform tr_;
+};
+
+template <typename Transform>
+inline transform_stage<Transform> make_transform_stage(Transform const& tr)
+{
+    return transform_stage<Transform>(tr);
+}
+
+// `simplify` holds the scratch buffers, a pipeline using this stage
+// must not be applied by several threads at once
+struct simplify_stage : detail::stage_base
+{
+    explicit simplify_stage(simplifier & simplify)
+        : simplify_(simplify) {}
+
+    template <typename VertexSource, typename Processor>
+    void apply(VertexSource const& source, Processor & proc) const
+    {
+        simplify_adapter<VertexSource> path(source, simplify_);
+        proc.add_path(path);
+    }
+
+    simplifier & simplify_;
+};
+
+struct offset_stage : detail::stage_base
+{
+    explicit offset_stage(double distance, double miter_limit = 4.0)
+        : distance_(distance),
+          miter_limit_(miter_limit) {}
+
+    template <typename VertexSource, typename Processor>
+    void apply(VertexSource const& source, Processor & proc) const
+    {
+        offset_adapter<VertexSource> path(source, distance_, miter_limit_);
+        proc.add_path(path);
+    }
+
+    double distance_;
+    double miter_limit_;
+};
+
+}}
+
+#endif //MAPNIK_GEOMETRY_PIPELINE_HPP
@@ -0,0 +1,359 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_QUANTIZED_HPP
+#define MAPNIK_GEOMETRY_QUANTIZED_HPP
+
+#include "geometry_impl.hpp"
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+namespace mapnik { namespace new_geometry {
+
+// Fixed point grid : x = origin_x + qx * resolution (same for y). Encoding
+// rounds to the nearest grid node, error <= resolution / 2 per ordinate.
+// Grid coordinates are limited to +/- 2^62, see quantized_encoder.
+struct quantization
+{
+    quantization()
+        : origin_x(0), origin_y(0), resolution(1) {}
+    quantization(double origin_x_, double origin_y_, double resolution_)
+        : origin_x(origin_x_), origin_y(origin_y_), resolution(resolution_)
+    {
+        if (!std::isfinite(origin_x) || !std::isfinite(origin_y) || !(resolution > 0)
+            || !std::isfinite(resolution) || !std::isfinite(1.0 / resolution))
+        {
+            throw std::runtime_error("quantization: origin must be finite, resolution finite and > 0");
+        }
+    }
+    double origin_x;
+    double origin_y;
+    double resolution;
+};
+
+namespace detail {
+
+inline std::uint64_t zigzag_encode(std::int64_t value)
+{
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+inline std::int64_t zigzag_decode(std::uint64_t value)
+{
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+template <typename Bytes>
+inline void append_varint(Bytes & out, std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+// no bounds checks, buffers are produced by the encoder below
+inline std::uint64_t read_varint(std::uint8_t const*& itr)
+{
+    std::uint64_t value = *itr++;
+    if (value < 0x80) return value;
+    value &= 0x7f;
+    for (unsigned shift = 7; ; shift += 7)
+    {
+        std::uint64_t byte = *itr++;
+        value |= (byte & 0x7f) << shift;
+        if (byte < 0x80) return value;
+    }
+}
+
+// delta + zigzag varint stream of grid coordinates, the cursor carries
+// over from one ring (or line) to the next like in vector tiles. Grid
+// coordinates must lie strictly inside +/- 2^62 so a delta between any two
+// of them stays below 2^63 ; others, NaN and infinite ones throw.
+template <typename Allocator>
+struct quantized_encoder
+{
+    using bytes_type = std::vector<std::uint8_t, rebind_alloc<Allocator, std::uint8_t> >;
+
+    quantized_encoder(quantization const& q, bytes_type & bytes)
+        : q_(q), scale_(1.0 / q.resolution), bytes_(bytes), x_(0), y_(0) {}
+
+    // `count` varint then the points
+    template <typename Iterator>
+    void add(Iterator first, Iterator last, std::size_t count)
+    {
+        append_varint(bytes_, count);
+        for (; first != last; ++first)
+        {
+            point pt = *first;
+            std::int64_t x = to_grid((pt.x - q_.origin_x) * scale_);
+            std::int64_t y = to_grid((pt.y - q_.origin_y) * scale_);
+            append_varint(bytes_, zigzag_encode(x - x_));
+            append_varint(bytes_, zigzag_encode(y - y_));
+            x_ = x;
+            y_ = y;
+        }
+    }
+
+    static std::int64_t to_grid(double value)
+    {
+        // false for NaN too ; below 2^62 doubles are at most 2^62 - 512,
+        // which llround keeps exact
+        if (!(std::abs(value) < 4611686018427387904.0))
+        {
+            throw std::runtime_error("quantized geometry: coordinate outside the quantization grid");
+        }
+        return std::llround(value);
+    }
+
+    quantization const& q_;
+    double scale_;
+    bytes_type & bytes_;
+    std::int64_t x_;
+    std::int64_t y_;
+};
+
+} // namespace detail
+
+// Quantized counterparts of line_string and polygon : 2 to 4 bytes per point
+// for typical tile or projected data instead of 16. Read-only once built,
+// iterate with the vertex adapters below or decode() back to doubles.
+template <typename Allocator = std::allocator<point> >
+struct basic_quantized_line_string
+{
+    using allocator_type = Allocator;
+    using bytes_type = typename detail::quantized_encoder<Allocator>::bytes_type;
+
+    basic_quantized_line_string() = default;
+    explicit basic_quantized_line_string(quantization const& q_, Allocator const& alloc = Allocator())
+        : q(q_),
+          bytes(alloc) {}
+
+    template <typename LineAllocator>
+    basic_quantized_line_string(basic_line_string<LineAllocator> const& line, quantization const& q_,
+                                Allocator const& alloc = Allocator())
+        : q(q_),
+          bytes(alloc)
+    {
+        bytes.reserve(line.data.size() * 2 + 1);
+        detail::quantized_encoder<Allocator> encoder(q, bytes);
+        encoder.add(line.data.begin(), line.data.end(), line.data.size());
+        bytes.shrink_to_fit();
+    }
+
+    template <typename LineAllocator>
+    void decode(basic_line_string<LineAllocator> & line) const;
+
+    quantization q;
+    bytes_type bytes;
+};
+
+using quantized_line_string = basic_quantized_line_string<>;
+
+template <typename Allocator = std::allocator<point> >
+struct basic_quantized_polygon
+{
+    using allocator_type = Allocator;
+    using bytes_type = typename detail::quantized_encoder<Allocator>::bytes_type;
+
+    basic_quantized_polygon() = default;
+    explicit basic_quantized_polygon(quantization const& q_, Allocator const& alloc = Allocator())
+        : q(q_),
+          bytes(alloc) {}
+
+    // rings as stored (closed_ring), empty rings are dropped
+    template <typename PolygonAllocator>
+    basic_quantized_polygon(basic_polygon3<PolygonAllocator> const& poly, quantization const& q_,
+                            Allocator const& alloc = Allocator())
+        : q(q_),
+          bytes(alloc)
+    {
+        std::size_t num_points = poly.exterior_ring.size();
+        for (auto const& hole : poly.interior_rings) num_points += hole.size();
+        bytes.reserve(num_points * 2 + poly.interior_rings.size() + 1);
+        detail::quantized_encoder<Allocator> encoder(q, bytes);
+        add_ring(encoder, poly.exterior_ring.begin(), poly.exterior_ring.end());
+        for (auto const& hole : poly.interior_rings) add_ring(encoder, hole.begin(), hole.end());
+        bytes.shrink_to_fit();
+    }
+
+    template <typename PolygonAllocator>
+    basic_quantized_polygon(basic_polygon<PolygonAllocator> const& poly, quantization const& q_,
+                            Allocator const& alloc = Allocator())
+        : q(q_),
+          bytes(alloc)
+    {
+        bytes.reserve(poly.data.size() * 2 + poly.rings.size());
+        detail::quantized_encoder<Allocator> encoder(q, bytes);
+        for (auto const& r : poly.rings)
+        {
+            auto first = poly.data.begin() + std::get<0>(r);
+            add_ring(encoder, first, first + std::get<1>(r));
+        }
+        bytes.shrink_to_fit();
+    }
+
+    template <typename PolygonAllocator>
+    basic_quantized_polygon(basic_polygon2<PolygonAllocator> const& poly, quantization const& q_,
+                            Allocator const& alloc = Allocator())
+        : q(q_),
+          bytes(alloc)
+    {
+        std::size_t num_points = 0;
+        for (auto const& ring : poly.rings) num_points += ring.size();
+        bytes.reserve(num_points * 2 + poly.rings.size());
+        detail::quantized_encoder<Allocator> encoder(q, bytes);
+        for (auto const& ring : poly.rings) add_ring(encoder, ring.begin(), ring.end());
+        bytes.shrink_to_fit();
+    }
+
+    template <typename PolygonAllocator>
+    void decode(basic_polygon3<PolygonAllocator> & poly) const;
+
+    quantization q;
+    bytes_type bytes;
+    std::uint32_t num_rings = 0;
+
+private:
+    template <typename Iterator>
+    void add_ring(detail::quantized_encoder<Allocator> & encoder, Iterator first, Iterator last)
+    {
+        if (first == last) return;
+        encoder.add(first, last, static_cast<std::size_t>(last - first));
+        ++num_rings;
+    }
+};
+
+using quantized_polygon = basic_quantized_polygon<>;
+
+// Streams a quantized line_string (closed = false) or polygon (closed = true)
+// back as doubles with the same commands as the line_string and polygon
+// adapters : SEG_MOVETO, SEG_LINETO ... and SEG_CLOSE on the last point of
+// every ring of more than one point.
+struct quantized_vertex_decoder
+{
+    quantized_vertex_decoder(quantization const& q, std::uint8_t const* first, std::uint8_t const* last, bool closed)
+        : q_(q),
+          first_(first),
+          last_(last),
+          closed_(closed)
+    {
+        rewind(0);
+    }
+
+    void rewind(unsigned) const
+    {
+        itr_ = first_;
+        x_ = 0;
+        y_ = 0;
+        index_ = 0;
+        count_ = 0;
+    }
+
+    unsigned vertex(double*x, double*y) const
+    {
+        while (index_ == count_)
+        {
+            if (itr_ == last_) return mapnik::SEG_END;
+            count_ = detail::read_varint(itr_);
+            index_ = 0;
+        }
+        x_ += detail::zigzag_decode(detail::read_varint(itr_));
+        y_ += detail::zigzag_decode(detail::read_varint(itr_));
+        *x = q_.origin_x + static_cast<double>(x_) * q_.resolution;
+        *y = q_.origin_y + static_cast<double>(y_) * q_.resolution;
+        if (index_++ == 0) return mapnik::SEG_MOVETO;
+        if (closed_ && index_ == count_) return mapnik::SEG_CLOSE;
+        return mapnik::SEG_LINETO;
+    }
+
+private:
+    quantization q_;
+    std::uint8_t const* first_;
+    std::uint8_t const* last_;
+    bool closed_;
+    mutable std::uint8_t const* itr_;
+    mutable std::int64_t x_;
+    mutable std::int64_t y_;
+    mutable std::uint64_t index_;
+    mutable std::uint64_t count_;
+};
+
+template <typename Allocator>
+struct basic_quantized_line_string_vertex_adapter : quantized_vertex_decoder
+{
+    basic_quantized_line_string_vertex_adapter(basic_quantized_line_string<Allocator> const& line)
+        : quantized_vertex_decoder(line.q, line.bytes.data(), line.bytes.data() + line.bytes.size(), false) {}
+};
+
+using quantized_line_string_vertex_adapter = basic_quantized_line_string_vertex_adapter<std::allocator<point> >;
+
+template <typename Allocator>
+struct basic_quantized_polygon_vertex_adapter : quantized_vertex_decoder
+{
+    basic_quantized_polygon_vertex_adapter(basic_quantized_polygon<Allocator> const& poly)
+        : quantized_vertex_decoder(poly.q, poly.bytes.data(), poly.bytes.data() + poly.bytes.size(), true) {}
+};
+
+using quantized_polygon_vertex_adapter = basic_quantized_polygon_vertex_adapter<std::allocator<point> >;
+
+template <typename Allocator>
+template <typename LineAllocator>
+void basic_quantized_line_string<Allocator>::decode(basic_line_string<LineAllocator> & line) const
+{
+    basic_quantized_line_string_vertex_adapter<Allocator> va(*this);
+    double x, y;
+    while (va.vertex(&x, &y) != mapnik::SEG_END) line.data.emplace_back(x, y);
+}
+
+template <typename Allocator>
+template <typename PolygonAllocator>
+void basic_quantized_polygon<Allocator>::decode(basic_polygon3<PolygonAllocator> & poly) const
+{
+    using ring_type = typename basic_polygon3<PolygonAllocator>::ring_type;
+    basic_quantized_polygon_vertex_adapter<Allocator> va(*this);
+    ring_type ring(poly.exterior_ring.get_allocator());
+    bool exterior = true;
+    double x, y;
+    for (;;)
+    {
+        unsigned cmd = va.vertex(&x, &y);
+        if ((cmd == mapnik::SEG_MOVETO || cmd == mapnik::SEG_END) && !ring.empty())
+        {
+            if (exterior) poly.set_exterior_ring(std::move(ring));
+            else poly.add_hole(std::move(ring));
+            exterior = false;
+            ring = ring_type(poly.exterior_ring.get_allocator());
+        }
+        if (cmd == mapnik::SEG_END) break;
+        ring.emplace_back(x, y);
+    }
+}
+
+}}
+
+#endif //MAPNIK_GEOMETRY_QUANTIZED_HPP
@@ -0,0 +1,616 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_SIMPLIFY_HPP
+#define MAPNIK_GEOMETRY_SIMPLIFY_HPP
+
+#include "geometry_impl.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+namespace mapnik { namespace new_geometry {
+
+namespace detail {
+
+template <typename Ring>
+inline point ring_point(Ring const& ring, std::size_t index)
+{
+    point pt;
+    ring.get(index, &pt.x, &pt.y);
+    return pt;
+}
+
+// squared distance from `p` to the segment a-b
+inline double segment_distance2(point const& p, point const& a, point const& b)
+{
+    double dx = b.x - a.x;
+    double dy = b.y - a.y;
+    double len2 = dx * dx + dy * dy;
+    double t = 0.0;
+    if (len2 > 0.0)
+    {
+        t = ((p.x - a.x) * dx + (p.y - a.y) * dy) / len2;
+        t = std::max(0.0, std::min(1.0, t));
+    }
+    double ex = a.x + t * dx - p.x;
+    double ey = a.y + t * dy - p.y;
+    return ex * ex + ey * ey;
+}
+
+inline double triangle_area(point const& a, point const& b, point const& c)
+{
+    return std::abs((b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y)) * 0.5;
+}
+
+// index of the vertex in (first, last) farthest from segment first-last,
+// the first one on ties, and its squared distance (-1 when the range is empty)
+template <typename Ring>
+inline std::size_t farthest_vertex(Ring const& ring, std::size_t first, std::size_t last, double & distance2)
+{
+    point a = ring_point(ring, first);
+    point b = ring_point(ring, last);
+    std::size_t index = first;
+    distance2 = -1.0;
+    for (std::size_t i = first + 1; i < last; ++i)
+    {
+        double d2 = segment_distance2(ring_point(ring, i), a, b);
+        if (d2 > distance2)
+        {
+            distance2 = d2;
+            index = i;
+        }
+    }
+    return index;
+}
+
+}
+
+enum simplify_algorithm : std::uint8_t
+{
+    douglas_peucker, // drop vertices closer than tolerance to the simplified path
+    visvalingam      // drop vertices whose triangle area is below tolerance^2
+};
+
+// Vertex selection for lines and rings. select() marks the vertices of one
+// path to keep (see keep()), end points are always kept. Closed rings
+// (last point == first) are split at the vertex farthest from the first one.
+// With `preserve_rings` a ring keeps at least 4 points (3 distinct), without
+// it a ring simplified below that collapses and select() returns 0 so the
+// caller drops it (a collapsed exterior ring drops the whole polygon).
+//
+// Douglas-Peucker runs on an explicit stack, Visvalingam on an indexed
+// binary heap updated in place. All scratch memory is kept and reused
+// between paths, keep one simplifier per thread. The in place overloads
+// compact every layout without reallocating.
+class simplifier
+{
+public:
+    explicit simplifier(double tolerance, simplify_algorithm algorithm = douglas_peucker, bool preserve_rings = true)
+        : tolerance2_(tolerance * tolerance),
+          algorithm_(algorithm),
+          preserve_rings_(preserve_rings) {}
+
+    // Ring : aos_ring or soa_ring
+    template <typename Ring>
+    std::size_t select(Ring const& ring, bool closed)
+    {
+        std::size_t size = ring.size();
+        keep_.assign(size, 1);
+        if (size <= (closed ? 4u : 2u)) return size;
+        std::size_t count = (algorithm_ == douglas_peucker) ? select_douglas_peucker(ring, closed)
+                                                            : select_visvalingam(ring, closed);
+        if (closed && count < 4 && !preserve_rings_) return 0;
+        return count;
+    }
+
+    bool keep(std::size_t index) const
+    {
+        return keep_[index] != 0;
+    }
+
+    template <typename Allocator>
+    void operator() (basic_line_string<Allocator> & line)
+    {
+        point * pts = line.data.data();
+        select(aos_ring{pts, pts + line.data.size()}, false);
+        line.data.resize(compact(pts, pts, line.data.size()));
+    }
+
+    void operator() (line_string_soa & line)
+    {
+        select(soa_ring{line.x.data(), line.y.data(), line.size()}, false);
+        line.resize(compact(line.x.data(), line.y.data(), line.x.data(), line.y.data(), line.size()));
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon<Allocator> & poly)
+    {
+        point * data = poly.data.data();
+        std::size_t size = 0;
+        std::size_t num_rings = 0;
+        for (std::size_t i = 0; i < poly.rings.size(); ++i)
+        {
+            std::size_t start = std::get<0>(poly.rings[i]);
+            std::size_t count = std::get<1>(poly.rings[i]);
+            if (select(aos_ring{data + start, data + start + count}, true) == 0)
+            {
+                if (i == 0) break;
+                continue;
+            }
+            std::size_t kept = compact(data + start, data + size, count);
+            poly.rings[num_rings++] = std::make_tuple(static_cast<std::uint32_t>(size), static_cast<std::uint32_t>(kept));
+            size += kept;
+        }
+        poly.rings.resize(num_rings);
+        poly.data.resize(size);
+    }
+
+    void operator() (polygon_soa & poly)
+    {
+        std::size_t size = 0;
+        std::size_t num_rings = 0;
+        for (std::size_t i = 0; i < poly.rings.size(); ++i)
+        {
+            std::size_t start = std::get<0>(poly.rings[i]);
+            std::size_t count = std::get<1>(poly.rings[i]);
+            double * x = poly.x.data();
+            double * y = poly.y.data();
+            if (select(soa_ring{x + start, y + start, count}, true) == 0)
+            {
+                if (i == 0) break;
+                continue;
+            }
+            std::size_t kept = compact(x + start, y + start, x + size, y + size, count);
+            poly.rings[num_rings++] = std::make_tuple(static_cast<std::uint32_t>(size), static_cast<std::uint32_t>(kept));
+            size += kept;
+        }
+        poly.rings.resize(num_rings);
+        poly.x.resize(size);
+        poly.y.resize(size);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon2<Allocator> & poly)
+    {
+        std::size_t num_rings = 0;
+        for (std::size_t i = 0; i < poly.rings.size(); ++i)
+        {
+            if (!simplify_ring(poly.rings[i]))
+            {
+                if (i == 0) break;
+                continue;
+            }
+            if (num_rings != i) poly.rings[num_rings] = std::move(poly.rings[i]);
+            ++num_rings;
+        }
+        poly.rings.erase(poly.rings.begin() + static_cast<std::ptrdiff_t>(num_rings), poly.rings.end());
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon3<Allocator> & poly)
+    {
+        simplify_polygon(poly);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_multi_line_string<Allocator> & multi_line)
+    {
+        for (auto & line : multi_line)
+        {
+            (*this)(line);
+        }
+    }
+
+    template <typename Allocator>
+    void operator() (basic_multi_polygon<Allocator> & multi_poly)
+    {
+        std::size_t num_parts = 0;
+        for (std::size_t i = 0; i < multi_poly.size(); ++i)
+        {
+            if (!simplify_polygon(multi_poly[i])) continue;
+            if (num_parts != i) multi_poly[num_parts] = std::move(multi_poly[i]);
+            ++num_parts;
+        }
+        multi_poly.erase(multi_poly.begin() + static_cast<std::ptrdiff_t>(num_parts), multi_poly.end());
+    }
+
+    // rebuilt, so that the part views of the result are updated
+    template <typename Allocator>
+    void operator() (basic_flat_multi_polygon<Allocator> & multi_poly)
+    {
+        basic_flat_multi_polygon<Allocator> result(multi_poly.data.get_allocator());
+        result.reserve(multi_poly.data.size(), multi_poly.rings.size(), multi_poly.parts.size());
+        for (auto const& part : multi_poly.parts)
+        {
+            for (std::size_t i = 0; i < std::get<1>(part); ++i)
+            {
+                auto r = multi_poly.ring(std::get<0>(part) + i);
+                if (select(aos_ring{r.first, r.second}, true) == 0)
+                {
+                    if (i == 0) break;
+                    continue;
+                }
+                if (i == 0) result.begin_part();
+                ring_.resize(static_cast<std::size_t>(r.second - r.first));
+                ring_.resize(compact(r.first, ring_.data(), ring_.size()));
+                result.add_ring(ring_.begin(), ring_.end());
+            }
+        }
+        multi_poly = std::move(result);
+    }
+
+    void operator() (point &) {}
+
+    template <typename Allocator>
+    void operator() (basic_multi_point<Allocator> &) {}
+
+    template <typename Allocator>
+    void operator() (basic_geometry_collection<Allocator> & collection)
+    {
+        for (auto & geom : collection)
+        {
+            mapnik::util::apply_visitor(*this, geom);
+        }
+    }
+
+    template <typename Allocator>
+    void operator() (basic_geometry<Allocator> & geom)
+    {
+        mapnik::util::apply_visitor(*this, geom);
+    }
+
+private:
+    struct range
+    {
+        std::uint32_t first;
+        std::uint32_t last;
+    };
+
+    template <typename Ring>
+    std::size_t select_douglas_peucker(Ring const& ring, bool closed)
+    {
+        std::size_t size = ring.size();
+        std::fill(keep_.begin() + 1, keep_.end() - 1, 0);
+        std::size_t count = 2;
+        stack_.clear();
+        std::size_t forced = 0;
+        if (closed)
+        {
+            // split at the vertex farthest from the first one
+            point first = detail::ring_point(ring, 0);
+            std::size_t split = 1;
+            double max_distance2 = -1.0;
+            for (std::size_t i = 1; i < size - 1; ++i)
+            {
+                point pt = detail::ring_point(ring, i);
+                double d2 = (pt.x - first.x) * (pt.x - first.x) + (pt.y - first.y) * (pt.y - first.y);
+                if (d2 > max_distance2)
+                {
+                    max_distance2 = d2;
+                    split = i;
+                }
+            }
+            keep_[split] = 1;
+            ++count;
+            // kept when the ring would collapse : the farther of the two halves' top vertices
+            double d0, d1;
+            std::size_t v0 = detail::farthest_vertex(ring, 0, split, d0);
+            std::size_t v1 = detail::farthest_vertex(ring, split, size - 1, d1);
+            forced = (d0 >= d1) ? v0 : v1;
+            stack_.push_back(range{0, static_cast<std::uint32_t>(split)});
+            stack_.push_back(range{static_cast<std::uint32_t>(split), static_cast<std::uint32_t>(size - 1)});
+        }
+        else
+        {
+            stack_.push_back(range{0, static_cast<std::uint32_t>(size - 1)});
+        }
+        while (!stack_.empty())
+        {
+            range r = stack_.back();
+            stack_.pop_back();
+            if (r.last - r.first < 2) continue;
+            double d2;
+            std::size_t index = detail::farthest_vertex(ring, r.first, r.last, d2);
+            if (d2 <= tolerance2_) continue;
+            keep_[index] = 1;
+            ++count;
+            stack_.push_back(range{r.first, static_cast<std::uint32_t>(index)});
+            stack_.push_back(range{static_cast<std::uint32_t>(index), r.last});
+        }
+        if (closed && count < 4 && preserve_rings_)
+        {
+            keep_[forced] = 1;
+            ++count;
+        }
+        return count;
+    }
+
+    template <typename Ring>
+    std::size_t select_visvalingam(Ring const& ring, bool closed)
+    {
+        std::size_t size = ring.size();
+        prev_.resize(size);
+        next_.resize(size);
+        area_.resize(size);
+        position_.resize(size);
+        heap_.clear();
+        for (std::size_t i = 1; i < size - 1; ++i)
+        {
+            prev_[i] = static_cast<std::uint32_t>(i - 1);
+            next_[i] = static_cast<std::uint32_t>(i + 1);
+            area_[i] = detail::triangle_area(detail::ring_point(ring, i - 1), detail::ring_point(ring, i),
+                                             detail::ring_point(ring, i + 1));
+            position_[i] = static_cast<std::uint32_t>(heap_.size());
+            heap_.push_back(static_cast<std::uint32_t>(i));
+        }
+        for (std::size_t i = heap_.size() / 2; i-- > 0; )
+        {
+            sift_down(i);
+        }
+        std::size_t count = size;
+        std::size_t min_count = closed ? (preserve_rings_ ? 4 : 3) : 2;
+        while (!heap_.empty() && count > min_count)
+        {
+            std::uint32_t index = heap_.front();
+            if (area_[index] >= tolerance2_) break;
+            heap_.front() = heap_.back();
+            position_[heap_.front()] = 0;
+            heap_.pop_back();
+            if (!heap_.empty()) sift_down(0);
+            keep_[index] = 0;
+            --count;
+            std::uint32_t p = prev_[index];
+            std::uint32_t n = next_[index];
+            next_[p] = n;
+            prev_[n] = p;
+            update(ring, p, size);
+            update(ring, n, size);
+        }
+        return count;
+    }
+
+    // new area of a vertex whose neighbour was removed
+    template <typename Ring>
+    void update(Ring const& ring, std::uint32_t index, std::size_t size)
+    {
+        if (index == 0 || index == size - 1) return;
+        double area = detail::triangle_area(detail::ring_point(ring, prev_[index]), detail::ring_point(ring, index),
+                                            detail::ring_point(ring, next_[index]));
+        bool smaller = area < area_[index];
+        area_[index] = area;
+        if (smaller) sift_up(position_[index]);
+        else sift_down(position_[index]);
+    }
+
+    // binary min-heap of vertex indices on area_, position_ maps back
+    void sift_up(std::size_t pos)
+    {
+        std::uint32_t index = heap_[pos];
+        while (pos > 0)
+        {
+            std::size_t parent = (pos - 1) / 2;
+            if (area_[heap_[parent]] <= area_[index]) break;
+            heap_[pos] = heap_[parent];
+            position_[heap_[pos]] = static_cast<std::uint32_t>(pos);
+            pos = parent;
+        }
+        heap_[pos] = index;
+        position_[index] = static_cast<std::uint32_t>(pos);
+    }
+
+    void sift_down(std::size_t pos)
+    {
+        std::uint32_t index = heap_[pos];
+        std::size_t size = heap_.size();
+        for (;;)
+        {
+            std::size_t child = 2 * pos + 1;
+            if (child >= size) break;
+            if (child + 1 < size && area_[heap_[child + 1]] < area_[heap_[child]]) ++child;
+            if (area_[index] <= area_[heap_[child]]) break;
+            heap_[pos] = heap_[child];
+            position_[heap_[pos]] = static_cast<std::uint32_t>(pos);
+            pos = child;
+        }
+        heap_[pos] = index;
+        position_[index] = static_cast<std::uint32_t>(pos);
+    }
+
+    // moves the kept points of `in` to `out` (out <= in), returns their number
+    std::size_t compact(point const* in, point * out, std::size_t size) const
+    {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            if (keep_[i]) out[count++] = in[i];
+        }
+        return count;
+    }
+
+    std::size_t compact(double const* in_x, double const* in_y, double * out_x, double * out_y, std::size_t size) const
+    {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            if (!keep_[i]) continue;
+            out_x[count] = in_x[i];
+            out_y[count] = in_y[i];
+            ++count;
+        }
+        return count;
+    }
+
+    template <typename RingType>
+    bool simplify_ring(RingType & ring)
+    {
+        point * pts = ring.data();
+        if (select(aos_ring{pts, pts + ring.size()}, true) == 0) return false;
+        ring.resize(compact(pts, pts, ring.size()));
+        return true;
+    }
+
+    // false when the exterior ring collapsed, the polygon is then empty
+    template <typename Allocator>
+    bool simplify_polygon(basic_polygon3<Allocator> & poly)
+    {
+        if (!simplify_ring(poly.exterior_ring))
+        {
+            poly.exterior_ring.clear();
+            poly.interior_rings.clear();
+            return false;
+        }
+        std::size_t num_holes = 0;
+        for (std::size_t i = 0; i < poly.interior_rings.size(); ++i)
+        {
+            if (!simplify_ring(poly.interior_rings[i])) continue;
+            if (num_holes != i) poly.interior_rings[num_holes] = std::move(poly.interior_rings[i]);
+            ++num_holes;
+        }
+        poly.interior_rings.erase(poly.interior_rings.begin() + static_cast<std::ptrdiff_t>(num_holes),
+                                  poly.interior_rings.end());
+        return true;
+    }
+
+    double tolerance2_;
+    simplify_algorithm algorithm_;
+    bool preserve_rings_;
+    std::vector<std::uint8_t> keep_;
+    std::vector<range> stack_;
+    std::vector<std::uint32_t> prev_;
+    std::vector<std::uint32_t> next_;
+    std::vector<double> area_;
+    std::vector<std::uint32_t> heap_;
+    std::vector<std::uint32_t> position_;
+    std::vector<point> ring_;
+};
+
+// Simplifies the paths of any vertex source on the fly : each path
+// (SEG_MOVETO up to the next one) is buffered, run through `simplify`
+// and replayed with its original commands. A collapsed ring (see
+// simplifier) is skipped. `simplify` may be shared by successive adapters.
+template <typename VertexSource>
+struct simplify_adapter
+{
+    simplify_adapter(VertexSource const& source, simplifier & simplify)
+        : source_(source),
+          simplify_(simplify),
+          index_(0),
+          pending_(false),
+          done_(false) {}
+
+    unsigned vertex(double*x, double*y) const
+    {
+        for (;;)
+        {
+            if (index_ < path_.size())
+            {
+                *x = path_[index_].x;
+                *y = path_[index_].y;
+                return commands_[index_++];
+            }
+            if (done_) return mapnik::SEG_END;
+            read_path();
+        }
+    }
+
+    void rewind(unsigned path_id) const
+    {
+        source_.rewind(path_id);
+        path_.clear();
+        commands_.clear();
+        index_ = 0;
+        pending_ = false;
+        done_ = false;
+    }
+
+private:
+    void read_path() const
+    {
+        path_.clear();
+        commands_.clear();
+        index_ = 0;
+        if (pending_)
+        {
+            path_.push_back(pending_point_);
+            commands_.push_back(mapnik::SEG_MOVETO);
+            pending_ = false;
+        }
+        for (;;)
+        {
+            point pt;
+            unsigned cmd = source_.vertex(&pt.x, &pt.y);
+            if (cmd == mapnik::SEG_END)
+            {
+                done_ = true;
+                break;
+            }
+            if (cmd == mapnik::SEG_MOVETO && !path_.empty())
+            {
+                pending_point_ = pt;
+                pending_ = true;
+                break;
+            }
+            path_.push_back(pt);
+            commands_.push_back(cmd);
+        }
+        if (path_.size() < 3) return;
+        bool closed = commands_.back() == mapnik::SEG_CLOSE;
+        if (simplify_.select(aos_ring{path_.data(), path_.data() + path_.size()}, closed) == 0)
+        {
+            path_.clear();
+            commands_.clear();
+            return;
+        }
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < path_.size(); ++i)
+        {
+            if (!simplify_.keep(i)) continue;
+            path_[count] = path_[i];
+            commands_[count] = commands_[i];
+            ++count;
+        }
+        path_.resize(count);
+        commands_.resize(count);
+    }
+
+    VertexSource const& source_;
+    simplifier & simplify_;
+    mutable std::vector<point> path_;
+    mutable std::vector<unsigned> commands_;
+    mutable std::size_t index_;
+    mutable point pending_point_;
+    mutable bool pending_;
+    mutable bool done_;
+};
+
+template <typename VertexSource>
+inline simplify_adapter<VertexSource> make_simplify_adapter(VertexSource const& source, simplifier & simplify)
+{
+    return simplify_adapter<VertexSource>(source, simplify);
+}
+
+}}
+
+#endif //MAPNIK_GEOMETRY_SIMPLIFY_HPP
@@ -0,0 +1,684 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_STORE_HPP
+#define MAPNIK_GEOMETRY_STORE_HPP
+
+#include "geometry_impl.hpp"
+#include "geometry_envelope.hpp"
+#include "geometry_mapped_file.hpp"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <ostream>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+namespace mapnik { namespace new_geometry {
+
+// Binary container for new_geometry, read back through mmap without parsing
+// or copying. All sections are native endian and 16-byte aligned :
+//
+//   store_header
+//   store_record[num_features]      type + ranges into the tables below
+//   bounding_box[num_features]      per feature envelope
+//   uint32 pairs[num_parts]         (first ring, num rings) per polygon part
+//   uint32 pairs[num_rings]         (start, count) per ring / line
+//   point[num_vertices]             every vertex, feature after feature
+//
+// Part and ring entries are relative to their feature (first ring / first
+// vertex) so a stored polygon is byte for byte the `data` and `rings` buffers
+// of `polygon`, and a stored multi-polygon those of `flat_multi_polygon`.
+
+enum store_geometry_type : std::uint32_t
+{
+    store_point = 1,
+    store_line_string = 2,
+    store_polygon = 3,
+    store_multi_point = 4,
+    store_multi_line_string = 5,
+    store_multi_polygon = 6
+};
+
+static const std::uint32_t store_version = 1;
+static const std::uint32_t store_byte_order_mark = 0x01020304;
+
+struct store_header
+{
+    char magic[8];           // "MNKGEOM" + '\0'
+    std::uint32_t version;
+    std::uint32_t byte_order; // store_byte_order_mark as written
+    std::uint64_t num_features;
+    std::uint64_t num_parts;
+    std::uint64_t num_rings;
+    std::uint64_t num_vertices;
+    std::uint64_t records_offset;
+    std::uint64_t envelopes_offset;
+    std::uint64_t parts_offset;
+    std::uint64_t rings_offset;
+    std::uint64_t vertices_offset;
+    std::uint64_t file_size;
+};
+
+struct store_record
+{
+    std::uint32_t type;
+    std::uint32_t num_parts;
+    std::uint32_t num_rings;
+    std::uint32_t num_vertices;
+    std::uint64_t first_part;
+    std::uint64_t first_ring;
+    std::uint64_t first_vertex;
+};
+
+static_assert(sizeof(point) == 2 * sizeof(double), "point must be two packed doubles");
+static_assert(sizeof(bounding_box) == 4 * sizeof(double), "bounding_box must be four packed doubles");
+static_assert(std::is_standard_layout<store_header>::value && sizeof(store_header) % 16 == 0, "store_header layout");
+static_assert(std::is_standard_layout<store_record>::value && sizeof(store_record) == 40, "store_record layout");
+
+// Read-only contiguous range
+template <typename T>
+struct array_view
+{
+    array_view()
+        : first_(nullptr), size_(0) {}
+    array_view(T const* first, std::size_t size)
+        : first_(first), size_(size) {}
+    T const* data() const { return first_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    T const* begin() const { return first_; }
+    T const* end() const { return first_ + size_; }
+    T const& operator[](std::size_t index) const { return first_[index]; }
+private:
+    T const* first_;
+    std::size_t size_;
+};
+
+// (start, count) table stored as uint32 pairs, entries read back as the
+// in-memory index tuple
+struct index_table_view
+{
+    using index_type = std::tuple<std::uint32_t, std::uint32_t>;
+    index_table_view()
+        : first_(nullptr), size_(0) {}
+    index_table_view(std::uint32_t const* first, std::size_t size)
+        : first_(first), size_(size) {}
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    index_type operator[](std::size_t index) const
+    {
+        return index_type(first_[2 * index], first_[2 * index + 1]);
+    }
+private:
+    std::uint32_t const* first_;
+    std::size_t size_;
+};
+
+// One feature of a geometry_store. `data` and `rings` follow the naming of
+// `polygon` so table_ring_source (and the polygon code built on it) works on
+// stored polygons and multi-polygons as is. Multi line strings keep their
+// lines in `rings`.
+struct stored_geometry
+{
+    store_geometry_type type;
+    array_view<point> data;
+    index_table_view rings;
+    index_table_view parts;
+};
+
+// Memory mapped geometry_store file. Opening checks the header and section
+// bounds only (constant time), call valid() once to check every record of
+// an untrusted file.
+class geometry_store
+{
+public:
+    explicit geometry_store(std::string const& filename)
+        : file_(filename),
+          header_(nullptr)
+    {
+        if (!file_.is_open() || file_.size() < sizeof(store_header)) return;
+        store_header const* header = reinterpret_cast<store_header const*>(file_.data());
+        if (std::memcmp(header->magic, "MNKGEOM", 8) != 0
+            || header->version != store_version
+            || header->byte_order != store_byte_order_mark
+            || header->file_size != file_.size()
+            || !section(header->records_offset, header->num_features, sizeof(store_record))
+            || !section(header->envelopes_offset, header->num_features, sizeof(bounding_box))
+            || !section(header->parts_offset, header->num_parts, 2 * sizeof(std::uint32_t))
+            || !section(header->rings_offset, header->num_rings, 2 * sizeof(std::uint32_t))
+            || !section(header->vertices_offset, header->num_vertices, sizeof(point))) return;
+        header_ = header;
+    }
+
+    bool is_open() const { return header_ != nullptr; }
+
+    std::size_t size() const
+    {
+        return (header_ != nullptr) ? static_cast<std::size_t>(header_->num_features) : 0;
+    }
+
+    stored_geometry operator[](std::size_t index) const
+    {
+        store_record const& r = records()[index];
+        stored_geometry geom;
+        geom.type = static_cast<store_geometry_type>(r.type);
+        geom.data = array_view<point>(vertices() + r.first_vertex, r.num_vertices);
+        geom.rings = index_table_view(rings() + 2 * r.first_ring, r.num_rings);
+        geom.parts = index_table_view(parts() + 2 * r.first_part, r.num_parts);
+        return geom;
+    }
+
+    bounding_box const& envelope(std::size_t index) const
+    {
+        return envelopes()[index];
+    }
+
+    // all envelopes, e.g. to bulk load a spatial index
+    array_view<bounding_box> envelopes_view() const
+    {
+        return array_view<bounding_box>(envelopes(), size());
+    }
+
+    // every record, part and ring within bounds
+    bool valid() const
+    {
+        if (header_ == nullptr) return false;
+        for (std::size_t i = 0; i < size(); ++i)
+        {
+            store_record const& r = records()[i];
+            if (r.type < store_point || r.type > store_multi_polygon
+                || r.first_vertex > header_->num_vertices || header_->num_vertices - r.first_vertex < r.num_vertices
+                || r.first_ring > header_->num_rings || header_->num_rings - r.first_ring < r.num_rings
+                || r.first_part > header_->num_parts || header_->num_parts - r.first_part < r.num_parts
+                || (r.type == store_point && r.num_vertices != 1)) return false;
+            stored_geometry geom = (*this)[i];
+            for (std::size_t j = 0; j < geom.rings.size(); ++j)
+            {
+                auto ring = geom.rings[j];
+                if (std::get<0>(ring) > r.num_vertices || r.num_vertices - std::get<0>(ring) < std::get<1>(ring)) return false;
+            }
+            for (std::size_t j = 0; j < geom.parts.size(); ++j)
+            {
+                auto part = geom.parts[j];
+                if (std::get<0>(part) > r.num_rings || r.num_rings - std::get<0>(part) < std::get<1>(part)) return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    bool section(std::uint64_t offset, std::uint64_t count, std::size_t item_size) const
+    {
+        return offset % 16 == 0 && offset <= file_.size()
+            && (file_.size() - offset) / item_size >= count;
+    }
+
+    template <typename T>
+    T const* at(std::uint64_t offset) const
+    {
+        return reinterpret_cast<T const*>(file_.data() + offset);
+    }
+
+    store_record const* records() const { return at<store_record>(header_->records_offset); }
+    bounding_box const* envelopes() const { return at<bounding_box>(header_->envelopes_offset); }
+    std::uint32_t const* parts() const { return at<std::uint32_t>(header_->parts_offset); }
+    std::uint32_t const* rings() const { return at<std::uint32_t>(header_->rings_offset); }
+    point const* vertices() const { return at<point>(header_->vertices_offset); }
+
+    mapped_file file_;
+    store_header const* header_;
+};
+
+// Vertex adapter over a stored_geometry : same command streams as the
+// adapters of the in-memory types (polygons through the ring engine).
+// Keeps its own copy of the (small) view, so it can be built from store[i].
+template <typename Closure = closed_ring>
+struct basic_stored_geometry_vertex_adapter
+{
+    explicit basic_stored_geometry_vertex_adapter(stored_geometry const& geom)
+        : geom_(geom),
+          rings_(geom_),
+          line_index_(0),
+          start_index_(0),
+          current_index_(0),
+          end_index_(0) {}
+
+    // rings_ refers to geom_, a copy starts over at the first vertex
+    basic_stored_geometry_vertex_adapter(basic_stored_geometry_vertex_adapter const& other)
+        : basic_stored_geometry_vertex_adapter(other.geom_) {}
+
+    basic_stored_geometry_vertex_adapter & operator=(basic_stored_geometry_vertex_adapter const&) = delete;
+
+    void rewind(unsigned) const
+    {
+        rings_.rewind(0);
+        line_index_ = 0;
+        current_index_ = 0;
+        end_index_ = 0;
+    }
+
+    unsigned vertex(double*x, double*y) const
+    {
+        if (is_polygonal()) return rings_.vertex(x, y);
+        while (current_index_ == end_index_)
+        {
+            if (!next_line()) return mapnik::SEG_END;
+        }
+        point const& pt = geom_.data[current_index_];
+        *x = pt.x;
+        *y = pt.y;
+        return (current_index_++ == start_index_ || geom_.type == store_multi_point)
+            ? mapnik::SEG_MOVETO : mapnik::SEG_LINETO;
+    }
+
+    bool next_span(vertex_span & span) const
+    {
+        if (is_polygonal()) return rings_.next_span(span);
+        while (current_index_ == end_index_)
+        {
+            if (!next_line()) return false;
+        }
+        span.first = geom_.data.data() + current_index_;
+        // multi-point : one point per span, each one a SEG_MOVETO
+        current_index_ = (geom_.type == store_multi_point) ? current_index_ + 1 : end_index_;
+        span.last = geom_.data.data() + current_index_;
+        span.close = vertex_span::no_close;
+        return true;
+    }
+
+private:
+    bool is_polygonal() const
+    {
+        return geom_.type == store_polygon || geom_.type == store_multi_polygon;
+    }
+
+    // points and line strings are one run over `data`, multi line strings
+    // one run per `rings` entry
+    bool next_line() const
+    {
+        if (geom_.type == store_multi_line_string)
+        {
+            if (line_index_ == geom_.rings.size()) return false;
+            auto line = geom_.rings[line_index_++];
+            start_index_ = current_index_ = std::get<0>(line);
+            end_index_ = current_index_ + std::get<1>(line);
+            return true;
+        }
+        if (line_index_++ != 0) return false;
+        start_index_ = current_index_ = 0;
+        end_index_ = geom_.data.size();
+        return true;
+    }
+
+    stored_geometry geom_;
+    ring_vertex_adapter<table_ring_source<stored_geometry>, Closure> rings_;
+    mutable std::size_t line_index_;
+    mutable std::size_t start_index_;
+    mutable std::size_t current_index_;
+    mutable std::size_t end_index_;
+};
+
+using stored_geometry_vertex_adapter = basic_stored_geometry_vertex_adapter<>;
+
+// Copies a stored feature into new_geometry types. Polygons become `polygon`
+// (plain buffer copies), multi-polygons `multi_polygon`.
+template <typename Allocator>
+inline void to_geometry(stored_geometry const& stored, basic_geometry<Allocator> & geom,
+                        Allocator const& alloc = Allocator())
+{
+    switch (stored.type)
+    {
+    case store_point:
+        geom = stored.data[0];
+        break;
+    case store_line_string:
+    {
+        basic_line_string<Allocator> line(alloc);
+        line.data.assign(stored.data.begin(), stored.data.end());
+        geom = std::move(line);
+        break;
+    }
+    case store_polygon:
+    {
+        basic_polygon<Allocator> poly(alloc);
+        poly.data.assign(stored.data.begin(), stored.data.end());
+        poly.rings.reserve(stored.rings.size());
+        for (std::size_t i = 0; i < stored.rings.size(); ++i) poly.rings.push_back(stored.rings[i]);
+        geom = std::move(poly);
+        break;
+    }
+    case store_multi_point:
+    {
+        basic_multi_point<Allocator> multi_pt(alloc);
+        multi_pt.assign(stored.data.begin(), stored.data.end());
+        geom = std::move(multi_pt);
+        break;
+    }
+    case store_multi_line_string:
+    {
+        basic_multi_line_string<Allocator> multi_line(alloc);
+        multi_line.reserve(stored.rings.size());
+        for (std::size_t i = 0; i < stored.rings.size(); ++i)
+        {
+            auto line = stored.rings[i];
+            multi_line.emplace_back(alloc);
+            point const* first = stored.data.data() + std::get<0>(line);
+            multi_line.back().data.assign(first, first + std::get<1>(line));
+        }
+        geom = std::move(multi_line);
+        break;
+    }
+    case store_multi_polygon:
+    {
+        basic_multi_polygon<Allocator> multi_poly(alloc);
+        multi_poly.reserve(stored.parts.size());
+        for (std::size_t i = 0; i < stored.parts.size(); ++i)
+        {
+            auto part = stored.parts[i];
+            multi_poly.emplace_back(alloc);
+            for (std::uint32_t j = 0; j < std::get<1>(part); ++j)
+            {
+                auto ring = stored.rings[std::get<0>(part) + j];
+                point const* first = stored.data.data() + std::get<0>(ring);
+                typename basic_polygon3<Allocator>::ring_type points(first, first + std::get<1>(ring), alloc);
+                if (j == 0) multi_poly.back().set_exterior_ring(std::move(points));
+                else multi_poly.back().add_hole(std::move(points));
+            }
+        }
+        geom = std::move(multi_poly);
+        break;
+    }
+    }
+}
+
+// Builds a geometry_store in memory, then writes it in one go. Geometry
+// collections can't be stored, add() returns false for them.
+class geometry_store_writer
+{
+public:
+    template <typename Allocator>
+    bool add(basic_geometry<Allocator> const& geom)
+    {
+        return mapnik::util::apply_visitor(add_visitor(*this), geom);
+    }
+
+    template <typename Geometry>
+    bool add(Geometry const& geom)
+    {
+        return add_visitor(*this)(geom);
+    }
+
+    std::size_t size() const { return records_.size(); }
+
+    // false on I/O error
+    bool save(std::string const& filename) const
+    {
+        std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+        return write(file);
+    }
+
+    // streams the file image, sections are written straight from the buffers
+    bool write(std::ostream & out) const
+    {
+        store_header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "MNKGEOM", 8);
+        header.version = store_version;
+        header.byte_order = store_byte_order_mark;
+        header.num_features = records_.size();
+        header.num_parts = parts_.size() / 2;
+        header.num_rings = rings_.size() / 2;
+        header.num_vertices = vertices_.size();
+        std::size_t offset = sizeof(store_header);
+        header.records_offset = offset;
+        offset = align(offset + records_.size() * sizeof(store_record));
+        header.envelopes_offset = offset;
+        offset = align(offset + envelopes_.size() * sizeof(bounding_box));
+        header.parts_offset = offset;
+        offset = align(offset + parts_.size() * sizeof(std::uint32_t));
+        header.rings_offset = offset;
+        offset = align(offset + rings_.size() * sizeof(std::uint32_t));
+        header.vertices_offset = offset;
+        offset += vertices_.size() * sizeof(point);
+        header.file_size = offset;
+
+        write_section(out, &header, sizeof(header), header.records_offset);
+        write_section(out, records_.data(), records_.size() * sizeof(store_record), header.envelopes_offset - header.records_offset);
+        write_section(out, envelopes_.data(), envelopes_.size() * sizeof(bounding_box), header.parts_offset - header.envelopes_offset);
+        write_section(out, parts_.data(), parts_.size() * sizeof(std::uint32_t), header.rings_offset - header.parts_offset);
+        write_section(out, rings_.data(), rings_.size() * sizeof(std::uint32_t), header.vertices_offset - header.rings_offset);
+        write_section(out, vertices_.data(), vertices_.size() * sizeof(point), header.file_size - header.vertices_offset);
+        return static_cast<bool>(out);
+    }
+
+private:
+    static std::size_t align(std::size_t offset)
+    {
+        return (offset + 15) & ~std::size_t(15);
+    }
+
+    // `size` bytes then zero padding up to `section_size`
+    static void write_section(std::ostream & out, void const* data, std::size_t size, std::size_t section_size)
+    {
+        static const char padding[16] = {};
+        out.write(static_cast<char const*>(data), static_cast<std::streamsize>(size));
+        out.write(padding, static_cast<std::streamsize>(section_size - size));
+    }
+
+    // new record, parts/rings/vertices appended next belong to it
+    void begin(store_geometry_type type)
+    {
+        store_record r;
+        r.type = type;
+        r.num_parts = 0;
+        r.num_rings = 0;
+        r.num_vertices = 0;
+        r.first_part = parts_.size() / 2;
+        r.first_ring = rings_.size() / 2;
+        r.first_vertex = vertices_.size();
+        records_.push_back(r);
+    }
+
+    // vertex count of the current feature must fit the uint32 tables
+    bool end(bounding_box const& bbox)
+    {
+        store_record & r = records_.back();
+        std::size_t num_vertices = vertices_.size() - r.first_vertex;
+        if (num_vertices > std::numeric_limits<std::uint32_t>::max())
+        {
+            vertices_.resize(r.first_vertex);
+            rings_.resize(2 * r.first_ring);
+            parts_.resize(2 * r.first_part);
+            records_.pop_back();
+            return false;
+        }
+        r.num_vertices = static_cast<std::uint32_t>(num_vertices);
+        r.num_rings = static_cast<std::uint32_t>(rings_.size() / 2 - r.first_ring);
+        r.num_parts = static_cast<std::uint32_t>(parts_.size() / 2 - r.first_part);
+        envelopes_.push_back(bbox);
+        return true;
+    }
+
+    template <typename Iterator>
+    void add_points(Iterator first, Iterator last)
+    {
+        vertices_.insert(vertices_.end(), first, last);
+    }
+
+    // empty rings are dropped like polygon::add_ring, empty lines and
+    // exterior rings are kept (the first ring is always the exterior)
+    template <typename Iterator>
+    void add_ring(Iterator first, Iterator last, bool keep_empty = false)
+    {
+        std::size_t start = vertices_.size() - records_.back().first_vertex;
+        add_points(first, last);
+        std::size_t count = vertices_.size() - records_.back().first_vertex - start;
+        if (count == 0 && !keep_empty) return;
+        rings_.push_back(static_cast<std::uint32_t>(start));
+        rings_.push_back(static_cast<std::uint32_t>(count));
+    }
+
+    template <typename Allocator>
+    void add_part(basic_polygon3<Allocator> const& poly)
+    {
+        std::size_t first_ring = rings_.size() / 2 - records_.back().first_ring;
+        add_ring(poly.exterior_ring.begin(), poly.exterior_ring.end(), true);
+        for (auto const& hole : poly.interior_rings) add_ring(hole.begin(), hole.end());
+        parts_.push_back(static_cast<std::uint32_t>(first_ring));
+        parts_.push_back(static_cast<std::uint32_t>(rings_.size() / 2 - records_.back().first_ring - first_ring));
+    }
+
+    struct add_visitor
+    {
+        explicit add_visitor(geometry_store_writer & writer)
+            : w(writer) {}
+
+        bool operator() (point const& pt) const
+        {
+            w.begin(store_point);
+            w.vertices_.push_back(pt);
+            return w.end(envelope(pt));
+        }
+
+        template <typename Allocator>
+        bool operator() (basic_line_string<Allocator> const& line) const
+        {
+            w.begin(store_line_string);
+            w.add_points(line.data.begin(), line.data.end());
+            return w.end(envelope(line));
+        }
+
+        bool operator() (line_string_soa const& line) const
+        {
+            w.begin(store_line_string);
+            w.add_points(line.begin(), line.end());
+            return w.end(envelope(line));
+        }
+
+        template <typename Allocator>
+        bool operator() (basic_polygon<Allocator> const& poly) const
+        {
+            w.begin(store_polygon);
+            for (auto const& r : poly.rings)
+            {
+                point const* first = poly.data.data() + std::get<0>(r);
+                w.add_ring(first, first + std::get<1>(r));
+            }
+            return w.end(envelope(poly));
+        }
+
+        template <typename Allocator>
+        bool operator() (basic_polygon2<Allocator> const& poly) const
+        {
+            w.begin(store_polygon);
+            for (auto const& ring : poly.rings) w.add_ring(ring.begin(), ring.end());
+            return w.end(envelope(poly));
+        }
+
+        template <typename Allocator>
+        bool operator() (basic_polygon3<Allocator> const& poly) const
+        {
+            w.begin(store_polygon);
+            w.add_ring(poly.exterior_ring.begin(), poly.exterior_ring.end(), true);
+            for (auto const& hole : poly.interior_rings) w.add_ring(hole.begin(), hole.end());
+            return w.end(envelope(poly));
+        }
+
+        bool operator() (polygon_soa const& poly) const
+        {
+            w.begin(store_polygon);
+            for (auto const& r : poly.rings)
+            {
+                auto first = poly.begin() + std::get<0>(r);
+                w.add_ring(first, first + std::get<1>(r));
+            }
+            return w.end(envelope(poly));
+        }
+
+        template <typename Allocator>
+        bool operator() (basic_multi_point<Allocator> const& multi_pt) const
+        {
+            w.begin(store_multi_point);
+            w.add_points(multi_pt.begin(), multi_pt.end());
+            return w.end(envelope(multi_pt));
+        }
+
+        template <typename Allocator>
+        bool operator() (basic_multi_line_string<Allocator> const& multi_line) const
+        {
+            w.begin(store_multi_line_string);
+            for (auto const& line : multi_line) w.add_ring(line.data.begin(), line.data.end(), true);
+            return w.end(envelope(multi_line));
+        }
+
+        template <typename Allocator>
+        bool operator() (basic_multi_polygon<Allocator> const& multi_poly) const
+        {
+            w.begin(store_multi_polygon);
+            for (auto const& poly : multi_poly)
+            {
+                if (!poly.exterior_ring.empty()) w.add_part(poly);
+            }
+            return w.end(envelope(multi_poly));
+        }
+
+        template <typename Allocator>
+        bool operator() (basic_flat_multi_polygon<Allocator> const& multi_poly) const
+        {
+            w.begin(store_multi_polygon);
+            w.add_points(multi_poly.data.begin(), multi_poly.data.end());
+            for (auto const& r : multi_poly.rings)
+            {
+                w.rings_.push_back(std::get<0>(r));
+                w.rings_.push_back(std::get<1>(r));
+            }
+            for (auto const& p : multi_poly.parts)
+            {
+                w.parts_.push_back(std::get<0>(p));
+                w.parts_.push_back(std::get<1>(p));
+            }
+            return w.end(envelope(multi_poly));
+        }
+
+        template <typename Allocator>
+        bool operator() (basic_geometry_collection<Allocator> const&) const
+        {
+            return false;
+        }
+
+        geometry_store_writer & w;
+    };
+
+    std::vector<store_record> records_;
+    std::vector<bounding_box> envelopes_;
+    std::vector<std::uint32_t> parts_;
+    std::vector<std::uint32_t> rings_;
+    std::vector<point> vertices_;
+};
+
+}}
+
+#endif //MAPNIK_GEOMETRY_STORE_HPP
@@ -0,0 +1,389 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_TILE_CLIP_HPP
+#define MAPNIK_GEOMETRY_TILE_CLIP_HPP
+
+#include "geometry_impl.hpp"
+#include "geometry_envelope.hpp"
+#include "geometry_clip.hpp"
+#include "geometry_index.hpp"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <cstdint>
+
+namespace mapnik { namespace new_geometry {
+
+// 2^zoom x 2^zoom tiles over `extent`, tile (0, 0) in the top left corner
+// and y going down (XYZ scheme). Tile boxes grow by `buffer` times the tile
+// size on every side.
+struct tile_grid
+{
+    tile_grid(bounding_box const& extent_, unsigned zoom_, double buffer_ = 0.0)
+        : extent(extent_),
+          zoom(zoom_),
+          buffer(buffer_) {}
+
+    inline unsigned size() const
+    {
+        return 1u << zoom;
+    }
+
+    bounding_box tile_box(unsigned x, unsigned y) const
+    {
+        return quad_box(zoom, x, y);
+    }
+
+    // buffered box of quad (x, y) at `level` <= zoom, the union of its tiles.
+    // Edges are computed at tile resolution so that quads at every level
+    // share them exactly with their tiles.
+    bounding_box quad_box(unsigned level, unsigned x, unsigned y) const
+    {
+        unsigned shift = zoom - level;
+        double dx = buffer * (extent.p1.x - extent.p0.x) / size();
+        double dy = buffer * (extent.p1.y - extent.p0.y) / size();
+        return bounding_box(column(x << shift) - dx, row((y + 1) << shift) - dy,
+                            column((x + 1) << shift) + dx, row(y << shift) + dy);
+    }
+
+    bounding_box extent;
+    unsigned zoom;
+    double buffer;
+
+private:
+    double column(unsigned x) const
+    {
+        if (x == size()) return extent.p1.x;
+        return extent.p0.x + (extent.p1.x - extent.p0.x) * x / size();
+    }
+
+    double row(unsigned y) const
+    {
+        if (y == size()) return extent.p0.y;
+        return extent.p1.y - (extent.p1.y - extent.p0.y) * y / size();
+    }
+};
+
+struct clipped_tile
+{
+    clipped_tile(unsigned x_, unsigned y_)
+        : x(x_),
+          y(y_) {}
+
+    unsigned x;
+    unsigned y;
+    clip_buffer polygons;
+    std::vector<std::uint32_t> features; // source feature of every polygon
+};
+
+// Cuts a polygon layer into every tile of a zoom level at once. Quads are
+// split recursively : the parts clipped to a quad are the input of its four
+// children, so a vertex is clipped once per level (zoom times) instead of
+// once per tile, and a part fully inside a quad is copied down without
+// clipping. The quads of a level chosen to give a few tasks per thread are
+// processed concurrently, each worker keeping one buffer per level below.
+// Only polygonal parts are clipped, other feature types still take an index.
+class tile_clipper
+{
+public:
+    explicit tile_clipper(tile_grid const& grid,
+                          unsigned num_threads = std::thread::hardware_concurrency())
+        : grid_(grid),
+          num_threads_(std::max(num_threads, 1u)),
+          num_features_(0) {}
+
+    // adds `geom` (a geometry variant) as feature num_features()
+    template <typename Geometry>
+    void add(Geometry const& geom)
+    {
+        add_visitor visitor(*this);
+        mapnik::util::apply_visitor(visitor, geom);
+        ++num_features_;
+    }
+
+    std::size_t num_features() const
+    {
+        return num_features_;
+    }
+
+    // non empty tiles, ordered by y then x
+    void clip(std::vector<clipped_tile> & tiles) const
+    {
+        unsigned level = 0;
+        while (level < grid_.zoom && (std::size_t(1) << (2 * level)) < std::size_t(4) * num_threads_) ++level;
+        std::size_t num_tasks = std::size_t(1) << (2 * level);
+        packed_rtree index(layer_.envelopes.begin(), layer_.envelopes.end());
+
+        std::vector<task> tasks(num_tasks);
+        std::atomic<std::size_t> next(0);
+        auto worker = [this, level, &index, &tasks, &next]()
+        {
+            box_clipper clipper(grid_.extent);
+            std::vector<level_buffer> levels(grid_.zoom + 1);
+            std::vector<std::size_t> hits;
+            for (std::size_t i = next++; i < tasks.size(); i = next++)
+            {
+                try
+                {
+                    unsigned side = 1u << level;
+                    unsigned x = static_cast<unsigned>(i % side);
+                    unsigned y = static_cast<unsigned>(i / side);
+                    bounding_box box = grid_.quad_box(level, x, y);
+                    hits.clear();
+                    index.query(box, std::back_inserter(hits));
+                    std::sort(hits.begin(), hits.end());
+                    descend(layer_, hits, level, x, y, clipper, levels, tasks[i].tiles);
+                }
+                catch (...)
+                {
+                    tasks[i].exception = std::current_exception();
+                }
+            }
+        };
+        std::size_t num_workers = std::min(static_cast<std::size_t>(num_threads_), num_tasks);
+        std::vector<std::thread> threads;
+        for (std::size_t i = 1; i < num_workers; ++i)
+        {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto & t : threads) t.join();
+
+        std::size_t first = tiles.size();
+        for (auto & t : tasks)
+        {
+            if (t.exception) std::rethrow_exception(t.exception);
+            tiles.insert(tiles.end(),
+                         std::make_move_iterator(t.tiles.begin()),
+                         std::make_move_iterator(t.tiles.end()));
+        }
+        std::sort(tiles.begin() + static_cast<std::ptrdiff_t>(first), tiles.end(),
+                  [](clipped_tile const& a, clipped_tile const& b)
+                  {
+                      return a.y < b.y || (a.y == b.y && a.x < b.x);
+                  });
+    }
+
+private:
+    // parts with their source feature and envelope
+    struct level_buffer
+    {
+        void clear()
+        {
+            polygons.clear();
+            features.clear();
+            envelopes.clear();
+        }
+
+        void add_envelopes(std::size_t first)
+        {
+            for (std::size_t i = first; i < polygons.num_polygons(); ++i)
+            {
+                bounding_box box = empty_envelope();
+                auto r = polygons.ring(std::get<0>(polygons.polygons[i]));
+                detail::expand_points(box, r.first, static_cast<std::size_t>(r.second - r.first));
+                envelopes.push_back(box);
+            }
+        }
+
+        clip_buffer polygons;
+        std::vector<std::uint32_t> features;
+        std::vector<bounding_box> envelopes;
+    };
+
+    struct task
+    {
+        std::vector<clipped_tile> tiles;
+        std::exception_ptr exception;
+    };
+
+    struct add_visitor
+    {
+        explicit add_visitor(tile_clipper & clipper)
+            : clipper_(clipper) {}
+
+        template <typename Allocator>
+        void operator() (basic_polygon<Allocator> const& poly) const
+        {
+            level_buffer & layer = clipper_.layer_;
+            std::uint32_t first_ring = static_cast<std::uint32_t>(layer.polygons.rings.size());
+            for (std::size_t i = 0; i < poly.num_rings(); ++i)
+            {
+                auto r = poly.ring(i);
+                layer.polygons.append_ring(&*r.first, &*r.first + (r.second - r.first));
+            }
+            added(first_ring);
+        }
+
+        template <typename Allocator>
+        void operator() (basic_polygon2<Allocator> const& poly) const
+        {
+            level_buffer & layer = clipper_.layer_;
+            std::uint32_t first_ring = static_cast<std::uint32_t>(layer.polygons.rings.size());
+            for (auto const& ring : poly.rings)
+            {
+                layer.polygons.append_ring(ring);
+            }
+            added(first_ring);
+        }
+
+        template <typename Allocator>
+        void operator() (basic_polygon3<Allocator> const& poly) const
+        {
+            level_buffer & layer = clipper_.layer_;
+            std::uint32_t first_ring = static_cast<std::uint32_t>(layer.polygons.rings.size());
+            layer.polygons.append_ring(poly.exterior_ring);
+            for (auto const& hole : poly.interior_rings)
+            {
+                layer.polygons.append_ring(hole);
+            }
+            added(first_ring);
+        }
+
+        template <typename Allocator>
+        void operator() (basic_multi_polygon<Allocator> const& multi_poly) const
+        {
+            for (auto const& poly : multi_poly)
+            {
+                (*this)(poly);
+            }
+        }
+
+        template <typename Allocator>
+        void operator() (basic_geometry_collection<Allocator> const& collection) const
+        {
+            for (auto const& geom : collection)
+            {
+                mapnik::util::apply_visitor(*this, geom);
+            }
+        }
+
+        template <typename Geometry>
+        void operator() (cached_envelope<Geometry> const& geom) const
+        {
+            (*this)(geom.geometry());
+        }
+
+        template <typename T>
+        void operator() (T const&) const {}
+
+    private:
+        void added(std::uint32_t first_ring) const
+        {
+            level_buffer & layer = clipper_.layer_;
+            std::uint32_t num_rings = static_cast<std::uint32_t>(layer.polygons.rings.size()) - first_ring;
+            if (num_rings == 0) return;
+            if (std::get<1>(layer.polygons.rings[first_ring]) == 0)
+            {
+                // empty exterior ring, nothing to clip
+                layer.polygons.points.resize(std::get<0>(layer.polygons.rings[first_ring]));
+                layer.polygons.rings.resize(first_ring);
+                return;
+            }
+            std::size_t index = layer.polygons.num_polygons();
+            layer.polygons.polygons.emplace_back(first_ring, num_rings);
+            layer.features.push_back(static_cast<std::uint32_t>(clipper_.num_features_));
+            layer.add_envelopes(index);
+        }
+
+        tile_clipper & clipper_;
+    };
+
+    // clips the parts `candidates` of `in` to quad (x, y) at `level`, then
+    // emits the tile or splits the quad further
+    template <typename Candidates>
+    void descend(level_buffer const& in, Candidates const& candidates, unsigned level, unsigned x, unsigned y,
+                 box_clipper & clipper, std::vector<level_buffer> & levels, std::vector<clipped_tile> & tiles) const
+    {
+        bounding_box box = grid_.quad_box(level, x, y);
+        clipper.reset(box);
+        if (level == grid_.zoom)
+        {
+            clipped_tile tile(x, y);
+            for (std::size_t i : candidates)
+            {
+                if (!intersects(box, in.envelopes[i])) continue;
+                if (contains(box, in.envelopes[i])) tile.polygons.append(in.polygons, i);
+                else clipper(in.polygons, i, tile.polygons);
+                tile.features.resize(tile.polygons.num_polygons(), in.features[i]);
+            }
+            if (tile.polygons.num_polygons() > 0) tiles.push_back(std::move(tile));
+            return;
+        }
+        level_buffer & out = levels[level];
+        out.clear();
+        for (std::size_t i : candidates)
+        {
+            if (!intersects(box, in.envelopes[i])) continue;
+            if (contains(box, in.envelopes[i]))
+            {
+                out.polygons.append(in.polygons, i);
+                out.features.push_back(in.features[i]);
+                out.envelopes.push_back(in.envelopes[i]);
+                continue;
+            }
+            std::size_t first = out.polygons.num_polygons();
+            clipper(in.polygons, i, out.polygons);
+            out.features.resize(out.polygons.num_polygons(), in.features[i]);
+            out.add_envelopes(first);
+        }
+        if (out.polygons.num_polygons() == 0) return;
+        index_range all(out.polygons.num_polygons());
+        for (unsigned q = 0; q < 4; ++q)
+        {
+            descend(out, all, level + 1, 2 * x + (q & 1), 2 * y + (q >> 1), clipper, levels, tiles);
+        }
+    }
+
+    // 0 .. size-1 as a range, every part of a parent quad is a candidate
+    struct index_range
+    {
+        struct iterator
+        {
+            std::size_t value;
+            std::size_t operator*() const { return value; }
+            iterator & operator++() { ++value; return *this; }
+            bool operator!=(iterator const& other) const { return value != other.value; }
+        };
+
+        explicit index_range(std::size_t size)
+            : size_(size) {}
+
+        iterator begin() const { return iterator{0}; }
+        iterator end() const { return iterator{size_}; }
+
+        std::size_t size_;
+    };
+
+    tile_grid grid_;
+    unsigned num_threads_;
+    std::size_t num_features_;
+    level_buffer layer_;
+};
+
+}}
+
+#endif //MAPNIK_GEOMETRY_TILE_CLIP_HPP
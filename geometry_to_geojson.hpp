@@ -0,0 +1,409 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_TO_GEOJSON_HPP
+#define MAPNIK_GEOMETRY_TO_GEOJSON_HPP
+
+#include "geometry_impl.hpp"
+
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+#if defined(__has_include)
+#if __has_include(<charconv>) && __cplusplus >= 201703L
+#include <charconv>
+#endif
+#endif
+
+namespace mapnik { namespace new_geometry {
+
+namespace detail {
+
+inline char * write_uint(char * end, std::uint64_t value)
+{
+    do
+    {
+        *--end = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    while (value != 0);
+    return end;
+}
+
+// appends scaled / 10^decimals, trailing zeros of the fraction dropped
+inline void append_fixed(std::string & out, bool negative, std::uint64_t scaled, std::uint64_t scale, int decimals)
+{
+    char buf[40];
+    char * end = buf + sizeof(buf);
+    char * start = end;
+    std::uint64_t fraction = scaled % scale;
+    if (fraction != 0)
+    {
+        while (fraction % 10 == 0)
+        {
+            fraction /= 10;
+            --decimals;
+        }
+        start = write_uint(end, fraction);
+        while (end - start < decimals) *--start = '0';
+        *--start = '.';
+    }
+    start = write_uint(start, scaled / scale);
+    if (negative && scaled != 0) *--start = '-';
+    out.append(start, end);
+}
+
+// Appends `value` as a JSON number. precision >= 0 : fixed number of
+// decimals with trailing zeros dropped. Otherwise, or when the value is too
+// large for that, the shortest string that reads back to the same double
+// with std::to_chars where the standard library has it. Without it, fewest
+// decimals up to 15 and a single %.17g past that (round trips, not always
+// the shortest). Non finite values are written as null.
+inline void append_double(std::string & out, double value, int precision)
+{
+    static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+                                    1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+    static const double max_exact = 9007199254740992.0; // 2^53
+    if (!std::isfinite(value))
+    {
+        out.append("null", 4);
+        return;
+    }
+    double abs_value = std::abs(value);
+    if (precision >= 0 && precision <= 15 && abs_value * pow10[precision] < max_exact)
+    {
+        append_fixed(out, value < 0, static_cast<std::uint64_t>(std::round(abs_value * pow10[precision])),
+                     static_cast<std::uint64_t>(pow10[precision]), precision);
+        return;
+    }
+#if defined(__cpp_lib_to_chars)
+    // plain decimals unless that doesn't fit, then exponent notation
+    char chars[64];
+    std::to_chars_result result = std::to_chars(chars, chars + sizeof(chars), value, std::chars_format::fixed);
+    if (result.ec != std::errc()) result = std::to_chars(chars, chars + sizeof(chars), value);
+    out.append(chars, result.ptr);
+#else
+    // fewest decimals that read back exactly : integer arithmetic only,
+    // r / 10^d is correctly rounded like strtod would round "r e-d"
+    for (int decimals = 0; decimals <= 15; ++decimals)
+    {
+        double scaled = std::round(abs_value * pow10[decimals]);
+        if (scaled >= max_exact) break;
+        if (scaled / pow10[decimals] == abs_value)
+        {
+            append_fixed(out, value < 0, static_cast<std::uint64_t>(scaled),
+                         static_cast<std::uint64_t>(pow10[decimals]), decimals);
+            return;
+        }
+    }
+    // 16 or more significant digits, %.17g always reads back
+    char buf[40];
+    int size = std::snprintf(buf, sizeof(buf), "%.17g", value);
+    out.append(buf, static_cast<std::size_t>(size));
+#endif
+}
+
+}
+
+// Visitor writing new_geometry types as GeoJSON geometry objects straight
+// from their storage. Output is appended to `out`, clear() and reuse the
+// same string between calls to avoid reallocation. Closure says how polygon
+// rings are stored, open_ring rings get their first point repeated so the
+// output is always closed.
+template <typename Closure = closed_ring>
+struct basic_geojson_writer
+{
+    explicit basic_geojson_writer(std::string & out, int precision = -1)
+        : out_(out),
+          precision_(precision) {}
+
+    // POINT EMPTY (NaN, see geometry_from_wkt.hpp) has no position : []
+    void operator() (point const& pt) const
+    {
+        out_.append("{\"type\":\"Point\",\"coordinates\":");
+        if (std::isnan(pt.x)) out_.append("[]");
+        else coord(pt.x, pt.y);
+        out_ += '}';
+    }
+
+    template <typename Allocator>
+    void operator() (basic_line_string<Allocator> const& line) const
+    {
+        out_.append("{\"type\":\"LineString\",\"coordinates\":");
+        coords(line.data.data(), line.data.data() + line.data.size());
+        out_ += '}';
+    }
+
+    void operator() (line_string_soa const& line) const
+    {
+        out_.append("{\"type\":\"LineString\",\"coordinates\":");
+        coords(line.x.data(), line.y.data(), line.size());
+        out_ += '}';
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon<Allocator> const& poly) const
+    {
+        out_.append("{\"type\":\"Polygon\",\"coordinates\":");
+        table_rings(poly.data.data(), poly.rings.begin(), poly.rings.end());
+        out_ += '}';
+    }
+
+    void operator() (polygon_soa const& poly) const
+    {
+        out_.append("{\"type\":\"Polygon\",\"coordinates\":[");
+        bool first = true;
+        for (auto const& ring : poly.rings)
+        {
+            if (first && std::get<1>(ring) == 0) break;
+            if (!first) out_ += ',';
+            first = false;
+            ring_coords(poly.x.data() + std::get<0>(ring), poly.y.data() + std::get<0>(ring), std::get<1>(ring));
+        }
+        out_.append("]}");
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon2<Allocator> const& poly) const
+    {
+        out_.append("{\"type\":\"Polygon\",\"coordinates\":[");
+        bool first = true;
+        for (auto const& ring : poly.rings)
+        {
+            if (first && ring.empty()) break;
+            if (!first) out_ += ',';
+            first = false;
+            ring_coords(ring.data(), ring.data() + ring.size());
+        }
+        out_.append("]}");
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon3<Allocator> const& poly) const
+    {
+        out_.append("{\"type\":\"Polygon\",\"coordinates\":");
+        polygon_coords(poly);
+        out_ += '}';
+    }
+
+    // empty (NaN) members are left out, as the vertex adapters skip them
+    template <typename Allocator>
+    void operator() (basic_multi_point<Allocator> const& multi_pt) const
+    {
+        out_.append("{\"type\":\"MultiPoint\",\"coordinates\":[");
+        bool first = true;
+        for (auto const& pt : multi_pt)
+        {
+            if (std::isnan(pt.x)) continue;
+            if (!first) out_ += ',';
+            first = false;
+            coord(pt.x, pt.y);
+        }
+        out_.append("]}");
+    }
+
+    template <typename Allocator>
+    void operator() (basic_multi_line_string<Allocator> const& multi_line) const
+    {
+        out_.append("{\"type\":\"MultiLineString\",\"coordinates\":[");
+        bool first = true;
+        for (auto const& line : multi_line)
+        {
+            if (!first) out_ += ',';
+            first = false;
+            coords(line.data.data(), line.data.data() + line.data.size());
+        }
+        out_.append("]}");
+    }
+
+    template <typename Allocator>
+    void operator() (basic_multi_polygon<Allocator> const& multi_poly) const
+    {
+        out_.append("{\"type\":\"MultiPolygon\",\"coordinates\":[");
+        bool first = true;
+        for (auto const& poly : multi_poly)
+        {
+            if (!first) out_ += ',';
+            first = false;
+            polygon_coords(poly);
+        }
+        out_.append("]}");
+    }
+
+    template <typename Allocator>
+    void operator() (basic_flat_multi_polygon<Allocator> const& multi_poly) const
+    {
+        out_.append("{\"type\":\"MultiPolygon\",\"coordinates\":[");
+        bool first = true;
+        for (auto const& part : multi_poly.parts)
+        {
+            if (!first) out_ += ',';
+            first = false;
+            auto rings_begin = multi_poly.rings.begin() + std::get<0>(part);
+            table_rings(multi_poly.data.data(), rings_begin, rings_begin + std::get<1>(part));
+        }
+        out_.append("]}");
+    }
+
+    template <typename Allocator>
+    void operator() (basic_geometry_collection<Allocator> const& collection) const
+    {
+        out_.append("{\"type\":\"GeometryCollection\",\"geometries\":[");
+        bool first = true;
+        for (auto const& geom : collection)
+        {
+            if (!first) out_ += ',';
+            first = false;
+            mapnik::util::apply_visitor(*this, geom);
+        }
+        out_.append("]}");
+    }
+
+private:
+    void coord(double x, double y) const
+    {
+        out_ += '[';
+        detail::append_double(out_, x, precision_);
+        out_ += ',';
+        detail::append_double(out_, y, precision_);
+        out_ += ']';
+    }
+
+    void coords(point const* first, point const* last) const
+    {
+        out_ += '[';
+        for (point const* itr = first; itr != last; ++itr)
+        {
+            if (itr != first) out_ += ',';
+            coord(itr->x, itr->y);
+        }
+        out_ += ']';
+    }
+
+    void coords(double const* x, double const* y, std::size_t size) const
+    {
+        out_ += '[';
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            if (i != 0) out_ += ',';
+            coord(x[i], y[i]);
+        }
+        out_ += ']';
+    }
+
+    // rings as stored, plus the closing point for open_ring
+    void ring_coords(point const* first, point const* last) const
+    {
+        std::size_t size = static_cast<std::size_t>(last - first);
+        if (Closure::num_vertices(size) == size)
+        {
+            coords(first, last);
+            return;
+        }
+        out_ += '[';
+        for (point const* itr = first; itr != last; ++itr)
+        {
+            coord(itr->x, itr->y);
+            out_ += ',';
+        }
+        coord(first->x, first->y);
+        out_ += ']';
+    }
+
+    void ring_coords(double const* x, double const* y, std::size_t size) const
+    {
+        if (Closure::num_vertices(size) == size)
+        {
+            coords(x, y, size);
+            return;
+        }
+        out_ += '[';
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            coord(x[i], y[i]);
+            out_ += ',';
+        }
+        coord(x[0], y[0]);
+        out_ += ']';
+    }
+
+    // an empty exterior ring is an empty polygon : [] rather than [[]]
+    template <typename Iterator>
+    void table_rings(point const* data, Iterator first, Iterator last) const
+    {
+        out_ += '[';
+        if (first != last && std::get<1>(*first) == 0) last = first;
+        for (Iterator itr = first; itr != last; ++itr)
+        {
+            if (itr != first) out_ += ',';
+            point const* ring = data + std::get<0>(*itr);
+            ring_coords(ring, ring + std::get<1>(*itr));
+        }
+        out_ += ']';
+    }
+
+    template <typename Allocator>
+    void polygon_coords(basic_polygon3<Allocator> const& poly) const
+    {
+        if (poly.exterior_ring.empty())
+        {
+            out_.append("[]");
+            return;
+        }
+        out_ += '[';
+        ring_coords(poly.exterior_ring.data(), poly.exterior_ring.data() + poly.exterior_ring.size());
+        for (auto const& ring : poly.interior_rings)
+        {
+            out_ += ',';
+            ring_coords(ring.data(), ring.data() + ring.size());
+        }
+        out_ += ']';
+    }
+
+    std::string & out_;
+    int precision_;
+};
+
+using geojson_writer = basic_geojson_writer<>;
+
+// appends the GeoJSON representation of `geom` to `json`,
+// to_geojson<open_ring>(json, geom) for rings stored without closing point
+template <typename Closure = closed_ring, typename Geometry>
+inline void to_geojson(std::string & json, Geometry const& geom, int precision = -1)
+{
+    basic_geojson_writer<Closure> writer(json, precision);
+    writer(geom);
+}
+
+template <typename Closure = closed_ring, typename Allocator>
+inline void to_geojson(std::string & json, basic_geometry<Allocator> const& geom, int precision = -1)
+{
+    basic_geojson_writer<Closure> writer(json, precision);
+    mapnik::util::apply_visitor(writer, geom);
+}
+
+}}
+
+#endif //MAPNIK_GEOMETRY_TO_GEOJSON_HPP
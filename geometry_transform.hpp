@@ -0,0 +1,606 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_TRANSFORM_HPP
+#define MAPNIK_GEOMETRY_TRANSFORM_HPP
+
+#include "geometry_impl.hpp"
+#include "geometry_envelope.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+
+// affine kernels : AVX (2 points / 4 ordinates per step), SSE2 (1 point /
+// 2 ordinates) or scalar, selected at compile time from the target flags.
+// Same operation order in every path, so results are bit identical across
+// paths as long as the compiler doesn't contract a*x + b*y + c into FMA
+// (GCC does by default with -mfma, the Makefile passes -ffp-contract=off).
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MAPNIK_GEOMETRY_TRANSFORM_AVX
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MAPNIK_GEOMETRY_TRANSFORM_SSE2
+#endif
+
+namespace mapnik { namespace new_geometry {
+
+// x' = sx * x + shx * y + tx
+// y' = shy * x + sy * y + ty  (agg::trans_affine layout)
+struct affine_transform
+{
+    affine_transform()
+        : sx(1.0), shy(0.0), shx(0.0), sy(1.0), tx(0.0), ty(0.0) {}
+
+    affine_transform(double sx_, double shy_, double shx_, double sy_, double tx_, double ty_)
+        : sx(sx_), shy(shy_), shx(shx_), sy(sy_), tx(tx_), ty(ty_) {}
+
+    static affine_transform scaling(double scale_x, double scale_y)
+    {
+        return affine_transform(scale_x, 0.0, 0.0, scale_y, 0.0, 0.0);
+    }
+
+    static affine_transform translation(double dx, double dy)
+    {
+        return affine_transform(1.0, 0.0, 0.0, 1.0, dx, dy);
+    }
+
+    // `extent` to a width x height pixel grid, y going down (view_transform)
+    static affine_transform screen(bounding_box const& extent, double width, double height)
+    {
+        double scale_x = width / (extent.p1.x - extent.p0.x);
+        double scale_y = height / (extent.p1.y - extent.p0.y);
+        return affine_transform(scale_x, 0.0, 0.0, -scale_y, -extent.p0.x * scale_x, extent.p1.y * scale_y);
+    }
+
+    // this transform followed by `other`
+    affine_transform & operator*= (affine_transform const& other)
+    {
+        double t0 = sx * other.sx + shy * other.shx;
+        double t2 = shx * other.sx + sy * other.shx;
+        double t4 = tx * other.sx + ty * other.shx + other.tx;
+        shy = sx * other.shy + shy * other.sy;
+        sy = shx * other.shy + sy * other.sy;
+        ty = tx * other.shy + ty * other.sy + other.ty;
+        sx = t0;
+        shx = t2;
+        tx = t4;
+        return *this;
+    }
+
+    // identity when the matrix is singular
+    affine_transform inverse() const
+    {
+        double det = sx * sy - shy * shx;
+        if (det == 0.0) return affine_transform();
+        double d = 1.0 / det;
+        return affine_transform(sy * d, -shy * d, -shx * d, sx * d,
+                                (shx * ty - sy * tx) * d, (shy * tx - sx * ty) * d);
+    }
+
+    void operator() (double & x, double & y) const
+    {
+        double x0 = x;
+        x = sx * x0 + shx * y + tx;
+        y = shy * x0 + sy * y + ty;
+    }
+
+    // `in` and `out` may be the same buffer
+    void apply(point const* in, point * out, std::size_t size) const
+    {
+        std::size_t i = 0;
+#if defined(MAPNIK_GEOMETRY_TRANSFORM_AVX)
+        __m256d a = _mm256_setr_pd(sx, shy, sx, shy);
+        __m256d b = _mm256_setr_pd(shx, sy, shx, sy);
+        __m256d t = _mm256_setr_pd(tx, ty, tx, ty);
+        for (; i + 2 <= size; i += 2)
+        {
+            __m256d v = _mm256_loadu_pd(&in[i].x);
+            __m256d xx = _mm256_permute_pd(v, 0x0);
+            __m256d yy = _mm256_permute_pd(v, 0xf);
+            __m256d r = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(xx, a), _mm256_mul_pd(yy, b)), t);
+            _mm256_storeu_pd(&out[i].x, r);
+        }
+#elif defined(MAPNIK_GEOMETRY_TRANSFORM_SSE2)
+        __m128d a = _mm_setr_pd(sx, shy);
+        __m128d b = _mm_setr_pd(shx, sy);
+        __m128d t = _mm_setr_pd(tx, ty);
+        for (; i < size; ++i)
+        {
+            __m128d v = _mm_loadu_pd(&in[i].x);
+            __m128d xx = _mm_unpacklo_pd(v, v);
+            __m128d yy = _mm_unpackhi_pd(v, v);
+            __m128d r = _mm_add_pd(_mm_add_pd(_mm_mul_pd(xx, a), _mm_mul_pd(yy, b)), t);
+            _mm_storeu_pd(&out[i].x, r);
+        }
+#endif
+        for (; i < size; ++i)
+        {
+            double x = in[i].x;
+            double y = in[i].y;
+            out[i].x = sx * x + shx * y + tx;
+            out[i].y = shy * x + sy * y + ty;
+        }
+    }
+
+    // separate ordinate arrays (soa storage)
+    void apply(double const* in_x, double const* in_y, double * out_x, double * out_y, std::size_t size) const
+    {
+        std::size_t i = 0;
+#if defined(MAPNIK_GEOMETRY_TRANSFORM_AVX)
+        __m256d vsx = _mm256_set1_pd(sx);
+        __m256d vshy = _mm256_set1_pd(shy);
+        __m256d vshx = _mm256_set1_pd(shx);
+        __m256d vsy = _mm256_set1_pd(sy);
+        __m256d vtx = _mm256_set1_pd(tx);
+        __m256d vty = _mm256_set1_pd(ty);
+        for (; i + 4 <= size; i += 4)
+        {
+            __m256d x = _mm256_loadu_pd(in_x + i);
+            __m256d y = _mm256_loadu_pd(in_y + i);
+            _mm256_storeu_pd(out_x + i, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(vsx, x), _mm256_mul_pd(vshx, y)), vtx));
+            _mm256_storeu_pd(out_y + i, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(vshy, x), _mm256_mul_pd(vsy, y)), vty));
+        }
+#elif defined(MAPNIK_GEOMETRY_TRANSFORM_SSE2)
+        __m128d vsx = _mm_set1_pd(sx);
+        __m128d vshy = _mm_set1_pd(shy);
+        __m128d vshx = _mm_set1_pd(shx);
+        __m128d vsy = _mm_set1_pd(sy);
+        __m128d vtx = _mm_set1_pd(tx);
+        __m128d vty = _mm_set1_pd(ty);
+        for (; i + 2 <= size; i += 2)
+        {
+            __m128d x = _mm_loadu_pd(in_x + i);
+            __m128d y = _mm_loadu_pd(in_y + i);
+            _mm_storeu_pd(out_x + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(vsx, x), _mm_mul_pd(vshx, y)), vtx));
+            _mm_storeu_pd(out_y + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(vshy, x), _mm_mul_pd(vsy, y)), vty));
+        }
+#endif
+        for (; i < size; ++i)
+        {
+            double x = in_x[i];
+            double y = in_y[i];
+            out_x[i] = sx * x + shx * y + tx;
+            out_y[i] = shy * x + sy * y + ty;
+        }
+    }
+
+    double sx, shy, shx, sy, tx, ty;
+};
+
+namespace detail {
+
+static const double pi = 3.14159265358979323846;
+static const double mercator_max_extent = 20037508.342789244;
+static const double mercator_max_latitude = 85.0511287798066;
+
+}
+
+// WGS84 longitude/latitude to Web Mercator metres, clamped to the valid
+// range like mapnik::lonlat2merc. Longitudes are scaled in their own loop,
+// which the compiler vectorizes, latitudes go through libm.
+struct web_mercator_forward
+{
+    void operator() (double & x, double & y) const
+    {
+        x = std::max(-180.0, std::min(180.0, x)) * (detail::mercator_max_extent / 180.0);
+        y = latitude(y);
+    }
+
+    void apply(point const* in, point * out, std::size_t size) const
+    {
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            out[i].x = std::max(-180.0, std::min(180.0, in[i].x)) * (detail::mercator_max_extent / 180.0);
+        }
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            out[i].y = latitude(in[i].y);
+        }
+    }
+
+    void apply(double const* in_x, double const* in_y, double * out_x, double * out_y, std::size_t size) const
+    {
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            out_x[i] = std::max(-180.0, std::min(180.0, in_x[i])) * (detail::mercator_max_extent / 180.0);
+        }
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            out_y[i] = latitude(in_y[i]);
+        }
+    }
+
+private:
+    static double latitude(double y)
+    {
+        y = std::max(-detail::mercator_max_latitude, std::min(detail::mercator_max_latitude, y));
+        return std::log(std::tan((90.0 + y) * (detail::pi / 360.0))) * (180.0 / detail::pi) * (detail::mercator_max_extent / 180.0);
+    }
+};
+
+// Web Mercator metres to WGS84 longitude/latitude (mapnik::merc2lonlat)
+struct web_mercator_inverse
+{
+    void operator() (double & x, double & y) const
+    {
+        x = longitude(x);
+        y = latitude(y);
+    }
+
+    void apply(point const* in, point * out, std::size_t size) const
+    {
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            out[i].x = longitude(in[i].x);
+        }
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            out[i].y = latitude(in[i].y);
+        }
+    }
+
+    void apply(double const* in_x, double const* in_y, double * out_x, double * out_y, std::size_t size) const
+    {
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            out_x[i] = longitude(in_x[i]);
+        }
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            out_y[i] = latitude(in_y[i]);
+        }
+    }
+
+private:
+    static double longitude(double x)
+    {
+        return std::max(-180.0, std::min(180.0, x / detail::mercator_max_extent * 180.0));
+    }
+
+    static double latitude(double y)
+    {
+        double lat = (180.0 / detail::pi) * (2.0 * std::atan(std::exp(y / detail::mercator_max_extent * detail::pi)) - detail::pi / 2.0);
+        return std::max(-detail::mercator_max_latitude, std::min(detail::mercator_max_latitude, lat));
+    }
+};
+
+namespace detail {
+
+template <typename Transform>
+struct transform_visitor
+{
+    explicit transform_visitor(Transform const& tr)
+        : tr_(tr) {}
+
+    void operator() (point & pt) const
+    {
+        tr_(pt.x, pt.y);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_line_string<Allocator> & line) const
+    {
+        apply(line.data);
+    }
+
+    void operator() (line_string_soa & line) const
+    {
+        tr_.apply(line.x.data(), line.y.data(), line.x.data(), line.y.data(), line.size());
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon<Allocator> & poly) const
+    {
+        apply(poly.data);
+    }
+
+    void operator() (polygon_soa & poly) const
+    {
+        tr_.apply(poly.x.data(), poly.y.data(), poly.x.data(), poly.y.data(), poly.size());
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon2<Allocator> & poly) const
+    {
+        for (auto & ring : poly.rings) apply(ring);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon3<Allocator> & poly) const
+    {
+        apply(poly.exterior_ring);
+        for (auto & hole : poly.interior_rings) apply(hole);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_multi_point<Allocator> & multi_pt) const
+    {
+        apply(multi_pt);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_multi_line_string<Allocator> & multi_line) const
+    {
+        for (auto & line : multi_line) apply(line.data);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_multi_polygon<Allocator> & multi_poly) const
+    {
+        for (auto & poly : multi_poly) (*this)(poly);
+    }
+
+    // in place, the part views stay valid
+    template <typename Allocator>
+    void operator() (basic_flat_multi_polygon<Allocator> & multi_poly) const
+    {
+        apply(multi_poly.data);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_geometry_collection<Allocator> & collection) const
+    {
+        for (auto & geom : collection) mapnik::util::apply_visitor(*this, geom);
+    }
+
+    template <typename Points>
+    void apply(Points & pts) const
+    {
+        tr_.apply(pts.data(), pts.data(), pts.size());
+    }
+
+    Transform const& tr_;
+};
+
+// `dst` takes the layout of `src` (reusing its buffers) and the transformed
+// coordinates, in a single pass over `src`
+template <typename Transform>
+struct transform_copy
+{
+    explicit transform_copy(Transform const& tr)
+        : tr_(tr) {}
+
+    void operator() (point const& src, point & dst) const
+    {
+        dst = src;
+        tr_(dst.x, dst.y);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_line_string<Allocator> const& src, basic_line_string<Allocator> & dst) const
+    {
+        apply(src.data, dst.data);
+    }
+
+    void operator() (line_string_soa const& src, line_string_soa & dst) const
+    {
+        dst.resize(src.size());
+        tr_.apply(src.x.data(), src.y.data(), dst.x.data(), dst.y.data(), src.size());
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon<Allocator> const& src, basic_polygon<Allocator> & dst) const
+    {
+        dst.rings = src.rings;
+        apply(src.data, dst.data);
+    }
+
+    void operator() (polygon_soa const& src, polygon_soa & dst) const
+    {
+        dst.rings = src.rings;
+        dst.x.resize(src.size());
+        dst.y.resize(src.size());
+        tr_.apply(src.x.data(), src.y.data(), dst.x.data(), dst.y.data(), src.size());
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon2<Allocator> const& src, basic_polygon2<Allocator> & dst) const
+    {
+        resize(dst.rings, src.rings.size());
+        for (std::size_t i = 0; i < src.rings.size(); ++i) apply(src.rings[i], dst.rings[i]);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon3<Allocator> const& src, basic_polygon3<Allocator> & dst) const
+    {
+        apply(src.exterior_ring, dst.exterior_ring);
+        resize(dst.interior_rings, src.interior_rings.size());
+        for (std::size_t i = 0; i < src.interior_rings.size(); ++i) apply(src.interior_rings[i], dst.interior_rings[i]);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_multi_point<Allocator> const& src, basic_multi_point<Allocator> & dst) const
+    {
+        apply(src, dst);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_multi_line_string<Allocator> const& src, basic_multi_line_string<Allocator> & dst) const
+    {
+        resize(dst, src.size());
+        for (std::size_t i = 0; i < src.size(); ++i) apply(src[i].data, dst[i].data);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_multi_polygon<Allocator> const& src, basic_multi_polygon<Allocator> & dst) const
+    {
+        resize(dst, src.size());
+        for (std::size_t i = 0; i < src.size(); ++i) (*this)(src[i], dst[i]);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_flat_multi_polygon<Allocator> const& src, basic_flat_multi_polygon<Allocator> & dst) const
+    {
+        dst.rings = src.rings;
+        dst.parts = src.parts;
+        apply(src.data, dst.data);
+        dst.update_views();
+    }
+
+    template <typename Allocator>
+    void operator() (basic_geometry_collection<Allocator> const& src, basic_geometry_collection<Allocator> & dst) const
+    {
+        resize(dst, src.size());
+        Allocator alloc(dst.get_allocator());
+        for (std::size_t i = 0; i < src.size(); ++i) (*this)(src[i], dst[i], alloc);
+    }
+
+    // `alloc` builds the new geometry when `dst` holds another type
+    template <typename Allocator>
+    void operator() (basic_geometry<Allocator> const& src, basic_geometry<Allocator> & dst,
+                     Allocator const& alloc = Allocator()) const
+    {
+        variant_copy<Allocator> visitor(*this, dst, alloc);
+        mapnik::util::apply_visitor(visitor, src);
+    }
+
+private:
+    template <typename Allocator>
+    struct variant_copy
+    {
+        variant_copy(transform_copy const& copy, basic_geometry<Allocator> & dst, Allocator const& alloc)
+            : copy_(copy), dst_(dst), alloc_(alloc) {}
+
+        template <typename Geometry>
+        void operator() (Geometry const& src) const
+        {
+            if (!dst_.template is<Geometry>()) dst_ = make<Geometry>();
+            copy_(src, dst_.template get<Geometry>());
+        }
+
+        template <typename Geometry>
+        typename std::enable_if<std::is_constructible<Geometry, Allocator const&>::value, Geometry>::type make() const
+        {
+            return Geometry(alloc_);
+        }
+
+        // point and the SoA layouts
+        template <typename Geometry>
+        typename std::enable_if<!std::is_constructible<Geometry, Allocator const&>::value, Geometry>::type make() const
+        {
+            return Geometry();
+        }
+
+        transform_copy const& copy_;
+        basic_geometry<Allocator> & dst_;
+        Allocator const& alloc_;
+    };
+
+    template <typename Points>
+    void apply(Points const& src, Points & dst) const
+    {
+        dst.resize(src.size());
+        tr_.apply(src.data(), dst.data(), src.size());
+    }
+
+    // keeps the allocations of the elements that stay
+    template <typename Container>
+    static void resize(Container & cont, std::size_t size)
+    {
+        if (cont.size() > size) cont.erase(cont.begin() + static_cast<std::ptrdiff_t>(size), cont.end());
+        while (cont.size() < size) cont.emplace_back(cont.get_allocator());
+    }
+
+    // new elements are points, the first type of the variant
+    template <typename Allocator>
+    static void resize(basic_geometry_collection<Allocator> & cont, std::size_t size)
+    {
+        if (cont.size() > size) cont.erase(cont.begin() + static_cast<std::ptrdiff_t>(size), cont.end());
+        while (cont.size() < size) cont.emplace_back();
+    }
+
+    Transform const& tr_;
+};
+
+}
+
+// Bulk coordinate transforms over new_geometry vertex buffers. Transform is
+// affine_transform, web_mercator_forward, web_mercator_inverse or any type
+// with apply(point const*, point*, size), apply(x, y, out_x, out_y, size)
+// and operator()(double&, double&). Rings tables are left untouched.
+template <typename Geometry, typename Transform>
+inline void transform(Geometry & geom, Transform const& tr)
+{
+    detail::transform_visitor<Transform> visitor(tr);
+    visitor(geom);
+}
+
+template <typename Allocator, typename Transform>
+inline void transform(basic_geometry<Allocator> & geom, Transform const& tr)
+{
+    mapnik::util::apply_visitor(detail::transform_visitor<Transform>(tr), geom);
+}
+
+// into `dst`, whose buffers are reused when it is transformed repeatedly
+template <typename Geometry, typename Transform>
+inline void transform(Geometry const& src, Geometry & dst, Transform const& tr)
+{
+    detail::transform_copy<Transform> copy(tr);
+    copy(src, dst);
+}
+
+// `alloc` builds the geometry in `dst` when it holds another type
+template <typename Allocator, typename Transform>
+inline void transform(basic_geometry<Allocator> const& src, basic_geometry<Allocator> & dst, Transform const& tr,
+                      Allocator const& alloc = Allocator())
+{
+    detail::transform_copy<Transform> copy(tr);
+    copy(src, dst, alloc);
+}
+
+// Transforms the vertices of a vertex source one at a time, for streaming
+// pipelines where the geometry isn't copied (see geometry_pipeline.hpp).
+template <typename VertexSource, typename Transform>
+struct transform_adapter
+{
+    transform_adapter(VertexSource const& source, Transform const& tr)
+        : source_(source),
+          tr_(tr) {}
+
+    unsigned vertex(double*x, double*y) const
+    {
+        unsigned cmd = source_.vertex(x, y);
+        if (cmd != mapnik::SEG_END) tr_(*x, *y);
+        return cmd;
+    }
+
+    void rewind(unsigned path_id) const
+    {
+        source_.rewind(path_id);
+    }
+
+private:
+    VertexSource const& source_;
+    Transform tr_;
+};
+
+template <typename VertexSource, typename Transform>
+inline transform_adapter<VertexSource, Transform> make_transform_adapter(VertexSource const& source, Transform const& tr)
+{
+    return transform_adapter<VertexSource, Transform>(source, tr);
+}
+
+}}
+
+#endif //MAPNIK_GEOMETRY_TRANSFORM_HPP
@@ -0,0 +1,744 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_WKB_HPP
+#define MAPNIK_GEOMETRY_WKB_HPP
+
+#include "geometry_impl.hpp"
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+
+// WKB (OGC/ISO and PostGIS EWKB flavours) <-> new_geometry. Z and M ordinates
+// are accepted and dropped, EWKB SRIDs are skipped. Output is 2D ISO WKB.
+
+namespace mapnik { namespace new_geometry {
+
+enum wkb_byte_order : std::uint8_t
+{
+    wkb_xdr = 0, // big endian
+    wkb_ndr = 1  // little endian
+};
+
+enum wkb_geometry_type : std::uint32_t
+{
+    wkb_point = 1,
+    wkb_line_string = 2,
+    wkb_polygon = 3,
+    wkb_multi_point = 4,
+    wkb_multi_line_string = 5,
+    wkb_multi_polygon = 6,
+    wkb_geometry_collection = 7
+};
+
+namespace detail {
+
+// nesting levels of multi geometries and collections
+static const std::size_t wkb_max_depth = 16;
+
+inline wkb_byte_order native_byte_order()
+{
+    std::uint16_t one = 1;
+    std::uint8_t first;
+    std::memcpy(&first, &one, 1);
+    return first == 1 ? wkb_ndr : wkb_xdr;
+}
+
+inline std::uint32_t byte_swap(std::uint32_t v)
+{
+    return ((v & 0x000000ffu) << 24) | ((v & 0x0000ff00u) << 8) |
+           ((v & 0x00ff0000u) >> 8) | ((v & 0xff000000u) >> 24);
+}
+
+inline std::uint64_t byte_swap(std::uint64_t v)
+{
+    return (static_cast<std::uint64_t>(byte_swap(static_cast<std::uint32_t>(v))) << 32) |
+        byte_swap(static_cast<std::uint32_t>(v >> 32));
+}
+
+// unaligned loads straight from the buffer
+inline std::uint32_t load_uint32(char const* p, bool swap)
+{
+    std::uint32_t v;
+    std::memcpy(&v, p, 4);
+    return swap ? byte_swap(v) : v;
+}
+
+inline double load_double(char const* p, bool swap)
+{
+    if (!swap)
+    {
+        double d;
+        std::memcpy(&d, p, 8);
+        return d;
+    }
+    std::uint64_t v;
+    std::memcpy(&v, p, 8);
+    v = byte_swap(v);
+    double d;
+    std::memcpy(&d, &v, 8);
+    return d;
+}
+
+// geometry header : byte order, type (ISO 1000/2000/3000 or EWKB Z/M/SRID flags)
+struct wkb_header
+{
+    bool swap;
+    std::uint32_t type;     // 1..7
+    std::size_t point_size; // bytes per point, 16..32
+};
+
+// Bounds checked cursor, every read returns false past the end
+struct wkb_cursor
+{
+    char const* pos;
+    char const* end;
+
+    bool read_uint32(std::uint32_t & v, bool swap)
+    {
+        if (end - pos < 4) return false;
+        v = load_uint32(pos, swap);
+        pos += 4;
+        return true;
+    }
+
+    bool read_header(wkb_header & header)
+    {
+        if (pos == end) return false;
+        std::uint8_t order = static_cast<std::uint8_t>(*pos++);
+        if (order > 1) return false;
+        header.swap = (order != native_byte_order());
+        std::uint32_t type;
+        if (!read_uint32(type, header.swap)) return false;
+        std::size_t dims = 2;
+        if (type & 0x80000000u) ++dims; // EWKB Z
+        if (type & 0x40000000u) ++dims; // EWKB M
+        if (type & 0x20000000u)         // EWKB SRID
+        {
+            std::uint32_t srid;
+            if (!read_uint32(srid, header.swap)) return false;
+        }
+        type &= 0x0fffffffu;
+        switch (type / 1000)
+        {
+        case 0: break;
+        case 1: case 2: dims = 3; break;
+        case 3: dims = 4; break;
+        default: return false;
+        }
+        header.type = type % 1000;
+        header.point_size = dims * 8;
+        return header.type >= wkb_point && header.type <= wkb_geometry_collection;
+    }
+
+    // skip `count` points, false past the end
+    bool skip_points(std::uint32_t count, std::size_t point_size)
+    {
+        if (static_cast<std::size_t>(end - pos) / point_size < count) return false;
+        pos += count * point_size;
+        return true;
+    }
+
+    // false when `count` items of at least `min_size` bytes can't fit, keeps
+    // corrupt counts from driving reserve()
+    bool can_hold(std::uint32_t count, std::size_t min_size) const
+    {
+        return static_cast<std::size_t>(end - pos) / min_size >= count;
+    }
+};
+
+}
+
+// Read-only geometry over a WKB buffer owned by someone else (e.g. a database
+// row). Nothing is copied, wkb_vertex_adapter walks the bytes in place. The
+// buffer must outlive the view and its adapters.
+struct wkb_view
+{
+    wkb_view()
+        : data(nullptr), size(0) {}
+    wkb_view(char const* data_, std::size_t size_)
+        : data(data_), size(size_) {}
+
+    // true when the buffer holds exactly one well formed geometry, adapters
+    // assume it
+    bool valid() const
+    {
+        if (data == nullptr) return false;
+        detail::wkb_cursor cursor{data, data + size};
+        return skip(cursor, 0) && cursor.pos == cursor.end;
+    }
+
+    wkb_geometry_type type() const
+    {
+        detail::wkb_cursor cursor{data, data + size};
+        detail::wkb_header header;
+        if (!cursor.read_header(header)) throw std::runtime_error("invalid WKB");
+        return static_cast<wkb_geometry_type>(header.type);
+    }
+
+    char const* data;
+    std::size_t size;
+
+private:
+    static bool skip(detail::wkb_cursor & cursor, std::size_t depth)
+    {
+        detail::wkb_header header;
+        if (depth == detail::wkb_max_depth || !cursor.read_header(header)) return false;
+        std::uint32_t count;
+        switch (header.type)
+        {
+        case wkb_point:
+            return cursor.skip_points(1, header.point_size);
+        case wkb_line_string:
+            return cursor.read_uint32(count, header.swap) && cursor.skip_points(count, header.point_size);
+        case wkb_polygon:
+        {
+            if (!cursor.read_uint32(count, header.swap)) return false;
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                std::uint32_t num_points;
+                if (!cursor.read_uint32(num_points, header.swap) ||
+                    !cursor.skip_points(num_points, header.point_size)) return false;
+            }
+            return true;
+        }
+        default:
+        {
+            if (!cursor.read_uint32(count, header.swap)) return false;
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                if (!skip(cursor, depth + 1)) return false;
+            }
+            return true;
+        }
+        }
+    }
+};
+
+// Vertex adapter over a valid wkb_view : points are SEG_MOVETO, lines
+// SEG_MOVETO SEG_LINETO ..., rings end with SEG_CLOSE on their stored closing
+// point (closed_ring). Nesting is tracked on a fixed stack, no allocation.
+struct wkb_vertex_adapter
+{
+    static const std::size_t max_depth = detail::wkb_max_depth + 1;
+
+    explicit wkb_vertex_adapter(wkb_view const& view)
+        : view_(view)
+    {
+        rewind(0);
+    }
+
+    void rewind(unsigned) const
+    {
+        pos_ = view_.data;
+        stack_[0] = 1;
+        depth_ = 1;
+        points_left_ = 0;
+        rings_left_ = 0;
+    }
+
+    unsigned vertex(double*x, double*y) const
+    {
+        for (;;)
+        {
+            if (points_left_ > 0)
+            {
+                *x = detail::load_double(pos_, swap_);
+                *y = detail::load_double(pos_ + 8, swap_);
+                pos_ += point_size_;
+                --points_left_;
+                if (first_)
+                {
+                    first_ = false;
+                    return mapnik::SEG_MOVETO;
+                }
+                if (points_left_ == 0 && ring_) return mapnik::SEG_CLOSE;
+                return mapnik::SEG_LINETO;
+            }
+            if (rings_left_ > 0)
+            {
+                --rings_left_;
+                start_points(detail::load_uint32(pos_, swap_), true, 4);
+                continue;
+            }
+            if (depth_ == 0) return mapnik::SEG_END;
+            if (stack_[depth_ - 1] == 0)
+            {
+                --depth_;
+                continue;
+            }
+            --stack_[depth_ - 1];
+            next_geometry();
+        }
+    }
+
+private:
+    void start_points(std::uint32_t count, bool ring, std::size_t offset) const
+    {
+        pos_ += offset;
+        points_left_ = count;
+        ring_ = ring && count > 1;
+        first_ = true;
+    }
+
+    // header of the next geometry, the buffer was validated : no checks
+    void next_geometry() const
+    {
+        detail::wkb_cursor cursor{pos_, view_.data + view_.size};
+        detail::wkb_header header;
+        cursor.read_header(header);
+        pos_ = cursor.pos;
+        swap_ = header.swap;
+        point_size_ = header.point_size;
+        std::uint32_t count = (header.type == wkb_point) ? 1 : detail::load_uint32(pos_, swap_);
+        switch (header.type)
+        {
+        case wkb_point:
+            // POINT EMPTY is stored as NaN NaN
+            if (std::isnan(detail::load_double(pos_, swap_))) pos_ += point_size_;
+            else start_points(1, false, 0);
+            break;
+        case wkb_line_string:
+            start_points(count, false, 4);
+            break;
+        case wkb_polygon:
+            pos_ += 4;
+            rings_left_ = count;
+            break;
+        default:
+            pos_ += 4;
+            stack_[depth_++] = count;
+            break;
+        }
+    }
+
+    wkb_view view_;
+    mutable char const* pos_;
+    mutable std::uint32_t stack_[max_depth];
+    mutable std::size_t depth_;
+    mutable std::uint32_t points_left_;
+    mutable std::uint32_t rings_left_;
+    mutable std::size_t point_size_;
+    mutable bool swap_;
+    mutable bool ring_;
+    mutable bool first_;
+};
+
+// Decodes WKB into new_geometry types : Polygon -> polygon3, MultiPolygon ->
+// multi_polygon, containers are created with `alloc`.
+template <typename Allocator = std::allocator<point> >
+class basic_wkb_reader
+{
+public:
+    using geometry_type = basic_geometry<Allocator>;
+
+    explicit basic_wkb_reader(Allocator const& alloc = Allocator())
+        : alloc_(alloc) {}
+
+    // false on malformed or truncated input
+    bool read(char const* data, std::size_t size, geometry_type & geom)
+    {
+        detail::wkb_cursor cursor{data, data + size};
+        return read_geometry(cursor, geom, 0) && cursor.pos == cursor.end;
+    }
+
+private:
+    using line_string_type = basic_line_string<Allocator>;
+    using polygon_type = basic_polygon3<Allocator>;
+    using ring_type = typename polygon_type::ring_type;
+
+    template <typename Points>
+    bool read_points(detail::wkb_cursor & cursor, detail::wkb_header const& header, Points & points)
+    {
+        std::uint32_t count;
+        if (!cursor.read_uint32(count, header.swap)) return false;
+        char const* first = cursor.pos;
+        if (!cursor.skip_points(count, header.point_size)) return false;
+        points.reserve(count);
+        for (char const* p = first; p != cursor.pos; p += header.point_size)
+        {
+            points.emplace_back(detail::load_double(p, header.swap), detail::load_double(p + 8, header.swap));
+        }
+        return true;
+    }
+
+    bool read_polygon(detail::wkb_cursor & cursor, detail::wkb_header const& header, polygon_type & poly)
+    {
+        std::uint32_t count;
+        if (!cursor.read_uint32(count, header.swap)) return false;
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            ring_type ring(alloc_);
+            if (!read_points(cursor, header, ring)) return false;
+            if (i == 0) poly.set_exterior_ring(std::move(ring));
+            else poly.add_hole(std::move(ring));
+        }
+        return true;
+    }
+
+    // member of a Multi* geometry, must be of `type`
+    bool read_member_header(detail::wkb_cursor & cursor, detail::wkb_header & header, std::uint32_t type)
+    {
+        return cursor.read_header(header) && header.type == type;
+    }
+
+    bool read_geometry(detail::wkb_cursor & cursor, geometry_type & geom, std::size_t depth)
+    {
+        detail::wkb_header header;
+        if (depth == detail::wkb_max_depth || !cursor.read_header(header)) return false;
+        switch (header.type)
+        {
+        case wkb_point:
+        {
+            if (cursor.end - cursor.pos < static_cast<std::ptrdiff_t>(header.point_size)) return false;
+            geom = point(detail::load_double(cursor.pos, header.swap), detail::load_double(cursor.pos + 8, header.swap));
+            cursor.pos += header.point_size;
+            return true;
+        }
+        case wkb_line_string:
+        {
+            line_string_type line(alloc_);
+            if (!read_points(cursor, header, line.data)) return false;
+            geom = std::move(line);
+            return true;
+        }
+        case wkb_polygon:
+        {
+            polygon_type poly(alloc_);
+            if (!read_polygon(cursor, header, poly)) return false;
+            geom = std::move(poly);
+            return true;
+        }
+        }
+        std::uint32_t count;
+        if (!cursor.read_uint32(count, header.swap) || !cursor.can_hold(count, 5)) return false;
+        switch (header.type)
+        {
+        case wkb_multi_point:
+        {
+            basic_multi_point<Allocator> multi_pt(alloc_);
+            multi_pt.reserve(count);
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                detail::wkb_header member;
+                if (!read_member_header(cursor, member, wkb_point) ||
+                    cursor.end - cursor.pos < static_cast<std::ptrdiff_t>(member.point_size)) return false;
+                multi_pt.emplace_back(detail::load_double(cursor.pos, member.swap),
+                                      detail::load_double(cursor.pos + 8, member.swap));
+                cursor.pos += member.point_size;
+            }
+            geom = std::move(multi_pt);
+            return true;
+        }
+        case wkb_multi_line_string:
+        {
+            basic_multi_line_string<Allocator> multi_line(alloc_);
+            multi_line.reserve(count);
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                detail::wkb_header member;
+                multi_line.emplace_back(alloc_);
+                if (!read_member_header(cursor, member, wkb_line_string) ||
+                    !read_points(cursor, member, multi_line.back().data)) return false;
+            }
+            geom = std::move(multi_line);
+            return true;
+        }
+        case wkb_multi_polygon:
+        {
+            basic_multi_polygon<Allocator> multi_poly(alloc_);
+            multi_poly.reserve(count);
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                detail::wkb_header member;
+                multi_poly.emplace_back(alloc_);
+                if (!read_member_header(cursor, member, wkb_polygon) ||
+                    !read_polygon(cursor, member, multi_poly.back())) return false;
+            }
+            geom = std::move(multi_poly);
+            return true;
+        }
+        default:
+        {
+            basic_geometry_collection<Allocator> collection(alloc_);
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                collection.emplace_back();
+                if (!read_geometry(cursor, collection.back(), depth + 1)) return false;
+            }
+            geom = std::move(collection);
+            return true;
+        }
+        }
+    }
+
+    Allocator alloc_;
+};
+
+using wkb_reader = basic_wkb_reader<>;
+
+template <typename Allocator>
+inline bool from_wkb(char const* data, std::size_t size, basic_geometry<Allocator> & geom,
+                     Allocator const& alloc = Allocator())
+{
+    basic_wkb_reader<Allocator> reader(alloc);
+    return reader.read(data, size, geom);
+}
+
+// Visitor appending 2D ISO WKB to `out` (bytes in a std::string, reusable).
+// Closure says how polygon rings are stored, WKB rings are always closed.
+template <typename Closure = closed_ring>
+struct basic_wkb_writer
+{
+    explicit basic_wkb_writer(std::string & out, wkb_byte_order byte_order = detail::native_byte_order())
+        : out_(out),
+          byte_order_(byte_order),
+          swap_(byte_order != detail::native_byte_order()) {}
+
+    void operator() (point const& pt) const
+    {
+        header(wkb_point);
+        coord(pt.x, pt.y);
+    }
+
+    template <typename Allocator>
+    void operator() (basic_line_string<Allocator> const& line) const
+    {
+        header(wkb_line_string);
+        coords(line.data.data(), line.data.size());
+    }
+
+    void operator() (line_string_soa const& line) const
+    {
+        header(wkb_line_string);
+        coords(line.x.data(), line.y.data(), line.size());
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon<Allocator> const& poly) const
+    {
+        header(wkb_polygon);
+        table_rings(poly.data.data(), poly.rings.begin(), poly.rings.end());
+    }
+
+    void operator() (polygon_soa const& poly) const
+    {
+        header(wkb_polygon);
+        uint32(poly.rings.size());
+        for (auto const& ring : poly.rings)
+        {
+            ring_coords(poly.x.data() + std::get<0>(ring), poly.y.data() + std::get<0>(ring), std::get<1>(ring));
+        }
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon2<Allocator> const& poly) const
+    {
+        header(wkb_polygon);
+        uint32(poly.rings.size());
+        for (auto const& ring : poly.rings)
+        {
+            ring_coords(ring.data(), ring.size());
+        }
+    }
+
+    template <typename Allocator>
+    void operator() (basic_polygon3<Allocator> const& poly) const
+    {
+        header(wkb_polygon);
+        uint32(poly.interior_rings.size() + 1);
+        ring_coords(poly.exterior_ring.data(), poly.exterior_ring.size());
+        for (auto const& ring : poly.interior_rings)
+        {
+            ring_coords(ring.data(), ring.size());
+        }
+    }
+
+    template <typename Allocator>
+    void operator() (basic_multi_point<Allocator> const& multi_pt) const
+    {
+        header(wkb_multi_point);
+        uint32(multi_pt.size());
+        for (auto const& pt : multi_pt)
+        {
+            (*this)(pt);
+        }
+    }
+
+    template <typename Allocator>
+    void operator() (basic_multi_line_string<Allocator> const& multi_line) const
+    {
+        header(wkb_multi_line_string);
+        uint32(multi_line.size());
+        for (auto const& line : multi_line)
+        {
+            (*this)(line);
+        }
+    }
+
+    template <typename Allocator>
+    void operator() (basic_multi_polygon<Allocator> const& multi_poly) const
+    {
+        header(wkb_multi_polygon);
+        uint32(multi_poly.size());
+        for (auto const& poly : multi_poly)
+        {
+            (*this)(poly);
+        }
+    }
+
+    template <typename Allocator>
+    void operator() (basic_flat_multi_polygon<Allocator> const& multi_poly) const
+    {
+        header(wkb_multi_polygon);
+        uint32(multi_poly.parts.size());
+        for (auto const& part : multi_poly.parts)
+        {
+            header(wkb_polygon);
+            auto rings_begin = multi_poly.rings.begin() + std::get<0>(part);
+            table_rings(multi_poly.data.data(), rings_begin, rings_begin + std::get<1>(part));
+        }
+    }
+
+    template <typename Allocator>
+    void operator() (basic_geometry_collection<Allocator> const& collection) const
+    {
+        header(wkb_geometry_collection);
+        uint32(collection.size());
+        for (auto const& geom : collection)
+        {
+            mapnik::util::apply_visitor(*this, geom);
+        }
+    }
+
+private:
+    void uint32(std::size_t value) const
+    {
+        std::uint32_t v = static_cast<std::uint32_t>(value);
+        if (swap_) v = detail::byte_swap(v);
+        out_.append(reinterpret_cast<char const*>(&v), 4);
+    }
+
+    void header(wkb_geometry_type type) const
+    {
+        out_ += static_cast<char>(byte_order_);
+        uint32(type);
+    }
+
+    void coord(double x, double y) const
+    {
+        double xy[2] = { x, y };
+        if (swap_)
+        {
+            for (double & d : xy)
+            {
+                std::uint64_t v;
+                std::memcpy(&v, &d, 8);
+                v = detail::byte_swap(v);
+                std::memcpy(&d, &v, 8);
+            }
+        }
+        out_.append(reinterpret_cast<char const*>(xy), 16);
+    }
+
+    void coords(point const* points, std::size_t size) const
+    {
+        uint32(size);
+        if (!swap_)
+        {
+            static_assert(sizeof(point) == 2 * sizeof(double), "point must be two packed doubles");
+            out_.append(reinterpret_cast<char const*>(points), size * sizeof(point));
+            return;
+        }
+        for (std::size_t i = 0; i < size; ++i) coord(points[i].x, points[i].y);
+    }
+
+    void coords(double const* x, double const* y, std::size_t size) const
+    {
+        uint32(size);
+        for (std::size_t i = 0; i < size; ++i) coord(x[i], y[i]);
+    }
+
+    // rings as stored, plus the closing point for open_ring
+    void ring_coords(point const* points, std::size_t size) const
+    {
+        if (Closure::num_vertices(size) == size)
+        {
+            coords(points, size);
+            return;
+        }
+        uint32(size + 1);
+        for (std::size_t i = 0; i < size; ++i) coord(points[i].x, points[i].y);
+        coord(points[0].x, points[0].y);
+    }
+
+    void ring_coords(double const* x, double const* y, std::size_t size) const
+    {
+        if (Closure::num_vertices(size) == size)
+        {
+            coords(x, y, size);
+            return;
+        }
+        uint32(size + 1);
+        for (std::size_t i = 0; i < size; ++i) coord(x[i], y[i]);
+        coord(x[0], y[0]);
+    }
+
+    template <typename Iterator>
+    void table_rings(point const* data, Iterator first, Iterator last) const
+    {
+        uint32(static_cast<std::size_t>(last - first));
+        for (Iterator itr = first; itr != last; ++itr)
+        {
+            ring_coords(data + std::get<0>(*itr), std::get<1>(*itr));
+        }
+    }
+
+    std::string & out_;
+    wkb_byte_order byte_order_;
+    bool swap_;
+};
+
+using wkb_writer = basic_wkb_writer<>;
+
+// to_wkb<open_ring>(wkb, geom) for rings stored without closing point
+template <typename Closure = closed_ring, typename Geometry>
+inline void to_wkb(std::string & wkb, Geometry const& geom, wkb_byte_order byte_order = detail::native_byte_order())
+{
+    basic_wkb_writer<Closure> writer(wkb, byte_order);
+    writer(geom);
+}
+
+template <typename Closure = closed_ring, typename Allocator>
+inline void to_wkb(std::string & wkb, basic_geometry<Allocator> const& geom,
+                   wkb_byte_order byte_order = detail::native_byte_order())
+{
+    basic_wkb_writer<Closure> writer(wkb, byte_order);
+    mapnik::util::apply_visitor(writer, geom);
+}
+
+}}
+
+#endif //MAPNIK_GEOMETRY_WKB_HPP
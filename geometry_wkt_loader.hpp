@@ -0,0 +1,180 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GEOMETRY_WKT_LOADER_HPP
+#define MAPNIK_GEOMETRY_WKT_LOADER_HPP
+
+#include "geometry_impl.hpp"
+#include "geometry_envelope.hpp"
+#include "geometry_from_wkt.hpp"
+#include "geometry_mapped_file.hpp"
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <algorithm>
+#include <cstring>
+
+namespace mapnik { namespace new_geometry {
+
+struct wkt_load_stats
+{
+    wkt_load_stats()
+        : num_geometries(0),
+          num_errors(0),
+          box(empty_envelope()) {}
+
+    std::size_t num_geometries; // parsed lines
+    std::size_t num_errors;     // non empty lines that failed to parse
+    bounding_box box;           // of all parsed geometries
+};
+
+// One WKT geometry per line ingest : the input is split into line aligned
+// chunks parsed concurrently by up to `num_threads` workers, each with its
+// own output vector and envelope. Chunks are merged in input order.
+class wkt_loader
+{
+public:
+    explicit wkt_loader(unsigned num_threads = std::thread::hardware_concurrency(),
+                        std::size_t chunk_size = 1 << 22)
+        : num_threads_(std::max(num_threads, 1u)),
+          chunk_size_(std::max(chunk_size, std::size_t(1))) {}
+
+    // appends to `geometries`, false when the file can't be mapped
+    bool load(std::string const& filename, std::vector<geometry> & geometries, wkt_load_stats & stats) const
+    {
+        mapped_file file(filename);
+        if (!file.is_open()) return false;
+        stats = load(file.data(), file.size(), geometries);
+        return true;
+    }
+
+    wkt_load_stats load(char const* data, std::size_t size, std::vector<geometry> & geometries) const
+    {
+        std::vector<chunk> chunks;
+        char const* end = data + size;
+        for (char const* first = data; first != end; )
+        {
+            char const* last = first + std::min(chunk_size_, static_cast<std::size_t>(end - first));
+            if (last != end)
+            {
+                char const* eol = static_cast<char const*>(std::memchr(last, '\n', static_cast<std::size_t>(end - last)));
+                last = (eol == nullptr) ? end : eol + 1;
+            }
+            chunks.emplace_back(first, last);
+            first = last;
+        }
+
+        std::atomic<std::size_t> next(0);
+        auto worker = [&chunks, &next]()
+        {
+            for (std::size_t i = next++; i < chunks.size(); i = next++)
+            {
+                try
+                {
+                    parse_chunk(chunks[i]);
+                }
+                catch (...)
+                {
+                    chunks[i].exception = std::current_exception();
+                }
+            }
+        };
+        std::size_t num_workers = std::min(static_cast<std::size_t>(num_threads_), chunks.size());
+        std::vector<std::thread> threads;
+        for (std::size_t i = 1; i < num_workers; ++i)
+        {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto & t : threads) t.join();
+
+        wkt_load_stats stats;
+        std::size_t count = 0;
+        for (auto const& c : chunks)
+        {
+            if (c.exception) std::rethrow_exception(c.exception);
+            count += c.geometries.size();
+        }
+        geometries.reserve(geometries.size() + count);
+        for (auto & c : chunks)
+        {
+            geometries.insert(geometries.end(),
+                              std::make_move_iterator(c.geometries.begin()),
+                              std::make_move_iterator(c.geometries.end()));
+            stats.num_errors += c.num_errors;
+            expand(stats.box, c.box);
+        }
+        stats.num_geometries = count;
+        return stats;
+    }
+
+private:
+    struct chunk
+    {
+        chunk(char const* first_, char const* last_)
+            : first(first_),
+              last(last_),
+              box(empty_envelope()),
+              num_errors(0) {}
+
+        char const* first;
+        char const* last;
+        std::vector<geometry> geometries;
+        bounding_box box;
+        std::size_t num_errors;
+        std::exception_ptr exception;
+    };
+
+    static void parse_chunk(chunk & c)
+    {
+        wkt_parser parser;
+        char const* itr = c.first;
+        while (itr != c.last)
+        {
+            char const* eol = static_cast<char const*>(std::memchr(itr, '\n', static_cast<std::size_t>(c.last - itr)));
+            char const* line_end = (eol == nullptr) ? c.last : eol;
+            char const* line_begin = itr;
+            itr = (eol == nullptr) ? c.last : eol + 1;
+            while (line_begin != line_end && (*line_begin == ' ' || *line_begin == '\t' || *line_begin == '\r')) ++line_begin;
+            if (line_begin == line_end) continue;
+            geometry geom;
+            if (!parser.parse(line_begin, line_end, geom))
+            {
+                ++c.num_errors;
+                continue;
+            }
+            expand(c.box, envelope(geom));
+            c.geometries.push_back(std::move(geom));
+        }
+    }
+
+    unsigned num_threads_;
+    std::size_t chunk_size_;
+};
+
+}}
+
+#endif //MAPNIK_GEOMETRY_WKT_LOADER_HPP
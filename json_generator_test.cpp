@@ -31,50 +31,13 @@
 #include <boost/timer/timer.hpp>
 
 #include "geometry_impl.hpp"
-
-//#include <mapnik/util/geometry_to_geojson.hpp>
+#include "geometry_to_geojson.hpp"
 
 #include <mapnik/json/geometry_generator_grammar.hpp>
 #include <mapnik/json/geometry_generator_grammar_impl.hpp>
 #include <boost/spirit/include/support_container.hpp>
 
 
-namespace boost { namespace spirit { namespace traits {
-
-template <>
-struct is_container<mapnik::new_geometry::vertex_adapter const> : mpl::true_ {} ;
-
-template <>
-struct container_iterator<mapnik::new_geometry::vertex_adapter const>
-{
-    using type = mapnik::util::path_iterator<mapnik::new_geometry::vertex_adapter>;
-};
-
-template <>
-struct begin_container<mapnik::new_geometry::vertex_adapter const>
-{
-    static mapnik::util::path_iterator<mapnik::new_geometry::vertex_adapter>
-    call (mapnik::new_geometry::vertex_adapter const& g)
-    {
-        return mapnik::util::path_iterator<mapnik::new_geometry::vertex_adapter>(g);
-    }
-};
-
-template <>
-struct end_container<mapnik::new_geometry::vertex_adapter const>
-{
-    static mapnik::util::path_iterator<mapnik::new_geometry::vertex_adapter>
-    call (mapnik::new_geometry::vertex_adapter const&)
-    {
-        return mapnik::util::path_iterator<mapnik::new_geometry::vertex_adapter>();
-    }
-};
-
-
-}}}
-
-
-
 namespace mapnik  {
 
 template <typename Geometry>
@@ -112,21 +75,6 @@ struct get_first<mapnik::vertex_adapter>
         return coord;
     }
 };
-
-// adapt new geometry get_first
-template <>
-struct get_first<mapnik::new_geometry::vertex_adapter>
-{
-    using geometry_type =  mapnik::new_geometry::vertex_adapter;
-    using result_type = typename geometry_type::value_type;
-    result_type operator() (geometry_type const& geom) const
-    {
-        result_type coord;
-        geom.rewind(0);
-        std::get<0>(coord) = geom.vertex(&std::get<1>(coord),&std::get<2>(coord));
-        return coord;
-    }
-};
 } // namespace detail
 } // namespace json
 } // namespace mapnik
@@ -155,7 +103,6 @@ int main(int, char **)
                         poly->line_to(x,y);
 
                 }
-                poly->line_to(0,10);// FIXME
                 poly->close_path();
             }
             geom_cont.push_back(poly.release());
@@ -188,23 +135,100 @@ int main(int, char **)
                     double y = 10 - i;
                     ring.add_coord(x, y);
                 }
-                // close ring
-                ring.add_coord(0, 10);
                 poly.add_ring(std::move(ring));
             }
             geom_cont.push_back(mapnik::new_geometry::geometry(std::move(poly)));
         }
         mapnik::new_geometry::point pt(100,200);
         geom_cont.push_back(mapnik::new_geometry::geometry(std::move(pt)));
+        // rings are stored open, the writer closes them
         for (auto const& geom : geom_cont)
         {
             std::string json;
-            mapnik::new_geometry::vertex_adapter v_adapter(geom);
-            mapnik::to_geojson_1(json, v_adapter);
+            mapnik::new_geometry::to_geojson<mapnik::new_geometry::open_ring>(json, geom);
             std::cerr << json << std::endl;
         }
     }
 #endif
 
+#if 1
+    {
+        // same polygons through the Karma grammar and geojson_writer
+        const std::size_t num_geom = 10000;
+        const std::size_t num_rings = 3;
+        const std::size_t num_points = 100;
+        mapnik::geometry_container geom_cont;
+        std::vector<mapnik::new_geometry::polygon3> new_geom_cont;
+        for (std::size_t n = 0; n < num_geom; ++n)
+        {
+            std::unique_ptr<mapnik::geometry_type> poly(
+                new mapnik::geometry_type(mapnik::geometry_type::types::Polygon));
+            mapnik::new_geometry::polygon3 new_poly;
+            for (std::size_t j = 0; j < num_rings; ++j)
+            {
+                mapnik::new_geometry::linear_ring ring;
+                for (std::size_t i = 0; i < num_points; ++i)
+                {
+                    double x = n + i * 0.1;
+                    double y = n - i * 0.1;
+                    if (i == 0)
+                        poly->move_to(x, y);
+                    else
+                        poly->line_to(x, y);
+                    ring.emplace_back(x, y);
+                }
+                // the Karma grammar writes the path as given, new_geometry
+                // rings are stored open and closed by the writer
+                poly->line_to(n, n);
+                poly->close_path();
+                if (j == 0) new_poly.set_exterior_ring(std::move(ring));
+                else new_poly.add_hole(std::move(ring));
+            }
+            geom_cont.push_back(poly.release());
+            new_geom_cont.push_back(std::move(new_poly));
+        }
+        std::size_t size = 0;
+        {
+            std::cerr << "Karma geometry_generator_grammar:";
+            boost::timer::auto_cpu_timer t;
+            std::string json;
+            for (auto const& geom : geom_cont)
+            {
+                json.clear();
+                mapnik::vertex_adapter va(geom);
+                mapnik::to_geojson_1(json, va);
+                size += json.size();
+            }
+        }
+        std::cerr << "bytes=" << size << std::endl;
+        size = 0;
+        {
+            std::cerr << "new_geometry::geojson_writer:";
+            boost::timer::auto_cpu_timer t;
+            std::string json;
+            for (auto const& geom : new_geom_cont)
+            {
+                json.clear();
+                mapnik::new_geometry::to_geojson<mapnik::new_geometry::open_ring>(json, geom);
+                size += json.size();
+            }
+        }
+        std::cerr << "bytes=" << size << std::endl;
+        size = 0;
+        {
+            std::cerr << "new_geometry::geojson_writer (precision=6):";
+            boost::timer::auto_cpu_timer t;
+            std::string json;
+            for (auto const& geom : new_geom_cont)
+            {
+                json.clear();
+                mapnik::new_geometry::to_geojson<mapnik::new_geometry::open_ring>(json, geom, 6);
+                size += json.size();
+            }
+        }
+        std::cerr << "bytes=" << size << std::endl;
+    }
+#endif
+
     return EXIT_SUCCESS;
 }
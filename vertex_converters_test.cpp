@@ -23,6 +23,9 @@
 #include <iostream>
 #include <cstdint>
 #include <vector>
+#include <limits>
+#include <string>
+#include <cmath>
 #include <cassert>
 
 #include <mapnik/geometry.hpp>
@@ -30,51 +33,24 @@
 #include <mapnik/feature_factory.hpp>
 #include <mapnik/json/feature_parser.hpp>
 #include <mapnik/vertex_converters.hpp>
+#include <mapnik/view_transform.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/attribute.hpp>
 #include <mapnik/json/geometry_generator_grammar.hpp>
 #include <mapnik/json/geometry_generator_grammar_impl.hpp>
 #include <mapnik/json/geometry_grammar_impl.hpp>
 #include <mapnik/json/feature_grammar_impl.hpp>
 
 #include <boost/spirit/include/support_container.hpp>
+#include <boost/timer/timer.hpp>
 
 #include "geometry_impl.hpp"
-
-
-namespace boost { namespace spirit { namespace traits {
-
-template <>
-struct is_container<mapnik::new_geometry::vertex_adapter const> : mpl::true_ {} ;
-
-template <>
-struct container_iterator<mapnik::new_geometry::vertex_adapter const>
-{
-    using type = mapnik::util::path_iterator<mapnik::new_geometry::vertex_adapter>;
-};
-
-template <>
-struct begin_container<mapnik::new_geometry::vertex_adapter const>
-{
-    static mapnik::util::path_iterator<mapnik::new_geometry::vertex_adapter>
-    call (mapnik::new_geometry::vertex_adapter const& g)
-    {
-        std::cerr << "begin_container" << std::endl;
-        return mapnik::util::path_iterator<mapnik::new_geometry::vertex_adapter>(g);
-    }
-};
-
-template <>
-struct end_container<mapnik::new_geometry::vertex_adapter const>
-{
-    static mapnik::util::path_iterator<mapnik::new_geometry::vertex_adapter>
-    call (mapnik::new_geometry::vertex_adapter const&)
-    {
-        return mapnik::util::path_iterator<mapnik::new_geometry::vertex_adapter>();
-    }
-};
-
-
-}}}
-
+#include "geometry_from_geojson.hpp"
+#include "geometry_to_geojson.hpp"
+#include "geometry_envelope.hpp"
+#include "geometry_pipeline.hpp"
 
 
 namespace mapnik  {
@@ -108,6 +84,44 @@ struct to_json_converter
     }
 };
 
+struct vertex_summer
+{
+    vertex_summer()
+        : count(0),
+          sum(0) {}
+
+    template <typename T>
+    void add_path(T & path)
+    {
+        double x, y;
+        path.rewind(0);
+        while (path.vertex(&x, &y) != mapnik::SEG_END)
+        {
+            sum += x + y;
+            ++count;
+        }
+    }
+    std::size_t count;
+    double sum;
+};
+
+// every vertex with its command, in output order
+struct vertex_recorder
+{
+    template <typename T>
+    void add_path(T & path)
+    {
+        double x, y;
+        unsigned cmd;
+        path.rewind(0);
+        while ((cmd = path.vertex(&x, &y)) != mapnik::SEG_END)
+        {
+            vertices.push_back(mapnik::vertex2d(x, y, cmd));
+        }
+    }
+    std::vector<mapnik::vertex2d> vertices;
+};
+
 int main(int argc, char ** argv)
 {
     if (argc !=2)
@@ -132,11 +146,187 @@ int main(int argc, char ** argv)
         std::cerr << json_out << std::endl;
     }
 
-    //using vertex_converter_type = vertex_converter<to_json_converter,smooth_tag>;
+    mapnik::new_geometry::geometry new_geom;
+    if (!mapnik::new_geometry::from_geojson(json, new_geom))
+    {
+        throw std::runtime_error("Failed to parse geojson (new_geometry)");
+    }
+    {
+        std::string json_out;
+        mapnik::new_geometry::to_geojson(json_out, new_geom);
+        std::cerr << json_out << std::endl;
+    }
+    {
+        // "geometry": null is an empty geometry, [] an empty point, nesting is capped
+        mapnik::new_geometry::geojson_parser parser;
+        mapnik::new_geometry::geometry geom;
+        bool ok = parser.parse(std::string("{\"type\":\"Feature\",\"geometry\":null,\"properties\":{}}"), geom)
+            && geom.is<mapnik::new_geometry::geometry_collection>()
+            && geom.get<mapnik::new_geometry::geometry_collection>().empty();
+        ok = ok && parser.parse(std::string("{\"type\":\"Point\",\"coordinates\":[]}"), geom)
+            && geom.is<mapnik::new_geometry::point>()
+            && std::isnan(geom.get<mapnik::new_geometry::point>().x);
+        std::string nested("{\"type\":\"Point\",\"coordinates\":[1,2]}");
+        for (std::size_t depth = 1; depth < mapnik::new_geometry::geojson_parser::max_depth; ++depth)
+        {
+            nested = "{\"type\":\"GeometryCollection\",\"geometries\":[" + nested + "]}";
+        }
+        ok = ok && parser.parse(nested, geom);
+        nested = "{\"type\":\"GeometryCollection\",\"geometries\":[" + nested + "]}";
+        ok = ok && !parser.parse(nested, geom);
+        if (!ok)
+        {
+            std::cerr << "geojson_parser null geometry, empty point or nesting limit is wrong" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    {
+        // empty point and empty polygon member have no coordinates
+        double nan = std::numeric_limits<double>::quiet_NaN();
+        std::string json_out;
+        mapnik::new_geometry::to_geojson(json_out, mapnik::new_geometry::point(nan, nan));
+        bool ok = json_out == "{\"type\":\"Point\",\"coordinates\":[]}";
+        mapnik::new_geometry::multi_polygon multi_poly;
+        multi_poly.resize(2);
+        multi_poly.front().exterior_ring.emplace_back(0, 0);
+        multi_poly.front().exterior_ring.emplace_back(0, 1);
+        multi_poly.front().exterior_ring.emplace_back(1, 1);
+        multi_poly.front().exterior_ring.emplace_back(0, 0);
+        json_out.clear();
+        mapnik::new_geometry::to_geojson(json_out, multi_poly);
+        ok = ok && json_out == "{\"type\":\"MultiPolygon\",\"coordinates\":[[[[0,0],[0,1],[1,1],[0,0]]],[]]}";
+        if (!ok)
+        {
+            std::cerr << "geojson_writer empty geometry is wrong : " << json_out << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    const std::size_t num_iterations = 100000;
+    {
+        std::cerr << "mapnik::json::from_geojson (Qi feature grammar):";
+        boost::timer::auto_cpu_timer t;
+        for (std::size_t i = 0; i < num_iterations; ++i)
+        {
+            mapnik::feature_ptr f(mapnik::feature_factory::create(ctx,1));
+            mapnik::json::from_geojson(json.c_str(), *f);
+        }
+    }
+    {
+        std::cerr << "mapnik::new_geometry::geojson_parser:";
+        boost::timer::auto_cpu_timer t;
+        mapnik::new_geometry::geojson_parser parser;
+        for (std::size_t i = 0; i < num_iterations; ++i)
+        {
+            mapnik::new_geometry::geometry geom;
+            parser.parse(json, geom);
+        }
+    }
 
-    //to_json_converter to_json;
-    //vertex_converter_type converter(clip_box, to_json, sym, common.t_, prj_trans, tr,
-    //                                feature,common.vars_,common.scale_factor_);
+    // clip | transform | simplify | offset to a 256x256 view of the geometry
+    mapnik::new_geometry::bounding_box extent = mapnik::new_geometry::envelope(new_geom);
+    extent.p0.x -= 1.0;
+    extent.p0.y -= 1.0;
+    extent.p1.x += 1.0;
+    extent.p1.y += 1.0;
+    double pad_x = 0.1 * (extent.p1.x - extent.p0.x);
+    double pad_y = 0.1 * (extent.p1.y - extent.p0.y);
+    mapnik::new_geometry::bounding_box clip_box(extent.p0.x + pad_x, extent.p0.y + pad_y,
+                                                extent.p1.x - pad_x, extent.p1.y - pad_y);
+    double const tolerance = 1.0;
+    double const offset = 2.0;
+    {
+        using vertex_converter_type = mapnik::vertex_converter<vertex_summer,
+                                                               mapnik::clip_line_tag,
+                                                               mapnik::transform_tag,
+                                                               mapnik::simplify_tag,
+                                                               mapnik::offset_transform_tag>;
+        mapnik::box2d<double> map_extent(extent.p0.x, extent.p0.y, extent.p1.x, extent.p1.y);
+        mapnik::box2d<double> map_clip_box(clip_box.p0.x, clip_box.p0.y, clip_box.p1.x, clip_box.p1.y);
+        mapnik::view_transform view(256, 256, map_extent);
+        mapnik::projection merc("+init=epsg:3857");
+        mapnik::proj_transform prj_trans(merc, merc);
+        agg::trans_affine tr;
+        mapnik::line_symbolizer sym;
+        mapnik::put(sym, mapnik::keys::simplify_tolerance, tolerance);
+        mapnik::put(sym, mapnik::keys::offset, offset);
+        mapnik::attributes vars;
+        vertex_summer summer;
+        {
+            std::cerr << "mapnik::vertex_converter clip|transform|simplify|offset:";
+            boost::timer::auto_cpu_timer t;
+            for (std::size_t i = 0; i < num_iterations; ++i)
+            {
+                vertex_converter_type converter(map_clip_box, summer, sym, view, prj_trans, tr, *feature, vars, 1.0);
+                converter.set<mapnik::clip_line_tag>();
+                converter.set<mapnik::transform_tag>();
+                converter.set<mapnik::simplify_tag>();
+                converter.set<mapnik::offset_transform_tag>();
+                for (auto const& geom : feature->paths())
+                {
+                    mapnik::vertex_adapter va(geom);
+                    converter.apply(va);
+                }
+            }
+        }
+        std::cerr << "vertices = " << summer.count / num_iterations << " sum = " << summer.sum / num_iterations << std::endl;
+    }
+    {
+        mapnik::new_geometry::simplifier simplify(tolerance);
+        auto pipeline = mapnik::new_geometry::clip_line_stage(clip_box)
+            | mapnik::new_geometry::make_transform_stage(mapnik::new_geometry::affine_transform::screen(extent, 256, 256))
+            | mapnik::new_geometry::simplify_stage(simplify)
+            | mapnik::new_geometry::offset_stage(offset);
+        vertex_summer summer;
+        {
+            std::cerr << "mapnik::new_geometry pipeline clip|transform|simplify|offset:";
+            boost::timer::auto_cpu_timer t;
+            for (std::size_t i = 0; i < num_iterations; ++i)
+            {
+                mapnik::new_geometry::apply_pipeline(pipeline, new_geom, summer);
+            }
+        }
+        std::cerr << "vertices = " << summer.count / num_iterations << " sum = " << summer.sum / num_iterations << std::endl;
+    }
+    {
+        // streaming (transform) and buffering (simplify) stages mixed :
+        // paths come out in input order, each starting with SEG_MOVETO
+        mapnik::new_geometry::multi_line_string lines;
+        lines.emplace_back();
+        lines.back().add_coord(0, 0);
+        lines.back().add_coord(1, 0);
+        lines.back().add_coord(2, 0);
+        lines.back().add_coord(3, 1);
+        lines.emplace_back();
+        lines.back().add_coord(10, 10);
+        lines.back().add_coord(11, 10);
+        lines.back().add_coord(12, 12);
+        mapnik::new_geometry::geometry lines_geom(std::move(lines));
+        mapnik::new_geometry::simplifier simplify(0.5);
+        auto pipeline = mapnik::new_geometry::make_transform_stage(mapnik::new_geometry::affine_transform::translation(100, 0))
+            | mapnik::new_geometry::simplify_stage(simplify)
+            | mapnik::new_geometry::make_transform_stage(mapnik::new_geometry::affine_transform::translation(0, 100));
+        vertex_recorder recorder;
+        mapnik::new_geometry::apply_pipeline(pipeline, lines_geom, recorder);
+        mapnik::vertex2d const expected[] = {
+            mapnik::vertex2d(100, 100, mapnik::SEG_MOVETO),
+            mapnik::vertex2d(102, 100, mapnik::SEG_LINETO),
+            mapnik::vertex2d(103, 101, mapnik::SEG_LINETO),
+            mapnik::vertex2d(110, 110, mapnik::SEG_MOVETO),
+            mapnik::vertex2d(111, 110, mapnik::SEG_LINETO),
+            mapnik::vertex2d(112, 112, mapnik::SEG_LINETO) };
+        bool ok = recorder.vertices.size() == sizeof(expected) / sizeof(expected[0]);
+        for (std::size_t i = 0; ok && i < recorder.vertices.size(); ++i)
+        {
+            ok = recorder.vertices[i].x == expected[i].x && recorder.vertices[i].y == expected[i].y
+                && recorder.vertices[i].cmd == expected[i].cmd;
+        }
+        if (!ok)
+        {
+            std::cerr << "pipeline transform|simplify|transform reordered the output" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
     return EXIT_SUCCESS;
 }